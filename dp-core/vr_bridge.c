@@ -701,7 +701,7 @@ bridge_table_lock(struct vr_interface *vif, uint8_t *mac)
     if (!bridge_table_lock)
         return -EINVAL;
 
-    hash = vr_hash(mac, VR_ETHER_ALEN, 0);
+    hash = vr_hash_key(vr_hash_crc32c_enabled, mac, VR_ETHER_ALEN, 0);
     hash %= vr_num_cpus;
 
     vr_get_mono_time(&t1s, &t1ns);
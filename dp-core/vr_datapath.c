@@ -11,6 +11,7 @@
 #include <vr_mirror.h>
 #include <vr_bridge.h>
 #include <vr_packet.h>
+#include <vr_trace.h>
 
 extern unsigned int vr_inet_route_flags(unsigned int, unsigned int);
 extern struct vr_vrf_stats *(*vr_inet_vrf_stats)(unsigned short,
@@ -662,6 +663,9 @@ vr_fabric_input(struct vr_interface *vif, struct vr_packet *pkt,
         return 0;
     }
 
+    VR_TRACE(VR_TRACE_FABRIC_INPUT, vif, pkt, fmd, NULL, vlan_id,
+            pkt->vp_type);
+
     if (pkt->vp_type == VP_TYPE_IP6)
         return vif_xconnect(vif, pkt, fmd);
 
@@ -14,11 +14,14 @@
 #include "vr_sandesh.h"
 #include "vr_message.h"
 #include "vr_btable.h"
+#include "vr_flow_event.h"
 #include "vr_fragment.h"
 #include "vr_datapath.h"
 #include "vr_hash.h"
 #include "vr_ip_mtrie.h"
 #include "vr_bridge.h"
+#include "vr_stats.h"
+#include "vr_trace.h"
 
 #define VR_NUM_FLOW_TABLES          1
 
@@ -28,6 +31,11 @@
 
 unsigned int vr_flow_entries = VR_DEF_FLOW_ENTRIES;
 unsigned int vr_oflow_entries = 0;
+/*
+ * the IPv4 flow table is opt-in, till the agent maps it through
+ * VR_MEM_INET_FLOW_TABLE_OBJECT and reclaims its idle entries
+ */
+unsigned int vr_inet_flow_entries = 0;
 
 /*
  * host can provide its own memory . Point in case is the DPDK. In DPDK,
@@ -41,7 +49,12 @@ void *vr_oflow_table;
  * is set by somebody and passed to agent for it to map
  */
 unsigned char *vr_flow_path;
+/* same for the flow event rings */
+void *vr_flow_event_table;
+unsigned char *vr_flow_event_path;
 unsigned int vr_flow_hold_limit = VR_DEF_MAX_FLOW_TABLE_HOLD_COUNT;
+unsigned int vr_flow_queue_depth = VR_MAX_FLOW_QUEUE_ENTRIES;
+unsigned int vr_flow_queue_budget = VR_DEF_FLOW_QUEUE_BUDGET;
 
 #if defined(__linux__) && defined(__KERNEL__)
 extern short vr_flow_major;
@@ -61,6 +74,9 @@ __vr_flow_schedule_transition(struct vrouter *, struct vr_flow_entry *,
         unsigned int, unsigned short);
 static bool vr_flow_is_fat_flow(struct vrouter *, struct vr_packet *,
         struct vr_flow_entry *);
+static flow_result_t vr_inet_flow_action(struct vrouter *,
+        struct vr_inet_flow_entry *, unsigned int, struct vr_packet *,
+        struct vr_forwarding_md *);
 
 struct vr_flow_entry *vr_find_flow(struct vrouter *, struct vr_flow *,
         uint8_t, unsigned int *);
@@ -313,6 +329,140 @@ vr_flow_get_va(struct vrouter *router, uint64_t offset)
     return vr_htable_get_address(router->vr_flow_table, offset);
 }
 
+unsigned int
+vr_inet_flow_table_size(struct vrouter *router)
+{
+    if (!router->vr_inet_flow_table)
+        return 0;
+
+    return vr_htable_size(router->vr_inet_flow_table);
+}
+
+void *
+vr_inet_flow_get_va(struct vrouter *router, uint64_t offset)
+{
+    if (!router->vr_inet_flow_table)
+        return NULL;
+
+    return vr_htable_get_address(router->vr_inet_flow_table, offset);
+}
+
+unsigned int
+vr_flow_event_table_size(struct vrouter *router)
+{
+    if (!router->vr_flow_event_table)
+        return 0;
+
+    return vr_btable_size(router->vr_flow_event_table);
+}
+
+void *
+vr_flow_event_get_va(struct vrouter *router, uint64_t offset)
+{
+    if (!router->vr_flow_event_table)
+        return NULL;
+
+    return vr_btable_get_address(router->vr_flow_event_table, offset);
+}
+
+static inline struct vr_flow_event_ring *
+vr_flow_event_ring_get(struct vrouter *router, unsigned int cpu)
+{
+    return (struct vr_flow_event_ring *)vr_btable_get(
+            router->vr_flow_event_table,
+            cpu * (VR_FLOW_EVENT_RING_SIZE / sizeof(struct vr_flow_event)));
+}
+
+/*
+ * post an event to the ring of the current cpu. the slot is reserved
+ * atomically, so that the process context and the softirq on the same
+ * cpu do not step on each other, and the sequence number is written
+ * last for the agent to know the event is complete
+ */
+static void
+__vr_flow_event_post(struct vrouter *router, unsigned int index,
+        uint8_t type, uint8_t gen_id, unsigned short flags, uint32_t data)
+{
+    uint64_t seq;
+    struct vr_flow_event *event;
+    struct vr_flow_event_ring *ring;
+
+    if (!router->vr_flow_event_table)
+        return;
+
+    ring = vr_flow_event_ring_get(router, vr_get_cpu());
+    if (!ring)
+        return;
+
+    seq = vr_sync_fetch_and_add_64u(&ring->fer_hdr.ferh_head, 1);
+    event = &ring->fer_events[seq % VR_FLOW_EVENT_RING_ENTRIES];
+
+    event->fev_seq = 0;
+    vr_sync_synchronize();
+    event->fev_index = index;
+    event->fev_type = type;
+    event->fev_gen_id = gen_id;
+    event->fev_flags = flags;
+    event->fev_data = data;
+    vr_sync_synchronize();
+    event->fev_seq = (uint32_t)(seq + 1);
+
+    return;
+}
+
+static void
+vr_flow_event_post(struct vrouter *router, struct vr_flow_entry *fe,
+        unsigned int index, uint8_t type, uint32_t data)
+{
+    __vr_flow_event_post(router, index, type, fe->fe_gen_id, fe->fe_flags,
+            data);
+    return;
+}
+
+/*
+ * the dirty bitmap has a bit per flow entry (including the overflow
+ * entries) per cpu. the datapath sets the bit whenever the stats or the
+ * state of the flow change, and the consumer harvests and clears the bits
+ * of all the cpus, so that a periodic synchronization with the flow table
+ * visits only the entries that changed since the previous one
+ */
+static inline uint64_t *
+vr_flow_dirty_word_get(struct vrouter *router, unsigned int cpu,
+        unsigned int word)
+{
+    return (uint64_t *)vr_btable_get(router->vr_flow_dirty_table,
+            (cpu * router->vr_flow_dirty_words) + word);
+}
+
+static inline void
+vr_flow_mark_dirty(struct vrouter *router, unsigned int index)
+{
+    unsigned int cpu;
+    uint64_t bit, *word;
+
+    if (!router->vr_flow_dirty_table)
+        return;
+
+    cpu = vr_get_cpu();
+    if ((cpu >= vr_num_cpus) || (index / 64 >= router->vr_flow_dirty_words))
+        return;
+
+    word = vr_flow_dirty_word_get(router, cpu, index / 64);
+    if (!word)
+        return;
+
+    /*
+     * the atomic operation is needed since the process context and the
+     * softirq on the same cpu can race. skip it, and the cache line
+     * invalidation, if the entry is already dirty
+     */
+    bit = 1ULL << (index % 64);
+    if (!(*word & bit))
+        (void)vr_sync_fetch_and_or_64u(word, bit);
+
+    return;
+}
+
 struct vr_flow_entry *
 vr_flow_get_entry(struct vrouter *router, int index)
 {
@@ -323,6 +473,109 @@ vr_flow_get_entry(struct vrouter *router, int index)
             vr_htable_get_hentry_by_index(router->vr_flow_table, index);
 }
 
+static inline bool
+vr_flow_index_is_inet(struct vrouter *router, int index)
+{
+    return router->vr_inet_flow_table && (index >= 0) &&
+        ((unsigned int)index >= router->vr_inet_flow_base);
+}
+
+static struct vr_inet_flow_entry *
+vr_inet_flow_get_entry(struct vrouter *router, int index)
+{
+    if (!vr_flow_index_is_inet(router, index))
+        return NULL;
+
+    return (struct vr_inet_flow_entry *)
+        vr_htable_get_hentry_by_index(router->vr_inet_flow_table,
+                index - router->vr_inet_flow_base);
+}
+
+static vr_hentry_key
+vr_inet_flow_get_key(vr_htable_t htable, vr_hentry_t *entry,
+        unsigned int *key_len)
+{
+    struct vr_inet_flow_entry *ife = CONTAINER_OF(ife_hentry,
+                             struct vr_inet_flow_entry, entry);
+
+    if ((ife->ife_flags & VR_FLOW_FLAG_DELETE_MARKED) ||
+                    !(ife->ife_flags & VR_FLOW_FLAG_ACTIVE))
+        return NULL;
+
+    if (key_len)
+        *key_len = sizeof(ife->ife_key);
+
+    return &ife->ife_key;
+}
+
+/* the key of an IPv4 flow is at the start of struct vr_flow */
+static struct vr_inet_flow_entry *
+vr_inet_flow_find(struct vrouter *router, struct vr_flow *key,
+        unsigned int *index)
+{
+    struct vr_inet_flow_entry *ife;
+
+    if (!router->vr_inet_flow_table || (key->flow_family != AF_INET))
+        return NULL;
+
+    ife = (struct vr_inet_flow_entry *)vr_htable_find_hentry(
+            router->vr_inet_flow_table, key, sizeof(ife->ife_key));
+    if (ife && index)
+        *index = router->vr_inet_flow_base + ife->ife_hentry.hentry_index;
+
+    return ife;
+}
+
+/*
+ * the entry is not visible to the lookups till it is made active, once
+ * the caller has set it up
+ */
+static struct vr_inet_flow_entry *
+vr_inet_flow_get_free_entry(struct vrouter *router, struct vr_flow *key,
+        unsigned int *index)
+{
+    struct vr_inet_flow_entry *ife;
+
+    if (!router->vr_inet_flow_table || (key->flow_family != AF_INET))
+        return NULL;
+
+    ife = (struct vr_inet_flow_entry *)vr_htable_find_free_hentry(
+            router->vr_inet_flow_table, key, sizeof(ife->ife_key));
+    if (!ife)
+        return NULL;
+
+    ife->ife_flags = 0;
+    memcpy(&ife->ife_key, key, sizeof(ife->ife_key));
+    ife->ife_gen_id++;
+    ife->ife_action = VR_FLOW_ACTION_DROP;
+    ife->ife_rflow = -1;
+    ife->ife_vrf = 0;
+    ife->ife_src_nh_index = NH_DISCARD_ID;
+    memset(&ife->ife_stats, 0, sizeof(ife->ife_stats));
+    *index = router->vr_inet_flow_base + ife->ife_hentry.hentry_index;
+
+    return ife;
+}
+
+static inline void
+vr_inet_flow_set_active(struct vr_inet_flow_entry *ife, unsigned short flags)
+{
+    vr_sync_synchronize();
+    ife->ife_flags = VR_FLOW_FLAG_ACTIVE | flags;
+    return;
+}
+
+static void
+vr_inet_flow_reset_entry(struct vrouter *router,
+        struct vr_inet_flow_entry *ife)
+{
+    ife->ife_flags = 0;
+    ife->ife_action = VR_FLOW_ACTION_DROP;
+    ife->ife_rflow = -1;
+    vr_htable_release_hentry(router->vr_inet_flow_table, &ife->ife_hentry);
+    return;
+}
+
 static inline void
 vr_flow_stop_modify(struct vrouter *router, struct vr_flow_entry *fe)
 {
@@ -351,6 +604,159 @@ vr_flow_start_modify(struct vrouter *router, struct vr_flow_entry *fe)
 }
 
 
+static void
+__vr_flow_queue_free(struct vrouter *router, struct vr_flow_queue *vfq)
+{
+    struct vr_flow_table_info *infop = router->vr_flow_table_info;
+
+    if (infop && (vfq->vfq_depth > VR_MAX_FLOW_QUEUE_ENTRIES))
+        (void)vr_sync_sub_and_fetch_32u(&infop->vfti_queue_budget_used,
+                vfq->vfq_depth - VR_MAX_FLOW_QUEUE_ENTRIES);
+
+    vr_free(vfq, VR_FLOW_QUEUE_OBJECT);
+
+    return;
+}
+
+/*
+ * Hold queues are freed to the cache of the cpu that frees them, keeping
+ * their share of the budget. The cache slots are only ever swapped as a
+ * whole, so the ones who free to and allocate from the same cache, the
+ * datapath and the deferred flow work, need no lock.
+ */
+static void
+vr_flow_queue_free(struct vrouter *router, struct vr_flow_queue *vfq)
+{
+    unsigned int i, cpu;
+    struct vr_flow_queue_cache *cache;
+
+    if (!vfq)
+        return;
+
+    cpu = vr_get_cpu();
+    if (router->vr_flow_queue_cache && (cpu < vr_num_cpus) &&
+            (vfq->vfq_depth == vr_flow_queue_depth)) {
+        cache = &router->vr_flow_queue_cache[cpu];
+        for (i = 0; i < VR_FLOW_QUEUE_CACHE_SIZE; i++) {
+            if (!cache->vfqc_queues[i] &&
+                    vr_sync_bool_compare_and_swap_p(&cache->vfqc_queues[i],
+                        NULL, vfq))
+                return;
+        }
+    }
+
+    __vr_flow_queue_free(router, vfq);
+
+    return;
+}
+
+static struct vr_flow_queue *
+vr_flow_queue_alloc(struct vrouter *router, unsigned int index)
+{
+    unsigned int i, cpu, depth, extra, size;
+    struct vr_flow_queue *vfq;
+    struct vr_flow_queue_cache *cache;
+    struct vr_flow_table_info *infop = router->vr_flow_table_info;
+
+    depth = vr_flow_queue_depth;
+    if (depth < VR_MAX_FLOW_QUEUE_ENTRIES)
+        depth = VR_MAX_FLOW_QUEUE_ENTRIES;
+    else if (depth > VR_FLOW_QUEUE_MAX_DEPTH)
+        depth = VR_FLOW_QUEUE_MAX_DEPTH;
+
+    cpu = vr_get_cpu();
+    if (router->vr_flow_queue_cache && (cpu < vr_num_cpus)) {
+        cache = &router->vr_flow_queue_cache[cpu];
+        for (i = 0; i < VR_FLOW_QUEUE_CACHE_SIZE; i++) {
+            vfq = cache->vfqc_queues[i];
+            if (!vfq || !vr_sync_bool_compare_and_swap_p(
+                        &cache->vfqc_queues[i], vfq, NULL))
+                continue;
+
+            if (vfq->vfq_depth == depth) {
+                memset(vfq, 0, sizeof(*vfq) + (depth -
+                            VR_MAX_FLOW_QUEUE_ENTRIES) *
+                        sizeof(struct vr_packet_node));
+                goto init_queue;
+            }
+
+            /* depth was changed since the queue was cached */
+            __vr_flow_queue_free(router, vfq);
+        }
+    }
+
+    extra = depth - VR_MAX_FLOW_QUEUE_ENTRIES;
+    if (extra && infop) {
+        if (vr_sync_add_and_fetch_32u(&infop->vfti_queue_budget_used,
+                    extra) > vr_flow_queue_budget) {
+            (void)vr_sync_sub_and_fetch_32u(&infop->vfti_queue_budget_used,
+                    extra);
+            extra = 0;
+        }
+    } else {
+        extra = 0;
+    }
+
+    depth = VR_MAX_FLOW_QUEUE_ENTRIES + extra;
+    size = sizeof(*vfq) + extra * sizeof(struct vr_packet_node);
+    vfq = vr_zalloc(size, VR_FLOW_QUEUE_OBJECT);
+    if (!vfq) {
+        if (extra)
+            (void)vr_sync_sub_and_fetch_32u(&infop->vfti_queue_budget_used,
+                    extra);
+        return NULL;
+    }
+
+init_queue:
+    vfq->vfq_depth = depth;
+    vfq->vfq_index = index;
+
+    return vfq;
+}
+
+static void
+vr_flow_queue_cache_exit(struct vrouter *router, bool soft_reset)
+{
+    unsigned int i, cpu;
+    struct vr_flow_queue *vfq;
+
+    if (!router->vr_flow_queue_cache)
+        return;
+
+    for (cpu = 0; cpu < vr_num_cpus; cpu++) {
+        for (i = 0; i < VR_FLOW_QUEUE_CACHE_SIZE; i++) {
+            vfq = router->vr_flow_queue_cache[cpu].vfqc_queues[i];
+            if (vfq) {
+                router->vr_flow_queue_cache[cpu].vfqc_queues[i] = NULL;
+                __vr_flow_queue_free(router, vfq);
+            }
+        }
+    }
+
+    if (!soft_reset) {
+        vr_free(router->vr_flow_queue_cache, VR_FLOW_QUEUE_OBJECT);
+        router->vr_flow_queue_cache = NULL;
+    }
+
+    return;
+}
+
+static int
+vr_flow_queue_cache_init(struct vrouter *router)
+{
+    unsigned int size;
+
+    if (router->vr_flow_queue_cache)
+        return 0;
+
+    size = vr_num_cpus * sizeof(struct vr_flow_queue_cache);
+    router->vr_flow_queue_cache = vr_zalloc(size, VR_FLOW_QUEUE_OBJECT);
+    if (!router->vr_flow_queue_cache)
+        return vr_module_error(-ENOMEM, __FUNCTION__, __LINE__, size);
+
+    return 0;
+}
+
 /* Non-static due to RCU callback pointer comparison in vRouter/DPDK */
 void
 vr_flow_flush_hold_queue(struct vrouter *router, struct vr_flow_entry *fe,
@@ -382,6 +788,9 @@ vr_flow_evict_flow(struct vrouter *router, struct vr_flow_entry *fe)
         if (vr_sync_bool_compare_and_swap_16u(&fe->fe_flags, flags,
                 (flags ^ VR_FLOW_FLAG_EVICT_CANDIDATE) |
                 VR_FLOW_FLAG_EVICTED)) {
+            vr_flow_event_post(router, fe, fe->fe_hentry.hentry_index,
+                    VR_FLOW_EVENT_EVICTED, 0);
+            vr_flow_mark_dirty(router, fe->fe_hentry.hentry_index);
             vr_flow_stop_modify(router, fe);
             vr_flow_reset_active_entry(router, fe);
         }
@@ -410,7 +819,7 @@ vr_flow_defer_cb(struct vrouter *router, void *arg)
     vfq = (struct vr_flow_queue *)vfdd->vfdd_flow_queue;
     if (vfq) {
         vr_flow_flush_hold_queue(router, fe, vfq);
-        vr_free(vfq, VR_FLOW_QUEUE_OBJECT);
+        vr_flow_queue_free(router, vfq);
         vfdd->vfdd_flow_queue = NULL;
     }
 
@@ -502,6 +911,7 @@ vr_flow_table_get_free_entry(struct vrouter *router, struct vr_flow *key,
 
         fe->fe_gen_id = (fe->fe_gen_id + 1) %
             (1 << (8 * sizeof(fe->fe_gen_id)));
+        fe->fe_used_clock = router->vr_flow_clock;
         *free_index = fe->fe_hentry.hentry_index;
     }
 
@@ -518,13 +928,10 @@ vr_flow_get_free_entry(struct vrouter *router, struct vr_flow *key, uint8_t type
     fe = vr_flow_table_get_free_entry(router, key, fe_index);
     if (fe) {
         if (need_hold) {
-            fe->fe_hold_list = vr_zalloc(sizeof(struct vr_flow_queue),
-                    VR_FLOW_QUEUE_OBJECT);
+            fe->fe_hold_list = vr_flow_queue_alloc(router, *fe_index);
             if (!fe->fe_hold_list) {
                 vr_flow_reset_entry(router, fe);
                 fe = NULL;
-            } else {
-                fe->fe_hold_list->vfq_index = *fe_index;
             }
         }
 
@@ -625,6 +1032,7 @@ vr_enqueue_flow(struct vrouter *router, struct vr_flow_entry *fe,
     unsigned short drop_reason = 0;
     struct vr_flow_queue *vfq = fe->fe_hold_list;
     struct vr_packet_node *pnode;
+    struct vr_flow_table_info *infop = router->vr_flow_table_info;
 
     if (!vfq) {
         drop_reason = VP_DROP_FLOW_UNUSABLE;
@@ -632,12 +1040,14 @@ vr_enqueue_flow(struct vrouter *router, struct vr_flow_entry *fe,
     }
 
     i = vr_sync_fetch_and_add_32u(&vfq->vfq_entries, 1);
-    if (i >= VR_MAX_FLOW_QUEUE_ENTRIES) {
+    if (i >= vfq->vfq_depth) {
+        (void)vr_sync_add_and_fetch_64u(&infop->vfti_queue_drops, 1);
         drop_reason = VP_DROP_FLOW_QUEUE_LIMIT_EXCEEDED;
         goto drop;
     }
 
-    pnode = &vfq->vfq_pnodes[i];
+    (void)vr_sync_add_and_fetch_64u(&infop->vfti_queued, 1);
+    pnode = vr_flow_queue_pnode(vfq, i);
     vr_flow_fill_pnode(pnode, pkt, fmd);
     if (!i)
         ret = vr_trap_flow(router, fe, pkt, index, stats, pnode);
@@ -737,6 +1147,11 @@ vr_flow_mark_evict(struct vrouter *router, struct vr_flow_entry *fe,
         if (__vr_flow_mark_evict(router, fe)) {
             if (!__vr_flow_schedule_transition(router, fe,
                         index, fe->fe_flags)) {
+                vr_flow_event_post(router, fe, index,
+                        VR_FLOW_EVENT_EVICT_CANDIDATE, fe->fe_tcp_flags);
+                if (rfe && (rfe->fe_flags & VR_FLOW_FLAG_EVICT_CANDIDATE))
+                    vr_flow_event_post(router, rfe, fe->fe_rflow,
+                            VR_FLOW_EVENT_EVICT_CANDIDATE, rfe->fe_tcp_flags);
                 return;
             } else {
                 goto reset_evict;
@@ -759,64 +1174,228 @@ reset_evict:
     return;
 }
 
-int16_t
-vr_flow_get_qos(struct vrouter *router, struct vr_packet *pkt,
-        struct vr_forwarding_md *fmd)
+struct vr_flow_reclaim_md {
+    struct vrouter *frmd_router;
+    struct vr_flow_entry *frmd_fe;
+    unsigned int frmd_index;
+    uint32_t frmd_idle;
+};
+
+/* held are the datapath flags the caller itself set on the entry */
+static bool
+vr_flow_reclaimable(struct vr_flow_entry *fe, unsigned short held)
 {
-    struct vr_flow_entry *fe;
+    unsigned short flags = fe->fe_flags & ~held;
 
-    if (fmd->fmd_flow_index >= 0) {
-        fe = vr_flow_get_entry(router, fmd->fmd_flow_index);
-        if (fe)
-            return fe->fe_qos_id;
-    }
+    if ((flags & (VR_FLOW_FLAG_ACTIVE | VR_FLOW_FLAG_DP_FLAGS |
+                    VR_FLOW_FLAG_DELETE_MARKED)) != VR_FLOW_FLAG_ACTIVE)
+        return false;
 
-    return -1;
+    if ((fe->fe_action == VR_FLOW_ACTION_HOLD) || fe->fe_hold_list)
+        return false;
+
+    /* tcp flows are evicted when the session closes */
+    if (fe->fe_key.flow_proto == VR_IP_PROTO_TCP)
+        return false;
+
+    return true;
 }
 
-static int
-vr_rflow_update_ecmp_index(struct vrouter *router, struct vr_flow_entry *fe,
-                    unsigned int new_ecmp_index, struct vr_forwarding_md *fmd)
+/* the reverse of the flow at index, unless the link is stale */
+static struct vr_flow_entry *
+vr_flow_reclaim_rflow(struct vrouter *router, struct vr_flow_entry *fe,
+        unsigned int index)
 {
     struct vr_flow_entry *rfe;
 
-    if (new_ecmp_index == -1)
-        return -1;
+    if (!(fe->fe_flags & VR_RFLOW_VALID) || (fe->fe_rflow < 0))
+        return NULL;
 
     rfe = vr_flow_get_entry(router, fe->fe_rflow);
-    if ((!rfe) || (rfe->fe_flags & VR_FLOW_FLAG_DELETE_MARKED))
-        return -1;
-
-    rfe->fe_ecmp_nh_index = new_ecmp_index;
-
-    fmd->fmd_ecmp_src_nh_index = new_ecmp_index;
+    if (rfe && (rfe->fe_rflow != (int)index))
+        return NULL;
 
-    return 0;
+    return rfe;
 }
 
-
-int
-vr_flow_update_ecmp_index(struct vrouter *router, struct vr_flow_entry *fe,
-                       unsigned int new_ecmp_index, struct vr_forwarding_md *fmd)
+static void
+vr_flow_reclaim_candidate(vr_htable_t htable, vr_hentry_t *ent,
+        unsigned int index, void *data)
 {
+    uint32_t idle, ridle;
+    struct vr_flow_entry *rfe;
+    struct vr_flow_reclaim_md *frmd = (struct vr_flow_reclaim_md *)data;
+    struct vrouter *router = frmd->frmd_router;
+    struct vr_flow_entry *fe = CONTAINER_OF(fe_hentry,
+            struct vr_flow_entry, ent);
 
-    if (new_ecmp_index == -1)
-        return -1;
+    if (!vr_flow_reclaimable(fe, 0))
+        return;
 
-    if ((!fe) || (fe->fe_flags & VR_FLOW_FLAG_DELETE_MARKED))
-        return -1;
+    /* the pair is idle only if neither of the directions saw a packet */
+    idle = router->vr_flow_clock - fe->fe_used_clock;
+    rfe = vr_flow_reclaim_rflow(router, fe, index);
+    if (rfe) {
+        if (!vr_flow_reclaimable(rfe, 0))
+            return;
 
-    /* If RPF verification is manipulating this flow, let it succeed */
-    (void)vr_sync_bool_compare_and_swap_8s(&fe->fe_ecmp_nh_index,
-                                fmd->fmd_ecmp_nh_index, new_ecmp_index);
+        ridle = router->vr_flow_clock - rfe->fe_used_clock;
+        if (ridle < idle)
+            idle = ridle;
+    }
 
-    fmd->fmd_ecmp_nh_index = fe->fe_ecmp_nh_index;
+    if (idle < VR_FLOW_RECLAIM_IDLE_SECS)
+        return;
 
-    return 0;
+    if (frmd->frmd_fe && (idle <= frmd->frmd_idle))
+        return;
+
+    frmd->frmd_fe = fe;
+    frmd->frmd_index = index;
+    frmd->frmd_idle = idle;
+
+    return;
 }
 
-static flow_result_t
-vr_flow_action(struct vrouter *router, struct vr_flow_entry *fe,
+/*
+ * Evicts the least recently used idle flow (and its reverse) of the bucket
+ * the key hashes to, through the same eviction protocol that closed TCP
+ * sessions go through, so that the agent sees the entries as evicted. The
+ * entries become free only after the transition, so the current allocation
+ * does not benefit, but the next one does.
+ */
+static void
+vr_flow_reclaim_idle(struct vrouter *router, struct vr_flow *key, bool force)
+{
+    bool rfe_marked = false;
+    uint64_t used, entries;
+    struct vr_flow_entry *fe, *rfe = NULL;
+    struct vr_flow_table_info *infop = router->vr_flow_table_info;
+    struct vr_flow_reclaim_md frmd;
+
+    if (!force) {
+        used = vr_flow_table_used_total_entries(router);
+        entries = vr_htable_entries(router->vr_flow_table);
+        if (used * 100 < entries * VR_FLOW_RECLAIM_WATERMARK)
+            return;
+    }
+
+    memset(&frmd, 0, sizeof(frmd));
+    frmd.frmd_router = router;
+    vr_htable_trav_bucket(router->vr_flow_table, key, key->flow_key_len,
+            vr_flow_reclaim_candidate, &frmd);
+
+    fe = frmd.frmd_fe;
+    if (!fe)
+        return;
+
+    if (!vr_flow_start_modify(router, fe))
+        return;
+
+    /* the entries may have changed since the bucket was traversed */
+    if (!vr_flow_reclaimable(fe, VR_FLOW_FLAG_MODIFIED))
+        goto stop_modify;
+
+    rfe = vr_flow_reclaim_rflow(router, fe, frmd.frmd_index);
+    if (rfe) {
+        if (!vr_flow_start_modify(router, rfe)) {
+            rfe = NULL;
+            goto stop_modify;
+        }
+
+        if (!vr_flow_reclaimable(rfe, VR_FLOW_FLAG_MODIFIED) ||
+                (rfe->fe_rflow != (int)frmd.frmd_index))
+            goto stop_modify;
+
+        rfe_marked = __vr_flow_mark_evict(router, rfe);
+    }
+
+    if (__vr_flow_mark_evict(router, fe)) {
+        if (!__vr_flow_schedule_transition(router, fe,
+                    frmd.frmd_index, fe->fe_flags)) {
+            vr_flow_event_post(router, fe, frmd.frmd_index,
+                    VR_FLOW_EVENT_EVICT_CANDIDATE, fe->fe_tcp_flags);
+            if (rfe_marked)
+                vr_flow_event_post(router, rfe, fe->fe_rflow,
+                        VR_FLOW_EVENT_EVICT_CANDIDATE, rfe->fe_tcp_flags);
+            if (infop)
+                (void)vr_sync_add_and_fetch_64u(&infop->vfti_reclaimed, 1);
+            return;
+        }
+    }
+
+    if (rfe)
+        vr_flow_reset_evict(router, rfe);
+    vr_flow_reset_evict(router, fe);
+
+    return;
+
+stop_modify:
+    if (rfe)
+        vr_flow_stop_modify(router, rfe);
+    vr_flow_stop_modify(router, fe);
+
+    return;
+}
+
+int16_t
+vr_flow_get_qos(struct vrouter *router, struct vr_packet *pkt,
+        struct vr_forwarding_md *fmd)
+{
+    struct vr_flow_entry *fe;
+
+    if (fmd->fmd_flow_index >= 0) {
+        fe = vr_flow_get_entry(router, fmd->fmd_flow_index);
+        if (fe)
+            return fe->fe_qos_id;
+    }
+
+    return -1;
+}
+
+static int
+vr_rflow_update_ecmp_index(struct vrouter *router, struct vr_flow_entry *fe,
+                    unsigned int new_ecmp_index, struct vr_forwarding_md *fmd)
+{
+    struct vr_flow_entry *rfe;
+
+    if (new_ecmp_index == -1)
+        return -1;
+
+    rfe = vr_flow_get_entry(router, fe->fe_rflow);
+    if ((!rfe) || (rfe->fe_flags & VR_FLOW_FLAG_DELETE_MARKED))
+        return -1;
+
+    rfe->fe_ecmp_nh_index = new_ecmp_index;
+
+    fmd->fmd_ecmp_src_nh_index = new_ecmp_index;
+
+    return 0;
+}
+
+
+int
+vr_flow_update_ecmp_index(struct vrouter *router, struct vr_flow_entry *fe,
+                       unsigned int new_ecmp_index, struct vr_forwarding_md *fmd)
+{
+
+    if (new_ecmp_index == -1)
+        return -1;
+
+    if ((!fe) || (fe->fe_flags & VR_FLOW_FLAG_DELETE_MARKED))
+        return -1;
+
+    /* If RPF verification is manipulating this flow, let it succeed */
+    (void)vr_sync_bool_compare_and_swap_8s(&fe->fe_ecmp_nh_index,
+                                fmd->fmd_ecmp_nh_index, new_ecmp_index);
+
+    fmd->fmd_ecmp_nh_index = fe->fe_ecmp_nh_index;
+
+    return 0;
+}
+
+static flow_result_t
+vr_flow_action(struct vrouter *router, struct vr_flow_entry *fe,
         unsigned int index, struct vr_packet *pkt,
         struct vr_forwarding_md *fmd)
 {
@@ -882,6 +1461,9 @@ vr_flow_action(struct vrouter *router, struct vr_flow_entry *fe,
         }
     }
 
+    VR_TRACE(VR_TRACE_FLOW_ACTION, pkt->vp_if, pkt, fmd, src_nh, index,
+            fe->fe_action | (fe->fe_flags << 16));
+
     switch (fe->fe_action) {
     case VR_FLOW_ACTION_DROP:
         vr_pfree(pkt, VP_DROP_FLOW_ACTION_DROP);
@@ -994,12 +1576,26 @@ vr_do_flow_action(struct vrouter *router, struct vr_flow_entry *fe,
     }
 
     new_stats = vr_sync_add_and_fetch_32u(&fe->fe_stats.flow_bytes, pkt_len(pkt));
-    if (new_stats < pkt_len(pkt))
+    if (new_stats < pkt_len(pkt)) {
         fe->fe_stats.flow_bytes_oflow++;
+        vr_flow_event_post(router, fe, index, VR_FLOW_EVENT_STATS_OFLOW,
+                fe->fe_stats.flow_bytes_oflow |
+                (fe->fe_stats.flow_packets_oflow << 16));
+    }
 
     new_stats = vr_sync_add_and_fetch_32u(&fe->fe_stats.flow_packets, 1);
-    if (!new_stats)
+    if (!new_stats) {
         fe->fe_stats.flow_packets_oflow++;
+        vr_flow_event_post(router, fe, index, VR_FLOW_EVENT_STATS_OFLOW,
+                fe->fe_stats.flow_bytes_oflow |
+                (fe->fe_stats.flow_packets_oflow << 16));
+    }
+
+    vr_flow_mark_dirty(router, index);
+
+    /* the stats above already own the cache line */
+    if (fe->fe_used_clock != router->vr_flow_clock)
+        fe->fe_used_clock = router->vr_flow_clock;
 
     if (fe->fe_action == VR_FLOW_ACTION_HOLD) {
         vr_enqueue_flow(router, fe, pkt, index, stats_p, fmd);
@@ -1461,15 +2057,152 @@ vr_flow_allow_new_flow(struct vrouter *router, struct vr_packet *pkt,
     return vr_flow_vif_allow_new_flow(router, pkt, drop_reason);
 }
 
+static inline bool
+vr_flow_policy_prefix_match(uint8_t *addr, uint8_t *prefix, unsigned int plen)
+{
+    unsigned int bytes = plen / 8, bits = plen % 8;
+
+    if (bytes && memcmp(addr, prefix, bytes))
+        return false;
+
+    if (bits && ((addr[bytes] ^ prefix[bytes]) & (0xFF << (8 - bits)) & 0xFF))
+        return false;
+
+    return true;
+}
+
+/*
+ * Returns the first flow policy cache rule that matches the new flow. The
+ * rules are replaced as a whole and freed only after the datapath is done
+ * with them, so the returned rule is good till the packet is processed.
+ */
+struct vr_flow_policy *
+vr_flow_policy_match(struct vrouter *router, struct vr_flow *key,
+        struct vr_packet *pkt, struct vr_forwarding_md *fmd,
+        unsigned int *rule)
+{
+    unsigned int i, j, end;
+    uint16_t sport, dport;
+    uint8_t *sip, *dip;
+    struct vr_flow_policy *fp;
+    struct vr_flow_policy_index *fpi = router->vr_flow_policy_index;
+
+    if (!router->vr_flow_policies || !fpi)
+        return NULL;
+
+    switch (key->flow_family) {
+    case AF_INET:
+        sip = (uint8_t *)&key->flow4_sip;
+        dip = (uint8_t *)&key->flow4_dip;
+        break;
+
+    case AF_INET6:
+        sip = key->flow6_sip;
+        dip = key->flow6_dip;
+        break;
+
+    default:
+        return NULL;
+    }
+
+    sport = ntohs(key->flow_sport);
+    dport = ntohs(key->flow_dport);
+
+    j = fpi->fpi_start[(unsigned short)fmd->fmd_dvrf %
+        VR_FLOW_POLICY_BUCKETS];
+    end = fpi->fpi_start[((unsigned short)fmd->fmd_dvrf %
+            VR_FLOW_POLICY_BUCKETS) + 1];
+    if (end - j > VR_FLOW_POLICY_MAX_SCAN)
+        end = j + VR_FLOW_POLICY_MAX_SCAN;
+
+    for (; j < end; j++) {
+        i = fpi->fpi_rule[j];
+        fp = router->vr_flow_policies[i];
+        if (!fp || (fp->fp_family != key->flow_family))
+            continue;
+
+        if ((fp->fp_vrf >= 0) && (fp->fp_vrf != fmd->fmd_dvrf))
+            continue;
+
+        if ((fp->fp_vif >= 0) &&
+                (!pkt->vp_if || (fp->fp_vif != pkt->vp_if->vif_idx)))
+            continue;
+
+        if (fp->fp_proto && (fp->fp_proto != key->flow_proto))
+            continue;
+
+        if ((sport < fp->fp_sport_lo) || (sport > fp->fp_sport_hi) ||
+                (dport < fp->fp_dport_lo) || (dport > fp->fp_dport_hi))
+            continue;
+
+        if (!vr_flow_policy_prefix_match(sip, fp->fp_src, fp->fp_src_plen) ||
+                !vr_flow_policy_prefix_match(dip, fp->fp_dst, fp->fp_dst_plen))
+            continue;
+
+        *rule = i;
+        return fp;
+    }
+
+    return NULL;
+}
+
+/*
+ * Sets up the new flow as the rule says. The agent learns about the flow
+ * from the flow event and the dirty bitmap, and can take it over with a
+ * regular flow set, like it does for the flows it traps.
+ */
+static void
+vr_flow_policy_set(struct vrouter *router, struct vr_flow_entry *fe,
+        unsigned int index, struct vr_flow_policy *fp, unsigned int rule)
+{
+    fe->fe_action = fp->fp_action;
+    fe->fe_src_nh_index = fp->fp_src_nh_index;
+    fe->fe_rflow = -1;
+    fe->fe_ecmp_nh_index = -1;
+    /* the flow is set up, as vr_flow_set does for the flows of the agent */
+    (void)vr_sync_and_and_fetch_16u(&fe->fe_flags,
+            ~(VR_RFLOW_VALID | VR_FLOW_FLAG_NEW_FLOW));
+
+    (void)vr_sync_add_and_fetch_64u(&fp->fp_hits, 1);
+    vr_flow_event_post(router, fe, index, VR_FLOW_EVENT_POLICY, rule);
+    vr_flow_mark_dirty(router, index);
+
+    return;
+}
+
+/* the rules forward or drop, which is all an IPv4 flow entry can do */
+static void
+vr_inet_flow_policy_set(struct vrouter *router,
+        struct vr_inet_flow_entry *ife, unsigned int index,
+        struct vr_flow_policy *fp, unsigned int rule,
+        struct vr_forwarding_md *fmd)
+{
+    ife->ife_action = fp->fp_action;
+    ife->ife_src_nh_index = fp->fp_src_nh_index;
+    ife->ife_vrf = fmd->fmd_dvrf;
+    vr_inet_flow_set_active(ife, 0);
+
+    (void)vr_sync_add_and_fetch_64u(&fp->fp_hits, 1);
+    __vr_flow_event_post(router, index, VR_FLOW_EVENT_POLICY,
+            ife->ife_gen_id, ife->ife_flags, rule);
+    vr_flow_mark_dirty(router, index);
+
+    return;
+}
+
 flow_result_t
 vr_flow_lookup(struct vrouter *router, struct vr_flow *key,
                struct vr_packet *pkt, struct vr_forwarding_md *fmd)
 {
-    unsigned int fe_index;
+    unsigned int fe_index, rule = 0;
     struct vr_flow_entry *flow_e;
+    struct vr_inet_flow_entry *ife;
+    struct vr_flow_policy *fp;
     unsigned short drop_reason = 0;
     bool burst = false;
 
+    VR_DP_LAT_STAGE(VR_DP_LAT_FLOW_LOOKUP, pkt, fmd);
+
     pkt->vp_flags |= VP_FLAG_FLOW_SET;
 
 
@@ -1485,16 +2218,36 @@ vr_flow_lookup(struct vrouter *router, struct vr_flow *key,
             return FLOW_CONSUMED;
         }
 
+        fp = vr_flow_policy_match(router, key, pkt, fmd, &rule);
+        if (fp && router->vr_inet_flow_table) {
+            ife = vr_inet_flow_get_free_entry(router, key, &fe_index);
+            if (ife) {
+                vr_inet_flow_policy_set(router, ife, fe_index, fp, rule, fmd);
+                return vr_inet_flow_action(router, ife, fe_index, pkt, fmd);
+            }
+        }
+
         flow_e = vr_flow_get_free_entry(router, key, pkt->vp_type,
-                true, &fe_index);
+                !fp, &fe_index);
         if (!flow_e) {
+            vr_flow_reclaim_idle(router, key, true);
             vr_pfree(pkt, VP_DROP_FLOW_TABLE_FULL);
             return FLOW_CONSUMED;
         }
 
+        /* the bucket is full, make room before the overflow runs out */
+        if (fe_index >= vr_flow_entries)
+            vr_flow_reclaim_idle(router, key, false);
+
         flow_e->fe_vrf = fmd->fmd_dvrf;
-        /* mark as hold */
-        vr_flow_entry_set_hold(router, flow_e, burst);
+        if (fp) {
+            vr_flow_policy_set(router, flow_e, fe_index, fp, rule);
+        } else {
+            /* mark as hold */
+            vr_flow_entry_set_hold(router, flow_e, burst);
+            vr_flow_event_post(router, flow_e, fe_index, VR_FLOW_EVENT_HOLD,
+                    fmd->fmd_dvrf);
+        }
     }
 
     if (flow_e->fe_flags & VR_FLOW_FLAG_EVICT_CANDIDATE)
@@ -1515,6 +2268,85 @@ vr_flow_lookup(struct vrouter *router, struct vr_flow *key,
     return vr_do_flow_action(router, flow_e, fe_index, pkt, fmd);
 }
 
+static flow_result_t
+vr_inet_flow_action(struct vrouter *router, struct vr_inet_flow_entry *ife,
+        unsigned int index, struct vr_packet *pkt,
+        struct vr_forwarding_md *fmd)
+{
+    int valid_src, modified_index = -1;
+    uint32_t new_stats;
+    struct vr_nexthop *src_nh;
+
+    new_stats = vr_sync_add_and_fetch_32u(&ife->ife_stats.flow_bytes,
+            pkt_len(pkt));
+    if (new_stats < pkt_len(pkt)) {
+        ife->ife_stats.flow_bytes_oflow++;
+        __vr_flow_event_post(router, index, VR_FLOW_EVENT_STATS_OFLOW,
+                ife->ife_gen_id, ife->ife_flags,
+                ife->ife_stats.flow_bytes_oflow |
+                (ife->ife_stats.flow_packets_oflow << 16));
+    }
+
+    new_stats = vr_sync_add_and_fetch_32u(&ife->ife_stats.flow_packets, 1);
+    if (!new_stats) {
+        ife->ife_stats.flow_packets_oflow++;
+        __vr_flow_event_post(router, index, VR_FLOW_EVENT_STATS_OFLOW,
+                ife->ife_gen_id, ife->ife_flags,
+                ife->ife_stats.flow_bytes_oflow |
+                (ife->ife_stats.flow_packets_oflow << 16));
+    }
+
+    vr_flow_mark_dirty(router, index);
+
+    fmd->fmd_flow_index = index;
+    fmd->fmd_dvrf = ife->ife_vrf;
+
+    src_nh = __vrouter_get_nexthop(router, ife->ife_src_nh_index);
+    if (!src_nh) {
+        vr_pfree(pkt, VP_DROP_INVALID_NH);
+        return FLOW_CONSUMED;
+    }
+
+    /* there is no ecmp index to fix up on a mismatch */
+    if (src_nh->nh_validate_src) {
+        valid_src = src_nh->nh_validate_src(pkt, src_nh, fmd, &modified_index);
+        if (valid_src == NH_SOURCE_INVALID) {
+            vr_pfree(pkt, VP_DROP_INVALID_SOURCE);
+            return FLOW_CONSUMED;
+        }
+    }
+
+    VR_TRACE(VR_TRACE_FLOW_ACTION, pkt->vp_if, pkt, fmd, src_nh, index,
+            ife->ife_action | (ife->ife_flags << 16));
+
+    if (ife->ife_action == VR_FLOW_ACTION_FORWARD)
+        return FLOW_FORWARD;
+
+    vr_pfree(pkt, VP_DROP_FLOW_ACTION_DROP);
+    return FLOW_CONSUMED;
+}
+
+/*
+ * IPv4 flows are looked up in the IPv4 flow table first, and then in the
+ * flow table, which also sets up the new flows
+ */
+flow_result_t
+vr_inet_flow_table_lookup(struct vrouter *router, struct vr_flow *key,
+        struct vr_packet *pkt, struct vr_forwarding_md *fmd)
+{
+    unsigned int index;
+    struct vr_inet_flow_entry *ife;
+
+    ife = vr_inet_flow_find(router, key, &index);
+    if (!ife)
+        return vr_flow_lookup(router, key, pkt, fmd);
+
+    VR_DP_LAT_STAGE(VR_DP_LAT_FLOW_LOOKUP, pkt, fmd);
+    pkt->vp_flags |= VP_FLAG_FLOW_SET;
+
+    return vr_inet_flow_action(router, ife, index, pkt, fmd);
+}
+
 static bool
 __vr_flow_forward(flow_result_t result, struct vr_packet *pkt,
         struct vr_forwarding_md *fmd)
@@ -1684,10 +2516,12 @@ __vr_flow_flush_hold_queue(struct vrouter *router, struct vr_flow_entry *fe,
 {
     unsigned int i;
     struct vr_packet_node *pnode;
+    struct vr_flow_table_info *infop = router->vr_flow_table_info;
 
-    for (i = 0; i < VR_MAX_FLOW_QUEUE_ENTRIES; i++) {
-        pnode = &vfq->vfq_pnodes[i];
-        vr_flow_flush_pnode(router, pnode, fe, fmd);
+    for (i = 0; i < vfq->vfq_depth; i++) {
+        pnode = vr_flow_queue_pnode(vfq, i);
+        if (vr_flow_flush_pnode(router, pnode, fe, fmd) != -EINVAL)
+            (void)vr_sync_sub_and_fetch_64u(&infop->vfti_queued, 1);
     }
 
     return;
@@ -1722,8 +2556,7 @@ vr_flush_entry(struct vrouter *router, struct vr_flow_entry *fe,
     return;
 
 free_flush_queue:
-    if (vfq)
-        vr_free(vfq, VR_FLOW_QUEUE_OBJECT);
+    vr_flow_queue_free(router, vfq);
     return;
 }
 
@@ -1860,6 +2693,7 @@ vr_add_flow(unsigned int rid, struct vr_flow *key, uint8_t type,
         uint8_t *fe_gen_id)
 {
     struct vr_flow_entry *flow_e;
+    struct vr_inet_flow_entry *ife;
     struct vrouter *router = vrouter_get(rid);
 
     flow_e = vr_find_flow(router, key, type, fe_index);
@@ -1867,6 +2701,9 @@ vr_add_flow(unsigned int rid, struct vr_flow *key, uint8_t type,
         *fe_gen_id = flow_e->fe_gen_id;
         /* a race between agent and dp. allow agent to handle this error */
         return NULL;
+    } else if ((ife = vr_inet_flow_find(router, key, fe_index))) {
+        *fe_gen_id = ife->ife_gen_id;
+        return NULL;
     } else {
         flow_e = vr_flow_get_free_entry(router, key, type,
                 need_hold_queue, fe_index);
@@ -1913,6 +2750,42 @@ vr_add_flow_req(vr_flow_req *req, unsigned int *fe_index, uint8_t *fe_gen_id)
     return fe;
 }
 
+/*
+ * the reverse flow has to be in the table of the flow, since the flow
+ * table entries look their reverse flow up there (NAT, for one). if the
+ * request has its key instead of its index, the index is filled in
+ */
+static bool
+vr_flow_set_req_rflow_exists(struct vrouter *router, vr_flow_req *req,
+        bool inet)
+{
+    int key_type;
+    struct vr_flow key;
+
+    if (req->fr_rindex != -1) {
+        if (inet)
+            return vr_inet_flow_get_entry(router, req->fr_rindex) != NULL;
+        return vr_flow_get_entry(router, req->fr_rindex) != NULL;
+    }
+
+    if (req->fr_family == AF_INET) {
+        vr_inet_fill_flow(&key, req->fr_rflow_nh_id,
+          (uint32_t)req->fr_rflow_sip_l, (uint32_t)req->fr_rflow_dip_l,
+          req->fr_flow_proto, req->fr_rflow_sport,
+          req->fr_rflow_dport, VR_FLOW_KEY_ALL);
+
+        key_type = VP_TYPE_IP;
+    } else {
+        vr_inet6_fill_rflow_from_req(&key, req);
+        key_type = VP_TYPE_IP6;
+    }
+
+    if (inet)
+        return vr_inet_flow_find(router, &key,
+                (unsigned int *)&req->fr_rindex) != NULL;
+    return vr_find_flow(router, &key, key_type, &req->fr_rindex) != NULL;
+}
+
 /*
  * can be called with 'fe' as null (specifically when flow is added from
  * agent), in which case we should be checking only the request
@@ -1921,9 +2794,7 @@ static int
 vr_flow_set_req_is_invalid(struct vrouter *router, vr_flow_req *req,
         struct vr_flow_entry *fe)
 {
-    int error = 0, key_type;
-    struct vr_flow_entry *rfe;
-    struct vr_flow key;
+    int error = 0;
     uint64_t *ip;
 
     if (fe) {
@@ -1994,25 +2865,7 @@ vr_flow_set_req_is_invalid(struct vrouter *router, vr_flow_req *req,
     }
 
     if (req->fr_flags & VR_RFLOW_VALID) {
-        if (req->fr_rindex != -1) {
-            rfe = vr_flow_get_entry(router, req->fr_rindex);
-        } else {
-            if (req->fr_family == AF_INET) {
-                vr_inet_fill_flow(&key, req->fr_rflow_nh_id,
-                  (uint32_t)req->fr_rflow_sip_l, (uint32_t)req->fr_rflow_dip_l,
-                  req->fr_flow_proto, req->fr_rflow_sport,
-                  req->fr_rflow_dport, VR_FLOW_KEY_ALL);
-
-                key_type = VP_TYPE_IP;
-            } else {
-                vr_inet6_fill_rflow_from_req(&key, req);
-                key_type = VP_TYPE_IP6;
-            }
-
-            rfe = vr_find_flow(router, &key, key_type,  &req->fr_rindex);
-        }
-
-        if (!rfe) {
+        if (!vr_flow_set_req_rflow_exists(router, req, false)) {
             error = -EINVAL;
             goto invalid_req;
         }
@@ -2146,33 +2999,167 @@ vr_flow_update_link_local_port(struct vrouter *router, vr_flow_req *req,
     return;
 }
 
-/* command from agent */
+/*
+ * an IPv4 flow entry forwards or drops, checks the source and counts, and
+ * has nothing else to be set up
+ */
 static int
-vr_flow_set(struct vrouter *router, vr_flow_req *req,
-            vr_flow_response *flow_resp)
+vr_inet_flow_set_req_is_invalid(struct vrouter *router, vr_flow_req *req,
+        struct vr_inet_flow_entry *ife)
 {
-    int ret;
-    unsigned int fe_index = (unsigned int)-1;
-    uint8_t fe_gen_id = 0;
-    bool new_flow = false, modified = false;
+    if (ife) {
+        if ((uint8_t)req->fr_gen_id != ife->ife_gen_id)
+            return -EBADF;
+
+        if (((unsigned short)req->fr_flow_sport != ife->ife_key.ip4_sport) ||
+                ((unsigned short)req->fr_flow_dport != ife->ife_key.ip4_dport) ||
+                ((unsigned short)req->fr_flow_nh_id != ife->ife_key.ip4_nh_id) ||
+                ((unsigned char)req->fr_flow_proto != ife->ife_key.ip4_proto) ||
+                ((uint32_t)req->fr_flow_sip_l != ife->ife_key.ip4_sip) ||
+                ((uint32_t)req->fr_flow_dip_l != ife->ife_key.ip4_dip))
+            return -EFAULT;
+    } else if (req->fr_index >= 0) {
+        return -ENOENT;
+    }
 
-    struct vr_flow_entry *fe = NULL, *rfe = NULL;
-    struct vr_flow_table_info *infop = router->vr_flow_table_info;
+    if (!(req->fr_flags & VR_FLOW_FLAG_ACTIVE))
+        return 0;
 
-    router = vrouter_get(req->fr_rid);
-    if (!router)
+    if ((req->fr_family != AF_INET) ||
+            ((req->fr_action != VR_FLOW_ACTION_FORWARD) &&
+             (req->fr_action != VR_FLOW_ACTION_DROP)))
         return -EINVAL;
 
-    flow_resp->fresp_index = req->fr_index;
+    if (req->fr_flags & (VR_FLOW_FLAG_MIRROR | VR_FLOW_FLAG_VRFT |
+                VR_FLOW_FLAG_LINK_LOCAL | VR_FLOW_FLAG_NAT_MASK |
+                VR_FLOW_FLAG_TRAP_MASK))
+        return -EINVAL;
 
-    fe = vr_flow_get_entry(router, req->fr_index);
-    if (fe) {
-        if (!(modified = vr_flow_start_modify(router, fe)))
-            return -EBUSY;
-    }
+    if (((int)req->fr_ecmp_nh_index != -1) ||
+            ((int16_t)req->fr_qos_id >= 0) || req->fr_ttl)
+        return -EINVAL;
 
-    if ((ret = vr_flow_set_req_is_invalid(router, req, fe)))
-        goto exit_set;
+    if ((req->fr_flags & VR_RFLOW_VALID) &&
+            !vr_flow_set_req_rflow_exists(router, req, true))
+        return -EINVAL;
+
+    return 0;
+}
+
+/*
+ * the agent requests are serialized, and the datapath only sets up new
+ * entries and counts, so the entries of the IPv4 flow table are updated
+ * in place and deleted right away
+ */
+static int
+vr_inet_flow_set(struct vrouter *router, vr_flow_req *req,
+        vr_flow_response *flow_resp)
+{
+    int ret;
+    unsigned int index;
+    struct vr_flow key;
+    struct vr_flow_entry *fe;
+    struct vr_inet_flow_entry *ife;
+    struct vr_flow_table_info *infop = router->vr_flow_table_info;
+
+    ife = vr_inet_flow_get_entry(router, req->fr_index);
+    if (ife && (ife->ife_flags & VR_FLOW_FLAG_DELETE_MARKED))
+        return -EINVAL;
+
+    if ((ret = vr_inet_flow_set_req_is_invalid(router, req, ife)))
+        return ret;
+
+    if (!(req->fr_flags & VR_FLOW_FLAG_ACTIVE)) {
+        if (!ife)
+            return -ENOENT;
+
+        ife->ife_flags |= VR_FLOW_FLAG_DELETE_MARKED;
+        vr_flow_mark_dirty(router, req->fr_index);
+        infop->vfti_deleted++;
+        flow_resp->fresp_flags |= VR_FLOW_RESP_FLAG_DELETED;
+        vr_inet_flow_reset_entry(router, ife);
+        return 0;
+    }
+
+    if (!ife) {
+        vr_inet_fill_flow(&key, req->fr_flow_nh_id,
+            (uint32_t)req->fr_flow_sip_l, (uint32_t)req->fr_flow_dip_l,
+            req->fr_flow_proto, req->fr_flow_sport, req->fr_flow_dport,
+            VR_FLOW_KEY_ALL);
+
+        /* the flow is already there, in one of the tables */
+        if ((fe = vr_find_flow(router, &key, VP_TYPE_IP, &index))) {
+            flow_resp->fresp_index = index;
+            flow_resp->fresp_gen_id = fe->fe_gen_id;
+            return -EEXIST;
+        }
+
+        if ((ife = vr_inet_flow_find(router, &key, &index))) {
+            flow_resp->fresp_index = index;
+            flow_resp->fresp_gen_id = ife->ife_gen_id;
+            return -EEXIST;
+        }
+
+        ife = vr_inet_flow_get_free_entry(router, &key, &index);
+        if (!ife)
+            return -ENOSPC;
+
+        infop->vfti_added++;
+    } else {
+        index = req->fr_index;
+        infop->vfti_changed++;
+    }
+
+    ife->ife_action = req->fr_action;
+    ife->ife_src_nh_index = req->fr_src_nh_index;
+    ife->ife_vrf = req->fr_flow_vrf;
+    if (req->fr_flags & VR_RFLOW_VALID)
+        ife->ife_rflow = req->fr_rindex;
+    else
+        ife->ife_rflow = -1;
+
+    vr_inet_flow_set_active(ife, req->fr_flags & VR_RFLOW_VALID);
+    vr_flow_mark_dirty(router, index);
+
+    flow_resp->fresp_index = index;
+    flow_resp->fresp_gen_id = ife->ife_gen_id;
+
+    return 0;
+}
+
+/* command from agent */
+static int
+vr_flow_set(struct vrouter *router, vr_flow_req *req,
+            vr_flow_response *flow_resp)
+{
+    int ret;
+    unsigned int fe_index = (unsigned int)-1;
+    uint8_t fe_gen_id = 0;
+    bool new_flow = false, modified = false;
+
+    struct vr_flow_entry *fe = NULL, *rfe = NULL;
+    struct vr_flow_table_info *infop = router->vr_flow_table_info;
+
+    router = vrouter_get(req->fr_rid);
+    if (!router)
+        return -EINVAL;
+
+    flow_resp->fresp_index = req->fr_index;
+
+    if (vr_flow_index_is_inet(router, req->fr_index) ||
+            ((req->fr_index < 0) && router->vr_inet_flow_table &&
+             (req->fr_op_flags & VR_FLOW_OP_FLAG_INET) &&
+             (req->fr_family == AF_INET)))
+        return vr_inet_flow_set(router, req, flow_resp);
+
+    fe = vr_flow_get_entry(router, req->fr_index);
+    if (fe) {
+        if (!(modified = vr_flow_start_modify(router, fe)))
+            return -EBUSY;
+    }
+
+    if ((ret = vr_flow_set_req_is_invalid(router, req, fe)))
+        goto exit_set;
 
     if (fe) {
         if ((fe->fe_action == VR_FLOW_ACTION_HOLD) &&
@@ -2194,6 +3181,7 @@ vr_flow_set(struct vrouter *router, vr_flow_req *req,
 
         infop->vfti_deleted++;
         flow_resp->fresp_flags |= VR_FLOW_RESP_FLAG_DELETED;
+        vr_flow_mark_dirty(router, req->fr_index);
         return vr_flow_delete(router, req, fe);
     }
 
@@ -2226,8 +3214,8 @@ vr_flow_set(struct vrouter *router, vr_flow_req *req,
         if ((req->fr_action == VR_FLOW_ACTION_HOLD) &&
                 (fe->fe_action != req->fr_action)) {
             if (!fe->fe_hold_list) {
-                fe->fe_hold_list = vr_zalloc(sizeof(struct vr_flow_queue),
-                        VR_FLOW_QUEUE_OBJECT);
+                fe->fe_hold_list = vr_flow_queue_alloc(router,
+                        fe->fe_hentry.hentry_index);
                 if (!fe->fe_hold_list) {
                     ret = -ENOMEM;
                     goto exit_set;
@@ -2301,7 +3289,7 @@ vr_flow_set(struct vrouter *router, vr_flow_req *req,
     if (fe->fe_flags & VR_FLOW_FLAG_NEW_FLOW)
         fe->fe_flags &= ~VR_FLOW_FLAG_NEW_FLOW;
 
-
+    vr_flow_mark_dirty(router, fe->fe_hentry.hentry_index);
 
     ret = vr_flow_schedule_transition(router, req, fe);
 
@@ -2313,6 +3301,50 @@ exit_set:
     return ret;
 }
 
+/*
+ * set a flow that is one of a forward and reverse pair, the reverse flow
+ * first. if the datapath has already created a hold entry for the key of
+ * the flow, as it happens when packets of the reverse flow race with the
+ * agent, that entry is taken over instead of failing with EEXIST. once
+ * the forward flow is set with its reverse flow, the reverse flow is
+ * linked back to it here, so that the agent does not need another round
+ * to patch the reverse flow
+ */
+static int
+vr_flow_pair_set(struct vrouter *router, vr_flow_req *req,
+        vr_flow_response *flow_resp)
+{
+    int ret;
+    struct vr_flow_entry *fe, *rfe;
+
+    ret = vr_flow_set(router, req, flow_resp);
+    if ((ret == -EEXIST) && (req->fr_index < 0)) {
+        req->fr_index = flow_resp->fresp_index;
+        req->fr_gen_id = flow_resp->fresp_gen_id;
+        ret = vr_flow_set(router, req, flow_resp);
+    }
+
+    if (ret || !(req->fr_flags & VR_FLOW_FLAG_ACTIVE) ||
+            !(req->fr_flags & VR_RFLOW_VALID))
+        return ret;
+
+    fe = vr_flow_get_entry(router, flow_resp->fresp_index);
+    rfe = vr_flow_get_entry(router, req->fr_rindex);
+    if (!fe || !rfe || (fe == rfe))
+        return ret;
+
+    /* setting the forward flow again is harmless, so let the agent retry */
+    if (!vr_flow_start_modify(router, rfe))
+        return -EBUSY;
+
+    rfe->fe_rflow = flow_resp->fresp_index;
+    (void)vr_sync_fetch_and_or_16u(&rfe->fe_flags, VR_RFLOW_VALID);
+    vr_flow_stop_modify(router, rfe);
+    vr_flow_mark_dirty(router, req->fr_rindex);
+
+    return 0;
+}
+
 static void
 vr_flow_table_data_destroy(vr_flow_table_data *ftable)
 {
@@ -2324,6 +3356,11 @@ vr_flow_table_data_destroy(vr_flow_table_data *ftable)
         ftable->ftable_file_path = NULL;
     }
 
+    if (ftable->ftable_event_file_path) {
+        vr_free(ftable->ftable_event_file_path, VR_FLOW_REQ_PATH_OBJECT);
+        ftable->ftable_event_file_path = NULL;
+    }
+
     if (ftable->ftable_hold_stat && ftable->ftable_hold_stat_size) {
         vr_free(ftable->ftable_hold_stat, VR_FLOW_HOLD_STAT_OBJECT);
         ftable->ftable_hold_stat = NULL;
@@ -2355,18 +3392,22 @@ vr_flow_table_data_get(vr_flow_table_data *ref)
         }
     }
 
+    if (vr_flow_event_path) {
+        ftable->ftable_event_file_path = vr_zalloc(VR_UNIX_PATH_MAX,
+                VR_FLOW_REQ_PATH_OBJECT);
+        if (!ftable->ftable_event_file_path) {
+            vr_flow_table_data_destroy(ftable);
+            return NULL;
+        }
+    }
+
     if (num_cpus > VR_FLOW_MAX_CPUS)
         num_cpus = VR_FLOW_MAX_CPUS;
 
     hold_stat_size = num_cpus * sizeof(uint32_t);
     ftable->ftable_hold_stat = vr_zalloc(hold_stat_size, VR_FLOW_HOLD_STAT_OBJECT);
     if (!ftable->ftable_hold_stat) {
-        if (ftable->ftable_file_path) {
-            vr_free(ftable->ftable_file_path, VR_FLOW_REQ_PATH_OBJECT);
-            ftable->ftable_file_path = NULL;
-        }
-
-        vr_free(ftable, VR_FLOW_TABLE_DATA_OBJECT);
+        vr_flow_table_data_destroy(ftable);
         return NULL;
     }
     ftable->ftable_hold_stat_size = num_cpus;
@@ -2374,6 +3415,32 @@ vr_flow_table_data_get(vr_flow_table_data *ref)
     return ftable;
 }
 
+/*
+ * Grows the overflow part of the flow table by one more segment, of the
+ * same size as the one the table was created with. The flow indices do
+ * not change, so nothing has to be migrated and the agent only has to map
+ * the table again with the new size to see the new entries.
+ */
+static int
+vr_flow_table_grow(struct vrouter *router)
+{
+    int ret;
+
+    /*
+     * the agent maps a table set up in memory the host provided (the huge
+     * pages, the shared memory of DPDK and Windows) with the fixed size of
+     * that memory, and would not see the segments allocated here
+     */
+    if (vr_flow_table)
+        return -EOPNOTSUPP;
+
+    ret = vr_htable_grow(router->vr_flow_table);
+    if (ret)
+        return ret;
+
+    return 0;
+}
+
 /*
  * sandesh handler for vr_flow_table_data
  */
@@ -2393,14 +3460,26 @@ vr_flow_table_data_process(void *s_req)
         goto send_response;
     }
 
+    if (ftable->ftable_op == FLOW_OP_FLOW_TABLE_GROW) {
+        ret = vr_flow_table_grow(router);
+        if (ret)
+            goto send_response;
+    }
+
     infop = router->vr_flow_table_info;
     resp->ftable_op = ftable->ftable_op;
     resp->ftable_size = vr_flow_table_size(router);
+    resp->ftable_entries = vr_htable_entries(router->vr_flow_table);
 #if defined(__linux__) && defined(__KERNEL__)
     resp->ftable_dev = vr_flow_major;
 #endif
     if (vr_flow_path)
         strncpy(resp->ftable_file_path, vr_flow_path, VR_UNIX_PATH_MAX - 1);
+    resp->ftable_event_size = vr_flow_event_table_size(router);
+    resp->ftable_event_ring_size = VR_FLOW_EVENT_RING_SIZE;
+    if (vr_flow_event_path)
+        strncpy(resp->ftable_event_file_path, vr_flow_event_path,
+                VR_UNIX_PATH_MAX - 1);
 
     if (!infop)
         goto send_response;
@@ -2411,6 +3490,9 @@ vr_flow_table_data_process(void *s_req)
     resp->ftable_processed = infop->vfti_action_count;
     resp->ftable_hold_oflows = infop->vfti_oflows;
     resp->ftable_added = infop->vfti_added;
+    resp->ftable_reclaimed = infop->vfti_reclaimed;
+    resp->ftable_hold_queued = infop->vfti_queued;
+    resp->ftable_hold_queue_drops = infop->vfti_queue_drops;
     resp->ftable_cpus = vr_num_cpus;
     /* we only have space for 64 stats block max when encoding */
     for (i = 0; ((i < vr_num_cpus) && (i < VR_FLOW_MAX_CPUS)); i++) {
@@ -2423,6 +3505,15 @@ vr_flow_table_data_process(void *s_req)
     resp->ftable_burst_free_tokens = infop->vfti_burst_tokens - infop->vfti_burst_used;
     resp->ftable_hold_entries = vr_flow_table_hold_count(router);
 
+    if (router->vr_inet_flow_table) {
+        resp->ftable_inet_size = vr_inet_flow_table_size(router);
+        resp->ftable_inet_entries =
+            vr_htable_entries(router->vr_inet_flow_table);
+        resp->ftable_inet_base = router->vr_inet_flow_base;
+        resp->ftable_inet_used_entries =
+            vr_htable_used_total_entries(router->vr_inet_flow_table);
+    }
+
 send_response:
     vr_message_response(VR_FLOW_TABLE_DATA_OBJECT_ID, resp, ret, false);
     if (resp)
@@ -2431,6 +3522,118 @@ send_response:
     return;
 }
 
+/*
+ * results of the operations of the FLOW_OP_FLOW_BULK_SET batch being
+ * processed. requests are processed one at a time, and a batch has to come
+ * in one message, so that there is only one batch in progress at any time
+ */
+struct vr_flow_bulk {
+    int vfb_error;
+    /* operations are in, and the response is yet to be sent */
+    bool vfb_pending;
+    unsigned int vfb_rid;
+    unsigned int vfb_count;
+    int32_t vfb_index[VR_FLOW_BULK_MAX_OPS];
+    int32_t vfb_status[VR_FLOW_BULK_MAX_OPS];
+    int8_t vfb_gen_id[VR_FLOW_BULK_MAX_OPS];
+};
+
+static struct vr_flow_bulk vr_flow_bulk;
+
+static void
+vr_flow_bulk_send_response(struct vr_flow_bulk *bulk)
+{
+    vr_flow_bulk_response resp;
+
+    memset(&resp, 0, sizeof(resp));
+    resp.fbresp_op = FLOW_OP_FLOW_BULK_SET;
+    resp.fbresp_rid = bulk->vfb_rid;
+    resp.fbresp_index = bulk->vfb_index;
+    resp.fbresp_index_size = bulk->vfb_count;
+    resp.fbresp_gen_id = bulk->vfb_gen_id;
+    resp.fbresp_gen_id_size = bulk->vfb_count;
+    resp.fbresp_status = bulk->vfb_status;
+    resp.fbresp_status_size = bulk->vfb_count;
+
+    vr_message_response(VR_FLOW_BULK_RESPONSE_OBJECT_ID, &resp,
+            bulk->vfb_error, false);
+    bulk->vfb_count = 0;
+    bulk->vfb_pending = false;
+
+    return;
+}
+
+/*
+ * each operation of a batch is a vr_flow_req of its own, carrying its
+ * position in the batch and the batch size. instead of a response per
+ * operation, the status, index and generation id of all the operations
+ * are returned in one vr_flow_bulk_response after the last one. an
+ * operation that fails does not stop the batch, while a batch that is
+ * out of sequence is answered right away with the operations done till
+ * then and the error, and the rest of it is ignored. a batch that is cut
+ * short is answered the same way at the end of its message
+ */
+static void
+vr_flow_bulk_set(struct vrouter *router, vr_flow_req *req)
+{
+    int ret;
+    unsigned int i;
+    vr_flow_response flow_resp;
+    struct vr_flow_bulk *bulk = &vr_flow_bulk;
+
+    if (!req->fr_bulk_index) {
+        bulk->vfb_count = 0;
+        bulk->vfb_error = 0;
+    } else if (bulk->vfb_error) {
+        return;
+    }
+
+    bulk->vfb_rid = req->fr_rid;
+    if (!router ||
+            (req->fr_bulk_count > VR_FLOW_BULK_MAX_OPS) ||
+            (req->fr_bulk_index >= req->fr_bulk_count) ||
+            (req->fr_bulk_index != bulk->vfb_count)) {
+        bulk->vfb_error = -EINVAL;
+        vr_flow_bulk_send_response(bulk);
+        return;
+    }
+
+    bulk->vfb_pending = true;
+
+    memset(&flow_resp, 0, sizeof(flow_resp));
+    if (req->fr_op_flags & VR_FLOW_OP_FLAG_PAIR)
+        ret = vr_flow_pair_set(router, req, &flow_resp);
+    else
+        ret = vr_flow_set(router, req, &flow_resp);
+
+    i = bulk->vfb_count++;
+    bulk->vfb_index[i] = flow_resp.fresp_index;
+    bulk->vfb_gen_id[i] = flow_resp.fresp_gen_id;
+    bulk->vfb_status[i] = ret;
+
+    if (bulk->vfb_count == req->fr_bulk_count)
+        vr_flow_bulk_send_response(bulk);
+
+    return;
+}
+
+/* called at the end of every request message */
+void
+vr_flow_bulk_end(void)
+{
+    struct vr_flow_bulk *bulk = &vr_flow_bulk;
+
+    if (bulk->vfb_pending) {
+        bulk->vfb_error = -EINVAL;
+        vr_flow_bulk_send_response(bulk);
+    }
+
+    /* the rest of a failed batch is not in the next message */
+    bulk->vfb_error = 0;
+
+    return;
+}
+
 /*
  * sandesh handler for vr_flow_req
  */
@@ -2444,12 +3647,19 @@ vr_flow_req_process(void *s_req)
 
     router = vrouter_get(req->fr_rid);
     switch (req->fr_op) {
+    case FLOW_OP_FLOW_BULK_SET:
+        vr_flow_bulk_set(router, req);
+        return;
+
     case FLOW_OP_FLOW_SET:
 
         flow_resp.fresp_rid = 0;
         flow_resp.fresp_op = req->fr_op;
 
-        ret = vr_flow_set(router, req, &flow_resp);
+        if (req->fr_op_flags & VR_FLOW_OP_FLAG_PAIR)
+            ret = vr_flow_pair_set(router, req, &flow_resp);
+        else
+            ret = vr_flow_set(router, req, &flow_resp);
         break;
 
     default:
@@ -2467,6 +3677,528 @@ vr_flow_response_process(void *s_req)
     return;
 }
 
+void
+vr_flow_bulk_response_process(void *s_req)
+{
+    return;
+}
+
+static void
+vr_flow_dirty_restore(struct vrouter *router, unsigned int word,
+        uint64_t *bitmap, unsigned int words)
+{
+    unsigned int i;
+    uint64_t *wordp;
+
+    for (i = 0; i < words; i++) {
+        if (!bitmap[i])
+            continue;
+
+        wordp = vr_flow_dirty_word_get(router, 0, word + i);
+        if (wordp)
+            (void)vr_sync_fetch_and_or_64u(wordp, bitmap[i]);
+    }
+
+    return;
+}
+
+/*
+ * collect the dirty bits of all the cpus for a chunk of the bitmap,
+ * clearing them unless asked to only peek. returns true if any of the
+ * flow entries in the chunk is dirty
+ */
+static bool
+vr_flow_dirty_harvest(struct vrouter *router, unsigned int word,
+        uint64_t *bitmap, unsigned int words, bool peek)
+{
+    bool dirty = false;
+    unsigned int i, cpu;
+    uint64_t *wordp;
+
+    for (i = 0; i < words; i++) {
+        bitmap[i] = 0;
+        for (cpu = 0; cpu < vr_num_cpus; cpu++) {
+            wordp = vr_flow_dirty_word_get(router, cpu, word + i);
+            if (!wordp || !*wordp)
+                continue;
+
+            if (peek)
+                bitmap[i] |= *wordp;
+            else
+                bitmap[i] |= vr_sync_lock_test_and_set_64u(wordp, 0);
+        }
+
+        if (bitmap[i])
+            dirty = true;
+    }
+
+    return dirty;
+}
+
+static void
+vr_flow_dirty_dump(vr_flow_dirty_req *r)
+{
+    int ret = 0;
+    bool peek;
+    unsigned int chunk, chunks, words;
+    uint64_t bitmap[VR_FLOW_DIRTY_CHUNK_WORDS];
+    struct vrouter *router;
+    struct vr_message_dumper *dumper = NULL;
+    vr_flow_dirty_req resp;
+
+    router = vrouter_get(r->fdr_rid);
+    if (!router && (ret = -EINVAL))
+        goto generate_response;
+
+    if (!router->vr_flow_dirty_table && (ret = -EOPNOTSUPP))
+        goto generate_response;
+
+    peek = !!(r->fdr_flags & VR_FLOW_DIRTY_FLAG_PEEK);
+    chunks = (router->vr_flow_dirty_words + VR_FLOW_DIRTY_CHUNK_WORDS - 1) /
+        VR_FLOW_DIRTY_CHUNK_WORDS;
+    if ((unsigned int)(r->fdr_marker + 1) >= chunks)
+        goto generate_response;
+
+    dumper = vr_message_dump_init(r);
+    if (!dumper && (ret = -ENOMEM))
+        goto generate_response;
+
+    for (chunk = (unsigned int)(r->fdr_marker + 1); chunk < chunks; chunk++) {
+        words = router->vr_flow_dirty_words - chunk * VR_FLOW_DIRTY_CHUNK_WORDS;
+        if (words > VR_FLOW_DIRTY_CHUNK_WORDS)
+            words = VR_FLOW_DIRTY_CHUNK_WORDS;
+
+        if (!vr_flow_dirty_harvest(router, chunk * VR_FLOW_DIRTY_CHUNK_WORDS,
+                    bitmap, words, peek))
+            continue;
+
+        memset(&resp, 0, sizeof(resp));
+        resp.fdr_rid = r->fdr_rid;
+        resp.fdr_marker = chunk;
+        resp.fdr_flags = r->fdr_flags;
+        resp.fdr_entries = vr_htable_entries(router->vr_flow_table);
+        resp.fdr_offset = chunk * VR_FLOW_DIRTY_CHUNK_WORDS * 64;
+        resp.fdr_bitmap = (int64_t *)bitmap;
+        resp.fdr_bitmap_size = words;
+
+        ret = vr_message_dump_object(dumper, VR_FLOW_DIRTY_OBJECT_ID, &resp);
+        if (ret <= 0) {
+            /* the chunk did not make it to this response, give it back */
+            if (!peek)
+                vr_flow_dirty_restore(router,
+                        chunk * VR_FLOW_DIRTY_CHUNK_WORDS, bitmap, words);
+            break;
+        }
+    }
+
+generate_response:
+    vr_message_dump_exit(dumper, ret);
+
+    return;
+}
+
+/*
+ * sandesh handler for vr_flow_dirty_req
+ */
+void
+vr_flow_dirty_req_process(void *s_req)
+{
+    vr_flow_dirty_req *req = (vr_flow_dirty_req *)s_req;
+
+    switch (req->h_op) {
+    case SANDESH_OP_DUMP:
+        vr_flow_dirty_dump(req);
+        break;
+
+    default:
+        vr_send_response(-EOPNOTSUPP);
+        break;
+    }
+
+    return;
+}
+
+static void
+vr_flow_policy_defer_free(struct vrouter *router, void *arg)
+{
+    struct vr_defer_data *defer = (struct vr_defer_data *)arg;
+
+    vr_free(defer->vdd_data, VR_FLOW_POLICY_OBJECT);
+
+    return;
+}
+
+/* frees a rule, or an index of the rules, the datapath may still be using */
+static void
+vr_flow_policy_free(struct vrouter *router, void *data)
+{
+    struct vr_defer_data *defer;
+
+    if (!vr_not_ready) {
+        defer = vr_get_defer_data(sizeof(*defer));
+        if (defer) {
+            defer->vdd_data = data;
+            vr_defer(router, vr_flow_policy_defer_free, (void *)defer);
+            return;
+        }
+
+        vr_delay_op();
+    }
+
+    vr_free(data, VR_FLOW_POLICY_OBJECT);
+
+    return;
+}
+
+/*
+ * Rebuilds the index of the rules by vrf bucket. A rule of any vrf goes to
+ * every bucket. Till the new index is in place the datapath uses the old
+ * one, which is safe as every rule is matched in full anyway.
+ */
+static int
+vr_flow_policy_index_update(struct vrouter *router)
+{
+    unsigned int i, b, size, entries = 0;
+    unsigned int fill[VR_FLOW_POLICY_BUCKETS];
+    struct vr_flow_policy *fp;
+    struct vr_flow_policy_index *fpi, *old;
+
+    for (i = 0; i < router->vr_flow_policy_count; i++) {
+        fp = router->vr_flow_policies[i];
+        if (fp)
+            entries += (fp->fp_vrf < 0) ? VR_FLOW_POLICY_BUCKETS : 1;
+    }
+
+    size = sizeof(*fpi) + entries * sizeof(fpi->fpi_rule[0]);
+    fpi = vr_zalloc(size, VR_FLOW_POLICY_OBJECT);
+    if (!fpi)
+        return -ENOMEM;
+
+    memset(fill, 0, sizeof(fill));
+    for (i = 0; i < router->vr_flow_policy_count; i++) {
+        fp = router->vr_flow_policies[i];
+        if (!fp)
+            continue;
+
+        for (b = 0; b < VR_FLOW_POLICY_BUCKETS; b++) {
+            if ((fp->fp_vrf < 0) ||
+                    ((unsigned short)fp->fp_vrf % VR_FLOW_POLICY_BUCKETS == b))
+                fill[b]++;
+        }
+    }
+
+    for (b = 0; b < VR_FLOW_POLICY_BUCKETS; b++)
+        fpi->fpi_start[b + 1] = fpi->fpi_start[b] + fill[b];
+
+    memset(fill, 0, sizeof(fill));
+    for (i = 0; i < router->vr_flow_policy_count; i++) {
+        fp = router->vr_flow_policies[i];
+        if (!fp)
+            continue;
+
+        for (b = 0; b < VR_FLOW_POLICY_BUCKETS; b++) {
+            if ((fp->fp_vrf < 0) ||
+                    ((unsigned short)fp->fp_vrf % VR_FLOW_POLICY_BUCKETS == b))
+                fpi->fpi_rule[fpi->fpi_start[b] + fill[b]++] = i;
+        }
+    }
+
+    /* the index is complete before the datapath can see it */
+    vr_sync_synchronize();
+    old = router->vr_flow_policy_index;
+    router->vr_flow_policy_index = fpi;
+    if (old)
+        vr_flow_policy_free(router, old);
+
+    return 0;
+}
+
+static int
+__vr_flow_policy_del(struct vrouter *router, unsigned int index)
+{
+    struct vr_flow_policy *fp;
+
+    if (!router->vr_flow_policies || (index >= VR_FLOW_POLICY_MAX_RULES))
+        return -EINVAL;
+
+    fp = router->vr_flow_policies[index];
+    if (!fp)
+        return -ENOENT;
+
+    router->vr_flow_policies[index] = NULL;
+    while (router->vr_flow_policy_count &&
+            !router->vr_flow_policies[router->vr_flow_policy_count - 1])
+        router->vr_flow_policy_count--;
+
+    /* the old index skips the rule that is gone, if this fails */
+    (void)vr_flow_policy_index_update(router);
+    vr_flow_policy_free(router, fp);
+
+    return 0;
+}
+
+static int
+vr_flow_policy_add(struct vrouter *router, vr_flow_policy_req *req)
+{
+    int ret;
+    unsigned int alen, count;
+    struct vr_flow_policy *fp, *old;
+
+    if (!router->vr_flow_policies ||
+            ((unsigned int)req->fpr_index >= VR_FLOW_POLICY_MAX_RULES))
+        return -EINVAL;
+
+    switch (req->fpr_family) {
+    case AF_INET:
+        alen = VR_IP_ADDRESS_LEN;
+        break;
+
+    case AF_INET6:
+        alen = VR_IP6_ADDRESS_LEN;
+        break;
+
+    default:
+        return -EINVAL;
+    }
+
+    if ((req->fpr_action != VR_FLOW_ACTION_FORWARD) &&
+            (req->fpr_action != VR_FLOW_ACTION_DROP))
+        return -EINVAL;
+
+    if ((req->fpr_src_plen > alen * 8) || (req->fpr_dst_plen > alen * 8) ||
+            (req->fpr_src_prefix_size < (req->fpr_src_plen + 7) / 8) ||
+            (req->fpr_dst_prefix_size < (req->fpr_dst_plen + 7) / 8))
+        return -EINVAL;
+
+    if ((req->fpr_sport_lo > req->fpr_sport_hi) ||
+            (req->fpr_dport_lo > req->fpr_dport_hi))
+        return -EINVAL;
+
+    if (!__vrouter_get_nexthop(router, req->fpr_src_nh_index))
+        return -EINVAL;
+
+    fp = vr_zalloc(sizeof(*fp), VR_FLOW_POLICY_OBJECT);
+    if (!fp)
+        return -ENOMEM;
+
+    fp->fp_vrf = req->fpr_vrf;
+    fp->fp_vif = req->fpr_vif;
+    fp->fp_family = req->fpr_family;
+    fp->fp_proto = req->fpr_proto;
+    fp->fp_sport_lo = req->fpr_sport_lo;
+    fp->fp_sport_hi = req->fpr_sport_hi;
+    fp->fp_dport_lo = req->fpr_dport_lo;
+    fp->fp_dport_hi = req->fpr_dport_hi;
+    fp->fp_src_plen = req->fpr_src_plen;
+    fp->fp_dst_plen = req->fpr_dst_plen;
+    if (fp->fp_src_plen)
+        memcpy(fp->fp_src, req->fpr_src_prefix, (fp->fp_src_plen + 7) / 8);
+    if (fp->fp_dst_plen)
+        memcpy(fp->fp_dst, req->fpr_dst_prefix, (fp->fp_dst_plen + 7) / 8);
+    fp->fp_action = req->fpr_action;
+    fp->fp_src_nh_index = req->fpr_src_nh_index;
+
+    /* the rule is complete before the datapath can see it */
+    vr_sync_synchronize();
+    count = router->vr_flow_policy_count;
+    old = router->vr_flow_policies[req->fpr_index];
+    router->vr_flow_policies[req->fpr_index] = fp;
+    if ((unsigned int)req->fpr_index >= router->vr_flow_policy_count)
+        router->vr_flow_policy_count = req->fpr_index + 1;
+
+    ret = vr_flow_policy_index_update(router);
+    if (ret) {
+        router->vr_flow_policies[req->fpr_index] = old;
+        router->vr_flow_policy_count = count;
+        vr_flow_policy_free(router, fp);
+        return ret;
+    }
+
+    if (old)
+        vr_flow_policy_free(router, old);
+
+    return 0;
+}
+
+static void
+vr_flow_policy_make_req(vr_flow_policy_req *req, struct vr_flow_policy *fp,
+        unsigned int index)
+{
+    unsigned int alen;
+
+    alen = (fp->fp_family == AF_INET6) ? VR_IP6_ADDRESS_LEN :
+        VR_IP_ADDRESS_LEN;
+
+    req->fpr_index = index;
+    req->fpr_vrf = fp->fp_vrf;
+    req->fpr_vif = fp->fp_vif;
+    req->fpr_family = fp->fp_family;
+    req->fpr_proto = fp->fp_proto;
+    req->fpr_sport_lo = fp->fp_sport_lo;
+    req->fpr_sport_hi = fp->fp_sport_hi;
+    req->fpr_dport_lo = fp->fp_dport_lo;
+    req->fpr_dport_hi = fp->fp_dport_hi;
+    req->fpr_src_prefix = (int8_t *)fp->fp_src;
+    req->fpr_src_prefix_size = alen;
+    req->fpr_src_plen = fp->fp_src_plen;
+    req->fpr_dst_prefix = (int8_t *)fp->fp_dst;
+    req->fpr_dst_prefix_size = alen;
+    req->fpr_dst_plen = fp->fp_dst_plen;
+    req->fpr_action = fp->fp_action;
+    req->fpr_src_nh_index = fp->fp_src_nh_index;
+    req->fpr_hits = fp->fp_hits;
+
+    return;
+}
+
+static void
+vr_flow_policy_get(struct vrouter *router, vr_flow_policy_req *req)
+{
+    int ret = 0;
+    vr_flow_policy_req resp;
+    struct vr_flow_policy *fp = NULL;
+
+    if (!router->vr_flow_policies ||
+            ((unsigned int)req->fpr_index >= VR_FLOW_POLICY_MAX_RULES)) {
+        ret = -EINVAL;
+    } else {
+        fp = router->vr_flow_policies[req->fpr_index];
+        if (!fp)
+            ret = -ENOENT;
+    }
+
+    if (fp) {
+        memset(&resp, 0, sizeof(resp));
+        resp.h_op = req->h_op;
+        resp.fpr_rid = req->fpr_rid;
+        vr_flow_policy_make_req(&resp, fp, req->fpr_index);
+    }
+
+    vr_message_response(VR_FLOW_POLICY_OBJECT_ID, fp ? &resp : NULL, ret,
+            false);
+
+    return;
+}
+
+static void
+vr_flow_policy_dump(struct vrouter *router, vr_flow_policy_req *r)
+{
+    int ret = 0;
+    unsigned int i;
+    vr_flow_policy_req resp;
+    struct vr_flow_policy *fp;
+    struct vr_message_dumper *dumper = NULL;
+
+    if (!router->vr_flow_policies && (ret = -ENODEV))
+        goto generate_response;
+
+    dumper = vr_message_dump_init(r);
+    if (!dumper && (ret = -ENOMEM))
+        goto generate_response;
+
+    for (i = (unsigned int)(r->fpr_marker + 1);
+            i < router->vr_flow_policy_count; i++) {
+        fp = router->vr_flow_policies[i];
+        if (!fp)
+            continue;
+
+        memset(&resp, 0, sizeof(resp));
+        resp.h_op = r->h_op;
+        resp.fpr_rid = r->fpr_rid;
+        vr_flow_policy_make_req(&resp, fp, i);
+        ret = vr_message_dump_object(dumper, VR_FLOW_POLICY_OBJECT_ID, &resp);
+        if (ret <= 0)
+            break;
+    }
+
+generate_response:
+    vr_message_dump_exit(dumper, ret);
+
+    return;
+}
+
+void
+vr_flow_policy_req_process(void *s_req)
+{
+    int ret;
+    struct vrouter *router;
+    vr_flow_policy_req *req = (vr_flow_policy_req *)s_req;
+
+    router = vrouter_get(req->fpr_rid);
+    if (!router) {
+        vr_send_response(-ENODEV);
+        return;
+    }
+
+    switch (req->h_op) {
+    case SANDESH_OP_ADD:
+        ret = vr_flow_policy_add(router, req);
+        vr_send_response(ret);
+        break;
+
+    case SANDESH_OP_DEL:
+        ret = __vr_flow_policy_del(router, req->fpr_index);
+        vr_send_response(ret);
+        break;
+
+    case SANDESH_OP_GET:
+        vr_flow_policy_get(router, req);
+        break;
+
+    case SANDESH_OP_DUMP:
+        vr_flow_policy_dump(router, req);
+        break;
+
+    default:
+        vr_send_response(-EOPNOTSUPP);
+        break;
+    }
+
+    return;
+}
+
+static void
+vr_flow_policy_exit(struct vrouter *router, bool soft_reset)
+{
+    unsigned int i;
+
+    if (!router->vr_flow_policies)
+        return;
+
+    for (i = 0; i < VR_FLOW_POLICY_MAX_RULES; i++) {
+        if (router->vr_flow_policies[i])
+            (void)__vr_flow_policy_del(router, i);
+    }
+
+    if (!soft_reset) {
+        if (router->vr_flow_policy_index) {
+            vr_free(router->vr_flow_policy_index, VR_FLOW_POLICY_OBJECT);
+            router->vr_flow_policy_index = NULL;
+        }
+        vr_free(router->vr_flow_policies, VR_FLOW_POLICY_OBJECT);
+        router->vr_flow_policies = NULL;
+    }
+
+    return;
+}
+
+static int
+vr_flow_policy_init(struct vrouter *router)
+{
+    unsigned int size;
+
+    if (router->vr_flow_policies)
+        return 0;
+
+    size = VR_FLOW_POLICY_MAX_RULES * sizeof(struct vr_flow_policy *);
+    router->vr_flow_policies = vr_zalloc(size, VR_FLOW_POLICY_OBJECT);
+    if (!router->vr_flow_policies)
+        return vr_module_error(-ENOMEM, __FUNCTION__, __LINE__, size);
+    router->vr_flow_policy_count = 0;
+
+    return 0;
+}
+
 static void
 vr_flow_table_info_destroy(struct vrouter *router)
 {
@@ -2483,6 +4215,9 @@ vr_flow_table_info_destroy(struct vrouter *router)
 static void
 vr_flow_table_info_reset(struct vrouter *router)
 {
+    uint64_t queued;
+    uint32_t budget_used;
+
     if (!router->vr_flow_table_info)
         return;
 
@@ -2492,7 +4227,15 @@ vr_flow_table_info_reset(struct vrouter *router)
         router->vr_flow_table_info->vfti_timer = NULL;
     }
 
+    /*
+     * the hold queues that are still around give their packets and budget
+     * back after the reset, so keep accounting for them
+     */
+    queued = router->vr_flow_table_info->vfti_queued;
+    budget_used = router->vr_flow_table_info->vfti_queue_budget_used;
     memset(router->vr_flow_table_info, 0, router->vr_flow_table_info_size);
+    router->vr_flow_table_info->vfti_queued = queued;
+    router->vr_flow_table_info->vfti_queue_budget_used = budget_used;
 
     return;
 }
@@ -2526,6 +4269,23 @@ vr_flow_table_destroy(struct vrouter *router)
         router->vr_flow_table = NULL;
     }
 
+    if (router->vr_inet_flow_table) {
+        vr_htable_delete(router->vr_inet_flow_table);
+        router->vr_inet_flow_table = NULL;
+        router->vr_inet_flow_base = 0;
+    }
+
+    if (router->vr_flow_event_table) {
+        vr_btable_free(router->vr_flow_event_table);
+        router->vr_flow_event_table = NULL;
+    }
+
+    if (router->vr_flow_dirty_table) {
+        vr_btable_free(router->vr_flow_dirty_table);
+        router->vr_flow_dirty_table = NULL;
+        router->vr_flow_dirty_words = 0;
+    }
+
     vr_flow_table_info_destroy(router);
 
     return;
@@ -2558,11 +4318,30 @@ vr_flow_invalidate_entry(vr_htable_t htable, vr_hentry_t *ent,
     vr_flow_reset_entry(router, fe);
 }
 
+static void
+vr_inet_flow_invalidate_entry(vr_htable_t htable, vr_hentry_t *ent,
+        unsigned int index, void *data)
+{
+    struct vr_inet_flow_entry *ife;
+
+    if (!ent)
+        return;
+
+    ife = CONTAINER_OF(ife_hentry, struct vr_inet_flow_entry, ent);
+    ife->ife_flags = 0;
+    ife->ife_action = VR_FLOW_ACTION_DROP;
+    ife->ife_rflow = -1;
+
+    return;
+}
+
 static void
 vr_flow_table_reset(struct vrouter *router)
 {
     vr_htable_reset(router->vr_flow_table,
             vr_flow_invalidate_entry, router);
+    vr_htable_reset(router->vr_inet_flow_table,
+            vr_inet_flow_invalidate_entry, router);
     vr_flow_table_info_reset(router);
 
     return;
@@ -2580,6 +4359,129 @@ vr_compute_size_oflow_table(void)
     }
 }
 
+static int
+vr_flow_event_table_init(struct vrouter *router)
+{
+    unsigned int i, rings = vr_num_cpus;
+    struct iovec iov;
+    struct vr_flow_event_ring *ring;
+
+    if (router->vr_flow_event_table)
+        return 0;
+
+    if (vr_flow_event_table) {
+        /* host memory is sized for the maximum number of cpus */
+        if (rings > VR_MAX_CPUS)
+            rings = VR_MAX_CPUS;
+        iov.iov_base = vr_flow_event_table;
+        iov.iov_len = rings * VR_FLOW_EVENT_RING_SIZE;
+        router->vr_flow_event_table = vr_btable_attach(&iov, 1,
+                sizeof(struct vr_flow_event));
+    } else {
+        router->vr_flow_event_table = vr_btable_alloc(rings *
+                (VR_FLOW_EVENT_RING_SIZE / sizeof(struct vr_flow_event)),
+                sizeof(struct vr_flow_event));
+    }
+
+    if (!router->vr_flow_event_table)
+        return vr_module_error(-ENOMEM, __FUNCTION__, __LINE__, rings);
+
+    for (i = 0; i < rings; i++) {
+        ring = vr_flow_event_ring_get(router, i);
+        if (!ring)
+            break;
+        memset(ring, 0, sizeof(*ring));
+        ring->fer_hdr.ferh_entries = VR_FLOW_EVENT_RING_ENTRIES;
+        ring->fer_hdr.ferh_cpu = i;
+    }
+
+    return 0;
+}
+
+static int
+vr_flow_dirty_table_init(struct vrouter *router)
+{
+    unsigned int i, words, entries;
+    uint64_t *wordp;
+
+    if (router->vr_flow_dirty_table)
+        return 0;
+
+    /*
+     * leave room for all the overflow segments the table can grow to, and
+     * for the IPv4 flow table after them
+     */
+    words = (vr_flow_entries + vr_oflow_entries * VR_HTABLE_MAX_OTABLES +
+            63) / 64;
+    if (router->vr_inet_flow_table)
+        words = (router->vr_inet_flow_base +
+                vr_htable_entries(router->vr_inet_flow_table) + 63) / 64;
+    entries = vr_num_cpus * words;
+    router->vr_flow_dirty_table = vr_btable_alloc(entries, sizeof(uint64_t));
+    if (!router->vr_flow_dirty_table)
+        return vr_module_error(-ENOMEM, __FUNCTION__, __LINE__, entries);
+
+    router->vr_flow_dirty_words = words;
+    /* host page allocation is not guaranteed to be zeroed */
+    for (i = 0; i < entries; i++) {
+        wordp = (uint64_t *)vr_btable_get(router->vr_flow_dirty_table, i);
+        if (wordp)
+            *wordp = 0;
+    }
+
+    return 0;
+}
+
+static void
+vr_flow_clock_tick(void *arg)
+{
+    struct vrouter *router = (struct vrouter *)arg;
+
+    router->vr_flow_clock++;
+    return;
+}
+
+static int
+vr_flow_clock_init(struct vrouter *router)
+{
+    struct vr_timer *vtimer;
+
+    if (router->vr_flow_clock_timer)
+        return 0;
+
+    vtimer = vr_zalloc(sizeof(*vtimer), VR_TIMER_OBJECT);
+    if (!vtimer)
+        return vr_module_error(-ENOMEM, __FUNCTION__, __LINE__,
+                sizeof(*vtimer));
+
+    vtimer->vt_timer = vr_flow_clock_tick;
+    vtimer->vt_vr_arg = router;
+    vtimer->vt_msecs = 1000;
+
+    /* without the clock, no flow is ever found idle */
+    if (vr_create_timer(vtimer)) {
+        vr_free(vtimer, VR_TIMER_OBJECT);
+        return 0;
+    }
+
+    router->vr_flow_clock_timer = vtimer;
+
+    return 0;
+}
+
+static void
+vr_flow_clock_exit(struct vrouter *router)
+{
+    if (!router->vr_flow_clock_timer)
+        return;
+
+    vr_delete_timer(router->vr_flow_clock_timer);
+    vr_free(router->vr_flow_clock_timer, VR_TIMER_OBJECT);
+    router->vr_flow_clock_timer = NULL;
+
+    return;
+}
+
 static int
 vr_flow_table_init(struct vrouter *router)
 {
@@ -2608,6 +4510,31 @@ vr_flow_table_init(struct vrouter *router)
     return vr_flow_table_info_init(router);
 }
 
+static int
+vr_inet_flow_table_init(struct vrouter *router)
+{
+    unsigned int entries, oentries;
+
+    if (router->vr_inet_flow_table || !vr_inet_flow_entries)
+        return 0;
+
+    /* whole pages, for the table to be mapped */
+    entries = (vr_inet_flow_entries + 63) & ~63;
+    oentries = ((entries / 5) + 1023) & ~1023;
+    router->vr_inet_flow_table = vr_htable_create(router, entries, oentries,
+            sizeof(struct vr_inet_flow_entry), sizeof(struct vr_inet_flow), 0,
+            vr_inet_flow_get_key);
+    if (!router->vr_inet_flow_table)
+        return vr_module_error(-ENOMEM, __FUNCTION__, __LINE__,
+                entries + oentries);
+
+    /* past all the indices the flow table can grow to */
+    router->vr_inet_flow_base = (vr_flow_entries +
+            vr_oflow_entries * VR_HTABLE_MAX_OTABLES + 63) & ~63;
+
+    return 0;
+}
+
 static void
 vr_link_local_ports_reset(struct vrouter *router)
 {
@@ -2660,7 +4587,10 @@ vr_flow_exit(struct vrouter *router, bool soft_reset)
 {
     vr_flow_table_reset(router);
     vr_link_local_ports_reset(router);
+    vr_flow_policy_exit(router, soft_reset);
+    vr_flow_queue_cache_exit(router, soft_reset);
     if (!soft_reset) {
+        vr_flow_clock_exit(router);
         vr_flow_table_destroy(router);
         vr_fragment_table_exit(router);
         vr_link_local_ports_exit(router);
@@ -2680,6 +4610,24 @@ vr_flow_mem(struct vrouter *router)
     if ((ret = vr_flow_table_init(router)))
         return ret;
 
+    if ((ret = vr_inet_flow_table_init(router)))
+        return ret;
+
+    if ((ret = vr_flow_event_table_init(router)))
+        return ret;
+
+    if ((ret = vr_flow_dirty_table_init(router)))
+        return ret;
+
+    if ((ret = vr_flow_clock_init(router)))
+        return ret;
+
+    if ((ret = vr_flow_policy_init(router)))
+        return ret;
+
+    if ((ret = vr_flow_queue_cache_init(router)))
+        return ret;
+
     if ((ret = vr_link_local_ports_init(router)))
         return ret;
 
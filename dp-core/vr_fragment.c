@@ -439,7 +439,7 @@ __vr_fragment_get_hash(unsigned int vrf, uint64_t sip_u, uint64_t sip_l,
 
     __fragment_key(&vfk, vrf, sip_u, sip_l, dip_u, dip_l, id);
 
-    return vr_hash(&vfk, sizeof(vfk), 0);
+    return vr_hash_key(vr_hash_crc32c_enabled, &vfk, sizeof(vfk), 0);
 }
 
 uint32_t
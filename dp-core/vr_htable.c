@@ -10,6 +10,13 @@
 
 #define VR_HENTRIES_PER_BUCKET 4
 
+/* the overflow segments are mapped page by page after the main table */
+#if defined(__linux__) && defined(__KERNEL__)
+#define VR_HTABLE_PAGE_SIZE     PAGE_SIZE
+#else
+#define VR_HTABLE_PAGE_SIZE     4096
+#endif
+
 #define VR_HENTRY_FLAG_VALID             0x1
 #define VR_HENTRY_FLAG_DELETE_MARKED     0x2
 #define VR_HENTRY_FLAG_DELETE_PROCESSED  0x4
@@ -17,6 +24,9 @@
                                             VR_HENTRY_FLAG_DELETE_PROCESSED)
 #define VR_HENTRY_FLAG_IN_FREE_LIST      0x8
 
+/* zero signature stands for "unknown", and the key has to be compared */
+#define VR_HTABLE_SIG(hash)             ((hash) ? (hash) : 1)
+
 
 struct vr_htable {
     struct vrouter *ht_router;
@@ -26,9 +36,24 @@ struct vr_htable {
     unsigned int ht_key_size;
     unsigned int ht_bucket_size;
     struct vr_btable *ht_htable;
-    struct vr_btable *ht_otable;
+    /*
+     * the key hash of each entry in the main table, kept densely apart
+     * from the entries, so that a lookup reads the entries of a bucket
+     * only when they are likely to hold the key
+     */
+    struct vr_btable *ht_stable;
+    /*
+     * overflow entries live in segments of ht_oseg_entries each. the first
+     * one is set up at the creation and vr_htable_grow appends the rest, so
+     * that an entry never moves and its index remains valid for ever
+     */
+    struct vr_btable *ht_otable[VR_HTABLE_MAX_OTABLES];
+    unsigned int ht_otables;
+    unsigned int ht_oseg_entries;
     struct vr_btable *ht_dtable;
     get_hentry_key ht_get_key;
+    /* hash backend, fixed at the table creation */
+    bool ht_hash_crc32c;
     vr_hentry_t *ht_free_oentry_head;
     unsigned int ht_used_oentries;
     unsigned int ht_used_entries;
@@ -140,6 +165,26 @@ vr_htable_put_free_oentry(struct vr_htable *table, vr_hentry_t *ent)
 }
 
 
+static inline uint32_t *
+vr_htable_sig(struct vr_htable *table, unsigned int index)
+{
+    if (!table->ht_stable || (index >= table->ht_hentries))
+        return NULL;
+
+    return (uint32_t *)vr_btable_get(table->ht_stable, index);
+}
+
+static inline void
+vr_htable_sig_set(struct vr_htable *table, unsigned int index, uint32_t sig)
+{
+    uint32_t *sigp = vr_htable_sig(table, index);
+
+    if (sigp)
+        *sigp = sig;
+
+    return;
+}
+
 /*
  * Returns the hash entry given an index. Does not validate whether the
  * entry is Valid or not
@@ -155,8 +200,14 @@ __vr_htable_get_hentry_by_index(vr_htable_t htable, unsigned int index)
     if (index < table->ht_hentries)
         return vr_btable_get(table->ht_htable, index);
 
-    if (index < (table->ht_oentries + table->ht_hentries))
-        return vr_btable_get(table->ht_otable, (index - table->ht_hentries));
+    if (index < (table->ht_oentries + table->ht_hentries)) {
+        index -= table->ht_hentries;
+        if (index < table->ht_oseg_entries)
+            return vr_btable_get(table->ht_otable[0], index);
+
+        return vr_btable_get(table->ht_otable[index / table->ht_oseg_entries],
+                index % table->ht_oseg_entries);
+    }
 
     return NULL;
 }
@@ -334,6 +385,7 @@ vr_htable_reset(vr_htable_t htable, htable_trav_cb cb, void *data)
             ent->hentry_flags &= ~VR_HENTRY_FLAG_VALID;
             (void)vr_sync_sub_and_fetch_32u(&table->ht_used_entries, 1);
         }
+        vr_htable_sig_set(table, i, 0);
 
 
         if ((i < table->ht_hentries) && ent->hentry_next) {
@@ -377,8 +429,10 @@ vr_htable_release_hentry(vr_htable_t htable, vr_hentry_t *ent)
     /* Mark it as Invalid */
     ent->hentry_flags &= ~VR_HENTRY_FLAG_VALID;
 
-    if (ent->hentry_index < table->ht_hentries)
+    if (ent->hentry_index < table->ht_hentries) {
+        vr_htable_sig_set(table, ent->hentry_index, 0);
         return;
+    }
 
     if (vr_not_ready)
         return;
@@ -432,7 +486,7 @@ vr_htable_find_free_hentry(vr_htable_t htable, void *key, unsigned int key_size)
             return NULL;
     }
 
-    hash = vr_hash(key, key_size, 0);
+    hash = vr_hash_key(table->ht_hash_crc32c, key, key_size, 0);
     tmp_hash = hash % table->ht_hentries;
     tmp_hash &= ~(table->ht_bucket_size - 1);
 
@@ -446,6 +500,7 @@ vr_htable_find_free_hentry(vr_htable_t htable, void *key, unsigned int key_size)
                         (ent->hentry_flags & ~VR_HENTRY_FLAG_VALID),
                         VR_HENTRY_FLAG_VALID)) {
                 ent->hentry_bucket_index = VR_INVALID_HENTRY_INDEX;
+                vr_htable_sig_set(table, ind, VR_HTABLE_SIG(hash));
                 (void)vr_sync_add_and_fetch_32u(&table->ht_used_entries, 1);
                 return ent;
             }
@@ -510,7 +565,7 @@ vr_htable_find_duplicate_hentry_index(vr_htable_t htable, vr_hentry_t *hentry)
             return -1;
     }
 
-    hash = vr_hash(hkey, key_len, 0);
+    hash = vr_hash_key(table->ht_hash_crc32c, hkey, key_len, 0);
 
     /* Look into the hash table from hash */
     tmp_hash = hash % table->ht_hentries;
@@ -538,7 +593,7 @@ vr_htable_find_duplicate_hentry_index(vr_htable_t htable, vr_hentry_t *hentry)
     tmp_hash = hash % table->ht_oentries;
     for (i = 0; i < table->ht_oentries; i++) {
         ind = table->ht_hentries + ((tmp_hash + i) % table->ht_oentries);
-        ent = vr_btable_get(table->ht_otable, ((tmp_hash + i) % table->ht_oentries));
+        ent = __vr_htable_get_hentry_by_index(htable, ind);
 
         if (ent->hentry_index == VR_INVALID_HENTRY_INDEX)
             continue;
@@ -564,6 +619,7 @@ vr_hentry_t *
 vr_htable_find_hentry(vr_htable_t htable, void *key, unsigned int key_len)
 {
     unsigned int hash, tmp_hash, ind, i, ent_key_len;
+    uint32_t sig, *sigp;
     vr_hentry_t *ent, *o_ent;
     vr_hentry_key ent_key;
     struct vr_htable *table = (struct vr_htable *)htable;
@@ -579,7 +635,8 @@ vr_htable_find_hentry(vr_htable_t htable, void *key, unsigned int key_len)
 
     ent = NULL;
 
-    hash = vr_hash(key, key_len, 0);
+    hash = vr_hash_key(table->ht_hash_crc32c, key, key_len, 0);
+    sig = VR_HTABLE_SIG(hash);
 
     /* Look into the hash table from hash*/
     tmp_hash = hash % table->ht_hentries;
@@ -588,6 +645,11 @@ vr_htable_find_hentry(vr_htable_t htable, void *key, unsigned int key_len)
 
         ind = tmp_hash + i;
 
+        /* skip the entries of other keys without touching them */
+        sigp = vr_htable_sig(table, ind);
+        if (sigp && *sigp && (*sigp != sig))
+            continue;
+
         ent = vr_btable_get(table->ht_htable, ind);
         if (!(ent->hentry_flags & VR_HENTRY_FLAG_VALID))
             continue;
@@ -600,6 +662,8 @@ vr_htable_find_hentry(vr_htable_t htable, void *key, unsigned int key_len)
             return ent;
     }
 
+    /* the overflow entries are linked to the last entry of the bucket */
+    ent = vr_btable_get(table->ht_htable, tmp_hash + table->ht_bucket_size - 1);
     for (o_ent = ent->hentry_next; o_ent; o_ent = o_ent->hentry_next) {
 
         /* Though in the list, can be under the deletion */
@@ -618,6 +682,46 @@ vr_htable_find_hentry(vr_htable_t htable, void *key, unsigned int key_len)
     return NULL;
 }
 
+/*
+ * Calls cb for each valid entry of the bucket the key hashes to, the
+ * overflow entries chained to the bucket included
+ */
+void
+vr_htable_trav_bucket(vr_htable_t htable, void *key, unsigned int key_len,
+        htable_trav_cb cb, void *data)
+{
+    unsigned int hash, tmp_hash, i;
+    vr_hentry_t *ent, *o_ent;
+    struct vr_htable *table = (struct vr_htable *)htable;
+
+    if (!table || !key || !cb)
+        return;
+
+    if (!key_len) {
+        key_len = table->ht_key_size;
+        if (!key_len)
+            return;
+    }
+
+    hash = vr_hash_key(table->ht_hash_crc32c, key, key_len, 0);
+    tmp_hash = hash % table->ht_hentries;
+    tmp_hash &= ~(table->ht_bucket_size - 1);
+
+    ent = NULL;
+    for (i = 0; i < table->ht_bucket_size; i++) {
+        ent = vr_btable_get(table->ht_htable, tmp_hash + i);
+        if (ent->hentry_flags & VR_HENTRY_FLAG_VALID)
+            cb(htable, ent, tmp_hash + i, data);
+    }
+
+    for (o_ent = ent->hentry_next; o_ent; o_ent = o_ent->hentry_next) {
+        if (o_ent->hentry_flags & VR_HENTRY_FLAG_VALID)
+            cb(htable, o_ent, o_ent->hentry_index, data);
+    }
+
+    return;
+}
+
 unsigned int
 vr_htable_used_oflow_entries(vr_htable_t htable)
 {
@@ -644,34 +748,122 @@ unsigned int
 vr_htable_size(vr_htable_t htable)
 {
     struct vr_htable *table = (struct vr_htable *)htable;
-    unsigned int size = 0;
+    unsigned int i, size = 0;
 
     if (table) {
         if (table->ht_htable)
             size = vr_btable_size(table->ht_htable);
-        if (table->ht_otable)
-            size += vr_btable_size(table->ht_otable);
+        for (i = 0; i < table->ht_otables; i++)
+            size += vr_btable_size(table->ht_otable[i]);
     }
 
     return size;
 }
 
+unsigned int
+vr_htable_entries(vr_htable_t htable)
+{
+    struct vr_htable *table = (struct vr_htable *)htable;
+
+    if (table)
+        return table->ht_hentries + table->ht_oentries;
+
+    return 0;
+}
+
 void *
 vr_htable_get_address(vr_htable_t htable, uint64_t offset)
 {
     struct vr_htable *table = (struct vr_htable *)htable;
     unsigned int size = vr_btable_size(table->ht_htable);
+    unsigned int segment;
     struct vr_btable *btable;
 
     btable = table->ht_htable;
     if (offset >= size) {
         offset -= size;
-        btable = table->ht_otable;
+        if (!table->ht_otables)
+            return NULL;
+
+        /*
+         * all the overflow segments are of the same size, a multiple of
+         * the page size as vr_htable_grow made sure, so that a page never
+         * straddles two of them
+         */
+        size = vr_btable_size(table->ht_otable[0]);
+        segment = offset / size;
+        if (segment >= table->ht_otables)
+            return NULL;
+
+        offset -= (uint64_t)segment * size;
+        btable = table->ht_otable[segment];
     }
 
     return vr_btable_get_address(btable, offset);
 }
 
+/*
+ * Appends one more overflow segment to the table. The entries that are
+ * already in use are not touched, and hence the lookups, the index based
+ * accesses and the memory mapped views of the table keep working while
+ * the table grows. The new entries become visible to the readers only
+ * after the segment is in place, and are handed out only after they are
+ * spliced to the free list. Callers have to serialize the growth.
+ */
+int
+vr_htable_grow(vr_htable_t htable)
+{
+    unsigned int i, base;
+    vr_hentry_t *ent, *first, *last, *head;
+    struct vr_btable *otable;
+    struct vr_htable *table = (struct vr_htable *)htable;
+
+    if (!table || !table->ht_oseg_entries)
+        return -EINVAL;
+
+    if (table->ht_otables >= VR_HTABLE_MAX_OTABLES)
+        return -ENOSPC;
+
+    if ((vr_btable_size(table->ht_htable) % VR_HTABLE_PAGE_SIZE) ||
+            ((table->ht_oseg_entries * table->ht_entry_size) %
+             VR_HTABLE_PAGE_SIZE))
+        return -EINVAL;
+
+    otable = vr_btable_alloc(table->ht_oseg_entries, table->ht_entry_size);
+    if (!otable)
+        return -ENOMEM;
+
+    base = table->ht_hentries + table->ht_oentries;
+    first = last = NULL;
+    for (i = 0; i < table->ht_oseg_entries; i++) {
+        ent = vr_btable_get(otable, i);
+        memset(ent, 0, table->ht_entry_size);
+        ent->hentry_index = base + i;
+        ent->hentry_bucket_index = VR_INVALID_HENTRY_INDEX;
+        ent->hentry_next_index = VR_INVALID_HENTRY_INDEX;
+        ent->hentry_flags = VR_HENTRY_FLAG_IN_FREE_LIST;
+        if (last)
+            last->hentry_next = ent;
+        else
+            first = ent;
+        last = ent;
+    }
+
+    table->ht_otable[table->ht_otables] = otable;
+    vr_sync_synchronize();
+    table->ht_otables++;
+    table->ht_oentries += table->ht_oseg_entries;
+    vr_sync_synchronize();
+
+    do {
+        head = table->ht_free_oentry_head;
+        last->hentry_next = head;
+    } while (!vr_sync_bool_compare_and_swap_p(&table->ht_free_oentry_head,
+                head, first));
+
+    return 0;
+}
+
 vr_htable_t
 __vr_htable_create(struct vrouter *router, unsigned int entries,
         void *htable, unsigned int oentries, void *otable,
@@ -712,20 +904,27 @@ __vr_htable_create(struct vrouter *router, unsigned int entries,
         goto exit;
     }
 
+    table->ht_stable = vr_btable_alloc(entries, sizeof(uint32_t));
+    if (!table->ht_stable) {
+        vr_module_error(-ENOMEM, __FUNCTION__, __LINE__, entries);
+        goto exit;
+    }
+
     if (oentries) {
 
         if (!otable) {
-            table->ht_otable = vr_btable_alloc(oentries, entry_size);
+            table->ht_otable[0] = vr_btable_alloc(oentries, entry_size);
         } else {
             iov.iov_base = otable;
             iov.iov_len = entry_size * oentries;
-            table->ht_otable = vr_btable_attach(&iov, 1, entry_size);
+            table->ht_otable[0] = vr_btable_attach(&iov, 1, entry_size);
         }
 
-        if (!table->ht_otable) {
+        if (!table->ht_otable[0]) {
             vr_module_error(-ENOMEM, __FUNCTION__, __LINE__, oentries);
             goto exit;
         }
+        table->ht_otables = 1;
 
         /*
          * If there is an over flow table, create the delete data for
@@ -744,12 +943,14 @@ __vr_htable_create(struct vrouter *router, unsigned int entries,
         ent = vr_btable_get(table->ht_htable, i);
         ent->hentry_index = i;
         ent->hentry_next_index = VR_INVALID_HENTRY_INDEX;
+        /* host page allocation is not guaranteed to be zeroed */
+        *(uint32_t *)vr_btable_get(table->ht_stable, i) = 0;
     }
 
 
     prev = NULL;
     for (i = 0; i < oentries; i++) {
-        ent = vr_btable_get(table->ht_otable, i);
+        ent = vr_btable_get(table->ht_otable[0], i);
         ent->hentry_index = entries + i;
         ent->hentry_next_index = VR_INVALID_HENTRY_INDEX;
         if (i == 0)
@@ -763,9 +964,11 @@ __vr_htable_create(struct vrouter *router, unsigned int entries,
 
     table->ht_hentries = entries;
     table->ht_oentries = oentries;
+    table->ht_oseg_entries = oentries;
     table->ht_entry_size = entry_size;
     table->ht_key_size = key_size;
     table->ht_get_key = get_entry_key;
+    table->ht_hash_crc32c = vr_hash_crc32c_enabled;
     table->ht_bucket_size = bucket_size;
     table->ht_router = router;
     table->ht_used_oentries = 0;
@@ -795,6 +998,7 @@ vr_htable_attach(struct vrouter *router, unsigned int entries,
 void
 vr_htable_delete(vr_htable_t htable)
 {
+    unsigned int i;
     struct vr_htable *table = (struct vr_htable *)htable;
 
     if (!table)
@@ -803,8 +1007,11 @@ vr_htable_delete(vr_htable_t htable)
     if (table->ht_htable)
         vr_btable_free(table->ht_htable);
 
-    if (table->ht_otable)
-        vr_btable_free(table->ht_otable);
+    if (table->ht_stable)
+        vr_btable_free(table->ht_stable);
+
+    for (i = 0; i < table->ht_otables; i++)
+        vr_btable_free(table->ht_otable[i]);
 
     if (table->ht_dtable)
         vr_btable_free(table->ht_dtable);
@@ -14,6 +14,9 @@
 #include "vr_datapath.h"
 #include "vr_bridge.h"
 #include "vr_btable.h"
+#include "vr_stats.h"
+#include "vr_trace.h"
+#include "vr_stats_shm.h"
 
 unsigned int vr_interfaces = VR_MAX_INTERFACES;
 
@@ -405,6 +408,9 @@ agent_tx(struct vr_interface *vif, struct vr_packet *pkt,
     int ret;
     struct vr_interface_stats *stats = vif_get_stats(vif, pkt->vp_cpu);
 
+    VR_DP_LAT_STAGE(VR_DP_LAT_VIF_TX, pkt, fmd);
+    VR_TRACE(VR_TRACE_VIF_TX, vif, pkt, fmd, pkt->vp_nh, pkt->vp_type, 0);
+
     stats->vis_obytes += pkt_len(pkt);
     stats->vis_opackets++;
 
@@ -675,6 +681,8 @@ vhost_rx(struct vr_interface *vif, struct vr_packet *pkt,
 
     vr_init_forwarding_md(&fmd);
     fmd.fmd_dvrf = vif->vif_vrf;
+    VR_DP_LAT_RX(pkt, &fmd);
+    VR_TRACE_RX(vif, pkt, &fmd, vlan_id);
 
     /*
      * TODO: Xconnect mode: Ideally all the flow processing need to happen
@@ -702,6 +710,9 @@ vhost_tx(struct vr_interface *vif, struct vr_packet *pkt,
     struct vr_vlan_hdr *vlan;
     struct vr_interface *in_vif;
 
+    VR_DP_LAT_STAGE(VR_DP_LAT_VIF_TX, pkt, fmd);
+    VR_TRACE(VR_TRACE_VIF_TX, vif, pkt, fmd, pkt->vp_nh, pkt->vp_type, 0);
+
     stats->vis_obytes += pkt_len(pkt);
     stats->vis_opackets++;
 
@@ -1123,6 +1134,8 @@ vm_rx(struct vr_interface *vif, struct vr_packet *pkt,
 
     vr_init_forwarding_md(&fmd);
     fmd.fmd_dvrf = vif->vif_vrf;
+    VR_DP_LAT_RX(pkt, &fmd);
+    VR_TRACE_RX(vif, pkt, &fmd, vlan_id);
 
     vif_mirror(vif, pkt, &fmd, vif->vif_flags & VIF_FLAG_MIRROR_RX);
 
@@ -1192,6 +1205,8 @@ tun_rx(struct vr_interface *vif, struct vr_packet *pkt,
     vr_init_forwarding_md(&fmd);
     fmd.fmd_vlan = vlan_id;
     fmd.fmd_dvrf = vif->vif_vrf;
+    VR_DP_LAT_RX(pkt, &fmd);
+    VR_TRACE_RX(vif, pkt, &fmd, vlan_id);
 
     vif_mirror(vif, pkt, &fmd, vif->vif_flags & VIF_FLAG_MIRROR_RX);
 
@@ -1271,6 +1286,8 @@ eth_rx(struct vr_interface *vif, struct vr_packet *pkt,
     struct vr_eth *eth = (struct vr_eth *)pkt_data(pkt);
 
     vr_init_forwarding_md(&fmd);
+    VR_DP_LAT_RX(pkt, &fmd);
+    VR_TRACE_RX(vif, pkt, &fmd, vlan_id);
 
     stats->vis_ibytes += pkt_len(pkt);
     stats->vis_ipackets++;
@@ -1318,6 +1335,9 @@ eth_tx(struct vr_interface *vif, struct vr_packet *pkt,
 
     struct vr_interface_stats *stats = vif_get_stats(vif, pkt->vp_cpu);
 
+    VR_DP_LAT_STAGE(VR_DP_LAT_VIF_TX, pkt, fmd);
+    VR_TRACE(VR_TRACE_VIF_TX, vif, pkt, fmd, pkt->vp_nh, pkt->vp_type, 0);
+
     vif_mirror(vif, pkt, fmd, vif->vif_flags & VIF_FLAG_MIRROR_TX);
 
     if (vif_is_virtual(vif)) {
@@ -1523,19 +1543,26 @@ static void
 vif_free(struct vr_interface *vif)
 {
     unsigned int i;
+    struct vrouter *router;
 
     if (!vif)
         return;
 
-    for (i = 0; i < vr_num_cpus; i++) {
-        if (vif->vif_stats[i].vis_queue_ierrors_to_lcore) {
-            vr_free(vif->vif_stats[i].vis_queue_ierrors_to_lcore,
-                VR_INTERFACE_TO_LCORE_ERRORS_OBJECT);
+    if (vif->vif_stats) {
+        for (i = 0; i < vr_num_cpus; i++) {
+            if (vif->vif_stats[i].vis_queue_ierrors_to_lcore) {
+                vr_free(vif->vif_stats[i].vis_queue_ierrors_to_lcore,
+                    VR_INTERFACE_TO_LCORE_ERRORS_OBJECT);
+            }
         }
-    }
 
-    if (vif->vif_stats)
-        vr_free(vif->vif_stats, VR_INTERFACE_STATS_OBJECT);
+        router = vrouter_get(vif->vif_rid);
+        if (vr_stats_shm_owns(router, vif->vif_stats))
+            vr_stats_shm_detach(router, vif->vif_stats);
+        else
+            vr_free(vif->vif_stats, VR_INTERFACE_STATS_OBJECT);
+        vif->vif_stats = NULL;
+    }
 
     if (vif->vif_vrf_table) {
         vr_free(vif->vif_vrf_table, VR_INTERFACE_VRF_TABLE_OBJECT);
@@ -2188,8 +2215,17 @@ vr_interface_add(vr_interface_req *req, bool need_response)
         goto error;
     }
 
-    vif->vif_stats = vr_zalloc(vr_num_cpus *
-            sizeof(struct vr_interface_stats), VR_INTERFACE_STATS_OBJECT);
+    /*
+     * the counters live in the slot of the interface in the shared stats
+     * region, unless there is no region or the slot is still held by an
+     * interface that was deleted but is not freed yet, in which case the
+     * slot is marked private and readers of the region go to netlink
+     */
+    vif->vif_stats = vr_stats_shm_attach(router, VR_STATS_SHM_VIF,
+            req->vifr_idx);
+    if (!vif->vif_stats)
+        vif->vif_stats = vr_zalloc(vr_num_cpus *
+                sizeof(struct vr_interface_stats), VR_INTERFACE_STATS_OBJECT);
     if (!vif->vif_stats) {
         ret = -ENOMEM;
         goto error;
@@ -12,6 +12,7 @@
 #include "vr_bridge.h"
 #include "vr_datapath.h"
 #include "vr_ip_mtrie.h"
+#include "vr_stats_shm.h"
 
 extern unsigned int vr_vrfs;
 
@@ -1101,19 +1102,28 @@ static void
 mtrie_stats_cleanup(struct vr_rtable *rtable, bool soft_reset)
 {
     unsigned int i, stats_memory_size;
+    struct vrouter *router = vrouter_get(0);
 
     if (!mtrie_vrf_stats)
         return;
 
     stats_memory_size = sizeof(struct vr_vrf_stats) * vr_num_cpus;
     for (i = 0; i < rtable->algo_max_vrfs; i++) {
-        if (mtrie_vrf_stats[i]) {
+        if (!mtrie_vrf_stats[i])
+            continue;
+
+        if (vr_stats_shm_owns(router, mtrie_vrf_stats[i])) {
             if (soft_reset) {
-                memset(mtrie_vrf_stats[i], 0, stats_memory_size);
+                vr_stats_shm_clear(router, mtrie_vrf_stats[i]);
             } else {
-                vr_free(mtrie_vrf_stats[i], VR_MTRIE_STATS_OBJECT);
+                vr_stats_shm_detach(router, mtrie_vrf_stats[i]);
                 mtrie_vrf_stats[i] = NULL;
             }
+        } else if (soft_reset) {
+            memset(mtrie_vrf_stats[i], 0, stats_memory_size);
+        } else {
+            vr_free(mtrie_vrf_stats[i], VR_MTRIE_STATS_OBJECT);
+            mtrie_vrf_stats[i] = NULL;
         }
     }
 
@@ -1170,6 +1180,12 @@ mtrie_stats_init(struct vr_rtable *rtable)
             return vr_module_error(-ENOMEM, __FUNCTION__,
                     __LINE__, stats_memory);
         for (i = 0; i < rtable->algo_max_vrfs; i++) {
+            /* in the slot of the vrf in the shared stats region, if any */
+            mtrie_vrf_stats[i] = vr_stats_shm_attach(vrouter_get(0),
+                    VR_STATS_SHM_VRF, i);
+            if (mtrie_vrf_stats[i])
+                continue;
+
             stats_memory = sizeof(struct vr_vrf_stats) * vr_num_cpus;
             mtrie_vrf_stats[i] = vr_zalloc(stats_memory,
                     VR_MTRIE_STATS_OBJECT);
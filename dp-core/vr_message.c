@@ -70,6 +70,8 @@ vr_message_request(struct vr_message *message)
 
     ret = message_h.vm_proto->mproto_decode(message->vr_message_buf,
             message->vr_message_len, NULL, NULL);
+    /* a flow bulk batch does not go beyond its message */
+    vr_flow_bulk_end();
     if (ret < 0)
         return ret;
 
@@ -316,6 +318,41 @@ vr_message_dump_object(void *arg, unsigned int object_type, void *object)
     return ret;
 }
 
+/*
+ * dump the per cpu records of a collector, with records of them per cpu.
+ * the marker is the position of the last record dumped, across all the
+ * cpus. fill makes the object of a record of a cpu, and returns 1 to dump
+ * it, 0 to skip the record and a negative value to skip the rest of the
+ * records of the cpu
+ */
+int
+vr_message_dump_pcpu(void *dumper, unsigned int object_type, int marker,
+        unsigned int records,
+        int (*fill)(void *, unsigned int, unsigned int, unsigned int, void *),
+        void *object, void *arg)
+{
+    int ret = 0, filled;
+    unsigned int i, cpu;
+
+    for (i = (unsigned int)(marker + 1); i < vr_num_cpus * records; i++) {
+        cpu = i / records;
+        filled = fill(object, cpu, i % records, i, arg);
+        if (filled < 0) {
+            i = ((cpu + 1) * records) - 1;
+            continue;
+        }
+
+        if (!filled)
+            continue;
+
+        ret = vr_message_dump_object(dumper, object_type, object);
+        if (ret <= 0)
+            break;
+    }
+
+    return ret;
+}
+
 void
 vr_message_dump_exit(void *context, int ret)
 {
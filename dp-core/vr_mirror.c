@@ -382,8 +382,9 @@ vr_mirror(struct vrouter *router, uint8_t mirror_id, struct vr_packet *pkt,
     if (!pkt)
         return 0;
 
-    /* Mark as mirrored */
+    /* Mark as mirrored, the copy is not the sampled or traced packet */
     pkt->vp_flags |= VP_FLAG_FROM_DP;
+    pkt->vp_flags &= ~(VP_FLAG_DP_LAT | VP_FLAG_TRACE);
 
     /* Set the GSO and partial checksum flag */
     pkt->vp_flags |= (VP_FLAG_FLOW_SET | VP_FLAG_GSO);
@@ -18,6 +18,8 @@
 #include "vr_route.h"
 #include "vr_hash.h"
 #include "vr_mirror.h"
+#include "vr_stats.h"
+#include "vr_trace.h"
 
 extern bool vr_has_to_fragment(struct vr_interface *, struct vr_packet *,
         unsigned int);
@@ -73,6 +75,21 @@ __vrouter_set_nexthop(struct vrouter *router, unsigned int index,
     return 0;
 }
 
+static inline void
+nh_stats_inc(struct vr_nexthop *nh, unsigned int slot, struct vr_packet *pkt)
+{
+    struct vr_nexthop_stats *stats = nh->nh_stats;
+
+    if (!stats || (slot >= nh->nh_stats_slots))
+        return;
+
+    stats += ((vr_get_cpu() & VR_CPU_MASK) * nh->nh_stats_stride) + slot;
+    stats->nhs_packets++;
+    stats->nhs_bytes += pkt_len(pkt);
+
+    return;
+}
+
 static bool
 vr_l2_control_data_add(struct vr_packet **pkt)
 {
@@ -130,6 +147,12 @@ vrouter_free_nexthop(struct vr_nexthop *nh)
         vrouter_put_interface(nh->nh_dev);
     }
 
+    if (nh->nh_stats_mem) {
+        vr_free(nh->nh_stats_mem, VR_NEXTHOP_STATS_OBJECT);
+        nh->nh_stats_mem = NULL;
+        nh->nh_stats = NULL;
+    }
+
     vr_free(nh, VR_NEXTHOP_OBJECT);
     return;
 }
@@ -868,7 +891,8 @@ nh_composite_ecmp_select_nh(struct vr_packet *pkt, struct vr_nexthop *nh,
              * packet can be hashed on ethernet header and VRF to identify
              * the component
              */
-            hash_ecmp = vr_hash(pkt_data(pkt), VR_ETHER_HLEN, 0);
+            hash_ecmp = vr_hash_key(vr_hash_crc32c_enabled, pkt_data(pkt),
+                    VR_ETHER_HLEN, 0);
             hash_ecmp = vr_hash_2words(hash_ecmp, fmd->fmd_dvrf, 0);
             hash_computed = true;
         }
@@ -877,7 +901,8 @@ nh_composite_ecmp_select_nh(struct vr_packet *pkt, struct vr_nexthop *nh,
 
     if (ecmp_index == -1) {
         if (!hash_computed)
-            hash_ecmp = vr_hash(flowp, flowp->flow_key_len, 0);
+            hash_ecmp = vr_hash_key(vr_hash_crc32c_enabled, flowp,
+                    flowp->flow_key_len, 0);
         hash = hash_ecmp % count;
         ecmp_index = cnhp[hash].cnh_ecmp_index;
         cnh = cnhp[hash].cnh;
@@ -934,6 +959,9 @@ nh_composite_ecmp(struct vr_packet *pkt, struct vr_nexthop *nh,
 
     vr_fmd_set_label(fmd, nh->nh_component_nh[fmd->fmd_ecmp_nh_index].cnh_label,
             VR_LABEL_TYPE_UNKNOWN);
+    VR_TRACE(VR_TRACE_ECMP, member_nh->nh_dev, pkt, fmd, nh,
+            fmd->fmd_ecmp_nh_index, member_nh->nh_id);
+    nh_stats_inc(nh, fmd->fmd_ecmp_nh_index + 1, pkt);
     nh_output(pkt, member_nh, fmd);
     return NH_PROCESSING_COMPLETE;
 
@@ -1302,7 +1330,8 @@ nh_composite_mcast_l2(struct vr_packet *pkt, struct vr_nexthop *nh,
             get_random_bytes(&vr_hashrnd, sizeof(vr_hashrnd));
             hashrnd_inited = 1;
         }
-        hashval = vr_hash(eth, sizeof(struct vr_eth), vr_hashrnd);
+        hashval = vr_hash_key(vr_hash_crc32c_enabled, eth,
+                sizeof(struct vr_eth), vr_hashrnd);
         /* Include the VRF to calculate the hash */
         hashval = vr_hash_2words(hashval, fmd->fmd_dvrf, vr_hashrnd);
 
@@ -1425,6 +1454,7 @@ nh_composite_mcast_l2(struct vr_packet *pkt, struct vr_nexthop *nh,
             continue;
         }
 
+        nh_stats_inc(nh, i + 1, new_pkt);
         nh_output(new_pkt, dir_nh, fmd);
     }
 
@@ -1477,6 +1507,7 @@ nh_composite_encap(struct vr_packet *pkt, struct vr_nexthop *nh,
             break;
         }
         fmd->fmd_dvrf = dir_nh->nh_dev->vif_vrf;
+        nh_stats_inc(nh, i + 1, new_pkt);
         nh_output(new_pkt, dir_nh, fmd);
     }
 
@@ -1540,6 +1571,7 @@ nh_composite_tor(struct vr_packet *pkt, struct vr_nexthop *nh,
         vr_fmd_set_label(fmd, nh->nh_component_nh[i].cnh_label,
                 VR_LABEL_TYPE_UNKNOWN);
         fmd->fmd_dvrf = dir_nh->nh_dev->vif_vrf;
+        nh_stats_inc(nh, i + 1, new_pkt);
         nh_output(new_pkt, dir_nh, fmd);
     }
 
@@ -1621,6 +1653,7 @@ nh_composite_evpn(struct vr_packet *pkt, struct vr_nexthop *nh,
         vr_fmd_set_label(fmd, nh->nh_component_nh[i].cnh_label,
                 VR_LABEL_TYPE_UNKNOWN);
         fmd->fmd_dvrf = dir_nh->nh_dev->vif_vrf;
+        nh_stats_inc(nh, i + 1, new_pkt);
         nh_output(new_pkt, dir_nh, fmd);
     }
 
@@ -1756,6 +1789,7 @@ nh_composite_fabric(struct vr_packet *pkt, struct vr_nexthop *nh,
         vr_fmd_set_label(fmd, nh->nh_component_nh[i].cnh_label,
                 VR_LABEL_TYPE_UNKNOWN);
         fmd->fmd_dvrf = dir_nh->nh_dev->vif_vrf;
+        nh_stats_inc(nh, i + 1, new_pkt);
         nh_output(new_pkt, dir_nh, fmd);
     }
 
@@ -1854,7 +1888,8 @@ nh_udp_tunnel(struct vr_packet *pkt, struct vr_nexthop *nh,
     }
 
     if (!ret) {
-        hash = vr_hash(flowp, flowp->flow_key_len, 0);
+        hash = vr_hash_key(vr_hash_crc32c_enabled, flowp,
+                flowp->flow_key_len, 0);
         port_range = VR_UDP_PORT_RANGE_END - VR_UDP_PORT_RANGE_START;
         sport = (uint16_t)
             (((uint64_t ) hash * port_range) >> 32);
@@ -1911,6 +1946,9 @@ nh_udp_tunnel(struct vr_packet *pkt, struct vr_nexthop *nh,
         pkt->vp_type = VP_TYPE_IP6;
     }
 
+    VR_TRACE(VR_TRACE_UDP_TUNNEL, nh->nh_dev, pkt, fmd, nh,
+            (nh->nh_family == AF_INET) ? nh->nh_udp_tun_dip : 0, sport);
+
     fmd->fmd_udp_src_port = sport;
 
     pkt_set_network_header(pkt, pkt->vp_data);
@@ -2443,6 +2481,10 @@ nh_output(struct vr_packet *pkt, struct vr_nexthop *nh,
     bool need_flow_lookup = false;
     nh_processing_t res;
 
+    VR_DP_LAT_STAGE(VR_DP_LAT_NH_OUTPUT, pkt, fmd);
+    VR_TRACE(VR_TRACE_NH_OUTPUT, nh->nh_dev, pkt, fmd, nh, nh->nh_type,
+            nh->nh_flags);
+
     if (!pkt->vp_ttl) {
         vr_trap(pkt, fmd->fmd_dvrf, AGENT_TRAP_ZERO_TTL, NULL);
         return 0;
@@ -2502,6 +2544,8 @@ nh_output(struct vr_packet *pkt, struct vr_nexthop *nh,
         }
     }
 
+    nh_stats_inc(nh, 0, pkt);
+
     res = nh->nh_reach_nh(pkt, nh, fmd);
     if (res == NH_PROCESSING_COMPLETE)
         return 0;
@@ -3271,6 +3315,85 @@ vr_nexthop_size(vr_nexthop_req *req)
     return size;
 }
 
+/*
+ * Counters are allocated, grown to the component count or freed as per
+ * NH_FLAG_COUNTERS of the request. The datapath finds the rows through
+ * nh_stats, so the old rows are unpublished and waited out before the
+ * geometry changes. Counts of the nexthop itself survive a resize.
+ */
+static int
+nh_stats_set(struct vr_nexthop *nh, vr_nexthop_req *req)
+{
+    unsigned int i, slots = 1, stride;
+    void *mem, *old_mem = nh->nh_stats_mem;
+    struct vr_nexthop_stats *stats, *old = nh->nh_stats;
+
+    if (!(req->nhr_flags & NH_FLAG_COUNTERS)) {
+        if (old) {
+            nh->nh_stats = NULL;
+            vr_delay_op();
+            nh->nh_stats_mem = NULL;
+            vr_free(old_mem, VR_NEXTHOP_STATS_OBJECT);
+        }
+
+        return 0;
+    }
+
+    if (nh->nh_type == NH_COMPOSITE)
+        slots += nh->nh_component_cnt;
+
+    if (old && (nh->nh_stats_slots >= slots))
+        return 0;
+
+    stride = sizeof(*stats) * slots;
+    stride = (stride + NH_STATS_ROW_ALIGN - 1) & ~(NH_STATS_ROW_ALIGN - 1);
+    stride /= sizeof(*stats);
+
+    mem = vr_zalloc((vr_num_cpus * stride * sizeof(*stats)) +
+            NH_STATS_ROW_ALIGN - 1, VR_NEXTHOP_STATS_OBJECT);
+    if (!mem)
+        return -ENOMEM;
+
+    stats = (struct vr_nexthop_stats *)(((uintptr_t)mem +
+                NH_STATS_ROW_ALIGN - 1) & ~(uintptr_t)(NH_STATS_ROW_ALIGN - 1));
+
+    if (old) {
+        nh->nh_stats = NULL;
+        vr_delay_op();
+        for (i = 0; i < vr_num_cpus; i++)
+            stats[i * stride] = old[i * nh->nh_stats_stride];
+        vr_free(old_mem, VR_NEXTHOP_STATS_OBJECT);
+    }
+
+    nh->nh_stats_mem = mem;
+    nh->nh_stats_slots = slots;
+    nh->nh_stats_stride = stride;
+    vr_sync_synchronize();
+    nh->nh_stats = stats;
+
+    return 0;
+}
+
+static void
+nh_stats_get(struct vr_nexthop *nh, unsigned int slot,
+        struct vr_nexthop_stats *sum)
+{
+    unsigned int i;
+    struct vr_nexthop_stats *stats;
+
+    memset(sum, 0, sizeof(*sum));
+    if (!nh->nh_stats || (slot >= nh->nh_stats_slots))
+        return;
+
+    for (i = 0; i < vr_num_cpus; i++) {
+        stats = &nh->nh_stats[(i * nh->nh_stats_stride) + slot];
+        sum->nhs_packets += stats->nhs_packets;
+        sum->nhs_bytes += stats->nhs_bytes;
+    }
+
+    return;
+}
+
 static bool
 vr_nexthop_valid_change(vr_nexthop_req *req, struct vr_nexthop *nh)
 {
@@ -3412,6 +3535,9 @@ vr_nexthop_add(vr_nexthop_req *req)
 
     }
 
+    if (!ret)
+        ret = nh_stats_set(nh, req);
+
 error:
     if (ret) {
         if (!change) {
@@ -3453,6 +3579,9 @@ vr_nexthop_req_get_size(void *req_p)
     if (req->nhr_label_list_size)
         size += (4 * req->nhr_label_list_size);
 
+    if (req->nhr_nh_packets_size)
+        size += (2 * 8 * req->nhr_nh_packets_size);
+
     size += req->nhr_pbb_mac_size;
 
     if ((req->nhr_type == NH_TUNNEL) &&
@@ -3470,6 +3599,7 @@ vr_nexthop_make_req(vr_nexthop_req *req, struct vr_nexthop *nh)
     unsigned int i;
     unsigned char *encap = NULL;
     struct vr_nexthop *cnh;
+    struct vr_nexthop_stats stats;
 
     bool dump = false;
 
@@ -3485,6 +3615,12 @@ vr_nexthop_make_req(vr_nexthop_req *req, struct vr_nexthop *nh)
     req->nhr_nh_list_size = 0;
     req->nhr_vrf = nh->nh_vrf;
 
+    if (nh->nh_stats) {
+        nh_stats_get(nh, 0, &stats);
+        req->nhr_packets = stats.nhs_packets;
+        req->nhr_bytes = stats.nhs_bytes;
+    }
+
     if ((nh->nh_flags & NH_FLAG_INDIRECT) && (cnh = nh->nh_direct_nh)) {
         req->nhr_nh_list_size = 1;
         req->nhr_nh_list =
@@ -3546,6 +3682,28 @@ vr_nexthop_make_req(vr_nexthop_req *req, struct vr_nexthop *nh)
 
                 req->nhr_label_list[i] = nh->nh_component_nh[i].cnh_label;
             }
+
+            if (nh->nh_stats) {
+                req->nhr_nh_packets_size = req->nhr_nh_list_size;
+                req->nhr_nh_packets =
+                    vr_zalloc(req->nhr_nh_packets_size * sizeof(uint64_t),
+                            VR_NEXTHOP_REQ_LIST_OBJECT);
+                if (!req->nhr_nh_packets)
+                    return -ENOMEM;
+
+                req->nhr_nh_bytes_size = req->nhr_nh_list_size;
+                req->nhr_nh_bytes =
+                    vr_zalloc(req->nhr_nh_bytes_size * sizeof(uint64_t),
+                            VR_NEXTHOP_REQ_LIST_OBJECT);
+                if (!req->nhr_nh_bytes)
+                    return -ENOMEM;
+
+                for (i = 0; i < req->nhr_nh_list_size; i++) {
+                    nh_stats_get(nh, i + 1, &stats);
+                    req->nhr_nh_packets[i] = stats.nhs_packets;
+                    req->nhr_nh_bytes[i] = stats.nhs_bytes;
+                }
+            }
         }
 
         break;
@@ -3706,6 +3864,18 @@ vr_nexthop_req_destroy(vr_nexthop_req *req)
         req->nhr_label_list_size = 0;
     }
 
+    if (req->nhr_nh_packets) {
+        vr_free(req->nhr_nh_packets, VR_NEXTHOP_REQ_LIST_OBJECT);
+        req->nhr_nh_packets = NULL;
+        req->nhr_nh_packets_size = 0;
+    }
+
+    if (req->nhr_nh_bytes) {
+        vr_free(req->nhr_nh_bytes, VR_NEXTHOP_REQ_LIST_OBJECT);
+        req->nhr_nh_bytes = NULL;
+        req->nhr_nh_bytes_size = 0;
+    }
+
     if (req->nhr_tun_sip6) {
         vr_free(req->nhr_tun_sip6, VR_NETWORK_ADDRESS_OBJECT);
         req->nhr_tun_sip6 = NULL;
@@ -14,6 +14,7 @@
 #include "vr_ip_mtrie.h"
 #include "vr_fragment.h"
 #include "vr_bridge.h"
+#include "vr_stats.h"
 
 static unsigned short vr_ip_id;
 
@@ -268,6 +269,7 @@ vr_forward(struct vrouter *router, struct vr_packet *pkt,
     rt.rtr_req.rtr_nh_id = 0;
     rt.rtr_req.rtr_marker_size = 0;
 
+    VR_DP_LAT_STAGE(VR_DP_LAT_ROUTE_LOOKUP, pkt, fmd);
     nh = vr_inet_route_lookup(fmd->fmd_dvrf, &rt);
     if (rt.rtr_req.rtr_label_flags & VR_RT_LABEL_VALID_FLAG) {
         if (!fmd) {
@@ -1085,7 +1087,7 @@ vr_inet_flow_lookup(struct vrouter *router, struct vr_packet *pkt,
         }
     }
 
-    return vr_flow_lookup(router, flow_p, pkt, fmd);
+    return vr_inet_flow_table_lookup(router, flow_p, pkt, fmd);
 }
 
 mac_response_t
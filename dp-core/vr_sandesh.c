@@ -8,6 +8,7 @@
 #include "vr_message.h"
 #include "vr_sandesh.h"
 #include "vrouter.h"
+#include "vr_stats.h"
 
 struct sandesh_object_md sandesh_md[] = {
     [VR_NULL_OBJECT_ID]         =   {
@@ -94,6 +95,41 @@ struct sandesh_object_md sandesh_md[] = {
         .obj_len                =       4 * sizeof(vr_hugepage_config),
         .obj_type_string        =       "vr_hugepage_config",
     },
+    [VR_LCORE_STATS_OBJECT_ID] = {
+        .obj_len                =       4 * sizeof(vr_lcore_stats_req),
+        .obj_type_string        =       "vr_lcore_stats_req",
+    },
+    [VR_FLOW_DIRTY_OBJECT_ID] = {
+        .obj_len                =       ((4 * sizeof(vr_flow_dirty_req)) +
+                    (VR_FLOW_DIRTY_CHUNK_WORDS * sizeof(uint64_t))),
+        .obj_type_string        =       "vr_flow_dirty_req",
+    },
+    [VR_FLOW_BULK_RESPONSE_OBJECT_ID] = {
+        .obj_len                =       ((4 * sizeof(vr_flow_bulk_response)) +
+                    (VR_FLOW_BULK_MAX_OPS * ((2 * sizeof(int32_t)) + 1))),
+        .obj_type_string        =       "vr_flow_bulk_response",
+    },
+    [VR_FLOW_POLICY_OBJECT_ID] = {
+        .obj_len                =       ((4 * sizeof(vr_flow_policy_req)) +
+                    (2 * VR_IP6_ADDRESS_LEN)),
+        .obj_type_string        =       "vr_flow_policy_req",
+    },
+    [VR_DP_LATENCY_OBJECT_ID] = {
+        .obj_len                =       ((4 * sizeof(vr_dp_latency_req)) +
+                    (VR_DP_LAT_STAGE_MAX * VR_DP_LAT_BUCKETS *
+                     sizeof(int64_t))),
+        .obj_type_string        =       "vr_dp_latency_req",
+    },
+    [VR_PKT_TRACE_OBJECT_ID] = {
+        .obj_len                =       ((4 * sizeof(vr_pkt_trace_req)) +
+                    (2 * VR_IP6_ADDRESS_LEN)),
+        .obj_type_string        =       "vr_pkt_trace_req",
+    },
+    [VR_DROP_CAPTURE_OBJECT_ID] = {
+        .obj_len                =       ((4 * sizeof(vr_drop_capture_req)) +
+                    VR_DROP_CAPTURE_LEN),
+        .obj_type_string        =       "vr_drop_capture_req",
+    },
 };
 
 static unsigned int
@@ -9,71 +9,12 @@
 #include <vr_packet.h>
 #include "vr_message.h"
 #include "vr_btable.h"
+#include "vr_stats.h"
+#include "vr_stats_shm.h"
 
 void vr_stats_exit(struct vrouter *, bool);
 int vr_stats_init(struct vrouter *);
 
-static void
-vr_drop_stats_make_response(vr_drop_stats_req *response, uint64_t *stats)
-{
-    if (!response || !stats)
-        return;
-
-    response->vds_discard += stats[VP_DROP_DISCARD];
-    response->vds_pull += stats[VP_DROP_PULL];
-    response->vds_invalid_if += stats[VP_DROP_INVALID_IF];
-    response->vds_invalid_arp += stats[VP_DROP_INVALID_ARP];
-    response->vds_trap_no_if += stats[VP_DROP_TRAP_NO_IF];
-    response->vds_nowhere_to_go += stats[VP_DROP_NOWHERE_TO_GO];
-    response->vds_flow_queue_limit_exceeded +=
-        stats[VP_DROP_FLOW_QUEUE_LIMIT_EXCEEDED];
-    response->vds_flow_no_memory += stats[VP_DROP_FLOW_NO_MEMORY];
-    response->vds_flow_invalid_protocol +=
-        stats[VP_DROP_FLOW_INVALID_PROTOCOL];
-    response->vds_flow_nat_no_rflow += stats[VP_DROP_FLOW_NAT_NO_RFLOW];
-    response->vds_flow_action_drop += stats[VP_DROP_FLOW_ACTION_DROP];
-    response->vds_flow_action_invalid += stats[VP_DROP_FLOW_ACTION_INVALID];
-    response->vds_flow_unusable += stats[VP_DROP_FLOW_UNUSABLE];
-    response->vds_flow_table_full += stats[VP_DROP_FLOW_TABLE_FULL];
-    response->vds_interface_tx_discard += stats[VP_DROP_INTERFACE_TX_DISCARD];
-    response->vds_interface_drop += stats[VP_DROP_INTERFACE_DROP];
-    response->vds_duplicated += stats[VP_DROP_DUPLICATED];
-    response->vds_push += stats[VP_DROP_PUSH];
-    response->vds_ttl_exceeded += stats[VP_DROP_TTL_EXCEEDED];
-    response->vds_invalid_nh += stats[VP_DROP_INVALID_NH];
-    response->vds_invalid_label += stats[VP_DROP_INVALID_LABEL];
-    response->vds_invalid_protocol += stats[VP_DROP_INVALID_PROTOCOL];
-    response->vds_interface_rx_discard += stats[VP_DROP_INTERFACE_RX_DISCARD];
-    response->vds_invalid_mcast_source += stats[VP_DROP_INVALID_MCAST_SOURCE];
-    response->vds_pcow_fail += stats[VP_DROP_PCOW_FAIL];
-    response->vds_mcast_df_bit += stats[VP_DROP_MCAST_DF_BIT];
-    response->vds_mcast_clone_fail += stats[VP_DROP_MCAST_CLONE_FAIL];
-    response->vds_no_memory += stats[VP_DROP_NO_MEMORY];
-    response->vds_rewrite_fail += stats[VP_DROP_REWRITE_FAIL];
-    response->vds_misc += stats[VP_DROP_MISC];
-    response->vds_invalid_packet += stats[VP_DROP_INVALID_PACKET];
-    response->vds_cksum_err += stats[VP_DROP_CKSUM_ERR];
-    response->vds_no_fmd += stats[VP_DROP_NO_FMD];
-    response->vds_cloned_original += stats[VP_DROP_CLONED_ORIGINAL];
-    response->vds_invalid_vnid += stats[VP_DROP_INVALID_VNID];
-    response->vds_frag_err += stats[VP_DROP_FRAGMENTS];
-    response->vds_invalid_source += stats[VP_DROP_INVALID_SOURCE];
-    response->vds_l2_no_route += stats[VP_DROP_L2_NO_ROUTE];
-    response->vds_fragment_queue_fail +=
-        stats[VP_DROP_FRAGMENT_QUEUE_FAIL];
-    response->vds_vlan_fwd_tx += stats[VP_DROP_VLAN_FWD_TX];
-    response->vds_vlan_fwd_enq += stats[VP_DROP_VLAN_FWD_ENQ];
-    response->vds_drop_new_flow += stats[VP_DROP_NEW_FLOWS];
-    response->vds_flow_evict += stats[VP_DROP_FLOW_EVICT];
-    response->vds_trap_original += stats[VP_DROP_TRAP_ORIGINAL];
-    response->vds_leaf_to_leaf += stats[VP_DROP_LEAF_TO_LEAF];
-    response->vds_bmac_isid_mismatch += stats[VP_DROP_BMAC_ISID_MISMATCH];
-    response->vds_pkt_loop += stats[VP_DROP_PKT_LOOP];
-
-    return;
-}
-
-
 void
 vr_drop_stats_get_vif_stats(vr_drop_stats_req *response,
                                 struct vr_interface *vif)
@@ -103,7 +44,7 @@ vr_drop_stats_get_vif_stats(vr_drop_stats_req *response,
     }
 
     /* Now add add the stats to response message */
-    vr_drop_stats_make_response(response, stats);
+    vr_drop_stats_fill(response, stats);
 
     return;
 }
@@ -126,11 +67,11 @@ vr_drop_stats_get(unsigned int rid, short core)
     if (core == -1) {
         /* summed up stats */
         for (cpu = 0; cpu < vr_num_cpus; cpu++) {
-            vr_drop_stats_make_response(response, router->vr_pdrop_stats[cpu]);
+            vr_drop_stats_fill(response, router->vr_pdrop_stats[cpu]);
         }
     } else if (core < vr_num_cpus) {
         /* stats for a specific core */
-        vr_drop_stats_make_response(response, router->vr_pdrop_stats[core]);
+        vr_drop_stats_fill(response, router->vr_pdrop_stats[core]);
     }
     /* otherwise the counters will be zeros */
 
@@ -348,6 +289,764 @@ vr_mem_stats_req_process(void *s_req)
     return;
 }
 
+/* maximum number of burst size histogram buckets reported by the host */
+#define VR_LCORE_STATS_BURST_HIST_SZ    16
+
+static int
+vr_lcore_stats_make_req(vr_lcore_stats_req *req, unsigned int core,
+        int64_t *hist)
+{
+    memset(req, 0, sizeof(*req));
+    memset(hist, 0, VR_LCORE_STATS_BURST_HIST_SZ * sizeof(*hist));
+
+    req->vlsr_core = core;
+    req->vlsr_burst_hist = hist;
+    req->vlsr_burst_hist_size = VR_LCORE_STATS_BURST_HIST_SZ;
+
+    return vr_get_lcore_stats(core, req);
+}
+
+static void
+vr_lcore_stats_get(vr_lcore_stats_req *r)
+{
+    int ret = 0;
+    int64_t hist[VR_LCORE_STATS_BURST_HIST_SZ];
+    vr_lcore_stats_req req;
+
+    if (!vr_get_lcore_stats && (ret = -EOPNOTSUPP))
+        goto exit_get;
+
+    if ((r->vlsr_core < 0 || (unsigned int)r->vlsr_core >= vr_num_cpus)
+            && (ret = -EINVAL))
+        goto exit_get;
+
+    ret = vr_lcore_stats_make_req(&req, r->vlsr_core, hist);
+
+exit_get:
+    vr_message_response(VR_LCORE_STATS_OBJECT_ID, ret ? NULL : &req, ret,
+            false);
+    return;
+}
+
+static void
+vr_lcore_stats_dump(vr_lcore_stats_req *r)
+{
+    int ret = 0;
+    unsigned int i;
+    int64_t hist[VR_LCORE_STATS_BURST_HIST_SZ];
+    struct vr_message_dumper *dumper = NULL;
+    vr_lcore_stats_req req;
+
+    if (!vr_get_lcore_stats && (ret = -EOPNOTSUPP))
+        goto generate_response;
+
+    if ((unsigned int)(r->vlsr_marker + 1) >= vr_num_cpus)
+        goto generate_response;
+
+    dumper = vr_message_dump_init(r);
+    if (!dumper && (ret = -ENOMEM))
+        goto generate_response;
+
+    for (i = (unsigned int)(r->vlsr_marker + 1); i < vr_num_cpus; i++) {
+        /* skip the cores which do not run the forwarding loops */
+        if (vr_lcore_stats_make_req(&req, i, hist))
+            continue;
+
+        ret = vr_message_dump_object(dumper, VR_LCORE_STATS_OBJECT_ID, &req);
+        if (ret <= 0)
+            break;
+    }
+
+generate_response:
+    vr_message_dump_exit(dumper, ret);
+
+    return;
+}
+
+void
+vr_lcore_stats_req_process(void *s_req)
+{
+    int ret;
+    vr_lcore_stats_req *req = (vr_lcore_stats_req *)s_req;
+
+    switch (req->h_op) {
+    case SANDESH_OP_GET:
+        vr_lcore_stats_get(req);
+        break;
+
+    case SANDESH_OP_DUMP:
+        vr_lcore_stats_dump(req);
+        break;
+
+    default:
+        ret = -EOPNOTSUPP;
+        vr_send_response(ret);
+        break;
+    }
+
+    return;
+}
+
+void
+vr_pcpu_blocks_free(void *array, unsigned int object)
+{
+    unsigned int i;
+    void **blocks = (void **)array;
+
+    if (!blocks)
+        return;
+
+    for (i = 0; i < vr_num_cpus; i++) {
+        if (!blocks[vr_num_cpus + i])
+            break;
+        vr_free(blocks[vr_num_cpus + i], object);
+    }
+
+    vr_free(blocks, object);
+
+    return;
+}
+
+/*
+ * an array of a zeroed block of the size per cpu. the allocator does not
+ * align to a cache line, so each block is carved out of an allocation of
+ * its own at the first aligned address, and the allocations are kept
+ * after the blocks in the array
+ */
+void *
+vr_pcpu_blocks_alloc(unsigned int size, unsigned int object)
+{
+    unsigned int i;
+    void **blocks;
+
+    blocks = vr_zalloc(2 * vr_num_cpus * sizeof(void *), object);
+    if (!blocks)
+        return NULL;
+
+    size = (size + VR_PCPU_BLOCK_ALIGN - 1) & ~(VR_PCPU_BLOCK_ALIGN - 1);
+    for (i = 0; i < vr_num_cpus; i++) {
+        blocks[vr_num_cpus + i] = vr_zalloc(size + VR_PCPU_BLOCK_ALIGN - 1,
+                object);
+        if (!blocks[vr_num_cpus + i]) {
+            vr_pcpu_blocks_free(blocks, object);
+            return NULL;
+        }
+
+        blocks[i] = (void *)(((uintptr_t)blocks[vr_num_cpus + i] +
+                    VR_PCPU_BLOCK_ALIGN - 1) &
+                ~(uintptr_t)(VR_PCPU_BLOCK_ALIGN - 1));
+    }
+
+    return blocks;
+}
+
+struct vr_dp_lat_cpu {
+    /* packets to go before the next one is sampled */
+    unsigned int dlc_countdown;
+    uint64_t dlc_samples;
+    uint64_t dlc_hist[VR_DP_LAT_STAGE_MAX][VR_DP_LAT_BUCKETS];
+};
+
+#define VR_DP_LAT_HIST_SIZE     (VR_DP_LAT_STAGE_MAX * VR_DP_LAT_BUCKETS)
+
+unsigned int vr_dp_lat_sample_rate;
+
+static unsigned int
+vr_dp_lat_bucket(uint64_t cycles)
+{
+    unsigned int bucket = 0;
+
+    while ((cycles >>= 1) && (bucket < VR_DP_LAT_BUCKETS - 1))
+        bucket++;
+
+    return bucket;
+}
+
+static struct vr_dp_lat_cpu *
+vr_dp_lat_cpu_get(void)
+{
+    unsigned int cpu = vr_get_cpu();
+    struct vrouter *router = vrouter_get(0);
+
+    if (!router->vr_dp_latency || cpu >= vr_num_cpus)
+        return NULL;
+
+    return router->vr_dp_latency[cpu];
+}
+
+void
+vr_dp_lat_rx(struct vr_packet *pkt, struct vr_forwarding_md *fmd)
+{
+    struct vr_dp_lat_cpu *lc = vr_dp_lat_cpu_get();
+
+    if (!lc)
+        return;
+
+    if (lc->dlc_countdown > 1) {
+        lc->dlc_countdown--;
+        return;
+    }
+
+    lc->dlc_countdown = vr_dp_lat_sample_rate;
+    fmd->fmd_lat_start = fmd->fmd_lat_last = vr_get_cycles();
+    pkt->vp_flags |= VP_FLAG_DP_LAT;
+    lc->dlc_samples++;
+
+    return;
+}
+
+/*
+ * the sample is dropped if the packet went on with a new forwarding
+ * metadata (out of a hold queue, for one), as the time since RX is gone
+ */
+void
+vr_dp_lat_stage(unsigned int stage, struct vr_packet *pkt,
+        struct vr_forwarding_md *fmd)
+{
+    uint64_t now;
+    struct vr_dp_lat_cpu *lc = vr_dp_lat_cpu_get();
+
+    if (!lc || !fmd || !fmd->fmd_lat_start) {
+        pkt->vp_flags &= ~VP_FLAG_DP_LAT;
+        return;
+    }
+
+    now = vr_get_cycles();
+    lc->dlc_hist[stage][vr_dp_lat_bucket(now - fmd->fmd_lat_last)]++;
+    fmd->fmd_lat_last = now;
+
+    if (stage == VR_DP_LAT_VIF_TX) {
+        lc->dlc_hist[VR_DP_LAT_TOTAL][vr_dp_lat_bucket(now -
+                fmd->fmd_lat_start)]++;
+        pkt->vp_flags &= ~VP_FLAG_DP_LAT;
+    }
+
+    return;
+}
+
+static void
+vr_dp_lat_reset(struct vrouter *router)
+{
+    unsigned int i;
+
+    if (!router->vr_dp_latency)
+        return;
+
+    for (i = 0; i < vr_num_cpus; i++) {
+        router->vr_dp_latency[i]->dlc_samples = 0;
+        memset(router->vr_dp_latency[i]->dlc_hist, 0,
+                sizeof(router->vr_dp_latency[i]->dlc_hist));
+    }
+
+    return;
+}
+
+static void
+vr_dp_lat_exit(struct vrouter *router)
+{
+    vr_dp_lat_sample_rate = 0;
+
+    vr_pcpu_blocks_free(router->vr_dp_latency, VR_DP_LATENCY_OBJECT);
+    router->vr_dp_latency = NULL;
+
+    return;
+}
+
+static int
+vr_dp_lat_init(struct vrouter *router)
+{
+    if (router->vr_dp_latency)
+        return 0;
+
+    router->vr_dp_latency = vr_pcpu_blocks_alloc(sizeof(struct vr_dp_lat_cpu),
+            VR_DP_LATENCY_OBJECT);
+    if (!router->vr_dp_latency)
+        return -ENOMEM;
+
+    return 0;
+}
+
+static void
+vr_dp_lat_make_req(vr_dp_latency_req *req, struct vrouter *router,
+        int core, int64_t *hist)
+{
+    unsigned int i, j, cpu;
+    struct vr_dp_lat_cpu *lc;
+
+    memset(req, 0, sizeof(*req));
+    memset(hist, 0, VR_DP_LAT_HIST_SIZE * sizeof(*hist));
+
+    req->vdl_core = core;
+    req->vdl_sample_rate = vr_dp_lat_sample_rate;
+    req->vdl_stages = VR_DP_LAT_STAGE_MAX;
+    req->vdl_buckets = VR_DP_LAT_BUCKETS;
+    req->vdl_hist = hist;
+    req->vdl_hist_size = VR_DP_LAT_HIST_SIZE;
+
+    if (!router->vr_dp_latency)
+        return;
+
+    /* core -1 sums up the histograms of all the cpus */
+    for (cpu = 0; cpu < vr_num_cpus; cpu++) {
+        if (core >= 0 && cpu != (unsigned int)core)
+            continue;
+
+        lc = router->vr_dp_latency[cpu];
+        req->vdl_samples += lc->dlc_samples;
+        for (i = 0; i < VR_DP_LAT_STAGE_MAX; i++)
+            for (j = 0; j < VR_DP_LAT_BUCKETS; j++)
+                hist[(i * VR_DP_LAT_BUCKETS) + j] += lc->dlc_hist[i][j];
+    }
+
+    return;
+}
+
+static void
+vr_dp_lat_set(vr_dp_latency_req *r)
+{
+    int ret = 0;
+    struct vrouter *router = vrouter_get(r->vdl_rid);
+
+    if (!router && (ret = -ENOENT))
+        goto exit_set;
+
+    if (!vr_get_cycles && (ret = -EOPNOTSUPP))
+        goto exit_set;
+
+    if (r->vdl_sample_rate) {
+        ret = vr_dp_lat_init(router);
+        if (ret)
+            goto exit_set;
+        /* publish the histograms before the datapath starts sampling */
+        vr_sync_synchronize();
+    }
+
+    vr_dp_lat_sample_rate = r->vdl_sample_rate;
+
+exit_set:
+    vr_send_response(ret);
+    return;
+}
+
+static void
+vr_dp_lat_get(vr_dp_latency_req *r)
+{
+    int ret = 0;
+    int64_t *hist = NULL;
+    struct vrouter *router = vrouter_get(r->vdl_rid);
+    vr_dp_latency_req req;
+
+    if (!router && (ret = -ENOENT))
+        goto exit_get;
+
+    if ((r->vdl_core < -1 || r->vdl_core >= (int)vr_num_cpus) &&
+            (ret = -EINVAL))
+        goto exit_get;
+
+    hist = vr_zalloc(VR_DP_LAT_HIST_SIZE * sizeof(*hist),
+            VR_DP_LATENCY_OBJECT);
+    if (!hist && (ret = -ENOMEM))
+        goto exit_get;
+
+    vr_dp_lat_make_req(&req, router, r->vdl_core, hist);
+
+exit_get:
+    vr_message_response(VR_DP_LATENCY_OBJECT_ID, ret ? NULL : &req, ret,
+            false);
+    if (hist)
+        vr_free(hist, VR_DP_LATENCY_OBJECT);
+
+    return;
+}
+
+static void
+vr_dp_lat_dump(vr_dp_latency_req *r)
+{
+    int ret = 0;
+    unsigned int i;
+    int64_t *hist = NULL;
+    struct vrouter *router = vrouter_get(r->vdl_rid);
+    struct vr_message_dumper *dumper = NULL;
+    vr_dp_latency_req req;
+
+    if (!router && (ret = -ENOENT))
+        goto generate_response;
+
+    if ((unsigned int)(r->vdl_marker + 1) >= vr_num_cpus)
+        goto generate_response;
+
+    hist = vr_zalloc(VR_DP_LAT_HIST_SIZE * sizeof(*hist),
+            VR_DP_LATENCY_OBJECT);
+    if (!hist && (ret = -ENOMEM))
+        goto generate_response;
+
+    dumper = vr_message_dump_init(r);
+    if (!dumper && (ret = -ENOMEM))
+        goto generate_response;
+
+    for (i = (unsigned int)(r->vdl_marker + 1); i < vr_num_cpus; i++) {
+        vr_dp_lat_make_req(&req, router, i, hist);
+        ret = vr_message_dump_object(dumper, VR_DP_LATENCY_OBJECT_ID, &req);
+        if (ret <= 0)
+            break;
+    }
+
+generate_response:
+    vr_message_dump_exit(dumper, ret);
+    if (hist)
+        vr_free(hist, VR_DP_LATENCY_OBJECT);
+
+    return;
+}
+
+void
+vr_dp_latency_req_process(void *s_req)
+{
+    int ret = 0;
+    struct vrouter *router;
+    vr_dp_latency_req *req = (vr_dp_latency_req *)s_req;
+
+    switch (req->h_op) {
+    case SANDESH_OP_ADD:
+        vr_dp_lat_set(req);
+        break;
+
+    case SANDESH_OP_GET:
+        vr_dp_lat_get(req);
+        break;
+
+    case SANDESH_OP_DUMP:
+        vr_dp_lat_dump(req);
+        break;
+
+    case SANDESH_OP_RESET:
+        router = vrouter_get(req->vdl_rid);
+        if (router)
+            vr_dp_lat_reset(router);
+        else
+            ret = -ENOENT;
+        vr_send_response(ret);
+        break;
+
+    default:
+        ret = -EOPNOTSUPP;
+        vr_send_response(ret);
+        break;
+    }
+
+    return;
+}
+
+struct vr_drop_record {
+    /* sequence number of the drop on the cpu, zero while it is written */
+    uint64_t dr_seq;
+    uint64_t dr_sec;
+    uint64_t dr_usec;
+    int16_t dr_vif;
+    uint16_t dr_vrf;
+    uint16_t dr_reason;
+    uint16_t dr_flags;
+    int32_t dr_nh;
+    /* length of the packet from the start of the captured data */
+    uint32_t dr_len;
+    uint16_t dr_caplen;
+    uint8_t dr_data[VR_DROP_CAPTURE_LEN];
+};
+
+struct vr_drop_capture_cpu {
+    /* drops to go before the next one is captured */
+    unsigned int dcc_countdown;
+    /* drops captured on this cpu, the last one is at seq % records */
+    uint64_t dcc_seq;
+    struct vr_drop_record dcc_records[VR_DROP_CAPTURE_RECORDS];
+};
+
+unsigned int vr_drop_capture_rate;
+static int vr_drop_capture_reason = VR_DROP_CAPTURE_ANY;
+
+void
+vr_drop_capture(struct vr_packet *pkt, unsigned short reason)
+{
+    int len;
+    unsigned int cpu = vr_get_cpu();
+    unsigned short offset, flags = 0;
+    struct vrouter *router = vrouter_get(0);
+    struct vr_drop_capture_cpu *dc;
+    struct vr_drop_record *dr;
+
+    if (!pkt || !router || !router->vr_drop_capture || cpu >= vr_num_cpus)
+        return;
+
+    if ((vr_drop_capture_reason != VR_DROP_CAPTURE_ANY) &&
+            (reason != vr_drop_capture_reason))
+        return;
+
+    dc = router->vr_drop_capture[cpu];
+    if (dc->dcc_countdown > 1) {
+        dc->dcc_countdown--;
+        return;
+    }
+    dc->dcc_countdown = vr_drop_capture_rate;
+
+    /*
+     * Once the packet is parsed, the data may have moved past the l2
+     * header, which need not be ethernet either (tunnels), so capture
+     * from the ip header unless ethernet sits right in front of it.
+     */
+    offset = pkt->vp_data;
+    if (((pkt->vp_type == VP_TYPE_IP) || (pkt->vp_type == VP_TYPE_IP6)) &&
+            (pkt->vp_network_h < pkt->vp_tail) &&
+            (pkt->vp_network_h != pkt->vp_data + VR_ETHER_HLEN)) {
+        offset = pkt->vp_network_h;
+        flags |= VR_DROP_CAPTURE_FLAG_L3;
+    }
+
+    len = pkt->vp_tail - offset;
+    if (len < 0)
+        len = 0;
+    else if (len > VR_DROP_CAPTURE_LEN)
+        len = VR_DROP_CAPTURE_LEN;
+
+    dr = &dc->dcc_records[dc->dcc_seq % VR_DROP_CAPTURE_RECORDS];
+    dr->dr_seq = 0;
+    vr_sync_synchronize();
+
+    vr_get_time(&dr->dr_sec, &dr->dr_usec);
+    dr->dr_vif = pkt->vp_if ? pkt->vp_if->vif_idx : -1;
+    dr->dr_vrf = pkt->vp_if ? pkt->vp_if->vif_vrf : 0;
+    dr->dr_reason = reason;
+    dr->dr_flags = flags;
+    dr->dr_nh = pkt->vp_nh ? (int32_t)pkt->vp_nh->nh_id : -1;
+    dr->dr_len = pkt_len(pkt) + pkt->vp_data - offset;
+    dr->dr_caplen = len;
+    memcpy(dr->dr_data, pkt->vp_head + offset, len);
+
+    vr_sync_synchronize();
+    dr->dr_seq = ++dc->dcc_seq;
+
+    return;
+}
+
+static void
+vr_drop_capture_reset(struct vrouter *router)
+{
+    unsigned int i;
+
+    if (!router->vr_drop_capture)
+        return;
+
+    for (i = 0; i < vr_num_cpus; i++) {
+        router->vr_drop_capture[i]->dcc_seq = 0;
+        memset(router->vr_drop_capture[i]->dcc_records, 0,
+                sizeof(router->vr_drop_capture[i]->dcc_records));
+    }
+
+    return;
+}
+
+static void
+vr_drop_capture_exit(struct vrouter *router)
+{
+    vr_drop_capture_rate = 0;
+    vr_drop_capture_reason = VR_DROP_CAPTURE_ANY;
+
+    vr_pcpu_blocks_free(router->vr_drop_capture, VR_DROP_CAPTURE_OBJECT);
+    router->vr_drop_capture = NULL;
+
+    return;
+}
+
+static int
+vr_drop_capture_init(struct vrouter *router)
+{
+    if (router->vr_drop_capture)
+        return 0;
+
+    router->vr_drop_capture = vr_pcpu_blocks_alloc(
+            sizeof(struct vr_drop_capture_cpu), VR_DROP_CAPTURE_OBJECT);
+    if (!router->vr_drop_capture)
+        return -ENOMEM;
+
+    return 0;
+}
+
+static void
+vr_drop_capture_set(vr_drop_capture_req *r)
+{
+    int ret = 0;
+    struct vrouter *router = vrouter_get(r->vdc_rid);
+
+    if (!router && (ret = -ENOENT))
+        goto exit_set;
+
+    if ((r->vdc_reason != VR_DROP_CAPTURE_ANY) &&
+            ((r->vdc_reason < 0) || (r->vdc_reason >= VP_DROP_MAX)) &&
+            (ret = -EINVAL))
+        goto exit_set;
+
+    if (r->vdc_rate) {
+        ret = vr_drop_capture_init(router);
+        if (ret)
+            goto exit_set;
+    }
+
+    vr_drop_capture_rate = 0;
+    vr_drop_capture_reason = r->vdc_reason;
+    /* publish the rings and the filter before the datapath captures */
+    vr_sync_synchronize();
+    vr_drop_capture_rate = r->vdc_rate;
+
+exit_set:
+    vr_send_response(ret);
+    return;
+}
+
+static void
+vr_drop_capture_get(vr_drop_capture_req *r)
+{
+    int ret = 0;
+    unsigned int i;
+    struct vrouter *router = vrouter_get(r->vdc_rid);
+    vr_drop_capture_req req;
+
+    if (!router && (ret = -ENOENT))
+        goto exit_get;
+
+    memset(&req, 0, sizeof(req));
+    req.h_op = r->h_op;
+    req.vdc_rid = r->vdc_rid;
+    req.vdc_core = -1;
+    req.vdc_rate = vr_drop_capture_rate;
+    req.vdc_reason = vr_drop_capture_reason;
+
+    if (router->vr_drop_capture) {
+        for (i = 0; i < vr_num_cpus; i++)
+            req.vdc_captured += router->vr_drop_capture[i]->dcc_seq;
+    }
+
+exit_get:
+    vr_message_response(VR_DROP_CAPTURE_OBJECT_ID, ret ? NULL : &req, ret,
+            false);
+    return;
+}
+
+struct vr_drop_capture_dumper {
+    vr_drop_capture_req *dcd_req;
+    struct vrouter *dcd_router;
+    /* the copy the response points to, until it is encoded */
+    struct vr_drop_record dcd_record;
+};
+
+static int
+vr_drop_capture_fill(void *object, unsigned int cpu, unsigned int index,
+        unsigned int marker, void *arg)
+{
+    uint64_t seq;
+    vr_drop_capture_req *req = (vr_drop_capture_req *)object;
+    struct vr_drop_capture_dumper *dcd = (struct vr_drop_capture_dumper *)arg;
+    vr_drop_capture_req *r = dcd->dcd_req;
+    struct vr_drop_record *dr, *record = &dcd->dcd_record;
+
+    dr = &dcd->dcd_router->vr_drop_capture[cpu]->dcc_records[index];
+
+    /* skip the records which were overwritten while being copied */
+    seq = dr->dr_seq;
+    vr_sync_synchronize();
+    memcpy(record, dr, sizeof(*record));
+    vr_sync_synchronize();
+    if (!seq || (seq != dr->dr_seq))
+        return 0;
+
+    memset(req, 0, sizeof(*req));
+    req->h_op = r->h_op;
+    req->vdc_rid = r->vdc_rid;
+    req->vdc_marker = marker;
+    req->vdc_core = cpu;
+    req->vdc_seq = seq;
+    req->vdc_sec = record->dr_sec;
+    req->vdc_usec = record->dr_usec;
+    req->vdc_vif = record->dr_vif;
+    req->vdc_vrf = record->dr_vrf;
+    req->vdc_drop_reason = record->dr_reason;
+    req->vdc_nh = record->dr_nh;
+    req->vdc_len = record->dr_len;
+    req->vdc_flags = record->dr_flags;
+    req->vdc_data = (int8_t *)record->dr_data;
+    req->vdc_data_size = record->dr_caplen;
+
+    return 1;
+}
+
+static void
+vr_drop_capture_dump(vr_drop_capture_req *r)
+{
+    int ret = 0;
+    struct vrouter *router = vrouter_get(r->vdc_rid);
+    struct vr_message_dumper *dumper = NULL;
+    struct vr_drop_capture_dumper dcd;
+    vr_drop_capture_req req;
+
+    if (!router && (ret = -ENOENT))
+        goto generate_response;
+
+    if (!router->vr_drop_capture)
+        goto generate_response;
+
+    dumper = vr_message_dump_init(r);
+    if (!dumper && (ret = -ENOMEM))
+        goto generate_response;
+
+    dcd.dcd_req = r;
+    dcd.dcd_router = router;
+    ret = vr_message_dump_pcpu(dumper, VR_DROP_CAPTURE_OBJECT_ID,
+            r->vdc_marker, VR_DROP_CAPTURE_RECORDS, vr_drop_capture_fill,
+            &req, &dcd);
+
+generate_response:
+    vr_message_dump_exit(dumper, ret);
+    return;
+}
+
+void
+vr_drop_capture_req_process(void *s_req)
+{
+    int ret = 0;
+    struct vrouter *router;
+    vr_drop_capture_req *req = (vr_drop_capture_req *)s_req;
+
+    switch (req->h_op) {
+    case SANDESH_OP_ADD:
+        vr_drop_capture_set(req);
+        break;
+
+    case SANDESH_OP_GET:
+        vr_drop_capture_get(req);
+        break;
+
+    case SANDESH_OP_DUMP:
+        vr_drop_capture_dump(req);
+        break;
+
+    case SANDESH_OP_RESET:
+        router = vrouter_get(req->vdc_rid);
+        if (!router)
+            ret = -ENOENT;
+        else if (vr_drop_capture_rate)
+            ret = -EBUSY;
+        else
+            vr_drop_capture_reset(router);
+        vr_send_response(ret);
+        break;
+
+    default:
+        ret = -EOPNOTSUPP;
+        vr_send_response(ret);
+        break;
+    }
+
+    return;
+}
+
 void
 vr_free_stats(unsigned int object)
 {
@@ -444,6 +1143,12 @@ vr_pkt_drop_stats_exit(struct vrouter *router)
     if (!router->vr_pdrop_stats)
         return;
 
+    /* the counters of all the cpus are one slot of the shared region */
+    if (vr_stats_shm_owns(router, router->vr_pdrop_stats[0])) {
+        vr_stats_shm_detach(router, router->vr_pdrop_stats[0]);
+        memset(router->vr_pdrop_stats, 0, sizeof(void *) * vr_num_cpus);
+    }
+
     for (i = 0; i < vr_num_cpus; i++) {
         if (!router->vr_pdrop_stats[i])
             break;
@@ -475,6 +1180,13 @@ vr_pkt_drop_stats_init(struct vrouter *router)
         goto cleanup;
     }
 
+    if (vr_stats_shm_attach(router, VR_STATS_SHM_DROP, 0)) {
+        for (i = 0; i < vr_num_cpus; i++)
+            router->vr_pdrop_stats[i] = vr_stats_shm_counters(router,
+                    VR_STATS_SHM_DROP, 0, i);
+        return 0;
+    }
+
     size = VP_DROP_MAX * sizeof(uint64_t);
     for (i = 0; i < vr_num_cpus; i++) {
         router->vr_pdrop_stats[i] = vr_zalloc(size, VR_DROP_STATS_OBJECT);
@@ -500,6 +1212,11 @@ vr_pkt_drop_stats_reset(struct vrouter *router)
     if (!router->vr_pdrop_stats)
         return;
 
+    if (vr_stats_shm_owns(router, router->vr_pdrop_stats[0])) {
+        vr_stats_shm_clear(router, router->vr_pdrop_stats[0]);
+        return;
+    }
+
     for (i = 0; i < vr_num_cpus; i++) {
         if (router->vr_pdrop_stats[i])
             memset(router->vr_pdrop_stats[i], 0, VP_DROP_MAX * sizeof(uint64_t));
@@ -513,10 +1230,17 @@ vr_stats_exit(struct vrouter *router, bool soft_reset)
 {
     if (soft_reset) {
         vr_pkt_drop_stats_reset(router);
+        vr_dp_lat_reset(router);
+        vr_drop_capture_rate = 0;
+        vr_drop_capture_reset(router);
+        vr_stats_shm_exit(router, true);
         return;
     }
 
+    vr_drop_capture_exit(router);
+    vr_dp_lat_exit(router);
     vr_pkt_drop_stats_exit(router);
+    vr_stats_shm_exit(router, false);
     vr_malloc_stats_exit(router);
     return;
 }
@@ -530,5 +1254,9 @@ vr_stats_init(struct vrouter *router)
     if (ret)
         return ret;
 
+    ret = vr_stats_shm_init(router);
+    if (ret)
+        return ret;
+
     return vr_pkt_drop_stats_init(router);
 }
@@ -0,0 +1,396 @@
+/*
+ * vr_stats_shm.c -- shared memory region of interface, vrf and drop
+ * statistics
+ *
+ * Copyright (c) 2016 Juniper Networks, Inc. All rights reserved.
+ */
+#include <vr_os.h>
+#include <vr_types.h>
+#include <vr_packet.h>
+#include <vr_interface.h>
+#include "vr_btable.h"
+#include "vr_route.h"
+#include "vr_stats_shm.h"
+
+extern unsigned int vr_interfaces, vr_vrfs;
+
+void *vr_stats_shm_table;
+unsigned char *vr_stats_shm_path;
+
+#define VR_STATS_SHM_ROUNDUP(x, a)  ((((x) + (a) - 1) / (a)) * (a))
+
+static unsigned int
+vr_stats_shm_pow2(unsigned int size)
+{
+    unsigned int pow2 = VR_STATS_SHM_ALIGN;
+
+    while (pow2 < size)
+        pow2 <<= 1;
+
+    return pow2;
+}
+
+/*
+ * lay the region out for the number of cpus, interfaces and vrfs. a slot
+ * stride is a power of two no larger than a partition of the table, and
+ * every section starts at a multiple of its slot stride, so that no slot
+ * straddles two partitions, which are not contiguous in the kernel
+ */
+static unsigned long
+vr_stats_shm_layout(struct vr_stats_shm_hdr *hdr, unsigned int cpus,
+        unsigned int vifs, unsigned int vrfs)
+{
+    unsigned int i;
+    unsigned long offset;
+    struct vr_stats_shm_section *section;
+
+    memset(hdr, 0, sizeof(*hdr));
+    hdr->sh_magic = VR_STATS_SHM_MAGIC;
+    hdr->sh_version = VR_STATS_SHM_VERSION;
+    hdr->sh_sections = VR_STATS_SHM_SECTIONS;
+    hdr->sh_hdr_size = VR_STATS_SHM_HDR_SIZE;
+    hdr->sh_cpus = cpus;
+
+    section = &hdr->sh_section[VR_STATS_SHM_VIF];
+    section->ss_slots = vifs;
+    section->ss_cpu_size = sizeof(struct vr_interface_stats);
+    /* the datapath indexes an array of the per cpu counters */
+    section->ss_cpu_stride = section->ss_cpu_size;
+
+    section = &hdr->sh_section[VR_STATS_SHM_VRF];
+    section->ss_slots = vrfs;
+    section->ss_cpu_size = sizeof(struct vr_vrf_stats);
+    section->ss_cpu_stride = section->ss_cpu_size;
+
+    section = &hdr->sh_section[VR_STATS_SHM_DROP];
+    section->ss_slots = 1;
+    section->ss_cpu_size = VP_DROP_MAX * sizeof(uint64_t);
+    /* drop counters of two cpus do not share a cache line */
+    section->ss_cpu_stride = VR_STATS_SHM_ROUNDUP(section->ss_cpu_size,
+            VR_STATS_SHM_ALIGN);
+
+    offset = VR_STATS_SHM_HDR_SIZE;
+    for (i = 0; i < VR_STATS_SHM_SECTIONS; i++) {
+        section = &hdr->sh_section[i];
+        section->ss_state_offset = offset;
+        offset += section->ss_slots * sizeof(struct vr_stats_shm_state);
+    }
+
+    for (i = 0; i < VR_STATS_SHM_SECTIONS; i++) {
+        section = &hdr->sh_section[i];
+        section->ss_slot_stride = vr_stats_shm_pow2(cpus *
+                section->ss_cpu_stride);
+        if (section->ss_slot_stride > VR_SINGLE_ALLOC_LIMIT)
+            return 0;
+
+        offset = VR_STATS_SHM_ROUNDUP(offset, section->ss_slot_stride);
+        section->ss_offset = offset;
+        offset += (unsigned long)section->ss_slots * section->ss_slot_stride;
+        if (offset > VR_STATS_SHM_MAX_SIZE)
+            return 0;
+    }
+
+    offset = VR_STATS_SHM_ROUNDUP(offset, VR_STATS_SHM_HDR_SIZE);
+    hdr->sh_size = offset;
+
+    return offset;
+}
+
+/*
+ * the size of the region the host has to provide, zero if the counters
+ * would not fit in the largest region that is created
+ */
+unsigned long
+vr_stats_shm_size(unsigned int cpus, unsigned int vifs, unsigned int vrfs)
+{
+    struct vr_stats_shm_hdr hdr;
+
+    return vr_stats_shm_layout(&hdr, cpus, vifs, vrfs);
+}
+
+unsigned int
+vr_stats_shm_table_size(struct vrouter *router)
+{
+    if (!router->vr_stats_shm)
+        return 0;
+
+    return vr_btable_size(router->vr_stats_shm);
+}
+
+/* used by the mmap code of the host to find the page at an offset */
+void *
+vr_stats_shm_get_va(struct vrouter *router, uint64_t offset)
+{
+    if (!router->vr_stats_shm)
+        return NULL;
+
+    return vr_btable_get_address(router->vr_stats_shm, offset);
+}
+
+static inline struct vr_stats_shm_hdr *
+vr_stats_shm_hdr(struct vrouter *router)
+{
+    if (!router || !router->vr_stats_shm)
+        return NULL;
+
+    return (struct vr_stats_shm_hdr *)vr_btable_get_address(
+            router->vr_stats_shm, 0);
+}
+
+static struct vr_stats_shm_state *
+vr_stats_shm_state(struct vrouter *router, unsigned int section,
+        unsigned int slot)
+{
+    struct vr_stats_shm_hdr *hdr = vr_stats_shm_hdr(router);
+
+    if (!hdr || (section >= VR_STATS_SHM_SECTIONS) ||
+            (slot >= hdr->sh_section[section].ss_slots))
+        return NULL;
+
+    return (struct vr_stats_shm_state *)vr_btable_get_address(
+            router->vr_stats_shm, hdr->sh_section[section].ss_state_offset +
+            slot * sizeof(struct vr_stats_shm_state));
+}
+
+/* counters of a cpu in a slot */
+void *
+vr_stats_shm_counters(struct vrouter *router, unsigned int section,
+        unsigned int slot, unsigned int cpu)
+{
+    struct vr_stats_shm_section *ss;
+    struct vr_stats_shm_hdr *hdr = vr_stats_shm_hdr(router);
+
+    if (!hdr || (section >= VR_STATS_SHM_SECTIONS))
+        return NULL;
+
+    ss = &hdr->sh_section[section];
+    if ((slot >= ss->ss_slots) || (cpu >= hdr->sh_cpus))
+        return NULL;
+
+    return vr_btable_get_address(router->vr_stats_shm,
+            ss->ss_offset + (slot * ss->ss_slot_stride) +
+            (cpu * ss->ss_cpu_stride));
+}
+
+/*
+ * find the section and the slot of the counters of cpu 0, returns false
+ * for memory that is not part of the region
+ */
+static bool
+vr_stats_shm_lookup(struct vrouter *router, void *counters,
+        unsigned int *section, unsigned int *slot)
+{
+    unsigned int i, offset;
+    struct vr_btable *table;
+    struct vr_btable_partition *partition;
+    struct vr_stats_shm_section *ss;
+    struct vr_stats_shm_hdr *hdr = vr_stats_shm_hdr(router);
+
+    if (!hdr || !counters)
+        return false;
+
+    table = router->vr_stats_shm;
+    for (i = 0; i < table->vb_partitions; i++) {
+        partition = vr_btable_get_partition(table, i);
+        if (!partition)
+            return false;
+
+        if (((char *)counters >= (char *)table->vb_mem[i]) &&
+                ((char *)counters < (char *)table->vb_mem[i] +
+                 partition->vb_mem_size))
+            break;
+    }
+
+    if (i == table->vb_partitions)
+        return false;
+
+    offset = partition->vb_offset +
+        ((char *)counters - (char *)table->vb_mem[i]);
+    for (i = 0; i < VR_STATS_SHM_SECTIONS; i++) {
+        ss = &hdr->sh_section[i];
+        if ((offset < ss->ss_offset) ||
+                (offset >= ss->ss_offset + ss->ss_slots * ss->ss_slot_stride))
+            continue;
+
+        *section = i;
+        *slot = (offset - ss->ss_offset) / ss->ss_slot_stride;
+        return true;
+    }
+
+    return false;
+}
+
+bool
+vr_stats_shm_owns(struct vrouter *router, void *counters)
+{
+    unsigned int section, slot;
+
+    return vr_stats_shm_lookup(router, counters, &section, &slot);
+}
+
+static void
+vr_stats_shm_slot_update(struct vr_stats_shm_state *state, void *counters,
+        unsigned int size, uint32_t flags)
+{
+    state->st_seq++;
+    vr_sync_synchronize();
+    if (counters)
+        memset(counters, 0, size);
+    state->st_flags = flags;
+    vr_sync_synchronize();
+    state->st_seq++;
+
+    return;
+}
+
+/*
+ * hand a slot of a section to the object with the index, returning its
+ * zeroed counters of cpu 0. the counters of the other cpus follow at
+ * ss_cpu_stride bytes. returns NULL if there is no region, the index is
+ * beyond the section or the slot is still in use by an object that was
+ * deleted but not yet freed, in which case the caller falls back to
+ * private memory. the slot is then marked private until it is handed out
+ * again
+ */
+void *
+vr_stats_shm_attach(struct vrouter *router, unsigned int section,
+        unsigned int slot)
+{
+    void *counters;
+    struct vr_stats_shm_state *state;
+    struct vr_stats_shm_hdr *hdr = vr_stats_shm_hdr(router);
+
+    state = vr_stats_shm_state(router, section, slot);
+    if (!state)
+        return NULL;
+
+    if (state->st_flags & VR_STATS_SHM_SLOT_USED) {
+        vr_stats_shm_slot_update(state, NULL, 0,
+                state->st_flags | VR_STATS_SHM_SLOT_PRIVATE);
+        return NULL;
+    }
+
+    counters = vr_stats_shm_counters(router, section, slot, 0);
+    if (!counters)
+        return NULL;
+
+    vr_stats_shm_slot_update(state, counters,
+            hdr->sh_section[section].ss_slot_stride, VR_STATS_SHM_SLOT_USED);
+
+    return counters;
+}
+
+static void
+vr_stats_shm_release(struct vrouter *router, void *counters, bool detach)
+{
+    unsigned int section, slot;
+    void *base;
+    struct vr_stats_shm_state *state;
+    struct vr_stats_shm_hdr *hdr = vr_stats_shm_hdr(router);
+
+    if (!vr_stats_shm_lookup(router, counters, &section, &slot))
+        return;
+
+    state = vr_stats_shm_state(router, section, slot);
+    base = vr_stats_shm_counters(router, section, slot, 0);
+    if (!state || !base)
+        return;
+
+    /* an object with private counters may have taken the index already */
+    vr_stats_shm_slot_update(state, base,
+            hdr->sh_section[section].ss_slot_stride,
+            detach ? (state->st_flags & VR_STATS_SHM_SLOT_PRIVATE) :
+            state->st_flags);
+
+    return;
+}
+
+/* take the slot back from an object, once the datapath is done with it */
+void
+vr_stats_shm_detach(struct vrouter *router, void *counters)
+{
+    vr_stats_shm_release(router, counters, true);
+    return;
+}
+
+/* zero the counters of a slot that stays in use */
+void
+vr_stats_shm_clear(struct vrouter *router, void *counters)
+{
+    vr_stats_shm_release(router, counters, false);
+    return;
+}
+
+void
+vr_stats_shm_exit(struct vrouter *router, bool soft_reset)
+{
+    struct vr_stats_shm_hdr *hdr;
+
+    if (soft_reset) {
+        hdr = vr_stats_shm_hdr(router);
+        if (hdr) {
+            vr_sync_synchronize();
+            hdr->sh_epoch++;
+        }
+        return;
+    }
+
+    if (router->vr_stats_shm) {
+        vr_btable_free(router->vr_stats_shm);
+        router->vr_stats_shm = NULL;
+    }
+
+    return;
+}
+
+int
+vr_stats_shm_init(struct vrouter *router)
+{
+    /* the region is mapped only on hosts that have the means to */
+#if defined(__linux__)
+    unsigned int i, j;
+    unsigned long size;
+    struct iovec iov;
+    struct vr_stats_shm_hdr hdr, *hdrp;
+    struct vr_stats_shm_state *state;
+
+    if (router->vr_stats_shm)
+        return 0;
+
+    size = vr_stats_shm_layout(&hdr, vr_num_cpus, vr_interfaces, vr_vrfs);
+    if (!size)
+        return 0;
+
+    if (vr_stats_shm_table) {
+        iov.iov_base = vr_stats_shm_table;
+        iov.iov_len = size;
+        router->vr_stats_shm = vr_btable_attach(&iov, 1,
+                VR_STATS_SHM_HDR_SIZE);
+    } else {
+        router->vr_stats_shm = vr_btable_alloc(size / VR_STATS_SHM_HDR_SIZE,
+                VR_STATS_SHM_HDR_SIZE);
+    }
+
+    /* the counters are kept in private memory without the region */
+    if (!router->vr_stats_shm)
+        return 0;
+
+    hdrp = vr_stats_shm_hdr(router);
+    if (!hdrp) {
+        vr_stats_shm_exit(router, false);
+        return 0;
+    }
+    memcpy(hdrp, &hdr, sizeof(hdr));
+
+    /* page allocations of all the hosts are not zeroed */
+    for (i = 0; i < VR_STATS_SHM_SECTIONS; i++) {
+        for (j = 0; j < hdr.sh_section[i].ss_slots; j++) {
+            state = vr_stats_shm_state(router, i, j);
+            if (state)
+                memset(state, 0, sizeof(*state));
+        }
+    }
+#endif
+
+    return 0;
+}
@@ -0,0 +1,584 @@
+/*
+ * vr_trace.c -- sampled packet trace through the datapath
+ *
+ * Copyright (c) 2016 Juniper Networks, Inc. All rights reserved.
+ */
+#include <vr_os.h>
+#include <vr_types.h>
+#include <vr_packet.h>
+#include <vr_interface.h>
+#include <vr_nexthop.h>
+#include "vr_message.h"
+#include "vr_sandesh.h"
+#include "vr_stats.h"
+#include "vr_trace.h"
+
+/*
+ * in tr_point, of the records of a packet which is yet to match the
+ * 5-tuple filter, and of a record being written
+ */
+#define VR_TRACE_TENTATIVE          0x8000
+
+struct vr_trace_buffer {
+    /* records written, and the ones the readers can look at */
+    unsigned int tb_count;
+    unsigned int tb_visible;
+    /* records which did not fit in the buffer */
+    uint32_t tb_lost;
+    struct vr_trace_record tb_records[VR_TRACE_RECORDS];
+};
+
+unsigned int vr_trace_armed;
+/* packets which are still to be traced */
+static int vr_trace_left;
+/* last trace id given out, and the last one before the trace was armed */
+static uint32_t vr_trace_packets, vr_trace_first;
+static struct vr_trace_filter vr_trace_filter;
+static bool vr_trace_tuple_filter;
+
+void vr_pkt_trace_req_process(void *);
+
+static struct vr_trace_buffer *
+vr_trace_buffer_get(void)
+{
+    unsigned int cpu = vr_get_cpu();
+    struct vrouter *router = vrouter_get(0);
+
+    if (!router->vr_trace_buffers || cpu >= vr_num_cpus)
+        return NULL;
+
+    return router->vr_trace_buffers[cpu];
+}
+
+/*
+ * the records of the packet are dropped if they are the last ones of the
+ * buffer, which they are unless the packet was held on its way. otherwise
+ * they stay tentative, and the readers skip them
+ */
+static void
+vr_trace_rollback(struct vr_trace_buffer *tb, uint32_t id)
+{
+    unsigned int count = tb->tb_count;
+
+    while (count && (tb->tb_records[count - 1].tr_packet == id))
+        count--;
+
+    tb->tb_visible = tb->tb_count = count;
+
+    return;
+}
+
+static void
+vr_trace_confirm(struct vr_trace_buffer *tb, uint32_t id)
+{
+    unsigned int i;
+    struct vr_trace_record *tr;
+
+    for (i = tb->tb_count; i > 0; i--) {
+        tr = &tb->tb_records[i - 1];
+        if (tr->tr_packet == id)
+            tr->tr_point &= ~VR_TRACE_TENTATIVE;
+    }
+
+    return;
+}
+
+static bool
+vr_trace_claim(void)
+{
+    return vr_sync_sub_and_fetch_32s(&vr_trace_left, 1) >= 0;
+}
+
+static bool
+vr_trace_addr_match(uint8_t *filter, uint8_t *addr, unsigned int len)
+{
+    unsigned int i;
+
+    for (i = 0; i < len; i++) {
+        if (filter[i])
+            return !memcmp(filter, addr, len);
+    }
+
+    return true;
+}
+
+static bool
+vr_trace_match(struct vr_packet *pkt)
+{
+    bool l4_valid = true;
+    uint8_t family, proto, *sip, *dip;
+    uint16_t ports[2];
+    unsigned int hlen, alen;
+    unsigned char *hdr;
+    struct vr_ip *ip;
+    struct vr_ip6 *ip6;
+    struct vr_trace_filter *tf = &vr_trace_filter;
+
+    hdr = pkt_network_header(pkt);
+    if (!hdr)
+        return false;
+
+    if (pkt->vp_type == VP_TYPE_IP) {
+        ip = (struct vr_ip *)hdr;
+        family = AF_INET;
+        proto = ip->ip_proto;
+        sip = (uint8_t *)&ip->ip_saddr;
+        dip = (uint8_t *)&ip->ip_daddr;
+        alen = VR_IP_ADDRESS_LEN;
+        hlen = ip->ip_hl * 4;
+        l4_valid = vr_ip_transport_header_valid(ip);
+    } else if (pkt->vp_type == VP_TYPE_IP6) {
+        ip6 = (struct vr_ip6 *)hdr;
+        family = AF_INET6;
+        proto = ip6->ip6_nxt;
+        sip = ip6->ip6_src;
+        dip = ip6->ip6_dst;
+        alen = VR_IP6_ADDRESS_LEN;
+        hlen = sizeof(struct vr_ip6);
+    } else {
+        return false;
+    }
+
+    if ((tf->tf_family && (tf->tf_family != family)) ||
+            (tf->tf_proto && (tf->tf_proto != proto)))
+        return false;
+
+    if (!vr_trace_addr_match(tf->tf_sip, sip, alen) ||
+            !vr_trace_addr_match(tf->tf_dip, dip, alen))
+        return false;
+
+    if (!tf->tf_sport && !tf->tf_dport)
+        return true;
+
+    if ((proto != VR_IP_PROTO_TCP) && (proto != VR_IP_PROTO_UDP) &&
+            (proto != VR_IP_PROTO_SCTP))
+        return false;
+
+    /* the ports have to be in the head buffer */
+    if (!l4_valid || (pkt->vp_network_h + hlen + sizeof(ports) >
+                pkt->vp_tail))
+        return false;
+
+    memcpy(ports, hdr + hlen, sizeof(ports));
+    if ((tf->tf_sport && (tf->tf_sport != ports[0])) ||
+            (tf->tf_dport && (tf->tf_dport != ports[1])))
+        return false;
+
+    return true;
+}
+
+static void
+vr_trace_record(struct vr_trace_buffer *tb, unsigned int point,
+        struct vr_interface *vif, struct vr_packet *pkt,
+        struct vr_forwarding_md *fmd, struct vr_nexthop *nh,
+        uint32_t data0, uint32_t data1)
+{
+    struct vr_trace_record *tr;
+
+    if (tb->tb_count >= VR_TRACE_RECORDS) {
+        tb->tb_lost++;
+        return;
+    }
+
+    tr = &tb->tb_records[tb->tb_count];
+    /* a rolled back record may still be read, hide it while it changes */
+    tr->tr_point = VR_TRACE_NONE | VR_TRACE_TENTATIVE;
+    vr_sync_synchronize();
+    tr->tr_packet = fmd->fmd_trace_id;
+    tr->tr_vif = vif ? vif->vif_idx : -1;
+    tr->tr_vrf = fmd->fmd_dvrf;
+    tr->tr_len = pkt_len(pkt);
+    tr->tr_nh = nh ? nh->nh_id : -1;
+    tr->tr_data[0] = data0;
+    tr->tr_data[1] = data1;
+    tr->tr_time = vr_get_cycles ? vr_get_cycles() : 0;
+    vr_sync_synchronize();
+    if (fmd->fmd_flags & FMD_FLAG_TRACE_PENDING)
+        point |= VR_TRACE_TENTATIVE;
+    tr->tr_point = point;
+    tb->tb_count++;
+
+    /* the record is complete before the readers can see it */
+    vr_sync_synchronize();
+    tb->tb_visible = tb->tb_count;
+
+    return;
+}
+
+void
+vr_trace_rx(struct vr_interface *vif, struct vr_packet *pkt,
+        struct vr_forwarding_md *fmd, unsigned short vlan_id)
+{
+    uint32_t id;
+    struct vr_trace_buffer *tb;
+
+    /* the packets which are being traced carry on till they are out */
+    if (vr_trace_left <= 0) {
+        vr_trace_armed = 0;
+        return;
+    }
+
+    if ((vr_trace_filter.tf_vif >= 0) &&
+            (vif->vif_idx != (unsigned int)vr_trace_filter.tf_vif))
+        return;
+
+    tb = vr_trace_buffer_get();
+    if (!tb)
+        return;
+
+    if (vr_trace_tuple_filter) {
+        fmd->fmd_flags |= FMD_FLAG_TRACE_PENDING;
+    } else if (!vr_trace_claim()) {
+        return;
+    }
+
+    /* zero is no trace id */
+    do {
+        id = vr_sync_add_and_fetch_32u(&vr_trace_packets, 1);
+    } while (!id);
+
+    fmd->fmd_trace_id = id;
+    pkt->vp_flags |= VP_FLAG_TRACE;
+    vr_trace_record(tb, VR_TRACE_RX, vif, pkt, fmd, NULL, vlan_id, 0);
+
+    return;
+}
+
+void
+vr_trace_add(unsigned int point, struct vr_interface *vif,
+        struct vr_packet *pkt, struct vr_forwarding_md *fmd,
+        struct vr_nexthop *nh, uint32_t data0, uint32_t data1)
+{
+    struct vr_trace_buffer *tb;
+
+    /*
+     * a packet which went on with a new forwarding metadata (out of a
+     * hold queue, for one), or which is left from an earlier trace, is
+     * not traced any further
+     */
+    if (!fmd || !fmd->fmd_trace_id ||
+            ((int32_t)(fmd->fmd_trace_id - vr_trace_first) <= 0)) {
+        pkt->vp_flags &= ~VP_FLAG_TRACE;
+        return;
+    }
+
+    tb = vr_trace_buffer_get();
+    if (!tb)
+        return;
+
+    if ((fmd->fmd_flags & FMD_FLAG_TRACE_PENDING) &&
+            (point == VR_TRACE_NH_OUTPUT)) {
+        fmd->fmd_flags &= ~FMD_FLAG_TRACE_PENDING;
+        if (!vr_trace_match(pkt) || !vr_trace_claim()) {
+            vr_trace_rollback(tb, fmd->fmd_trace_id);
+            pkt->vp_flags &= ~VP_FLAG_TRACE;
+            return;
+        }
+        vr_trace_confirm(tb, fmd->fmd_trace_id);
+    }
+
+    vr_trace_record(tb, point, vif, pkt, fmd, nh, data0, data1);
+
+    return;
+}
+
+static void
+vr_trace_reset(struct vrouter *router)
+{
+    unsigned int i;
+    struct vr_trace_buffer *tb;
+
+    if (!router->vr_trace_buffers)
+        return;
+
+    for (i = 0; i < vr_num_cpus; i++) {
+        tb = router->vr_trace_buffers[i];
+        tb->tb_count = tb->tb_visible = 0;
+        tb->tb_lost = 0;
+    }
+
+    return;
+}
+
+static int
+vr_trace_buffers_alloc(struct vrouter *router)
+{
+    if (router->vr_trace_buffers)
+        return 0;
+
+    router->vr_trace_buffers = vr_pcpu_blocks_alloc(
+            sizeof(struct vr_trace_buffer), VR_TRACE_OBJECT);
+    if (!router->vr_trace_buffers)
+        return -ENOMEM;
+
+    return 0;
+}
+
+static int
+vr_trace_arm(struct vrouter *router, vr_pkt_trace_req *req)
+{
+    int ret;
+    unsigned int alen = 0;
+    struct vr_trace_filter *tf = &vr_trace_filter;
+
+    if (req->ptr_count <= 0)
+        return -EINVAL;
+
+    switch (req->ptr_family) {
+    case 0:
+        break;
+
+    case AF_INET:
+        alen = VR_IP_ADDRESS_LEN;
+        break;
+
+    case AF_INET6:
+        alen = VR_IP6_ADDRESS_LEN;
+        break;
+
+    default:
+        return -EINVAL;
+    }
+
+    if ((req->ptr_sip_size && (req->ptr_sip_size != alen)) ||
+            (req->ptr_dip_size && (req->ptr_dip_size != alen)))
+        return -EINVAL;
+
+    ret = vr_trace_buffers_alloc(router);
+    if (ret)
+        return ret;
+
+    vr_trace_armed = 0;
+    vr_trace_left = 0;
+    /* let the packets which are being traced go out */
+    vr_delay_op();
+
+    vr_trace_reset(router);
+
+    memset(tf, 0, sizeof(*tf));
+    tf->tf_vif = req->ptr_vif;
+    tf->tf_family = req->ptr_family;
+    tf->tf_proto = req->ptr_proto;
+    tf->tf_sport = htons(req->ptr_sport);
+    tf->tf_dport = htons(req->ptr_dport);
+    if (req->ptr_sip_size)
+        memcpy(tf->tf_sip, req->ptr_sip, alen);
+    if (req->ptr_dip_size)
+        memcpy(tf->tf_dip, req->ptr_dip, alen);
+
+    vr_trace_tuple_filter = tf->tf_family || tf->tf_proto ||
+        tf->tf_sport || tf->tf_dport ||
+        req->ptr_sip_size || req->ptr_dip_size;
+
+    vr_trace_first = vr_trace_packets;
+    vr_trace_left = req->ptr_count;
+    vr_sync_synchronize();
+    vr_trace_armed = 1;
+
+    return 0;
+}
+
+static void
+vr_trace_make_req(vr_pkt_trace_req *req, struct vr_trace_record *tr,
+        unsigned int cpu)
+{
+    req->ptr_core = cpu;
+    req->ptr_packet = tr->tr_packet;
+    req->ptr_point = tr->tr_point;
+    req->ptr_rec_vif = tr->tr_vif;
+    req->ptr_vrf = tr->tr_vrf;
+    req->ptr_len = tr->tr_len;
+    req->ptr_nh = tr->tr_nh;
+    req->ptr_data0 = tr->tr_data[0];
+    req->ptr_data1 = tr->tr_data[1];
+    req->ptr_time = tr->tr_time;
+
+    return;
+}
+
+static void
+vr_trace_get(struct vrouter *router, vr_pkt_trace_req *r)
+{
+    unsigned int i, j, alen, visible;
+    struct vr_trace_buffer *tb;
+    struct vr_trace_filter *tf = &vr_trace_filter;
+    vr_pkt_trace_req resp;
+
+    if (vr_trace_left <= 0)
+        vr_trace_armed = 0;
+
+    memset(&resp, 0, sizeof(resp));
+    resp.h_op = r->h_op;
+    resp.ptr_rid = r->ptr_rid;
+    resp.ptr_count = (vr_trace_armed && (vr_trace_left > 0)) ?
+        vr_trace_left : 0;
+    resp.ptr_vif = tf->tf_vif;
+    resp.ptr_family = tf->tf_family;
+    resp.ptr_proto = tf->tf_proto;
+    resp.ptr_sport = ntohs(tf->tf_sport);
+    resp.ptr_dport = ntohs(tf->tf_dport);
+
+    alen = (tf->tf_family == AF_INET6) ? VR_IP6_ADDRESS_LEN :
+        VR_IP_ADDRESS_LEN;
+    if (tf->tf_family) {
+        resp.ptr_sip = (int8_t *)tf->tf_sip;
+        resp.ptr_sip_size = alen;
+        resp.ptr_dip = (int8_t *)tf->tf_dip;
+        resp.ptr_dip_size = alen;
+    }
+
+    if (router->vr_trace_buffers) {
+        for (i = 0; i < vr_num_cpus; i++) {
+            tb = router->vr_trace_buffers[i];
+            visible = tb->tb_visible;
+            vr_sync_synchronize();
+            for (j = 0; j < visible; j++) {
+                if (!(tb->tb_records[j].tr_point & VR_TRACE_TENTATIVE))
+                    resp.ptr_records++;
+            }
+            resp.ptr_lost += tb->tb_lost;
+        }
+    }
+
+    vr_message_response(VR_PKT_TRACE_OBJECT_ID, &resp, 0, false);
+
+    return;
+}
+
+static int
+vr_trace_fill(void *object, unsigned int cpu, unsigned int index,
+        unsigned int marker, void *arg)
+{
+    uint32_t packet;
+    unsigned int point;
+    vr_pkt_trace_req *resp = (vr_pkt_trace_req *)object;
+    vr_pkt_trace_req *r = (vr_pkt_trace_req *)arg;
+    struct vr_trace_buffer *tb = vrouter_get(r->ptr_rid)->vr_trace_buffers[cpu];
+    struct vr_trace_record *tr, record;
+
+    if (index >= tb->tb_visible)
+        return -1;
+    vr_sync_synchronize();
+
+    /* the record may be rolled back and written again as it is read */
+    tr = &tb->tb_records[index];
+    point = tr->tr_point;
+    packet = tr->tr_packet;
+    if (point & VR_TRACE_TENTATIVE)
+        return 0;
+    vr_sync_synchronize();
+    record = *tr;
+    vr_sync_synchronize();
+    if ((tr->tr_point != point) || (tr->tr_packet != packet))
+        return 0;
+
+    memset(resp, 0, sizeof(*resp));
+    resp->h_op = r->h_op;
+    resp->ptr_rid = r->ptr_rid;
+    resp->ptr_marker = marker;
+    vr_trace_make_req(resp, &record, cpu);
+
+    return 1;
+}
+
+static void
+vr_trace_dump(struct vrouter *router, vr_pkt_trace_req *r)
+{
+    int ret = 0;
+    struct vr_message_dumper *dumper = NULL;
+    vr_pkt_trace_req resp;
+
+    if (vr_trace_left <= 0)
+        vr_trace_armed = 0;
+
+    if (!router->vr_trace_buffers)
+        goto generate_response;
+
+    dumper = vr_message_dump_init(r);
+    if (!dumper && (ret = -ENOMEM))
+        goto generate_response;
+
+    ret = vr_message_dump_pcpu(dumper, VR_PKT_TRACE_OBJECT_ID, r->ptr_marker,
+            VR_TRACE_RECORDS, vr_trace_fill, &resp, r);
+
+generate_response:
+    vr_message_dump_exit(dumper, ret);
+
+    return;
+}
+
+void
+vr_pkt_trace_req_process(void *s_req)
+{
+    int ret;
+    struct vrouter *router;
+    vr_pkt_trace_req *req = (vr_pkt_trace_req *)s_req;
+
+    router = vrouter_get(req->ptr_rid);
+    if (!router) {
+        vr_send_response(-ENODEV);
+        return;
+    }
+
+    switch (req->h_op) {
+    case SANDESH_OP_ADD:
+        ret = vr_trace_arm(router, req);
+        vr_send_response(ret);
+        break;
+
+    case SANDESH_OP_DEL:
+        vr_trace_armed = 0;
+        vr_trace_left = 0;
+        vr_send_response(0);
+        break;
+
+    case SANDESH_OP_RESET:
+        if (vr_trace_armed) {
+            vr_send_response(-EBUSY);
+            break;
+        }
+        vr_trace_reset(router);
+        vr_send_response(0);
+        break;
+
+    case SANDESH_OP_GET:
+        vr_trace_get(router, req);
+        break;
+
+    case SANDESH_OP_DUMP:
+        vr_trace_dump(router, req);
+        break;
+
+    default:
+        vr_send_response(-EOPNOTSUPP);
+        break;
+    }
+
+    return;
+}
+
+void
+vr_trace_exit(struct vrouter *router, bool soft_reset)
+{
+    vr_trace_armed = 0;
+    vr_trace_left = 0;
+
+    if (soft_reset) {
+        vr_trace_reset(router);
+        return;
+    }
+
+    vr_pcpu_blocks_free(router->vr_trace_buffers, VR_TRACE_OBJECT);
+    router->vr_trace_buffers = NULL;
+
+    return;
+}
+
+int
+vr_trace_init(struct vrouter *router)
+{
+    /* the buffers are allocated when tracing is armed for the first time */
+    vr_trace_filter.tf_vif = -1;
+
+    return 0;
+}
@@ -23,6 +23,9 @@
 #include <vr_mirror.h>
 #include <vr_vxlan.h>
 #include <vr_qos.h>
+#include <vr_hash.h>
+#include <vr_trace.h>
+#include <vr_stats_shm.h>
 
 static struct vrouter router;
 struct host_os *vrouter_host;
@@ -37,11 +40,16 @@ extern unsigned int vr_bridge_entries;
 extern unsigned int vr_bridge_oentries;
 extern const char *ContrailBuildInfo;
 
+#if defined(__linux__) && defined(__KERNEL__)
+extern short vr_flow_major;
+#endif
+
 void vrouter_exit(bool);
 
 volatile bool vr_not_ready = true;
 unsigned int vr_memory_alloc_checks = 0;
 unsigned int vr_priority_tagging = 0;
+bool vr_hash_crc32c_enabled = false;
 
 struct vr_module {
     char *mod_name;
@@ -106,6 +114,11 @@ static struct vr_module modules[] = {
         .init           =       vr_qos_init,
         .exit           =       vr_qos_exit,
     },
+    {
+        .mod_name       =       "Trace",
+        .init           =       vr_trace_init,
+        .exit           =       vr_trace_exit,
+    },
 
 
 };
@@ -284,6 +297,11 @@ vrouter_ops_destroy(vrouter_ops *req)
         req->vo_build_info = NULL;
     }
 
+    if (req->vo_stats_file_path) {
+        vr_free(req->vo_stats_file_path, VR_BUILD_INFO_OBJECT);
+        req->vo_stats_file_path = NULL;
+    }
+
     vr_free(req, VR_VROUTER_REQ_OBJECT);
 
     return;
@@ -305,6 +323,15 @@ vrouter_ops_get(void)
         return NULL;
     }
 
+    if (vr_stats_shm_path) {
+        req->vo_stats_file_path = vr_zalloc(VR_UNIX_PATH_MAX,
+                VR_BUILD_INFO_OBJECT);
+        if (!req->vo_stats_file_path) {
+            vrouter_ops_destroy(req);
+            return NULL;
+        }
+    }
+
     return req;
 }
 
@@ -358,6 +385,8 @@ vrouter_ops_get_process(void *s_req)
     resp->vo_perfq3 = vr_perfq3;
     resp->vo_udp_coff = vr_udp_coff;
     resp->vo_flow_hold_limit = vr_flow_hold_limit;
+    resp->vo_flow_hold_queue_depth = vr_flow_queue_depth;
+    resp->vo_flow_hold_queue_budget = vr_flow_queue_budget;
     resp->vo_mudp = vr_mudp;
 
     /* Build info */
@@ -387,6 +416,15 @@ vrouter_ops_get_process(void *s_req)
     resp->vo_memory_alloc_checks = vr_memory_alloc_checks;
     resp->vo_priority_tagging = vr_priority_tagging;
 
+    /* Shared statistics region */
+#if defined(__linux__) && defined(__KERNEL__)
+    resp->vo_stats_dev = vr_flow_major;
+#endif
+    resp->vo_stats_size = vr_stats_shm_table_size(router);
+    if (vr_stats_shm_path)
+        strncpy(resp->vo_stats_file_path, (char *)vr_stats_shm_path,
+                VR_UNIX_PATH_MAX - 1);
+
     req = resp;
 generate_response:
     if (ret)
@@ -453,6 +491,11 @@ vrouter_ops_add_process(void *s_req)
         vr_udp_coff = req->vo_udp_coff;
     if (req->vo_flow_hold_limit != -1)
         vr_flow_hold_limit = (unsigned int)req->vo_flow_hold_limit;
+    if ((req->vo_flow_hold_queue_depth >= (int)VR_MAX_FLOW_QUEUE_ENTRIES) &&
+            (req->vo_flow_hold_queue_depth <= (int)VR_FLOW_QUEUE_MAX_DEPTH))
+        vr_flow_queue_depth = (unsigned int)req->vo_flow_hold_queue_depth;
+    if (req->vo_flow_hold_queue_budget > 0)
+        vr_flow_queue_budget = (unsigned int)req->vo_flow_hold_queue_budget;
     if (req->vo_mudp != -1)
         vr_mudp = req->vo_mudp;
     vr_flow_set_burst_params(vrouter_get(req->vo_rid), req->vo_burst_tokens,
@@ -498,6 +541,27 @@ vrouter_exit(bool soft_reset)
     return;
 }
 
+/*
+ * vr_hash_init - select the hash backend. CRC32C is used if the CPU
+ * supports SSE4.2, otherwise we fall back to Jenkins hash.
+ */
+static void
+vr_hash_init(void)
+{
+#ifdef VR_HASH_CRC32C_ARCH
+    uint32_t eax = 1, ebx, ecx = 0, edx;
+
+    __asm__ __volatile__ ("cpuid"
+            : "+a" (eax), "=b" (ebx), "+c" (ecx), "=d" (edx));
+    /* CPUID.01H:ECX.SSE4_2[bit 20] */
+    vr_hash_crc32c_enabled = !!(ecx & (1U << 20));
+#else
+    vr_hash_crc32c_enabled = false;
+#endif
+    vr_printf("vrouter: using %s hash\n",
+            vr_hash_crc32c_enabled ? "CRC32C" : "Jenkins");
+}
+
 int
 vrouter_init(void)
 {
@@ -508,6 +572,8 @@ vrouter_init(void)
     if (!vrouter_host && (ret = -ENOMEM))
         goto init_fail;
 
+    vr_hash_init();
+
     for (i = 0; i < VR_NUM_MODULES; i++) {
         module_under_init = &modules[i];
         ret = modules[i].init(&router);
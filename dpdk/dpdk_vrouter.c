@@ -27,6 +27,7 @@
 #include "vr_dpdk_virtio.h"
 #include "vr_uvhost.h"
 #include "vr_bridge.h"
+#include "vr_flow_event.h"
 #include "vr_mem.h"
 #include "nl_util.h"
 
@@ -167,10 +168,67 @@ vr_dpdk_pktmbuf_init(struct rte_mempool *mp, void *opaque_arg, void *_m, unsigne
     pkt->vp_end = m->buf_len;
 }
 
+/*
+ * Create an RSS mempool on each NUMA socket with forwarding lcores, so the
+ * lcores polling VMs copy packets to the local memory. The sockets without
+ * forwarding lcores or with no free memory share the main RSS mempool.
+ */
+static int
+dpdk_socket_mempools_create(void)
+{
+    int ret;
+    unsigned lcore_id, socket_id, master_socket_id = rte_socket_id();
+    char mempool_name[RTE_MEMPOOL_NAMESIZE];
+
+    for (socket_id = 0; socket_id < RTE_MAX_NUMA_NODES; socket_id++)
+        vr_dpdk.socket_mempools[socket_id] = vr_dpdk.rss_mempool;
+
+    if (!VR_DPDK_SOCKET_MEMPOOLS)
+        return 0;
+
+    RTE_LCORE_FOREACH_SLAVE(lcore_id) {
+        if (lcore_id < VR_DPDK_FWD_LCORE_ID)
+            continue;
+
+        socket_id = rte_lcore_to_socket_id(lcore_id);
+        if (socket_id >= RTE_MAX_NUMA_NODES || socket_id == master_socket_id
+                || vr_dpdk.socket_mempools[socket_id] != vr_dpdk.rss_mempool)
+            continue;
+
+        ret = snprintf(mempool_name, sizeof(mempool_name),
+                "rss_mempool_%u", socket_id);
+        if (ret >= sizeof(mempool_name)) {
+            RTE_LOG(ERR, VROUTER, "Error creating socket %u mempool name\n",
+                socket_id);
+            return -ENOMEM;
+        }
+        vr_dpdk.socket_mempools[socket_id] = rte_mempool_create(mempool_name,
+                vr_mempool_sz,
+                VR_DPDK_MBUF_HDR_SZ + vr_packet_sz,
+                VR_DPDK_RSS_MEMPOOL_CACHE_SZ,
+                sizeof(struct rte_pktmbuf_pool_private),
+                vr_dpdk_pktmbuf_pool_init, NULL, vr_dpdk_pktmbuf_init, NULL,
+                socket_id, 0);
+        if (vr_dpdk.socket_mempools[socket_id] == NULL) {
+            RTE_LOG(INFO, VROUTER, "Error creating socket %u RSS mempool: %s (%d),"
+                " using the main RSS mempool\n", socket_id,
+                rte_strerror(rte_errno), rte_errno);
+            vr_dpdk.socket_mempools[socket_id] = vr_dpdk.rss_mempool;
+            continue;
+        }
+        RTE_LOG(INFO, VROUTER, "Allocated RSS mempool on socket %u\n",
+            socket_id);
+    }
+
+    return 0;
+}
+
 /* Create memory pools */
 static int
 dpdk_mempools_create(void)
 {
+    int ret;
+
     /* Create the mbuf pool used for RSS */
     vr_dpdk.rss_mempool = rte_mempool_create("rss_mempool",
             vr_mempool_sz,
@@ -184,6 +242,10 @@ dpdk_mempools_create(void)
         return -rte_errno;
     }
 
+    ret = dpdk_socket_mempools_create();
+    if (ret < 0)
+        return ret;
+
     /* Create the mbuf pool used for IP fragmentation (direct mbufs) */
     vr_dpdk.frag_direct_mempool = rte_mempool_create("frag_direct_mempool",
             VR_DPDK_FRAG_DIRECT_MEMPOOL_SZ, VR_DPDK_FRAG_DIRECT_MBUF_SZ,
@@ -208,7 +270,7 @@ dpdk_mempools_create(void)
     }
 
 #if VR_DPDK_USE_HW_FILTERING
-    int ret, i;
+    int i;
     char mempool_name[RTE_MEMPOOL_NAMESIZE];
 
     /* Create a list of free mempools */
@@ -675,6 +737,14 @@ dpdk_init(void)
         return ret;
     }
 
+    ret = vr_dpdk_table_mem_init(VR_MEM_FLOW_EVENT_OBJECT, VR_MAX_CPUS,
+            VR_MAX_CPUS * VR_FLOW_EVENT_RING_SIZE, 0, 0);
+    if (ret < 0) {
+        RTE_LOG(ERR, VROUTER, "Error initializing flow event rings: %s (%d)\n",
+            rte_strerror(-ret), -ret);
+        return ret;
+    }
+
     ret = dpdk_argv_update();
     if (ret == -1) {
         RTE_LOG(ERR, VROUTER, "Error updating EAL arguments\n");
@@ -25,6 +25,7 @@
 #include <rte_ip.h>
 #include <rte_port_ethdev.h>
 #include <rte_udp.h>
+#include <rte_vect.h>
 
 struct rte_eth_conf ethdev_conf = {
 #if (RTE_VERSION >= RTE_VERSION_NUM(17, 2, 0, 0))
@@ -869,6 +870,64 @@ dpdk_mbuf_rss_hash(struct rte_mbuf *mbuf, struct vr_ip *ipv4_hdr,
     return 1;
 }
 
+/*
+ * dpdk_mbuf_parse_inner_and_hash - parse the tunnelled packet starting
+ * at pull_len, perform TCP MSS adjust if needed and hash the packet.
+ *
+ * Return values are the same as for dpdk_mbuf_parse_and_hash_packets().
+ */
+static inline int
+dpdk_mbuf_parse_inner_and_hash(struct rte_mbuf *mbuf, struct vr_ip *ipv4_hdr,
+    struct vr_gre *gre_hdr, unsigned short gre_udp_encap,
+    unsigned int pull_len)
+{
+    struct vr_ip *ipv4_inner_hdr = NULL;
+    struct vr_ip6 *ipv6_hdr = NULL;
+    struct vr_ip6 *ipv6_inner_hdr = NULL;
+    int encap_type, helper_ret;
+
+    helper_ret = vr_inner_pkt_parse(rte_pktmbuf_mtod(mbuf, unsigned char *),
+                                    vr_mpls_tunnel_type, &encap_type,
+                                    NULL, &pull_len, mbuf->buf_len,
+                                    &ipv4_inner_hdr, &ipv6_inner_hdr,
+                                    gre_udp_encap, ipv4_hdr->ip_proto);
+    if (helper_ret == PKT_RET_SLOW_PATH)
+        return -1;
+    else if (helper_ret == PKT_RET_UNHANDLED)
+        return 0;
+
+    /* If not inner IPv4 nor IPv6 - nothing to do. */
+    if (unlikely(ipv4_inner_hdr == NULL))
+        return 0; /* Inner IPv6 packets have ipv4_inner_hdr != NULL */
+
+    helper_ret = vr_ip_transport_parse(ipv4_inner_hdr, ipv6_inner_hdr,
+                                       NULL, mbuf->buf_len,
+                                       dpdk_adjust_tcp_mss, NULL, NULL,
+                                       NULL, &pull_len);
+    if (unlikely(helper_ret == PKT_RET_SLOW_PATH))
+        return -1;
+
+    /* Packet may already be hashed by the NIC */
+    if (mbuf->ol_flags & PKT_RX_RSS_HASH) {
+        RTE_LOG_DP(DEBUG, VROUTER, "%s: RSS hash: 0x%x (from NIC)\n",
+                __func__, mbuf->hash.rss);
+        return 0;
+    } else {
+        /* For GRE packets we need to hash inner packet */
+        if (gre_hdr) {
+            if (ipv6_inner_hdr) {
+                ipv6_hdr = ipv6_inner_hdr;
+                ipv4_hdr = NULL;
+            } else if (ipv4_inner_hdr) {
+                ipv4_hdr = ipv4_inner_hdr;
+            }
+        }
+        /* Go to hashing */
+    }
+
+    return dpdk_mbuf_rss_hash(mbuf, ipv4_hdr, ipv6_hdr);
+}
+
 /* dpdk_mbuf_parse_and_hash_packets
  *
  * Parse incoming packet. Check L2, L3 headers, encapsulation type, perform
@@ -889,14 +948,11 @@ dpdk_mbuf_parse_and_hash_packets(struct rte_mbuf *mbuf)
 {
     struct vr_eth *eth_hdr = rte_pktmbuf_mtod(mbuf, struct vr_eth *);
     struct vr_ip *ipv4_hdr = NULL;
-    struct vr_ip *ipv4_inner_hdr = NULL;
     struct vr_ip6 *ipv6_hdr = NULL;
-    struct vr_ip6 *ipv6_inner_hdr = NULL;
     struct vr_udp *udp_hdr = NULL;
     struct vr_gre *gre_hdr = NULL;
     struct vlan_hdr *vlan_hdr;
     unsigned int pull_len = VR_ETHER_HLEN, ipv4_len;
-    int encap_type, helper_ret;
     unsigned short gre_udp_encap = 0, gre_hdr_len = VR_GRE_BASIC_HDR_LEN,
                    eth_proto, udp_port;
     uint16_t mbuf_data_len = rte_pktmbuf_data_len(mbuf);
@@ -1012,44 +1068,8 @@ dpdk_mbuf_parse_and_hash_packets(struct rte_mbuf *mbuf)
             return 0; /* Not MPLS-over-GRE, not MPLS-over-UDP, not anything from VM. */
         }
 
-        helper_ret = vr_inner_pkt_parse(rte_pktmbuf_mtod(mbuf, unsigned char *),
-                                        vr_mpls_tunnel_type, &encap_type,
-                                        NULL, &pull_len, mbuf->buf_len,
-                                        &ipv4_inner_hdr, &ipv6_inner_hdr,
-                                        gre_udp_encap, ipv4_hdr->ip_proto);
-        if (helper_ret == PKT_RET_SLOW_PATH)
-            return -1;
-        else if (helper_ret == PKT_RET_UNHANDLED)
-            return 0;
-
-        /* If not inner IPv4 nor IPv6 - nothing to do. */
-        if (unlikely(ipv4_inner_hdr == NULL))
-            return 0; /* Inner IPv6 packets have ipv4_inner_hdr != NULL */
-
-        helper_ret = vr_ip_transport_parse(ipv4_inner_hdr, ipv6_inner_hdr,
-                                           NULL, mbuf->buf_len,
-                                           dpdk_adjust_tcp_mss, NULL, NULL,
-                                           NULL, &pull_len);
-        if (unlikely(helper_ret == PKT_RET_SLOW_PATH))
-            return -1;
-
-        /* Packet may already be hashed by the NIC */
-        if (mbuf->ol_flags & PKT_RX_RSS_HASH) {
-            RTE_LOG_DP(DEBUG, VROUTER, "%s: RSS hash: 0x%x (from NIC)\n",
-                    __func__, mbuf->hash.rss);
-            return 0;
-        } else {
-            /* For GRE packets we need to hash inner packet */
-            if (gre_hdr) {
-                if (ipv6_inner_hdr) {
-                    ipv6_hdr = ipv6_inner_hdr;
-                    ipv4_hdr = NULL;
-                } else if (ipv4_inner_hdr) {
-                    ipv4_hdr = ipv4_inner_hdr;
-                }
-            }
-            /* Go to hashing */
-        }
+        return dpdk_mbuf_parse_inner_and_hash(mbuf, ipv4_hdr, gre_hdr,
+                gre_udp_encap, pull_len);
     } else if (eth_proto == rte_cpu_to_be_16(VR_ETH_PROTO_IP6)) {
         ipv6_hdr = (struct vr_ip6 *)((uintptr_t)eth_hdr + pull_len);
 
@@ -1070,8 +1090,114 @@ dpdk_mbuf_parse_and_hash_packets(struct rte_mbuf *mbuf)
     } else {
         return 0;
     }
+}
 
-    return dpdk_mbuf_rss_hash(mbuf, ipv4_hdr, ipv6_hdr);
+/*
+ * Length of the outer headers of MPLSoGRE packets handled by the vector
+ * classifier: untagged Ethernet, IPv4 without options, basic GRE header.
+ */
+#define DPDK_MPLSOGRE_HDR_LEN   (VR_ETHER_HLEN + sizeof(struct vr_ip) \
+                                    + VR_GRE_BASIC_HDR_LEN)
+/* The classifier loads 16 bytes at offset 24, so we need 40 bytes */
+#define DPDK_MPLSOGRE_LOAD_LEN  40
+
+/*
+ * Outer header templates for the vector classifier. The first vector
+ * covers bytes 12-27 (EtherType, IPv4 version/IHL, fragment offset and
+ * protocol), the second one bytes 24-39 (GRE flags and protocol).
+ */
+static const uint8_t dpdk_mplsogre_mask_lo[16] __rte_aligned(16) = {
+    0xff, 0xff, 0xff, 0, 0, 0, 0, 0, 0x3f, 0xff, 0, 0xff, 0, 0, 0, 0,
+};
+static const uint8_t dpdk_mplsogre_tmpl_lo[16] __rte_aligned(16) = {
+    0x08, 0x00, 0x45, 0, 0, 0, 0, 0, 0, 0, 0, VR_IP_PROTO_GRE, 0, 0, 0, 0,
+};
+static const uint8_t dpdk_mplsogre_mask_hi[16] __rte_aligned(16) = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xff, 0xff, 0xff, 0xff, 0, 0,
+};
+static const uint8_t dpdk_mplsogre_tmpl_hi[16] __rte_aligned(16) = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x88, 0x47, 0, 0,
+};
+
+/*
+ * dpdk_mbuf_is_mplsogre - check the mbuf outer headers against the
+ * MPLSoGRE templates using SSE.
+ *
+ * Returns 1 if the packet is a non-fragmented MPLSoGRE packet with basic
+ * outer headers, 0 otherwise.
+ */
+static inline int
+dpdk_mbuf_is_mplsogre(struct rte_mbuf *mbuf, __m128i mask_lo, __m128i tmpl_lo,
+    __m128i mask_hi, __m128i tmpl_hi)
+{
+    const uint8_t *data = rte_pktmbuf_mtod(mbuf, const uint8_t *);
+    __m128i lo, hi;
+
+    if (unlikely(rte_pktmbuf_data_len(mbuf) < DPDK_MPLSOGRE_LOAD_LEN))
+        return 0;
+
+    lo = _mm_loadu_si128((const __m128i *)(data + 12));
+    hi = _mm_loadu_si128((const __m128i *)(data + 24));
+    lo = _mm_cmpeq_epi8(_mm_and_si128(lo, mask_lo), tmpl_lo);
+    hi = _mm_cmpeq_epi8(_mm_and_si128(hi, mask_hi), tmpl_hi);
+
+    return _mm_movemask_epi8(_mm_and_si128(lo, hi)) == 0xffff;
+}
+
+/*
+ * dpdk_mbuf_classify_mplsogre - classify the outer headers of a burst,
+ * four packets per iteration.
+ *
+ * Returns a bitmask of MPLSoGRE packets dpdk_mbuf_hash_mplsogre() can
+ * handle. The rest of the packets go through the generic parser.
+ */
+static inline uint64_t
+dpdk_mbuf_classify_mplsogre(struct rte_mbuf *pkts[VR_DPDK_RX_BURST_SZ],
+    uint32_t nb_pkts)
+{
+    const __m128i mask_lo = _mm_load_si128((const __m128i *)dpdk_mplsogre_mask_lo);
+    const __m128i tmpl_lo = _mm_load_si128((const __m128i *)dpdk_mplsogre_tmpl_lo);
+    const __m128i mask_hi = _mm_load_si128((const __m128i *)dpdk_mplsogre_mask_hi);
+    const __m128i tmpl_hi = _mm_load_si128((const __m128i *)dpdk_mplsogre_tmpl_hi);
+    uint64_t mask = 0;
+    uint32_t i;
+
+    for (i = 0; i + 4 <= nb_pkts; i += 4) {
+        mask |= (uint64_t)dpdk_mbuf_is_mplsogre(pkts[i],
+                    mask_lo, tmpl_lo, mask_hi, tmpl_hi) << i
+            | (uint64_t)dpdk_mbuf_is_mplsogre(pkts[i + 1],
+                    mask_lo, tmpl_lo, mask_hi, tmpl_hi) << (i + 1)
+            | (uint64_t)dpdk_mbuf_is_mplsogre(pkts[i + 2],
+                    mask_lo, tmpl_lo, mask_hi, tmpl_hi) << (i + 2)
+            | (uint64_t)dpdk_mbuf_is_mplsogre(pkts[i + 3],
+                    mask_lo, tmpl_lo, mask_hi, tmpl_hi) << (i + 3);
+    }
+    for (; i < nb_pkts; i++) {
+        mask |= (uint64_t)dpdk_mbuf_is_mplsogre(pkts[i],
+                    mask_lo, tmpl_lo, mask_hi, tmpl_hi) << i;
+    }
+
+    return mask;
+}
+
+/*
+ * dpdk_mbuf_hash_mplsogre - hash the MPLSoGRE packet classified by
+ * dpdk_mbuf_classify_mplsogre(), skipping the outer header parsing.
+ *
+ * Return values are the same as for dpdk_mbuf_parse_and_hash_packets().
+ */
+static inline int
+dpdk_mbuf_hash_mplsogre(struct rte_mbuf *mbuf)
+{
+    struct vr_ip *ipv4_hdr = rte_pktmbuf_mtod_offset(mbuf, struct vr_ip *,
+                                                    VR_ETHER_HLEN);
+
+    /* see dpdk_mbuf_parse_and_hash_packets() */
+    mbuf->ol_flags &= ~PKT_RX_RSS_HASH;
+
+    return dpdk_mbuf_parse_inner_and_hash(mbuf, ipv4_hdr,
+            (struct vr_gre *)(ipv4_hdr + 1), VR_GRE_PROTO_MPLS_NO,
+            DPDK_MPLSOGRE_HDR_LEN);
 }
 
 /*
@@ -1087,7 +1213,7 @@ vr_dpdk_ethdev_rx_emulate(struct vr_interface *vif,
     struct rte_mbuf *pkts[VR_DPDK_RX_BURST_SZ], uint32_t *nb_pkts)
 {
     uint64_t mask_to_distribute = 0, mask_to_distribute_ret = 0,
-             mask_to_drop = 0;
+             mask_to_drop = 0, mask_mplsogre = 0;
     unsigned i, nb_pkts_ret = 0;
     int ret;
 
@@ -1115,9 +1241,18 @@ vr_dpdk_ethdev_rx_emulate(struct vr_interface *vif,
     if (unlikely(vr_dpdk.nb_fwd_lcores == 1))
         return 0;
 
+#if VR_DPDK_RSS_VECTOR_CLASSIFY
+    /* classify the outer headers of the burst */
+    if (vif_is_fabric(vif))
+        mask_mplsogre = dpdk_mbuf_classify_mplsogre(pkts, *nb_pkts);
+#endif
+
     /* parse packet headers and emulate RSS hash */
     for (i = 0; i < *nb_pkts; i++) {
-        ret = dpdk_mbuf_parse_and_hash_packets(pkts[i]);
+        if (mask_mplsogre & (1ULL << i))
+            ret = dpdk_mbuf_hash_mplsogre(pkts[i]);
+        else
+            ret = dpdk_mbuf_parse_and_hash_packets(pkts[i]);
 
         /**
          * ret:
@@ -19,6 +19,7 @@
 #include "vr_hash.h"
 #include "vr_proto.h"
 #include "vr_sandesh.h"
+#include "vr_stats.h"
 
 #include <linux/if_ether.h>
 #include <netinet/ip.h>
@@ -199,6 +200,7 @@ dpdk_pfree(struct vr_packet *pkt, unsigned short reason)
     if (pkt) {
         /* Handle Vrouter statistics */
         pkt_drop_stats(pkt->vp_if, reason, rte_lcore_id());
+        VR_DROP_CAPTURE(pkt, reason);
 
         rte_pktmbuf_free(vr_dpdk_pkt_to_mbuf(pkt));
     }
@@ -599,6 +601,12 @@ dpdk_get_mono_time(uint64_t *sec, uint64_t *nsec)
     return;
 }
 
+static uint64_t
+dpdk_get_cycles(void)
+{
+    return rte_rdtsc();
+}
+
 static void
 dpdk_htable_work_cb(struct vrouter *router __attribute__((unused)), void *arg)
 {
@@ -669,8 +677,8 @@ dpdk_rcu_cb(struct rcu_head *rh)
         defer = (struct vr_defer_data *)cb_data->rcd_user_data;
         vfq = ((struct vr_flow_defer_data *)defer->vdd_data)->vfdd_flow_queue;
         if (vfq) {
-            for (i = 0; i < VR_MAX_FLOW_QUEUE_ENTRIES; i++) {
-                pnode = &vfq->vfq_pnodes[i];
+            for (i = 0; i < vfq->vfq_depth; i++) {
+                pnode = vr_flow_queue_pnode(vfq, i);
                 if (pnode->pl_packet) {
                     RTE_LOG_DP(DEBUG, VROUTER, "%s: lcore %u passing RCU callback "
                             "to lcore %u\n", __func__, rte_lcore_id(),
@@ -942,7 +950,8 @@ dpdk_get_udp_src_port(struct vr_packet *pkt, struct vr_forwarding_md *fmd,
             if (pkt_head_len(pkt) < ETH_HLEN)
                 goto error;
 
-            hashval = vr_hash(pkt_data(pkt), ETH_HLEN, vr_hashrnd);
+            hashval = vr_hash_key(vr_hash_crc32c_enabled, pkt_data(pkt),
+                    ETH_HLEN, vr_hashrnd);
             /* Include the VRF to calculate the hash */
             hashval = vr_hash_2words(hashval, vrf, vr_hashrnd);
         }
@@ -1432,6 +1441,8 @@ struct host_os dpdk_host = {
     .hos_is_frag_limit_exceeded     =    dpdk_is_frag_limit_exceeded,
     .hos_register_nic               =    dpdk_register_nic, /* not used with DPDK */
     .hos_nl_broadcast_supported     =    false,
+    .hos_get_lcore_stats            =    vr_dpdk_lcore_stats_get,
+    .hos_get_cycles                 =    dpdk_get_cycles,
 };
 
 struct host_os *
@@ -1599,6 +1610,9 @@ vr_dpdk_host_init(void)
         if (vr_dpdk_bridge_init()) {
             return -1;
         }
+
+        /* not fatal, the counters are then kept private */
+        vr_dpdk_stats_shm_init();
     }
 
     /*
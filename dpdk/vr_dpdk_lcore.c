@@ -58,6 +58,38 @@ vr_dpdk_lcore_least_used_get(void)
     return least_used_id;
 }
 
+/*
+ * Returns the least used forwarding lcore on a given NUMA socket, which
+ * does not serve an RX queue of the given vif yet, or VR_MAX_CPUS.
+ */
+unsigned
+vr_dpdk_lcore_least_used_socket_get(unsigned socket_id, unsigned vif_idx)
+{
+    unsigned lcore_id;
+    struct vr_dpdk_lcore *lcore;
+    unsigned least_used_id = VR_MAX_CPUS;
+    uint16_t least_used_nb_queues = 2 * VR_MAX_INTERFACES;
+    unsigned int num_queues;
+
+    RTE_LCORE_FOREACH_SLAVE(lcore_id) {
+        if (lcore_id < VR_DPDK_FWD_LCORE_ID ||
+                lcore_id == vr_dpdk.vf_lcore_id ||
+                rte_lcore_to_socket_id(lcore_id) != socket_id)
+            continue;
+        lcore = vr_dpdk.lcores[lcore_id];
+        if (lcore->lcore_rx_queues[vif_idx].q_queue_h != NULL)
+            continue;
+
+        num_queues = lcore->lcore_nb_rx_queues;
+        if (num_queues < least_used_nb_queues) {
+            least_used_nb_queues = num_queues;
+            least_used_id = lcore_id;
+        }
+    }
+
+    return least_used_id;
+}
+
 /* Returns the least used IO lcore or VR_MAX_CPUS */
 unsigned
 dpdk_lcore_least_used_io_get(void)
@@ -591,30 +623,368 @@ vr_dpdk_lcore_if_unschedule(struct vr_interface *vif)
     dpdk_lcore_rxtx_release_all(vif);
 }
 
-inline static void
-dpdk_lcore_delay_us(unsigned us)
+/*
+ * dpdk_lcore_stats_tsc - read TSC for the lcore statistics.
+ * Returns 0 if the statistics are disabled.
+ */
+static inline uint64_t
+dpdk_lcore_stats_tsc(void)
 {
-    rcu_thread_offline();
-#if VR_DPDK_SLEEP_NO_PACKETS_US > 0
-    usleep(us);
+#if VR_DPDK_LCORE_STATS
+    return rte_rdtsc();
+#else
+    return 0;
 #endif
-#if VR_DPDK_YIELD_NO_PACKETS > 0
-    /*
-     * Yielding specified time reduces TX side enqueue drops,
-     * but also reduces PPS on RX side.
-     */
-//    const uint64_t start = rte_get_timer_cycles();
-//    const uint64_t ticks = (uint64_t)us * rte_get_timer_hz() / 1E6;
-//    while ((rte_get_timer_cycles() - start) < ticks)
-        sched_yield();
+}
 
+/*
+ * dpdk_lcore_stats_stage - account TSC cycles elapsed since *tsc to the
+ * given forwarding loop stage and restart the measurement.
+ */
+static inline void
+dpdk_lcore_stats_stage(struct vr_dpdk_lcore *lcore,
+    enum vr_dpdk_lcore_stage stage, uint64_t *tsc)
+{
+#if VR_DPDK_LCORE_STATS
+    uint64_t now = rte_rdtsc();
+
+    lcore->lcore_stats.lcs_stage_cycles[stage] += now - *tsc;
+    *tsc = now;
 #endif
-    rcu_thread_online();
+}
+
+/* dpdk_lcore_stats_poll - account an RX burst of nb_pkts packets */
+static inline void
+dpdk_lcore_stats_poll(struct vr_dpdk_lcore *lcore, uint32_t nb_pkts)
+{
+#if VR_DPDK_LCORE_STATS
+    struct vr_dpdk_lcore_stats *stats = &lcore->lcore_stats;
+
+    if (likely(nb_pkts > 0)) {
+        stats->lcs_polls++;
+        stats->lcs_packets += nb_pkts;
+        /* bucket N holds bursts of [2^N, 2^(N+1)) packets */
+        stats->lcs_burst_hist[RTE_MIN(31 - __builtin_clz(nb_pkts),
+                VR_DPDK_BURST_HIST_SZ - 1)]++;
+    } else {
+        stats->lcs_empty_polls++;
+    }
+#endif
+}
+
+/*
+ * dpdk_lcore_stats_loop - account the cycles of the last lcore loop as
+ * busy or idle depending on whether any packets were handled.
+ * Returns the TSC value to start the next loop measurement with.
+ */
+static inline uint64_t
+dpdk_lcore_stats_loop(struct vr_dpdk_lcore *lcore, uint64_t loop_tsc,
+    uint64_t total_pkts)
+{
+#if VR_DPDK_LCORE_STATS
+    uint64_t now = rte_rdtsc();
+
+    if (total_pkts)
+        lcore->lcore_stats.lcs_busy_cycles += now - loop_tsc;
+    else
+        lcore->lcore_stats.lcs_idle_cycles += now - loop_tsc;
+    lcore->lcore_stats.lcs_loops++;
+
+    return now;
+#else
+    return 0;
+#endif
+}
+
+/*
+ * vr_dpdk_lcore_stats_get - fill in the lcore statistics response.
+ * Returns 0 on success, -ENOENT if the lcore does not forward packets.
+ */
+int
+vr_dpdk_lcore_stats_get(unsigned lcore_id, vr_lcore_stats_req *resp)
+{
+    struct vr_dpdk_lcore *lcore;
+    struct vr_dpdk_lcore_stats *stats;
+    int i;
+
+    /* only IO and forwarding lcores run the packet loops */
+    if (lcore_id >= RTE_MAX_LCORE || lcore_id < VR_DPDK_IO_LCORE_ID
+            || (lcore_id > VR_DPDK_LAST_IO_LCORE_ID
+                && lcore_id < VR_DPDK_FWD_LCORE_ID))
+        return -ENOENT;
+
+    lcore = vr_dpdk.lcores[lcore_id];
+    if (lcore == NULL)
+        return -ENOENT;
+
+    stats = &lcore->lcore_stats;
+    resp->vlsr_tsc_hz = rte_get_tsc_hz();
+    resp->vlsr_busy_cycles = stats->lcs_busy_cycles;
+    resp->vlsr_idle_cycles = stats->lcs_idle_cycles;
+    resp->vlsr_loops = stats->lcs_loops;
+    resp->vlsr_polls = stats->lcs_polls;
+    resp->vlsr_empty_polls = stats->lcs_empty_polls;
+    resp->vlsr_packets = stats->lcs_packets;
+    resp->vlsr_rx_cycles = stats->lcs_stage_cycles[VR_DPDK_LCORE_STAGE_RX];
+    resp->vlsr_distribute_cycles =
+        stats->lcs_stage_cycles[VR_DPDK_LCORE_STAGE_DISTRIBUTE];
+    resp->vlsr_vroute_cycles =
+        stats->lcs_stage_cycles[VR_DPDK_LCORE_STAGE_VROUTE];
+    resp->vlsr_tx_push_cycles =
+        stats->lcs_stage_cycles[VR_DPDK_LCORE_STAGE_TX_PUSH];
+
+    if (resp->vlsr_burst_hist) {
+        for (i = 0; i < VR_DPDK_BURST_HIST_SZ &&
+                i < resp->vlsr_burst_hist_size; i++)
+            resp->vlsr_burst_hist[i] = stats->lcs_burst_hist[i];
+        resp->vlsr_burst_hist_size = i;
+    }
+
+    return 0;
+}
+
+/*
+ * dpdk_lcore_dist_vif - get the interface a staged burst was received on.
+ * Returns NULL if the interface is no longer available.
+ */
+static inline struct vr_interface *
+dpdk_lcore_dist_vif(uintptr_t header)
+{
+    struct vr_interface *vif;
+    unsigned short vif_idx = header >> LCORE_RX_RING_VIF_IDX_OFF
+                                & LCORE_RX_RING_VIF_IDX_MASK;
+    unsigned int vif_gen = header >> LCORE_RX_RING_VIF_GEN_OFF
+                                & LCORE_RX_RING_VIF_GEN_MASK;
+
+    vif = __vrouter_get_interface(vrouter_get(0), vif_idx);
+    if (likely(vif != NULL) && vif->vif_gen == vif_gen)
+        return vif;
+
+    return NULL;
+}
+
+/*
+ * dpdk_lcore_dist_drop - drop all the packets staged for the destination
+ * lcore and account them as queue errors.
+ */
+static void
+dpdk_lcore_dist_drop(struct vr_dpdk_lcore *lcore, uint16_t dst_lcore_idx)
+{
+    struct vr_dpdk_dist_stage *stage = &lcore->lcore_dist_stages[dst_lcore_idx];
+    uintptr_t header = (uintptr_t)stage->ds_pkts[0];
+    uint32_t i, nb_pkts = header & LCORE_RX_RING_NB_PKTS_MASK;
+    unsigned dst_fwd_lcore_idx = lcore->lcore_dst_lcore_idxs[dst_lcore_idx]
+                                    + VR_DPDK_FWD_LCORE_ID;
+    struct vr_interface *vif = dpdk_lcore_dist_vif(header);
+    struct vr_interface_stats *stats;
+
+    RTE_LOG_DP(DEBUG, VROUTER, "%s: lcore %u ring is full, dropping %u packets\n",
+            __func__, dst_fwd_lcore_idx, nb_pkts - 1);
+
+    if (vif) {
+        stats = vif_get_stats(vif, rte_lcore_id());
+        /* count out the header */
+        stats->vis_queue_ierrors += nb_pkts - 1;
+        stats->vis_queue_ierrors_to_lcore[dst_fwd_lcore_idx] += nb_pkts - 1;
+    }
+
+    for (i = 1; i < nb_pkts; i++)
+        vr_dpdk_pfree(stage->ds_pkts[i], vif, VP_DROP_INTERFACE_DROP);
+
+    stage->ds_pkts[0] = NULL;
+}
+
+/*
+ * dpdk_lcore_dist_ring - RX ring of the destination lcore.
+ */
+static inline struct rte_ring *
+dpdk_lcore_dist_ring(struct vr_dpdk_lcore *lcore, const bool io_lcore,
+    uint16_t dst_lcore_idx)
+{
+    unsigned dst_fwd_lcore_idx = lcore->lcore_dst_lcore_idxs[dst_lcore_idx]
+                                    + VR_DPDK_FWD_LCORE_ID;
+
+    if (io_lcore)
+        return vr_dpdk.lcores[dst_fwd_lcore_idx]->lcore_io_rx_ring;
+
+    return vr_dpdk.lcores[dst_fwd_lcore_idx]->lcore_rx_ring;
+}
+
+/*
+ * dpdk_lcore_dist_congestion_update - update the congestion state of the
+ * destination lcore from the number of mbufs in its RX ring.
+ */
+static inline void
+dpdk_lcore_dist_congestion_update(struct vr_dpdk_lcore *lcore,
+    struct vr_dpdk_dist_stage *stage, struct rte_ring *ring)
+{
+    stage->ds_congested = dpdk_lcore_dist_congested(stage->ds_congested,
+            rte_ring_count(ring), VR_DPDK_DIST_CONGESTION_ON,
+            VR_DPDK_DIST_CONGESTION_OFF);
+    if (stage->ds_congested)
+        lcore->lcore_dist_congested = true;
+}
+
+/*
+ * dpdk_lcore_dist_flush - pass the staged packets to the destination lcore.
+ *
+ * If the destination RX ring has no room for the whole burst, the packets
+ * which fit are passed as a separate (shorter) burst and the rest of the
+ * packets stays staged until the next flush.
+ *
+ * Returns number of packets left staged.
+ */
+static uint32_t
+dpdk_lcore_dist_flush(struct vr_dpdk_lcore *lcore, const bool io_lcore,
+    uint16_t dst_lcore_idx)
+{
+    struct vr_dpdk_dist_stage *stage = &lcore->lcore_dist_stages[dst_lcore_idx];
+    unsigned dst_fwd_lcore_idx = lcore->lcore_dst_lcore_idxs[dst_lcore_idx]
+                                    + VR_DPDK_FWD_LCORE_ID;
+    uintptr_t header = (uintptr_t)stage->ds_pkts[0];
+    uint32_t nb_pkts, enq_nb_pkts, chunk_nb_pkts, free_count;
+    struct vr_interface *vif;
+    struct rte_ring *ring;
+    int ret;
+
+    nb_pkts = header & LCORE_RX_RING_NB_PKTS_MASK;
+    if (nb_pkts <= 1)
+        return 0;
+
+    ring = dpdk_lcore_dist_ring(lcore, io_lcore, dst_lcore_idx);
+
+    /* round up the number of packets to the chunk size */
+    chunk_nb_pkts = (nb_pkts + VR_DPDK_RX_RING_CHUNK_SZ - 1)
+            /VR_DPDK_RX_RING_CHUNK_SZ*VR_DPDK_RX_RING_CHUNK_SZ;
+    free_count = rte_ring_free_count(ring);
+    if (likely(free_count >= chunk_nb_pkts)) {
+        enq_nb_pkts = nb_pkts;
+    } else {
+        /* pass as many packets as fit, including the header */
+        chunk_nb_pkts = free_count
+                /VR_DPDK_RX_RING_CHUNK_SZ*VR_DPDK_RX_RING_CHUNK_SZ;
+        enq_nb_pkts = chunk_nb_pkts;
+        if (enq_nb_pkts <= 1) {
+            stage->ds_congested = true;
+            lcore->lcore_dist_congested = true;
+            return nb_pkts - 1;
+        }
+        stage->ds_pkts[0] = (struct rte_mbuf *)
+            ((header & ~(uintptr_t)LCORE_RX_RING_NB_PKTS_MASK) | enq_nb_pkts);
+    }
+
+    RTE_LOG_DP(DEBUG, VROUTER, "%s: enqueueing %u of %u packet(s) to lcore %u\n",
+         __func__, enq_nb_pkts - 1, nb_pkts - 1, dst_fwd_lcore_idx);
+
+    if (io_lcore) {
+        /* IO lcore enqueue packets. */
+        ret = rte_ring_sp_enqueue_bulk(ring, (void **)&stage->ds_pkts[0],
+                chunk_nb_pkts);
+    } else {
+        /* Other forwarding lcores enqueue packets. */
+        ret = rte_ring_mp_enqueue_bulk(ring, (void **)&stage->ds_pkts[0],
+                chunk_nb_pkts);
+    }
+    if (unlikely(ret == -ENOBUFS)) {
+        /* other lcores took the room, keep the packets staged */
+        stage->ds_pkts[0] = (struct rte_mbuf *)header;
+        stage->ds_congested = true;
+        lcore->lcore_dist_congested = true;
+        return nb_pkts - 1;
+    }
+
+    vif = dpdk_lcore_dist_vif(header);
+    if (likely(vif != NULL)) {
+        /* count out the header */
+        vif_get_stats(vif, rte_lcore_id())->vis_queue_ipackets
+                                                += enq_nb_pkts - 1;
+    }
+
+    dpdk_lcore_dist_congestion_update(lcore, stage, ring);
+
+    nb_pkts -= enq_nb_pkts - 1;
+    if (unlikely(nb_pkts > 1)) {
+        /* move the rest of the packets right after the header */
+        memmove(&stage->ds_pkts[1], &stage->ds_pkts[enq_nb_pkts],
+                (nb_pkts - 1) * sizeof(stage->ds_pkts[0]));
+        stage->ds_pkts[0] = (struct rte_mbuf *)
+            ((header & ~(uintptr_t)LCORE_RX_RING_NB_PKTS_MASK) | nb_pkts);
+        return nb_pkts - 1;
+    }
+
+    stage->ds_pkts[0] = NULL;
+    return 0;
+}
+
+/*
+ * dpdk_lcore_dist_congestion_check - recheck the congested destination
+ * lcores. A ring only gets flushed to while packets are staged for it, so
+ * with the traffic biased away the rings are also checked every
+ * VR_DPDK_DIST_CONGESTION_LOOPS loops for the congestion to clear.
+ */
+static inline void
+dpdk_lcore_dist_congestion_check(struct vr_dpdk_lcore *lcore,
+    const bool io_lcore)
+{
+    int i;
+    struct vr_dpdk_dist_stage *stage;
+
+    if (likely(!lcore->lcore_dist_congested))
+        return;
+
+    if (++lcore->lcore_dist_loops < VR_DPDK_DIST_CONGESTION_LOOPS)
+        return;
+
+    lcore->lcore_dist_loops = 0;
+    lcore->lcore_dist_congested = false;
+    for (i = 0; i < lcore->lcore_nb_dst_lcores; i++) {
+        stage = &lcore->lcore_dist_stages[i];
+        if (stage->ds_congested)
+            dpdk_lcore_dist_congestion_update(lcore, stage,
+                    dpdk_lcore_dist_ring(lcore, io_lcore, i));
+    }
+}
+
+/*
+ * dpdk_lcore_dist_flush_all - flush the distribution staging buffers.
+ * The buffers are flushed if the lcore is idle or the packets have been
+ * staged for VR_DPDK_DIST_FLUSH_LOOPS loops.
+ */
+static inline void
+dpdk_lcore_dist_flush_all(struct vr_dpdk_lcore *lcore, const bool io_lcore,
+    const bool idle)
+{
+    int i;
+    bool pending = false;
+    struct vr_dpdk_dist_stage *stage;
+
+    dpdk_lcore_dist_congestion_check(lcore, io_lcore);
+
+    if (likely(!lcore->lcore_dist_pending))
+        return;
+
+    for (i = 0; i < lcore->lcore_nb_dst_lcores; i++) {
+        stage = &lcore->lcore_dist_stages[i];
+        if (stage->ds_pkts[0] == NULL)
+            continue;
+
+        if (idle || ++stage->ds_age >= VR_DPDK_DIST_FLUSH_LOOPS) {
+            if (dpdk_lcore_dist_flush(lcore, io_lcore, i) == 0)
+                continue;
+        }
+        pending = true;
+    }
+
+    lcore->lcore_dist_pending = pending;
 }
 
 /*
  * Distribute mbufs among forwarding lcores using hash.rss.
  * The destination lcores are listed in lcore->lcore_dst_lcore_idxs.
+ *
+ * The packets are staged per destination lcore and passed in bursts of
+ * VR_DPDK_DIST_FLUSH_SZ packets or by dpdk_lcore_dist_flush_all(). The
+ * packets get dropped only if the staging buffer overflows.
  */
 void
 vr_dpdk_lcore_distribute(struct vr_dpdk_lcore *lcore, const bool io_lcore,
@@ -624,34 +994,21 @@ vr_dpdk_lcore_distribute(struct vr_dpdk_lcore *lcore, const bool io_lcore,
     const unsigned lcore_id = rte_lcore_id();
     uint16_t nb_dst_lcores = lcore->lcore_nb_dst_lcores;
     uint16_t *dst_lcore_idxs = lcore->lcore_dst_lcore_idxs;
+    struct vr_dpdk_dist_stage *stage;
     struct rte_mbuf *mbuf;
-    int i, j, ret, retry;
-    int nb_retry_lcores;
+    int i;
     uint16_t dst_lcore_idx, dst_fwd_lcore_idx;
-    uint32_t lcore_nb_pkts, chunk_nb_pkts, hashval;
-    struct rte_mbuf *lcore_pkts[nb_dst_lcores][nb_pkts + VR_DPDK_RX_RING_CHUNK_SZ];
+    uint32_t lcore_nb_pkts, hashval;
+    uintptr_t header, vif_header;
     struct vr_interface_stats *stats;
-    unsigned retry_lcores[nb_dst_lcores];
 
     RTE_LOG_DP(DEBUG, VROUTER, "%s: distributing %" PRIu32 " packet(s) from interface %s\n",
          __func__, nb_pkts, vif->vif_name);
 
-    /* init the headers */
-    for (i = 0; i < nb_dst_lcores; i++) {
-        lcore_pkts[i][0] = (struct rte_mbuf *)(((uintptr_t)1
-                                            << LCORE_RX_RING_HEADER_OFF)
+    vif_header = ((uintptr_t)1 << LCORE_RX_RING_HEADER_OFF)
                 | ((uintptr_t)vif->vif_idx << LCORE_RX_RING_VIF_IDX_OFF)
-                | ((uintptr_t)vif->vif_gen << LCORE_RX_RING_VIF_GEN_OFF)
-                | 1 /* the header */);
-        retry_lcores[i] = i;
-        if (io_lcore) {
-            rte_prefetch0(vr_dpdk.lcores[dst_lcore_idxs[i]
-                          + VR_DPDK_FWD_LCORE_ID]->lcore_io_rx_ring);
-        } else {
-            rte_prefetch0(vr_dpdk.lcores[dst_lcore_idxs[i]
-                          + VR_DPDK_FWD_LCORE_ID]->lcore_rx_ring);
-        }
-    }
+                | ((uintptr_t)vif->vif_gen << LCORE_RX_RING_VIF_GEN_OFF);
+    stats = vif_get_stats(vif, lcore_id);
 
     /* distribute the burst among the forwarding lcores */
     for (i = 0; i < nb_pkts; i++) {
@@ -663,101 +1020,64 @@ vr_dpdk_lcore_distribute(struct vr_dpdk_lcore *lcore, const bool io_lcore,
             hashval = 0;
 
         dst_lcore_idx = hashval % nb_dst_lcores;
+#if VR_DPDK_DIST_CONGESTION_BIAS
+        /*
+         * Use an alternative lcore while the destination is congested.
+         * The alternative is also chosen by hash, so the flows get
+         * reordered only when the congestion state changes.
+         */
+        if (unlikely(lcore->lcore_dist_stages[dst_lcore_idx].ds_congested)
+                && nb_dst_lcores > 1) {
+            uint16_t alt_lcore_idx = (dst_lcore_idx + 1
+                    + (hashval >> 16) % (nb_dst_lcores - 1)) % nb_dst_lcores;
+            if (!lcore->lcore_dist_stages[alt_lcore_idx].ds_congested)
+                dst_lcore_idx = alt_lcore_idx;
+        }
+#endif
         dst_fwd_lcore_idx = dst_lcore_idxs[dst_lcore_idx] + VR_DPDK_FWD_LCORE_ID;
+        stage = &lcore->lcore_dist_stages[dst_lcore_idx];
+
+        header = (uintptr_t)stage->ds_pkts[0];
+        if (header != 0
+                && (header & ~(uintptr_t)LCORE_RX_RING_NB_PKTS_MASK) != vif_header) {
+            /* the staged packets are from another interface, flush them */
+            if (dpdk_lcore_dist_flush(lcore, io_lcore, dst_lcore_idx) != 0)
+                dpdk_lcore_dist_drop(lcore, dst_lcore_idx);
+            header = 0;
+        } else if (header != 0 && (header & LCORE_RX_RING_NB_PKTS_MASK)
+                                        > VR_DPDK_RX_BURST_SZ) {
+            /* the staging buffer is full, make some room */
+            dpdk_lcore_dist_flush(lcore, io_lcore, dst_lcore_idx);
+            header = (uintptr_t)stage->ds_pkts[0];
+        }
+
+        if (header == 0) {
+            /* init the header */
+            header = vif_header | 1 /* the header */;
+            stage->ds_age = 0;
+            lcore->lcore_dist_pending = true;
+        }
+
+        lcore_nb_pkts = header & LCORE_RX_RING_NB_PKTS_MASK;
+        if (unlikely(lcore_nb_pkts > VR_DPDK_RX_BURST_SZ)) {
+            /* the destination is overloaded, drop the packet */
+            stats->vis_queue_ierrors++;
+            stats->vis_queue_ierrors_to_lcore[dst_fwd_lcore_idx]++;
+            vr_dpdk_pfree(mbuf, vif, VP_DROP_INTERFACE_DROP);
+            continue;
+        }
 
         /* put the mbuf to the burst */
-        lcore_nb_pkts = (uintptr_t)lcore_pkts[dst_lcore_idx][0]
-                                                 & LCORE_RX_RING_NB_PKTS_MASK;
         RTE_LOG_DP(DEBUG, VROUTER, "%s: lcore %u RSS hash 0x%x packet %u dst lcore %u\n",
              __func__, lcore_id, hashval, lcore_nb_pkts, dst_fwd_lcore_idx);
-        lcore_pkts[dst_lcore_idx][lcore_nb_pkts] = mbuf;
+        stage->ds_pkts[lcore_nb_pkts] = mbuf;
 
         /* increase number of packets in the burst */
-        lcore_pkts[dst_lcore_idx][0] = (struct rte_mbuf *)(
-                            (uintptr_t)lcore_pkts[dst_lcore_idx][0] + 1);
-    }
-
-    stats = vif_get_stats(vif, lcore_id);
-
-    /*
-     * Pass distributed bursts to other forwarding lcores.
-     * Retry on full RX rings.
-     */
-    for (retry = 0; retry < VR_DPDK_RETRY_NUM; retry++) {
-        nb_retry_lcores = 0;
-        for (i = 0; i < nb_dst_lcores; i++) {
-            dst_lcore_idx = retry_lcores[i];
-            dst_fwd_lcore_idx = dst_lcore_idxs[dst_lcore_idx] + VR_DPDK_FWD_LCORE_ID;
-
-            lcore_nb_pkts = (uintptr_t)lcore_pkts[dst_lcore_idx][0]
-                                                  & LCORE_RX_RING_NB_PKTS_MASK;
-            if (likely(lcore_nb_pkts > 1)) {
-                RTE_LOG_DP(DEBUG, VROUTER, "%s: enqueueing %u packet(s) to lcore %u\n",
-                     __func__, lcore_nb_pkts - 1, dst_fwd_lcore_idx);
-
-                /* round up the number of packets to the chunk size */
-                chunk_nb_pkts = (lcore_nb_pkts + VR_DPDK_RX_RING_CHUNK_SZ - 1)
-                        /VR_DPDK_RX_RING_CHUNK_SZ*VR_DPDK_RX_RING_CHUNK_SZ;
-                if (io_lcore) {
-                    /* IO lcore enqueue packets. */
-                    ret = rte_ring_sp_enqueue_bulk(
-                            vr_dpdk.lcores[dst_fwd_lcore_idx]->lcore_io_rx_ring,
-                            (void **)&lcore_pkts[dst_lcore_idx][0],
-                            chunk_nb_pkts);
-                } else {
-                    /* Other forwarding lcores enqueue packets. */
-                    ret = rte_ring_mp_enqueue_bulk(
-                            vr_dpdk.lcores[dst_fwd_lcore_idx]->lcore_rx_ring,
-                            (void **)&lcore_pkts[dst_lcore_idx][0],
-                            chunk_nb_pkts);
-                }
-                if (unlikely(ret == -ENOBUFS)) {
-                    /* drop packets if it's the last retry */
-                    if (unlikely(retry == VR_DPDK_RETRY_NUM - 1)) {
-                        /* count out the header */
-                        stats->vis_queue_ierrors += lcore_nb_pkts - 1;
-                        stats->vis_queue_ierrors_to_lcore[dst_fwd_lcore_idx]
-                                                          += lcore_nb_pkts - 1;
-
-                        if (io_lcore) {
-                            RTE_LOG_DP(DEBUG, VROUTER, "%s: lcore %u IO ring is full, dropping %u packets: %d/%d\n",
-                                    __func__, dst_fwd_lcore_idx,
-                                    lcore_nb_pkts,
-                                    rte_ring_count(vr_dpdk.lcores[dst_fwd_lcore_idx]->lcore_io_rx_ring),
-                                    rte_ring_free_count(vr_dpdk.lcores[dst_fwd_lcore_idx]->lcore_io_rx_ring));
-                        } else {
-                            RTE_LOG_DP(DEBUG, VROUTER, "%s: lcore %u ring is full, dropping %u packets: %d/%d\n",
-                                    __func__, dst_fwd_lcore_idx,
-                                    lcore_nb_pkts,
-                                    rte_ring_count(vr_dpdk.lcores[dst_fwd_lcore_idx]->lcore_rx_ring),
-                                    rte_ring_free_count(vr_dpdk.lcores[dst_fwd_lcore_idx]->lcore_rx_ring));
-                        }
-
-                        /* ring is full, drop the packets */
-                        for (j = 1; j < lcore_nb_pkts; j++) {
-                            vr_dpdk_pfree(lcore_pkts[dst_lcore_idx][j], vif, VP_DROP_INTERFACE_DROP);
-                        }
-                    } else {
-                        /* mark the lcore to retry */
-                        retry_lcores[nb_retry_lcores++] = dst_lcore_idx;
-                        RTE_LOG_DP(DEBUG, VROUTER, "%s: retrying %d lcore %u...\n",
-                            __func__, retry, dst_fwd_lcore_idx);
-
-                    }
-                } else {
-                    /* count out the header */
-                    stats->vis_queue_ipackets += lcore_nb_pkts - 1;
-                }
-            } /* if there are packets to pass */
-        } /* for all lcores */
-
-        if (likely(nb_retry_lcores == 0))
-            break;
-        /* pause a bit */
-        dpdk_lcore_delay_us(VR_DPDK_RETRY_US);
+        stage->ds_pkts[0] = (struct rte_mbuf *)(header + 1);
 
-        nb_dst_lcores = nb_retry_lcores;
-    } /* for all tries */
+        if (lcore_nb_pkts >= VR_DPDK_DIST_FLUSH_SZ)
+            dpdk_lcore_dist_flush(lcore, io_lcore, dst_lcore_idx);
+    }
 }
 
 /*
@@ -872,14 +1192,17 @@ dpdk_lcore_rxqs_vroute(struct vr_dpdk_lcore *lcore)
     uint32_t nb_pkts_to_route;
     uint32_t nb_pkts_to_distribute;
     uint64_t mask_to_distribute;
+    uint64_t tsc;
     int i;
 
     /* for all hardware RX queues */
     SLIST_FOREACH(rx_queue, &lcore->lcore_rx_head, q_next) {
         /* burst RX */
         rte_prefetch0(rx_queue->q_queue_h);
+        tsc = dpdk_lcore_stats_tsc();
         nb_pkts = rx_queue->rxq_ops.f_rx(rx_queue->q_queue_h, pkts,
                 VR_DPDK_RX_BURST_SZ);
+        dpdk_lcore_stats_poll(lcore, nb_pkts);
         if (likely(nb_pkts > 0)) {
             rte_prefetch0(rx_queue->q_vif);
 
@@ -896,9 +1219,12 @@ dpdk_lcore_rxqs_vroute(struct vr_dpdk_lcore *lcore)
                 /* (Re)calculate hashes and strip VLAN tags. */
                 mask_to_distribute = vr_dpdk_ethdev_rx_emulate(rx_queue->q_vif,
                                                     pkts, &nb_pkts);
+                dpdk_lcore_stats_stage(lcore, VR_DPDK_LCORE_STAGE_RX, &tsc);
                 if (likely(mask_to_distribute == 0)) {
                     /* Packets have been hashed by NIC, just route them. */
                     vr_dpdk_lcore_vroute(lcore, rx_queue->q_vif, pkts, nb_pkts);
+                    dpdk_lcore_stats_stage(lcore, VR_DPDK_LCORE_STAGE_VROUTE,
+                            &tsc);
                 } else {
                     /* Split packets to route and to distribute. */
 
@@ -915,26 +1241,38 @@ dpdk_lcore_rxqs_vroute(struct vr_dpdk_lcore *lcore)
                     /* Some of the packets got new hash, distribute them. */
                     vr_dpdk_lcore_distribute(lcore, false, rx_queue->q_vif,
                             pkts_to_distribute, nb_pkts_to_distribute);
+                    dpdk_lcore_stats_stage(lcore,
+                            VR_DPDK_LCORE_STAGE_DISTRIBUTE, &tsc);
                     /* Route the rest of the packets. */
                     vr_dpdk_lcore_vroute(lcore, rx_queue->q_vif, pkts,
                             nb_pkts_to_route);
+                    dpdk_lcore_stats_stage(lcore, VR_DPDK_LCORE_STAGE_VROUTE,
+                            &tsc);
                 }
             } else {
                 /* For non-fabric interfaces we always distribute the packets. */
                 mask_to_distribute = vr_dpdk_ethdev_rx_emulate(rx_queue->q_vif,
                         pkts, &nb_pkts);
+                dpdk_lcore_stats_stage(lcore, VR_DPDK_LCORE_STAGE_RX, &tsc);
                 if (likely(mask_to_distribute != 0)) {
                     /* Distribute all the packets. */
                     vr_dpdk_lcore_distribute(lcore, false, rx_queue->q_vif,
                             pkts, nb_pkts);
+                    dpdk_lcore_stats_stage(lcore,
+                            VR_DPDK_LCORE_STAGE_DISTRIBUTE, &tsc);
                 } else {
                     /* No other lcores to distribute, so just route the packets. */
                     vr_dpdk_lcore_vroute(lcore, rx_queue->q_vif, pkts, nb_pkts);
+                    dpdk_lcore_stats_stage(lcore, VR_DPDK_LCORE_STAGE_VROUTE,
+                            &tsc);
                 }
             }
         }
     }
 
+    /* pass the staged packets to other lcores */
+    dpdk_lcore_dist_flush_all(lcore, false, total_pkts == 0);
+
     return total_pkts;
 }
 
@@ -953,13 +1291,16 @@ dpdk_lcore_rxqs_distribute(struct vr_dpdk_lcore *lcore, const bool io_core)
     struct rte_mbuf *pkts[VR_DPDK_RX_BURST_SZ];
     struct vr_dpdk_queue *rx_queue;
     uint32_t nb_pkts, i;
+    uint64_t tsc;
 
     /* for all hardware RX queues */
     SLIST_FOREACH(rx_queue, &lcore->lcore_rx_head, q_next) {
         /* burst RX */
         rte_prefetch0(rx_queue->q_queue_h);
+        tsc = dpdk_lcore_stats_tsc();
         nb_pkts = rx_queue->rxq_ops.f_rx(rx_queue->q_queue_h, pkts,
                 VR_DPDK_RX_BURST_SZ);
+        dpdk_lcore_stats_poll(lcore, nb_pkts);
         if (likely(nb_pkts > 0)) {
             rte_prefetch0(rx_queue->q_vif);
 
@@ -984,11 +1325,18 @@ dpdk_lcore_rxqs_distribute(struct vr_dpdk_lcore *lcore, const bool io_core)
 
             /* (Re)calculate hashes and strip VLAN tags. */
             vr_dpdk_ethdev_rx_emulate(rx_queue->q_vif, pkts, &nb_pkts);
+            dpdk_lcore_stats_stage(lcore, VR_DPDK_LCORE_STAGE_RX, &tsc);
             /* Distribute all the packets. */
             vr_dpdk_lcore_distribute(lcore, io_core, rx_queue->q_vif, pkts, nb_pkts);
+            dpdk_lcore_stats_stage(lcore, VR_DPDK_LCORE_STAGE_DISTRIBUTE, &tsc);
         }
     }
 
+    /* pass the staged packets to forwarding lcores */
+    tsc = dpdk_lcore_stats_tsc();
+    dpdk_lcore_dist_flush_all(lcore, io_core, total_pkts == 0);
+    dpdk_lcore_stats_stage(lcore, VR_DPDK_LCORE_STAGE_DISTRIBUTE, &tsc);
+
     return total_pkts;
 }
 
@@ -1006,6 +1354,7 @@ dpdk_lcore_rx_ring_vroute(struct vr_dpdk_lcore *lcore, struct rte_ring *ring)
     unsigned short vif_idx;
     unsigned int vif_gen;
     struct rte_mbuf *pkts[VR_DPDK_RX_BURST_SZ + VR_DPDK_RX_RING_CHUNK_SZ];
+    uint64_t tsc = dpdk_lcore_stats_tsc();
 
     /* dequeue the first chunk */
     ret = rte_ring_sc_dequeue_bulk(ring, (void **)pkts,
@@ -1040,6 +1389,7 @@ dpdk_lcore_rx_ring_vroute(struct vr_dpdk_lcore *lcore, struct rte_ring *ring)
             for (i = 1; i < nb_pkts; i++)
                 vr_dpdk_pfree(pkts[i], NULL, VP_DROP_INTERFACE_DROP);
         }
+        dpdk_lcore_stats_stage(lcore, VR_DPDK_LCORE_STAGE_VROUTE, &tsc);
     }
 
     return total_pkts;
@@ -1056,6 +1406,7 @@ dpdk_lcore_tx_rings_push(struct vr_dpdk_lcore *lcore)
     uint32_t nb_pkts;
     uint16_t nb_rtp;
     struct rte_mbuf *pkts[VR_DPDK_TX_BURST_SZ];
+    uint64_t tsc = dpdk_lcore_stats_tsc();
 
     /* for all TX rings to push */
     rtp = &lcore->lcore_rings_to_push[0];
@@ -1089,11 +1440,17 @@ dpdk_lcore_tx_rings_push(struct vr_dpdk_lcore *lcore)
         }
         rtp++;
     }
+    if (total_pkts)
+        dpdk_lcore_stats_stage(lcore, VR_DPDK_LCORE_STAGE_TX_PUSH, &tsc);
+
     return total_pkts;
 }
 
-/* IO lcore RX/TX */
-static inline void
+/*
+ * IO lcore RX/TX
+ * Returns total number of packets handled.
+ */
+static inline uint64_t
 dpdk_lcore_io_rxtx(struct vr_dpdk_lcore *lcore)
 {
     uint64_t total_pkts;
@@ -1111,6 +1468,8 @@ dpdk_lcore_io_rxtx(struct vr_dpdk_lcore *lcore)
 #endif
         rcu_thread_online();
     }
+
+    return total_pkts;
 }
 
 /*
@@ -1160,9 +1519,10 @@ dpdk_lcore_vlan_fwd(struct vr_dpdk_lcore* lcore)
 }
 
 /*
- * dpdk_lcore_io_rxtx - SR-IOV VF IO lcore RX/TX
+ * dpdk_lcore_sriov_rxtx - SR-IOV VF IO lcore RX/TX
+ * Returns total number of packets handled.
  */
-static inline void
+static inline uint64_t
 dpdk_lcore_sriov_rxtx(struct vr_dpdk_lcore *lcore)
 {
     uint64_t total_pkts = 0;
@@ -1192,10 +1552,15 @@ dpdk_lcore_sriov_rxtx(struct vr_dpdk_lcore *lcore)
             && vr_dpdk.vlan_ring) {
         dpdk_lcore_vlan_fwd(lcore);
     }
+
+    return total_pkts;
 }
 
-/* Forwarding lcore RX/TX */
-static inline void
+/*
+ * Forwarding lcore RX/TX
+ * Returns total number of packets handled.
+ */
+static inline uint64_t
 dpdk_lcore_fwd_rxtx(struct vr_dpdk_lcore *lcore)
 {
     uint64_t total_pkts = 0;
@@ -1238,6 +1603,8 @@ dpdk_lcore_fwd_rxtx(struct vr_dpdk_lcore *lcore)
             && vr_dpdk.vlan_ring) {
         dpdk_lcore_vlan_fwd(lcore);
     }
+
+    return total_pkts;
 }
 
 /* Setup signal handlers */
@@ -1445,11 +1812,18 @@ void
 dpdk_lcore_exit(unsigned lcore_id)
 {
     struct vr_dpdk_lcore *lcore = vr_dpdk.lcores[lcore_id];
+    int i;
 
     /* wait for interface operation to complete */
     vr_dpdk_if_lock();
     vr_dpdk_if_unlock();
 
+    /* drop the packets staged to distribute */
+    for (i = 0; i < lcore->lcore_nb_dst_lcores; i++) {
+        if (lcore->lcore_dist_stages[i].ds_pkts[0] != NULL)
+            dpdk_lcore_dist_drop(lcore, i);
+    }
+
     /* lcore-specific initializations */
     if (lcore_id >= VR_DPDK_FWD_LCORE_ID) {
         /* Free forwarding lcore RX rings. */
@@ -1522,6 +1896,10 @@ vr_dpdk_lcore_cmd_handle(struct vr_dpdk_lcore *lcore)
         vr_dpdk_virtio_rx_queue_set((void *)cmd_arg);
         lcore->lcore_cmd = VR_DPDK_LCORE_NO_CMD;
         break;
+    case VR_DPDK_LCORE_RX_QUEUE_NUMA_CMD:
+        vr_dpdk_virtio_rx_queue_numa_set((void *)cmd_arg);
+        lcore->lcore_cmd = VR_DPDK_LCORE_NO_CMD;
+        break;
     }
 
     return ret;
@@ -1552,6 +1930,9 @@ dpdk_lcore_io_loop(void)
     uint64_t cur_cycles = 0;
     uint64_t diff_cycles;
     uint64_t last_tx_cycles = 0;
+    /* statistics */
+    uint64_t total_pkts;
+    uint64_t loop_tsc = dpdk_lcore_stats_tsc();
 #if VR_DPDK_USE_TIMER
     /* calculate timeouts in CPU cycles */
     const uint64_t tx_flush_cycles = (rte_get_timer_hz() + US_PER_S - 1)
@@ -1573,7 +1954,8 @@ dpdk_lcore_io_loop(void)
 #endif
 
         /* run IO lcore RX/TX cycle */
-        dpdk_lcore_io_rxtx(lcore);
+        total_pkts = dpdk_lcore_io_rxtx(lcore);
+        loop_tsc = dpdk_lcore_stats_loop(lcore, loop_tsc, total_pkts);
 
         diff_cycles = cur_cycles - last_tx_cycles;
         if (unlikely(tx_flush_cycles < diff_cycles)) {
@@ -1612,6 +1994,10 @@ dpdk_lcore_fwd_loop(void)
     uint64_t last_tx_cycles = 0, last_gro_flush_cycles = 0;
     uint64_t last_bond_tx_cycles = 0;
     uint64_t last_assembler_cycles = 0;
+    /* statistics */
+    uint64_t total_pkts;
+    uint64_t loop_tsc = dpdk_lcore_stats_tsc();
+    uint64_t flush_tsc;
     /* always calculate bond TX timeout in CPU cycles */
     const uint64_t bond_tx_cycles = (rte_get_timer_hz() + MS_PER_S - 1)
         * VR_DPDK_BOND_TX_MS / MS_PER_S;
@@ -1644,9 +2030,10 @@ dpdk_lcore_fwd_loop(void)
 
         /* Run forwarding lcore or SR-IOV VF RX/TX cycle. */
         if (lcore_id == vr_dpdk.vf_lcore_id)
-            dpdk_lcore_sriov_rxtx(lcore);
+            total_pkts = dpdk_lcore_sriov_rxtx(lcore);
         else
-            dpdk_lcore_fwd_rxtx(lcore);
+            total_pkts = dpdk_lcore_fwd_rxtx(lcore);
+        loop_tsc = dpdk_lcore_stats_loop(lcore, loop_tsc, total_pkts);
 
         /* IP fragment assembler timers */
 #if VR_DPDK_USE_TIMER
@@ -1673,7 +2060,10 @@ dpdk_lcore_fwd_loop(void)
             last_tx_cycles = cur_cycles;
 
             /* flush all TX queues */
+            flush_tsc = dpdk_lcore_stats_tsc();
             vr_dpdk_lcore_flush(lcore);
+            dpdk_lcore_stats_stage(lcore, VR_DPDK_LCORE_STAGE_TX_PUSH,
+                    &flush_tsc);
 
             /* check if we need to TX bond queues */
             if (unlikely(lcore->lcore_nb_bonds_to_tx > 0)) {
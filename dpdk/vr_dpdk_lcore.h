@@ -22,5 +22,22 @@
 #define LCORE_RX_RING_VIF_GEN_MASK 0xFFFFFFFFU
 #define LCORE_RX_RING_NB_PKTS_MASK 0x7fffU
 
+/*
+ * dpdk_lcore_dist_congested - congestion state of a destination lcore RX
+ * ring holding count mbufs, given its previous state. The ring gets
+ * congested at on mbufs and stays so until it drains below off.
+ */
+static inline bool
+dpdk_lcore_dist_congested(bool congested, unsigned count, unsigned on,
+    unsigned off)
+{
+    if (count >= on)
+        return true;
+    if (count < off)
+        return false;
+
+    return congested;
+}
+
 
 #endif /* __VR_DPDK_LCORE_H__ */
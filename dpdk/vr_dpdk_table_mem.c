@@ -9,12 +9,15 @@
 #include <sys/types.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <linux/mempolicy.h>
 
 #include "vr_dpdk.h"
 #include "vr_btable.h"
 #include "vr_mem.h"
+#include "vr_stats_shm.h"
 #include "nl_util.h"
 
 #include <rte_errno.h>
@@ -22,6 +25,7 @@
 #define MAX_LINE_SIZE   128
 #define HPI_MAX         16
 #define MOUNT_TABLE     "/proc/mounts"
+#define NODE_ONLINE     "/sys/devices/system/node/online"
 
 struct vr_hugepage_info {
     char *mnt;
@@ -32,7 +36,10 @@ struct vr_hugepage_info {
 
 extern void *vr_flow_table, *vr_oflow_table;
 extern void *vr_bridge_table, *vr_bridge_otable;
+extern void *vr_flow_event_table;
 extern unsigned char *vr_flow_path, *vr_bridge_table_path;
+extern unsigned char *vr_flow_event_path;
+extern unsigned int vr_interfaces, vr_vrfs;
 
 static int
 vr_hugepage_info_init(void)
@@ -137,11 +144,73 @@ exit_func:
 }
 
 
+/*
+ * Read the mask of online NUMA nodes, i.e. a list of ranges like "0-1,3".
+ * Returns the number of nodes in the mask.
+ */
+static unsigned int
+vr_table_mem_online_nodes(unsigned long *nodemask)
+{
+    FILE *fp;
+    char line[MAX_LINE_SIZE], *p, *end;
+    unsigned long first, last, node;
+    unsigned int nodes = 0;
+
+    *nodemask = 0;
+    fp = fopen(NODE_ONLINE, "r");
+    if (!fp)
+        return 0;
+
+    if (fgets(line, sizeof(line), fp)) {
+        p = line;
+        while (*p >= '0' && *p <= '9') {
+            first = last = strtoul(p, &end, 10);
+            if (*end == '-')
+                last = strtoul(end + 1, &end, 10);
+            for (node = first; node <= last && node < 8 * sizeof(*nodemask);
+                    node++) {
+                *nodemask |= 1UL << node;
+                nodes++;
+            }
+            if (*end != ',')
+                break;
+            p = end + 1;
+        }
+    }
+    fclose(fp);
+
+    return nodes;
+}
+
+/*
+ * Interleave the table pages across the online NUMA nodes, so the lcores
+ * on all the sockets see the same average access latency. Must be called
+ * before the table memory is touched.
+ */
+static void
+vr_table_mem_interleave(void *addr, unsigned long size)
+{
+    unsigned long nodemask;
+
+    if (vr_table_mem_online_nodes(&nodemask) < 2)
+        return;
+
+    if (syscall(SYS_mbind, addr, size, MPOL_INTERLEAVE, &nodemask,
+                8 * sizeof(nodemask) + 1, 0)) {
+        RTE_LOG(INFO, VROUTER, "Error interleaving table memory: %s (%d)\n",
+            rte_strerror(errno), errno);
+        return;
+    }
+    RTE_LOG(INFO, VROUTER, "Interleaving table memory across NUMA nodes 0x%lx\n",
+        nodemask);
+}
+
 int
 vr_dpdk_table_mem_init(unsigned int table, unsigned int entries,
         unsigned long size, unsigned int oentries, unsigned long osize)
 {
     int ret, i, fd;
+    bool use_shm = no_huge_set;
 
     void **table_p;
     char shm_file[VR_UNIX_PATH_MAX];
@@ -152,12 +221,16 @@ vr_dpdk_table_mem_init(unsigned int table, unsigned int entries,
     struct stat f_stat;
     struct vr_hugepage_info *hpi;
 
-    if (!oentries) {
-        oentries = (entries / 5 + 1023) & ~1023;
-        osize = (size / entries) * oentries;
-    }
+    /* only the flow and the bridge tables have an overflow table */
+    if ((table == VR_MEM_FLOW_TABLE_OBJECT) ||
+            (table == VR_MEM_BRIDGE_TABLE_OBJECT)) {
+        if (!oentries) {
+            oentries = (entries / 5 + 1023) & ~1023;
+            osize = (size / entries) * oentries;
+        }
 
-    size += osize;
+        size += osize;
+    }
 
     switch (table) {
     case VR_MEM_FLOW_TABLE_OBJECT:
@@ -176,11 +249,27 @@ vr_dpdk_table_mem_init(unsigned int table, unsigned int entries,
         vr_bridge_oentries = oentries;
         break;
 
+    case VR_MEM_FLOW_EVENT_OBJECT:
+        shmem_name = "flow_event.shmem";
+        hp_file_name = "flow_event";
+        table_p = &vr_dpdk.flow_event_table;
+        path = &vr_flow_event_path;
+        break;
+
+    case VR_MEM_STATS_OBJECT:
+        shmem_name = "stats.shmem";
+        hp_file_name = "stats";
+        table_p = &vr_dpdk.stats_table;
+        path = &vr_stats_shm_path;
+        /* the hugepages are all claimed by EAL by the time it is created */
+        use_shm = true;
+        break;
+
     default:
         return -EINVAL;
     }
 
-    if (no_huge_set) {
+    if (use_shm) {
         /* Create a shared memory under the socket directory. */
         ret = snprintf(shm_file, sizeof(shm_file), "%s/%s",
                 vr_socket_dir, shmem_name);
@@ -227,7 +316,7 @@ vr_dpdk_table_mem_init(unsigned int table, unsigned int entries,
             return -errno;
         }
 
-        if (no_huge_set) {
+        if (use_shm) {
             ret = ftruncate(fd, size);
             if (ret == -1) {
                 RTE_LOG(ERR, VROUTER, "Error truncating file %s: %s (%d)\n",
@@ -245,6 +334,8 @@ vr_dpdk_table_mem_init(unsigned int table, unsigned int entries,
                 touse_file_name, rte_strerror(errno), errno);
             return -errno;
         }
+        if (VR_DPDK_TABLE_MEM_INTERLEAVE)
+            vr_table_mem_interleave(*table_p, size);
         memset(*table_p, 0, size);
         *path = (unsigned char *)touse_file_name;
     }
@@ -272,6 +363,7 @@ vr_dpdk_flow_init(void)
 
     vr_flow_table = vr_dpdk.flow_table;
     vr_oflow_table = vr_dpdk.flow_table + VR_FLOW_TABLE_SIZE;
+    vr_flow_event_table = vr_dpdk.flow_event_table;
 
     if (!vr_flow_table)
         return -1;
@@ -282,3 +374,29 @@ vr_dpdk_flow_init(void)
 
     return 0;
 }
+
+/*
+ * Map the region of the interface, vrf and drop counters. Called once the
+ * number of cpus is known, the counters are kept in private memory if it
+ * fails.
+ */
+int
+vr_dpdk_stats_shm_init(void)
+{
+    int ret;
+    unsigned long size;
+
+    size = vr_stats_shm_size(vr_num_cpus, vr_interfaces, vr_vrfs);
+    if (!size) {
+        RTE_LOG(INFO, VROUTER, "Statistics do not fit in a shared region\n");
+        return -E2BIG;
+    }
+
+    ret = vr_dpdk_table_mem_init(VR_MEM_STATS_OBJECT, 0, size, 0, 0);
+    if (ret)
+        return ret;
+
+    vr_stats_shm_table = vr_dpdk.stats_table;
+
+    return 0;
+}
@@ -181,6 +181,8 @@ struct dpdk_virtio_reader {
     uint64_t nb_nombufs;
 
     vr_dpdk_virtioq_t *rx_virtioq;
+    /* mempool on the socket of the lcore polling the queue */
+    struct rte_mempool *mempool;
 };
 
 struct dpdk_virtio_reader_params {
@@ -211,6 +213,10 @@ dpdk_virtio_reader_create(void *params, int socket_id)
 
     /* Initialization */
     port->rx_virtioq = conf->rx_virtioq;
+    port->mempool = vr_dpdk.rss_mempool;
+    if (socket_id >= 0 && socket_id < RTE_MAX_NUMA_NODES
+            && vr_dpdk.socket_mempools[socket_id] != NULL)
+        port->mempool = vr_dpdk.socket_mempools[socket_id];
 
     return port;
 }
@@ -695,6 +701,161 @@ vr_dpdk_virtio_rx_queue_set(void *arg)
     rte_free(arg);
 }
 
+struct dpdk_virtio_rx_queue_numa_params {
+    unsigned int vif_id;
+    unsigned int vif_gen;
+    unsigned int socket_id;
+};
+
+/*
+ * Called on uvhost lcore only, once the guest memory is mapped.
+ */
+void
+vr_dpdk_virtio_rx_queue_numa_request(unsigned int vif_id,
+                                     unsigned int vif_gen,
+                                     int socket_id)
+{
+    struct dpdk_virtio_rx_queue_numa_params *arg;
+
+    if (!VR_DPDK_VIRTIO_NUMA_AFFINITY || socket_id < 0)
+        return;
+
+    arg = rte_malloc("virtio_rx_queue_numa", sizeof(*arg), 0);
+    if (arg == NULL)
+        return;
+
+    arg->vif_id = vif_id;
+    arg->vif_gen = vif_gen;
+    arg->socket_id = socket_id;
+
+    vr_dpdk_lcore_cmd_post(VR_DPDK_NETLINK_LCORE_ID,
+                           VR_DPDK_LCORE_RX_QUEUE_NUMA_CMD, (uint64_t)arg);
+}
+
+/*
+ * dpdk_virtio_rx_queue_move - moves a virtio RX queue from one forwarding
+ * lcore to another. The virtio queue state is preserved, the reader is
+ * reallocated on the socket of the new lcore.
+ *
+ * Returns 0 on success, -errno otherwise.
+ */
+static int
+dpdk_virtio_rx_queue_move(struct vr_interface *vif, unsigned int queue_id,
+                          unsigned int old_lcore_id, unsigned int new_lcore_id)
+{
+    unsigned int vif_idx = vif->vif_idx;
+    unsigned int socket_id = rte_lcore_to_socket_id(new_lcore_id);
+    struct vr_dpdk_lcore *old_lcore = vr_dpdk.lcores[old_lcore_id];
+    struct vr_dpdk_lcore *new_lcore = vr_dpdk.lcores[new_lcore_id];
+    struct vr_dpdk_queue *old_queue = &old_lcore->lcore_rx_queues[vif_idx];
+    struct vr_dpdk_queue *new_queue = &new_lcore->lcore_rx_queues[vif_idx];
+    struct vr_dpdk_lcore_rx_queue_remove_arg *rx_rm_arg;
+    struct dpdk_virtio_reader *old_port, *new_port;
+    struct dpdk_virtio_reader_params reader_params = {
+        .rx_virtioq = &vr_dpdk_virtio_rxqs[vif_idx][queue_id],
+    };
+    bool enabled = old_queue->enabled;
+
+    new_port = dpdk_virtio_reader_create(&reader_params, socket_id);
+    if (new_port == NULL)
+        return -ENOMEM;
+
+    /* stop polling the queue on the old lcore and wait for it */
+    if (enabled) {
+        rx_rm_arg = rte_malloc("lcore_rx_queue_rm_cmd", sizeof(*rx_rm_arg), 0);
+        if (rx_rm_arg == NULL) {
+            rte_free(new_port);
+            return -ENOMEM;
+        }
+        rx_rm_arg->vif_id = vif_idx;
+        rx_rm_arg->clear_f_rx = false;
+        rx_rm_arg->free_arg = true;
+        vr_dpdk_lcore_cmd_post(old_lcore_id, VR_DPDK_LCORE_RX_RM_CMD,
+                               (uint64_t)rx_rm_arg);
+        vr_dpdk_lcore_cmd_wait(old_lcore_id);
+    }
+
+    /* keep the statistics, but use the mempool of the new socket */
+    old_port = (struct dpdk_virtio_reader *)old_queue->q_queue_h;
+    new_port->stats = old_port->stats;
+    new_port->nb_syscalls = old_port->nb_syscalls;
+    new_port->nb_nombufs = old_port->nb_nombufs;
+    rte_free(old_port);
+
+    /* the vif reference moves along with the queue */
+    new_queue->rxq_ops = old_queue->rxq_ops;
+    new_queue->q_queue_h = new_port;
+    new_queue->q_vif = old_queue->q_vif;
+    new_queue->enabled = false;
+    new_lcore->lcore_rx_queue_params[vif_idx] =
+        old_lcore->lcore_rx_queue_params[vif_idx];
+
+    memset(old_queue, 0, sizeof(*old_queue));
+    memset(&old_lcore->lcore_rx_queue_params[vif_idx], 0,
+            sizeof(old_lcore->lcore_rx_queue_params[vif_idx]));
+
+    vif_rx_queue_lcore[vif_idx][queue_id] = new_lcore_id;
+    if (enabled)
+        dpdk_lcore_queue_add(new_lcore_id, &new_lcore->lcore_rx_head,
+                             new_queue);
+
+    return 0;
+}
+
+/*
+ * Move the virtio RX queues of a vif to the forwarding lcores on the NUMA
+ * socket of the VM memory, so the copies in the virtio path stay local.
+ * Queues stay where they are if there is no free lcore on that socket.
+ *
+ * Called only on netlink lcore.
+ */
+void
+vr_dpdk_virtio_rx_queue_numa_set(void *arg)
+{
+    struct dpdk_virtio_rx_queue_numa_params *p = arg;
+    struct vr_interface *vif;
+    struct vr_dpdk_lcore *lcore;
+    unsigned int queue_id, old_lcore_id, new_lcore_id;
+    int ret;
+
+    /* Check if vif is still valid */
+    vif = __vrouter_get_interface(vrouter_get(0), p->vif_id);
+    if (!vif || vif->vif_gen != p->vif_gen) {
+        rte_free(arg);
+        return;
+    }
+
+    for (queue_id = 0; queue_id < vr_dpdk_virtio_nrxqs(vif); queue_id++) {
+        old_lcore_id = vif_rx_queue_lcore[p->vif_id][queue_id];
+        /* IO lcores distribute the packets anyway */
+        if (old_lcore_id < VR_DPDK_FWD_LCORE_ID)
+            continue;
+        lcore = vr_dpdk.lcores[old_lcore_id];
+        if (lcore->lcore_rx_queues[p->vif_id].q_queue_h == NULL
+                || rte_lcore_to_socket_id(old_lcore_id) == p->socket_id)
+            continue;
+
+        new_lcore_id = vr_dpdk_lcore_least_used_socket_get(p->socket_id,
+                p->vif_id);
+        if (new_lcore_id == VR_MAX_CPUS)
+            break;
+
+        ret = dpdk_virtio_rx_queue_move(vif, queue_id, old_lcore_id,
+                new_lcore_id);
+        if (ret < 0) {
+            RTE_LOG(ERR, VROUTER, "    error moving virtio device %s RX queue %u"
+                " to lcore %u: %s (%d)\n", vif->vif_name, queue_id,
+                new_lcore_id, rte_strerror(-ret), -ret);
+            break;
+        }
+        RTE_LOG(INFO, VROUTER, "    virtio device %s RX queue %u moved from"
+            " lcore %u to lcore %u on socket %u\n", vif->vif_name, queue_id,
+            old_lcore_id, new_lcore_id, p->socket_id);
+    }
+
+    rte_free(arg);
+}
+
 /*
  * vr_dpdk_guest_phys_to_host_virt - convert a guest physical address
  * to a host virtual address. Uses the guest memory map stored in the
@@ -840,7 +1001,7 @@ dpdk_virtio_create_mss_sized_mbuf_chain(struct rte_mbuf *mbuf,
             rte_memcpy(tail_addr, append_addr, copy_len);
             pktlen_to_copy -= copy_len;
             append_addr += copy_len;
-            new_mbuf = rte_pktmbuf_alloc(vr_dpdk.rss_mempool);
+            new_mbuf = rte_pktmbuf_alloc(mbuf->pool);
             if (unlikely(new_mbuf == NULL)) {
                 RTE_LOG_DP(DEBUG, VROUTER, "%s: mbuf alloc failed\n",__func__);
                 return -1;
@@ -879,7 +1040,7 @@ dpdk_virtio_create_chained_mbuf(struct rte_mbuf *mbuf, char* pkt_addr, uint32_t
         rte_memcpy(tail_addr, append_addr, pkt_tailroom);
         append_len -= pkt_tailroom;
         append_addr += pkt_tailroom;
-        new_mbuf = rte_pktmbuf_alloc(vr_dpdk.rss_mempool);
+        new_mbuf = rte_pktmbuf_alloc(mbuf->pool);
         if (unlikely(new_mbuf == NULL)) {
             RTE_LOG_DP(DEBUG, VROUTER, "%s: mbuf alloc failed\n",__func__);
             return -1;
@@ -937,7 +1098,7 @@ dpdk_virtio_from_vm_rx(void *port, struct rte_mbuf **pkts, uint32_t max_pkts)
     for (i = 0; i < avail_pkts; i++) {
         uint32_t header_len = 0;
         /* Allocate a mbuf. */
-        mbuf = rte_pktmbuf_alloc(vr_dpdk.rss_mempool);
+        mbuf = rte_pktmbuf_alloc(p->mempool);
         if (unlikely(mbuf == NULL)) {
             p->nb_nombufs++;
             DPDK_UDEBUG(VROUTER, &vq->vdv_hash, "%s: queue %p no_mbufs=%"PRIu64"\n",
@@ -89,6 +89,12 @@ void
 vr_dpdk_virtio_tx_queue_set(void *arg);
 void
 vr_dpdk_virtio_rx_queue_set(void *arg);
+void
+vr_dpdk_virtio_rx_queue_numa_request(unsigned int vif_id,
+                                     unsigned int vif_gen,
+                                     int socket_id);
+void
+vr_dpdk_virtio_rx_queue_numa_set(void *arg);
 int vr_dpdk_virtio_set_vring_base(unsigned int vif_idx, unsigned int vring_idx,
                                    unsigned int vring_base);
 int vr_dpdk_virtio_get_vring_base(unsigned int vif_idx, unsigned int vring_idx,
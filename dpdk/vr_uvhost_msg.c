@@ -15,9 +15,11 @@
 #include "vr_uvhost_util.h"
 
 #include <fcntl.h>
+#include <linux/mempolicy.h>
 #include <linux/virtio_net.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
 #include <sys/un.h>
 #include <sys/timerfd.h>
 #include <linux/netlink.h>
@@ -406,6 +408,51 @@ vr_uvmh_set_protocol_features(vr_uvh_client_t *vru_cl)
     return 0;
 }
 
+/* Number of pages to sample in each guest memory region */
+#define UVHM_NUMA_SAMPLES_PER_REGION    8
+
+/*
+ * uvhm_client_mem_socket - finds out the NUMA socket most of the guest
+ * memory is on by sampling the pages of the mapped regions.
+ *
+ * Returns the socket ID or -1 if it can not be determined.
+ */
+static int
+uvhm_client_mem_socket(vr_uvh_client_t *vru_cl)
+{
+    int i, j, node, socket_id = -1;
+    uint64_t step, max_size = 0;
+    uint64_t node_size[RTE_MAX_NUMA_NODES];
+    vr_uvh_client_mem_region_t *region;
+
+    memset(node_size, 0, sizeof(node_size));
+    for (i = 0; i < vru_cl->vruc_num_mem_regions; i++) {
+        region = &vru_cl->vruc_mem_regions[i];
+        if (!region->vrucmr_mmap_addr || !region->vrucmr_size)
+            continue;
+
+        step = region->vrucmr_size / UVHM_NUMA_SAMPLES_PER_REGION;
+        for (j = 0; j < UVHM_NUMA_SAMPLES_PER_REGION; j++) {
+            node = -1;
+            if (syscall(SYS_get_mempolicy, &node, NULL, 0,
+                        (void *)(uintptr_t)(region->vrucmr_mmap_addr
+                            + j * step), MPOL_F_NODE | MPOL_F_ADDR))
+                continue;
+            if (node >= 0 && node < RTE_MAX_NUMA_NODES)
+                node_size[node] += step;
+        }
+    }
+
+    for (i = 0; i < RTE_MAX_NUMA_NODES; i++) {
+        if (node_size[i] > max_size) {
+            max_size = node_size[i];
+            socket_id = i;
+        }
+    }
+
+    return socket_id;
+}
+
 /*
  * vr_uvhm_set_mem_table - handles VHOST_USER_SET_MEM_TABLE message from
  * user space vhost client to learn the memory map of the guest.
@@ -415,11 +462,26 @@ vr_uvmh_set_protocol_features(vr_uvh_client_t *vru_cl)
 static int
 vr_uvhm_set_mem_table(vr_uvh_client_t *vru_cl)
 {
+    int ret, socket_id;
+
     vr_uvhost_log("    SET MEM TABLE:\n");
 
     /* Unmap previously mmaped guest memory. */
     uvhm_client_munmap(vru_cl);
-    return uvhm_client_mmap(vru_cl);
+    ret = uvhm_client_mmap(vru_cl);
+    if (ret)
+        return ret;
+
+    /* Poll the guest from the lcores on the same socket as its memory. */
+    socket_id = uvhm_client_mem_socket(vru_cl);
+    if (socket_id >= 0) {
+        vr_uvhost_log("Client %s: guest memory is on socket %d\n",
+                uvhm_client_name(vru_cl), socket_id);
+        vr_dpdk_virtio_rx_queue_numa_request(vru_cl->vruc_idx,
+                vru_cl->vruc_vif_gen, socket_id);
+    }
+
+    return 0;
 }
 
 /*
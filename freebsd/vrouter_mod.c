@@ -54,6 +54,7 @@
 #include "vr_proto.h"
 #include "vr_sandesh.h"
 #include "vrouter.h"
+#include "vr_stats.h"
 
 /* UMA zone for vr_packet */
 extern uma_zone_t zone_vr_packet;
@@ -216,6 +217,7 @@ fh_pfree(struct vr_packet *pkt, unsigned short reason)
 
     /* Handle vrouter statistics */
     pkt_drop_stats(pkt->vp_if, reason, pkt->vp_cpu);
+    VR_DROP_CAPTURE(pkt, reason);
 
 	/* Fetch original mbuf from packet structure */
 	m = vp_os_packet(pkt);
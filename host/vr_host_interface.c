@@ -3,6 +3,7 @@
  *
  * Copyright (c) 2013 Juniper Networks, Inc. All rights reserved.
  */
+#define _GNU_SOURCE
 #include <sys/socket.h>
 
 #include "vr_os.h"
@@ -39,6 +40,13 @@ struct hif_interface_md {
     },
 };
 
+struct vr_hif_burst {
+    unsigned int hb_count;
+    struct vr_hpacket *hb_pkts[HIF_BURST_SIZE];
+    struct mmsghdr hb_msgs[HIF_BURST_SIZE];
+    struct iovec hb_iov[HIF_BURST_SIZE][HIF_MAX_SEGMENTS];
+};
+
 static void
 vr_netif_rx(struct vr_hinterface *hif, struct vr_hpacket *hpkt)
 {
@@ -52,53 +60,119 @@ vr_netif_rx(struct vr_hinterface *hif, struct vr_hpacket *hpkt)
     return;
 }
 
+static void
+hif_udp_flush(struct vr_hinterface *hif)
+{
+    int ret;
+    unsigned int i, sent = 0;
+    struct vr_hif_burst *burst = hif->hif_tx_burst;
+
+    if (!burst->hb_count)
+        return;
+
+    while (sent < burst->hb_count) {
+        ret = sendmmsg(hif->hif_fd, &burst->hb_msgs[sent],
+                burst->hb_count - sent, 0);
+        if (ret <= 0) {
+            if (ret < 0 && errno == EINTR)
+                continue;
+            break;
+        }
+        sent += ret;
+    }
+
+    /* whatever the socket did not take is dropped, as a failed sendmsg was */
+    for (i = 0; i < burst->hb_count; i++) {
+        vr_hpacket_free(burst->hb_pkts[i]);
+        burst->hb_pkts[i] = NULL;
+    }
+    burst->hb_count = 0;
+
+    return;
+}
+
 static int
 hif_udp_rx(void *arg)
 {
-    int ret = 0;
+    int ret;
+    unsigned int i, n;
     struct vr_hinterface *hif = (struct vr_hinterface *)arg;
+    struct vr_hif_burst *burst = hif->hif_rx_burst;
     struct vr_hpacket *hpkt;
     struct vr_packet *pkt;
+    struct msghdr *msg;
+
+    for (n = 0; n < HIF_BURST_SIZE; n++) {
+        hpkt = vr_hpacket_pool_alloc(hif->hif_pkt_pool);
+        if (!hpkt)
+            break;
+
+        burst->hb_pkts[n] = hpkt;
+        burst->hb_iov[n][0].iov_base = hpkt_data(hpkt);
+        burst->hb_iov[n][0].iov_len = hpkt_room(hpkt);
+        msg = &burst->hb_msgs[n].msg_hdr;
+        msg->msg_iov = burst->hb_iov[n];
+        msg->msg_iovlen = 1;
+        burst->hb_msgs[n].msg_len = 0;
+    }
+
+    if (!n)
+        return -ENOMEM;
 
-    hpkt = vr_hpacket_pool_alloc(hif->hif_pkt_pool);
-    if (!hpkt)
-        assert(!hpkt);
+    ret = recvmmsg(hif->hif_fd, burst->hb_msgs, n, MSG_DONTWAIT, NULL);
+    for (i = 0; i < n; i++) {
+        hpkt = burst->hb_pkts[i];
+        burst->hb_pkts[i] = NULL;
+        if (ret <= 0 || i >= (unsigned int)ret ||
+                !burst->hb_msgs[i].msg_len) {
+            vr_hpacket_pool_free(hpkt);
+            continue;
+        }
 
-    ret = read(hif->hif_fd, hpkt_data(hpkt), hpkt_size(hpkt));
-    if (ret > 0) {
-        hpkt->hp_tail += ret;
+        hpkt->hp_tail += burst->hb_msgs[i].msg_len;
         pkt = &hpkt->hp_packet;
-        pkt->vp_len = ret;
+        pkt->vp_len = burst->hb_msgs[i].msg_len;
         pkt->vp_tail = hpkt->hp_tail;
         pkt->vp_if = hif->hif_vif;
         vr_netif_rx(hif, hpkt);
-    } else {
-        vr_hpacket_pool_free(hpkt);
     }
 
+    /*
+     * dp-core has no burst receive entry point, and hence the burst is
+     * handed over one packet at a time. what it transmitted in the process
+     * goes out in one sendmmsg per interface
+     */
+    vr_hinterface_flush_all();
+
     return ret;
 }
 
 static unsigned int
 hif_udp_tx(struct vr_hinterface *hif, struct vr_hpacket *hpkt)
 {
-    int i = 0;
-    struct msghdr msg;
+    unsigned int i = 0;
+    struct vr_hif_burst *burst = hif->hif_tx_burst;
     struct vr_hpacket *hpkt_tmp = hpkt;
-    struct iovec msg_iov[64];
+    struct iovec *iov;
+    struct msghdr *msg;
 
-    bzero(&msg, sizeof(msg));
-    msg.msg_iov = msg_iov;
-    while (hpkt_tmp && i < 64) {
-        msg_iov[i].iov_base = hpkt_data(hpkt);
-        msg_iov[i].iov_len = hpkt->hp_packet.vp_len;
+    iov = burst->hb_iov[burst->hb_count];
+    while (hpkt_tmp && i < HIF_MAX_SEGMENTS) {
+        iov[i].iov_base = pkt_data(&hpkt_tmp->hp_packet);
+        iov[i].iov_len = pkt_head_len(&hpkt_tmp->hp_packet);
         i++;
         hpkt_tmp = hpkt_tmp->hp_next;
     }
 
-    msg.msg_iovlen = i;
-    sendmsg(hif->hif_fd, &msg, 0);
-    vr_hpacket_free(hpkt);
+    msg = &burst->hb_msgs[burst->hb_count].msg_hdr;
+    bzero(msg, sizeof(*msg));
+    msg->msg_iov = iov;
+    msg->msg_iovlen = i;
+    burst->hb_pkts[burst->hb_count++] = hpkt;
+
+    if (burst->hb_count == HIF_BURST_SIZE)
+        hif_udp_flush(hif);
+
     return 0;
 }
 
@@ -136,27 +210,41 @@ vr_hif_udp_create(struct vr_hinterface *hif, unsigned int vif_type)
     if (ret < 0)
         goto cleanup;
 
-    hif_info->hif_num_ports++;
     hif->hif_vif_type = vif_type;
     hif->hif_fd = sock;
     hif->hif_tx = hif_udp_tx;
     hif->hif_rx = hif_udp_rx;
-    hif->hif_pkt_pool = vr_hpacket_pool_create(100, 2000);
-    if (!hif->hif_pkt_pool)
+    hif->hif_flush = hif_udp_flush;
+    hif->hif_rx_burst = calloc(1, sizeof(*hif->hif_rx_burst));
+    hif->hif_tx_burst = calloc(1, sizeof(*hif->hif_tx_burst));
+    hif->hif_pkt_pool = vr_hpacket_pool_create(HIF_PKT_POOL_SIZE,
+            HIF_PKT_SIZE);
+    if (!hif->hif_rx_burst || !hif->hif_tx_burst || !hif->hif_pkt_pool) {
+        ret = -ENOMEM;
         goto cleanup;
+    }
 
     ret = vr_host_io_register(hif->hif_fd, hif_udp_rx, hif);
     if (ret < 0)
         goto cleanup;
 
+    hif_info->hif_num_ports++;
+
     return 0;
 cleanup:
     if (sock >= 0)
         close(sock);
 
-    if (hif && hif->hif_pkt_pool) {
-        vr_hpacket_pool_destroy(hif->hif_pkt_pool);
-        hif->hif_pkt_pool = NULL;
+    if (hif) {
+        if (hif->hif_pkt_pool) {
+            vr_hpacket_pool_destroy(hif->hif_pkt_pool);
+            hif->hif_pkt_pool = NULL;
+        }
+
+        free(hif->hif_rx_burst);
+        hif->hif_rx_burst = NULL;
+        free(hif->hif_tx_burst);
+        hif->hif_tx_burst = NULL;
     }
 
     return ret;
@@ -168,11 +256,18 @@ vr_hif_udp_destroy(struct vr_hinterface *hif)
     struct hif_interface_md *hif_info;
 
     vr_host_io_unregister(hif->hif_fd);
+    hif_udp_flush(hif);
 
     hif_info = &hif_interface_info[hif->hif_vif_type];
     hif_info->hif_num_ports--;
 
     close(hif->hif_fd);
+    /*
+     * packets of the pool can still be queued in the datapath, and hence
+     * the pool is left behind as it always was
+     */
+    free(hif->hif_rx_burst);
+    free(hif->hif_tx_burst);
     free(hif);
 
     return;
@@ -269,6 +364,21 @@ vr_hinterface_put(struct vr_hinterface *hif)
     return;
 }
 
+void
+vr_hinterface_flush_all(void)
+{
+    unsigned int i;
+    struct vr_hinterface *hif;
+
+    for (i = 0; i < HIF_MAX_INTERFACES; i++) {
+        hif = hif_table[i];
+        if (hif && hif->hif_flush)
+            hif->hif_flush(hif);
+    }
+
+    return;
+}
+
 void
 vr_hinterface_delete(struct vr_hinterface *hif)
 {
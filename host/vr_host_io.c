@@ -20,6 +20,8 @@ unsigned int pollfd_to_cb[VR_MAX_IO_CBS];
 struct pollfd vr_io_pollfds[VR_MAX_IO_CBS];
 unsigned int vr_io_n_pollfds;
 
+extern void vr_hinterface_flush_all(void);
+
 void
 vhost_remove_xconnect(void)
 {
@@ -123,6 +125,10 @@ vr_host_io(void)
             if (++processed == ret)
                 break;
         }
+
+        /* send out what the callbacks left in the interface tx bursts */
+        vr_hinterface_flush_all();
+        processed = 0;
     }
 
     return 0;
@@ -87,7 +87,7 @@ vr_hpacket_alloc(unsigned int size)
     struct vr_hpacket_tail *hpkt_tail;
     struct vr_packet *pkt;
 
-    hpkt = (struct vr_hpacket *)malloc(sizeof(*hpkt));
+    hpkt = (struct vr_hpacket *)calloc(1, sizeof(*hpkt));
     if (!hpkt)
         return NULL;
 
@@ -136,13 +136,40 @@ struct vr_hpacket *
 vr_hpacket_pool_alloc(struct vr_hpacket_pool *pool)
 {
     struct vr_hpacket *hpkt;
+    struct vr_hpacket_tail *hpkt_tail;
     struct vr_packet *pkt;
 
     hpkt = pool->pool_head;
+    if (!hpkt) {
+        /*
+         * grow the pool instead of failing. the new packet stays with the
+         * pool once freed, and hence the pool settles at the high water
+         * mark of packets in flight
+         */
+        hpkt = vr_hpacket_alloc(pool->pool_psize);
+        if (!hpkt)
+            return NULL;
+
+        hpkt->hp_pool = pool;
+        pool->pool_size++;
+        return hpkt;
+    }
+
     pool->pool_head = hpkt->hp_next;
     hpkt->hp_next = NULL;
+    hpkt->hp_tail = hpkt->hp_data;
+    hpkt->hp_len = 0;
+    hpkt->hp_flags = 0;
+    hpkt_tail = (struct vr_hpacket_tail *)hpkt_end(hpkt);
+    hpkt_tail->hp_users = 1;
+
     pkt = &hpkt->hp_packet;
+    memset(pkt, 0, sizeof(*pkt));
+    pkt->vp_head = hpkt->hp_head;
     pkt->vp_data = hpkt->hp_data;
+    pkt->vp_tail = hpkt->hp_tail;
+    pkt->vp_end = hpkt->hp_end;
+
     return hpkt;
 }
 
@@ -154,6 +181,7 @@ vr_hpacket_pool_free(struct vr_hpacket *hpkt)
 
     hpkt->hp_next = pool->pool_head;
     pool->pool_head = hpkt;
+    hpkt->hp_tail = hpkt->hp_data;
     pkt = &hpkt->hp_packet;
     pkt->vp_data = hpkt->hp_data;
     pkt->vp_len = 0;
@@ -194,6 +222,8 @@ vr_hpacket_pool_create(unsigned int pool_size, unsigned int psize)
     if (!pool)
         goto cleanup;
 
+    pool->pool_psize = psize;
+
     for (i = 0; i < pool_size; i++) {
         hpkt = vr_hpacket_alloc(psize);
         if (!hpkt)
@@ -206,6 +236,7 @@ vr_hpacket_pool_create(unsigned int pool_size, unsigned int psize)
             pool->pool_head->hp_next = hpkt;
         }
         hpkt->hp_pool = pool;
+        pool->pool_size++;
     }
 
     return pool;
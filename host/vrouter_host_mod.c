@@ -12,6 +12,7 @@
 #include <sys/time.h>
 #include "vr_message.h"
 #include "vr_sandesh.h"
+#include "vr_stats.h"
 #include "host/vr_host_packet.h"
 #include "ulinux.h"
 
@@ -20,6 +21,7 @@ unsigned int vr_num_cpus = 1;
 
 static bool vr_host_inited = false;
 static unsigned int vr_message_proto;
+static struct vr_hpacket_pool *vr_lib_pkt_pool;
 
 extern void vr_diet_message_proto_exit(void);
 extern int vr_diet_message_proto_init(void);
@@ -117,12 +119,28 @@ vr_lib_get_packet(struct vr_hpacket *hpkt, struct vr_interface *vif)
     return pkt;
 }
 
+static struct vr_hpacket *
+vr_lib_hpacket_alloc(unsigned int size)
+{
+    if (size > VR_HPACKET_POOL_PSIZE)
+        return vr_hpacket_alloc(size);
+
+    if (!vr_lib_pkt_pool) {
+        vr_lib_pkt_pool = vr_hpacket_pool_create(VR_HPACKET_POOL_SIZE,
+                VR_HPACKET_POOL_PSIZE);
+        if (!vr_lib_pkt_pool)
+            return vr_hpacket_alloc(size);
+    }
+
+    return vr_hpacket_pool_alloc(vr_lib_pkt_pool);
+}
+
 static struct vr_packet *
 vr_lib_palloc(unsigned int size)
 {
     struct vr_hpacket *hpkt;
-    
-    hpkt = vr_hpacket_alloc(size);
+
+    hpkt = vr_lib_hpacket_alloc(size);
     if (!hpkt)
         return NULL;
 
@@ -134,7 +152,7 @@ vr_lib_palloc_head(struct vr_packet *pkt, unsigned int size)
 {
     struct vr_hpacket *hpkt_head, *hpkt;
 
-    hpkt_head = vr_hpacket_alloc(size);
+    hpkt_head = vr_lib_hpacket_alloc(size);
     if (!hpkt_head)
         return NULL;
 
@@ -179,6 +197,7 @@ vr_lib_pfree(struct vr_packet *pkt, unsigned short reason)
 
     /* Handle Vrouter statistics */
     pkt_drop_stats(pkt->vp_if, reason, pkt->vp_cpu);
+    VR_DROP_CAPTURE(pkt, reason);
 
     hpkt = VR_PACKET_TO_HPACKET(pkt);
     vr_hpacket_free(hpkt);
@@ -321,6 +340,11 @@ vrouter_host_exit(void)
     vr_message_exit();
     vrouter_exit(false);
 
+    if (vr_lib_pkt_pool) {
+        vr_hpacket_pool_destroy(vr_lib_pkt_pool);
+        vr_lib_pkt_pool = NULL;
+    }
+
     return;
 }
 
@@ -34,8 +34,18 @@
 
 #define HIF_TYPE_UDP                        1
 
+/*
+ * packets are received and transmitted in bursts of up to HIF_BURST_SIZE
+ * with one recvmmsg/sendmmsg, each of at most HIF_MAX_SEGMENTS buffers
+ */
+#define HIF_BURST_SIZE                      32
+#define HIF_MAX_SEGMENTS                    8
+#define HIF_PKT_POOL_SIZE                   256
+#define HIF_PKT_SIZE                        2048
+
 struct vr_hpacket;
 struct vr_hpacket_pool;
+struct vr_hif_burst;
 struct vr_interface;
 
 struct vr_hinterface {
@@ -48,6 +58,10 @@ struct vr_hinterface {
     struct vr_hpacket_pool *hif_pkt_pool;
     unsigned int (*hif_tx)(struct vr_hinterface *, struct vr_hpacket *);
     int (*hif_rx)(void *);
+    /* flushes the packets queued by hif_tx, if any */
+    void (*hif_flush)(struct vr_hinterface *);
+    struct vr_hif_burst *hif_rx_burst;
+    struct vr_hif_burst *hif_tx_burst;
 };
 
 struct vr_hinterface *hif_table[HIF_MAX_INTERFACES];
@@ -57,6 +71,7 @@ struct vr_hinterface *vr_hinterface_create(unsigned int, unsigned int,
 struct vr_hinterface *vr_hinterface_get(unsigned int);
 void vr_hinterface_put(struct vr_hinterface *);
 void vr_hinterface_delete(struct vr_hinterface *);
+void vr_hinterface_flush_all(void);
 
 
 
@@ -12,8 +12,20 @@
  */
 #define VR_HPACKET_HEAD_SPACE       64
 
+/*
+ * packets of up to VR_HPACKET_POOL_PSIZE bytes are allocated from a pool
+ * that starts with VR_HPACKET_POOL_SIZE packets and grows on demand, so
+ * that the steady state datapath does not malloc/free per packet
+ */
+#define VR_HPACKET_POOL_SIZE        1024
+#define VR_HPACKET_POOL_PSIZE       2048
+
 struct vr_hpacket_pool {
     struct vr_hpacket *pool_head;
+    /* size of the packets in the pool */
+    unsigned int pool_psize;
+    /* number of packets owned by the pool, free or in use */
+    unsigned int pool_size;
 };
 
 #define VR_HPACKET_FLAGS_CLONED     0x1
@@ -60,6 +72,13 @@ hpkt_end(struct vr_hpacket *hpkt)
     return hpkt->hp_head + hpkt->hp_end;
 }
 
+/* room for data between the head space and the end of the buffer */
+static inline unsigned short
+hpkt_room(struct vr_hpacket *hpkt)
+{
+    return hpkt->hp_end - hpkt->hp_data;
+}
+
 static inline unsigned short
 hpkt_len(struct vr_hpacket *hpkt)
 {
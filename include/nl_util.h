@@ -31,6 +31,9 @@ extern "C" {
 
 #define BRIDGE_TABLE_DEV            "/dev/vr_bridge"
 #define FLOW_TABLE_DEV              "/dev/flow"
+#define FLOW_EVENT_DEV              "/dev/flow_event"
+#define INET_FLOW_TABLE_DEV         "/dev/inet_flow"
+#define STATS_DEV                   "/dev/vr_stats"
 
 #ifdef _WIN32
 #define CLEAN_SCREEN_CMD        "cls"
@@ -111,6 +114,13 @@ struct nl_sandesh_callbacks {
     void (*vr_flow_table_data_process)(void *);
     void (*vr_bridge_table_data_process)(void *);
     void (*vr_hugepage_config_process)(void *);
+    void (*vr_lcore_stats_req_process)(void *);
+    void (*vr_flow_dirty_req_process)(void *);
+    void (*vr_flow_bulk_response_process)(void *);
+    void (*vr_flow_policy_req_process)(void *);
+    void (*vr_dp_latency_req_process)(void *);
+    void (*vr_pkt_trace_req_process)(void *);
+    void (*vr_drop_capture_req_process)(void *);
 };
 
 extern struct nl_sandesh_callbacks nl_cb;
@@ -192,6 +202,13 @@ extern struct nl_client *vr_get_nl_client(int);
 extern int vr_response_common_process(vr_response *, bool *);
 
 extern bool vr_table_map(int, unsigned int, char *, size_t, void **);
+struct vr_flow_event;
+struct vr_flow_event_ring;
+extern unsigned int vr_flow_event_ring_read(struct vr_flow_event_ring *,
+        uint64_t *, struct vr_flow_event *, unsigned int, uint64_t *);
+extern int vr_stats_shm_read(void *, unsigned int, unsigned int, int,
+        uint64_t *, unsigned int);
+extern void *vr_stats_shm_map(struct nl_client *);
 extern uint64_t vr_sum_drop_stats(vr_drop_stats_req *);
 extern void vr_drop_stats_req_destroy(vr_drop_stats_req *);
 extern vr_drop_stats_req *vr_drop_stats_req_get_copy(vr_drop_stats_req *);
@@ -210,6 +227,32 @@ extern void vr_interface_req_destroy(vr_interface_req *);
 
 extern int vr_send_mem_stats_get(struct nl_client *, unsigned intid);
 
+extern int vr_send_lcore_stats_get(struct nl_client *, unsigned int, int);
+extern int vr_send_lcore_stats_dump(struct nl_client *, unsigned int, int);
+
+extern int vr_send_flow_dirty_dump(struct nl_client *, unsigned int, int,
+        unsigned short);
+extern int vr_send_flow_policy_dump(struct nl_client *, unsigned int, int);
+
+extern int vr_send_dp_latency_set(struct nl_client *, unsigned int,
+        unsigned int);
+extern int vr_send_dp_latency_reset(struct nl_client *, unsigned int);
+extern int vr_send_dp_latency_get(struct nl_client *, unsigned int, int);
+extern int vr_send_dp_latency_dump(struct nl_client *, unsigned int, int);
+
+extern int vr_send_pkt_trace_arm(struct nl_client *, unsigned int, int, int,
+        uint8_t, uint8_t, uint16_t, uint16_t, uint8_t *, uint8_t *);
+extern int vr_send_pkt_trace_disarm(struct nl_client *, unsigned int);
+extern int vr_send_pkt_trace_reset(struct nl_client *, unsigned int);
+extern int vr_send_pkt_trace_get(struct nl_client *, unsigned int);
+extern int vr_send_pkt_trace_dump(struct nl_client *, unsigned int, int);
+
+extern int vr_send_drop_capture_set(struct nl_client *, unsigned int,
+        unsigned int, int);
+extern int vr_send_drop_capture_reset(struct nl_client *, unsigned int);
+extern int vr_send_drop_capture_get(struct nl_client *, unsigned int);
+extern int vr_send_drop_capture_dump(struct nl_client *, unsigned int, int);
+
 extern int vr_send_mirror_dump(struct nl_client *, unsigned int, int);
 extern int vr_send_mirror_get(struct nl_client *, unsigned int, unsigned int);
 extern int vr_send_mirror_delete(struct nl_client *,
@@ -145,6 +145,12 @@ extern unsigned vr_packet_sz;
 #define VR_DEF_MEMPOOL_SZ           (16 * 1024)
 /* How many objects (mbufs) to keep in per-lcore RSS mempool cache */
 #define VR_DPDK_RSS_MEMPOOL_CACHE_SZ    (VR_DPDK_RX_BURST_SZ*8)
+/* Create an RSS mempool on each NUMA socket with forwarding lcores */
+#define VR_DPDK_SOCKET_MEMPOOLS     true
+/* Move virtio RX queues to lcores on the socket of the VM memory */
+#define VR_DPDK_VIRTIO_NUMA_AFFINITY    true
+/* Interleave flow and bridge table memory across the online NUMA nodes */
+#define VR_DPDK_TABLE_MEM_INTERLEAVE    false
 /* Number of mbufs in FRAG_DIRECT mempool */
 #define VR_DPDK_FRAG_DIRECT_MEMPOOL_SZ     4096
 /* How many objects (mbufs) to keep in per-lcore FRAG_DIRECT mempool cache */
@@ -163,14 +169,27 @@ extern unsigned vr_packet_sz;
 #define VR_DPDK_TX_RING_SZ          (VR_DPDK_TX_BURST_SZ*32)
 /* RX ring minimum number of pointers to transfer (cache line / size of ptr) */
 #define VR_DPDK_RX_RING_CHUNK_SZ    1
-/* Number of mbufs in lcore RX ring (we retry in case enqueue fails) */
+/* Number of mbufs in lcore RX ring (we stage packets in case enqueue fails) */
 #define VR_DPDK_RX_RING_SZ          1024
-/* Number of retries to enqueue packets */
-#define VR_DPDK_RETRY_NUM           1
-/* Delay between retries */
-#define VR_DPDK_RETRY_US            15
+/* Flush a distribution staging buffer once it has that many packets */
+#define VR_DPDK_DIST_FLUSH_SZ       (VR_DPDK_RX_BURST_SZ/2)
+/* Flush a distribution staging buffer after that many RX loops */
+#define VR_DPDK_DIST_FLUSH_LOOPS    4
+/* Bias distribution away from the congested forwarding lcores */
+#define VR_DPDK_DIST_CONGESTION_BIAS    true
+/* Lcore RX ring is congested above ON and until below OFF number of mbufs */
+#define VR_DPDK_DIST_CONGESTION_ON  (VR_DPDK_RX_RING_SZ*7/8)
+#define VR_DPDK_DIST_CONGESTION_OFF (VR_DPDK_RX_RING_SZ/2)
+/* Recheck the congested lcore RX rings after that many RX loops */
+#define VR_DPDK_DIST_CONGESTION_LOOPS   16
 /* Use timer to measure flushes (slower, but should improve latency) */
 #define VR_DPDK_USE_TIMER           false
+/* Collect per-lcore cycle and poll efficiency statistics (uses TSC) */
+#define VR_DPDK_LCORE_STATS         true
+/* Classify outer headers of fabric RX bursts with SSE before RSS emulation */
+#define VR_DPDK_RSS_VECTOR_CLASSIFY true
+/* Number of burst size histogram buckets: log2(VR_DPDK_RX_BURST_SZ) + 1 */
+#define VR_DPDK_BURST_HIST_SZ       6
 /* TX flush timeout (in loops or US if USE_TIMER defined) */
 #define VR_DPDK_TX_FLUSH_LOOPS      16
 /* TX idle timeout - if packets are not sent to a VM for this many
@@ -381,6 +400,8 @@ enum vr_dpdk_lcore_cmd {
     VR_DPDK_LCORE_TX_QUEUE_SET_CMD,
     /* RX queue disable/enable command */
     VR_DPDK_LCORE_RX_QUEUE_SET_CMD,
+    /* Move virtio RX queues to the lcores on a given NUMA socket */
+    VR_DPDK_LCORE_RX_QUEUE_NUMA_CMD,
 };
 
 struct gro_ctrl {
@@ -395,12 +416,58 @@ struct gro_ctrl {
     struct rte_hash *gro_tbl_v6_handle;
 };
 
+/* Forwarding loop stages accounted in lcore statistics */
+enum vr_dpdk_lcore_stage {
+    /* RX bursts and software RSS hashing */
+    VR_DPDK_LCORE_STAGE_RX,
+    /* Passing packets to other lcores */
+    VR_DPDK_LCORE_STAGE_DISTRIBUTE,
+    /* dp-core processing */
+    VR_DPDK_LCORE_STAGE_VROUTE,
+    /* Pushing TX rings and flushing TX queues */
+    VR_DPDK_LCORE_STAGE_TX_PUSH,
+    VR_DPDK_LCORE_STAGE_MAX
+};
+
+/*
+ * Per-lcore cycle and poll efficiency counters. Written by the owning
+ * lcore only and read by the NetLink lcore, so no locking is required.
+ */
+struct vr_dpdk_lcore_stats {
+    /* TSC cycles spent in loops which received at least one packet */
+    uint64_t lcs_busy_cycles;
+    /* TSC cycles spent in loops which received no packets */
+    uint64_t lcs_idle_cycles;
+    /* Number of loops */
+    uint64_t lcs_loops;
+    /* Number of RX bursts returned at least one packet */
+    uint64_t lcs_polls;
+    /* Number of RX bursts returned no packets */
+    uint64_t lcs_empty_polls;
+    /* Number of packets received from RX queues */
+    uint64_t lcs_packets;
+    /* Histogram of non-empty RX burst sizes (log2 buckets) */
+    uint64_t lcs_burst_hist[VR_DPDK_BURST_HIST_SZ];
+    /* TSC cycles spent per forwarding loop stage */
+    uint64_t lcs_stage_cycles[VR_DPDK_LCORE_STAGE_MAX];
+};
+
 struct vr_dpdk_lcore_rx_queue_remove_arg {
     unsigned int vif_id;
     bool clear_f_rx;
     bool free_arg;
 };
 
+/* Per destination lcore distribution staging buffer */
+struct vr_dpdk_dist_stage {
+    /* Number of RX loops the packets have been staged for */
+    uint16_t ds_age;
+    /* Destination lcore RX ring is congested */
+    bool ds_congested;
+    /* Burst header (see vr_dpdk_lcore.h) followed by the staged mbufs */
+    struct rte_mbuf *ds_pkts[VR_DPDK_RX_BURST_SZ + VR_DPDK_RX_RING_CHUNK_SZ];
+};
+
 struct vr_dpdk_lcore {
     /**********************************************************************/
     /* Frequently used fields */
@@ -428,6 +495,14 @@ struct vr_dpdk_lcore {
     bool do_fragment_assembly;
     /* GRO ctrl structure */
     struct gro_ctrl gro;
+    /* Some packets are staged to be distributed to other lcores */
+    bool lcore_dist_pending;
+    /* Some destination lcore RX rings are congested */
+    bool lcore_dist_congested;
+    /* Number of RX loops since the congested rings were checked */
+    uint16_t lcore_dist_loops;
+    /* Cycle and poll efficiency statistics */
+    struct vr_dpdk_lcore_stats lcore_stats __rte_cache_aligned;
 
     /**********************************************************************/
     /* Big and less frequently used fields */
@@ -435,6 +510,8 @@ struct vr_dpdk_lcore {
     uint16_t lcore_nb_dst_lcores;
     /* List of forwarding lcore indexes based on VR_DPDK_FWD_LCORE_ID */
     uint16_t lcore_dst_lcore_idxs[VR_MAX_CPUS];
+    /* Staging buffers indexed as lcore_dst_lcore_idxs */
+    struct vr_dpdk_dist_stage lcore_dist_stages[VR_MAX_CPUS] __rte_cache_aligned;
     /* Table of RX queues */
     struct vr_dpdk_queue lcore_rx_queues[VR_MAX_INTERFACES];
     /* Table of TX queues */
@@ -528,6 +605,8 @@ struct vr_dpdk_global {
     /* Frequently used fields */
     /* Pointer to main (RSS) memory pool */
     struct rte_mempool *rss_mempool;
+    /* Per NUMA socket RSS memory pools (point to rss_mempool by default) */
+    struct rte_mempool *socket_mempools[RTE_MAX_NUMA_NODES];
     /* Packet socket ring */
     struct rte_ring *packet_ring;
     /* Global stop flag */
@@ -562,6 +641,8 @@ struct vr_dpdk_global {
     void *netlink_sock;
     void *flow_table;
     void *bridge_table;
+    void *flow_event_table;
+    void *stats_table;
     /* Packet socket */
     void *packet_transport;
     /* Interface configuration mutex
@@ -715,6 +796,7 @@ int vr_dpdk_table_mem_init(unsigned int, unsigned int, unsigned long,
         unsigned int, unsigned long);
 int vr_dpdk_flow_init(void);
 int vr_dpdk_bridge_init(void);
+int vr_dpdk_stats_shm_init(void);
 
 /*
  * vr_dpdk_host.c
@@ -839,6 +921,9 @@ int vr_dpdk_lcore_mpls_schedule(struct vr_interface *vif, unsigned dst_ip,
     unsigned mpls_label);
 /* Returns the least used lcore or VR_MAX_CPUS */
 unsigned vr_dpdk_lcore_least_used_get(void);
+/* Returns the least used lcore on a given socket or VR_MAX_CPUS */
+unsigned vr_dpdk_lcore_least_used_socket_get(unsigned socket_id,
+    unsigned vif_idx);
 /* Flush TX queues */
 static inline void
 vr_dpdk_lcore_flush(struct vr_dpdk_lcore *lcore)
@@ -874,6 +959,8 @@ void vr_dpdk_lcore_cmd_post_all(uint16_t cmd, uint64_t cmd_arg);
 void vr_dpdk_lcore_schedule_assembler_work(struct vr_dpdk_lcore *lcore,
         void (*fun)(void *arg), void *arg);
 void dpdk_lcore_exit(unsigned lcore_id);
+/* Get lcore cycle and poll efficiency statistics */
+int vr_dpdk_lcore_stats_get(unsigned lcore_id, vr_lcore_stats_req *resp);
 /*
  * vr_dpdk_netlink.c
  */
@@ -26,6 +26,11 @@ typedef enum {
 
 #define VR_FLOW_RESP_FLAG_DELETED       0x0001
 
+/* vr_flow_req operation flags */
+#define VR_FLOW_OP_FLAG_PAIR            0x0001
+/* set the new flow up in the IPv4 flow table */
+#define VR_FLOW_OP_FLAG_INET            0x0002
+
 #define VR_FLOW_FLAG_ACTIVE             0x0001
 #define VR_FLOW_FLAG_MODIFIED           0x0100
 #define VR_FLOW_FLAG_NEW_FLOW           0x0200
@@ -233,6 +238,12 @@ struct vr_flow_table_info {
     uint64_t vfti_changed;
     uint64_t vfti_action_count;
     uint64_t vfti_added;
+    uint64_t vfti_reclaimed;
+    /* packets sitting in the hold queues, and the ones they dropped */
+    uint64_t vfti_queued;
+    uint64_t vfti_queue_drops;
+    /* hold queue packet nodes taken from vr_flow_queue_budget */
+    uint32_t vfti_queue_budget_used;
     uint32_t vfti_oflows;
     uint32_t vfti_burst_step_configured;
     uint32_t vfti_burst_interval_configured;
@@ -256,6 +267,16 @@ struct vr_flow_stats {
 } __attribute__packed__close__;
 
 #define VR_MAX_FLOW_QUEUE_ENTRIES   3U
+/*
+ * The hold queue depth is configurable up to VR_FLOW_QUEUE_MAX_DEPTH. The
+ * packet nodes beyond the inline VR_MAX_FLOW_QUEUE_ENTRIES ones are taken
+ * from a budget shared by all the hold queues, and a queue that finds the
+ * budget exhausted falls back to the inline nodes.
+ */
+#define VR_FLOW_QUEUE_MAX_DEPTH     256U
+#define VR_DEF_FLOW_QUEUE_BUDGET    (64 * 1024)
+/* freed hold queues kept per cpu for reuse */
+#define VR_FLOW_QUEUE_CACHE_SIZE    16
 
 #define PN_FLAG_LABEL_IS_VXLAN_ID   0x1
 #define PN_FLAG_TO_ME               0x2
@@ -279,9 +300,25 @@ struct vr_packet_node {
 struct vr_flow_queue {
     unsigned int vfq_index;
     unsigned int vfq_entries;
+    /* packet nodes in the queue, the inline ones included */
+    unsigned int vfq_depth;
     struct vr_packet_node vfq_pnodes[VR_MAX_FLOW_QUEUE_ENTRIES];
+    struct vr_packet_node vfq_ext_pnodes[0];
+};
+
+struct vr_flow_queue_cache {
+    struct vr_flow_queue *vfqc_queues[VR_FLOW_QUEUE_CACHE_SIZE];
 };
 
+static inline struct vr_packet_node *
+vr_flow_queue_pnode(struct vr_flow_queue *vfq, unsigned int i)
+{
+    if (i < VR_MAX_FLOW_QUEUE_ENTRIES)
+        return &vfq->vfq_pnodes[i];
+
+    return &vfq->vfq_ext_pnodes[i - VR_MAX_FLOW_QUEUE_ENTRIES];
+}
+
 /*
  * Flow eviction:
  * 1. Requirement
@@ -359,6 +396,7 @@ struct vr_dummy_flow_entry {
     uint8_t fe_type;
     unsigned short fe_udp_src_port;
     uint32_t fe_src_info;
+    uint32_t fe_used_clock;
 } __attribute__packed__close__;
 
 #define VR_FLOW_ENTRY_PACK (128 - sizeof(struct vr_dummy_flow_entry))
@@ -394,9 +432,39 @@ struct vr_flow_entry {
      * component NH as this source
      */
     uint32_t fe_src_info;
+    /* flow clock tick (seconds) of the last packet, for idle reclaim */
+    uint32_t fe_used_clock;
     unsigned char fe_pack[VR_FLOW_ENTRY_PACK];
 } __attribute__packed__close__;
 
+/*
+ * IPv4 flow table. Entries of one cache line, for the IPv4 flows that need
+ * no more than a forward or drop action, the source nexthop and a reverse
+ * flow: the flows the flow policy cache sets up, and the ones the agent
+ * sets with VR_FLOW_OP_FLAG_INET. The rest of the flows, and all of them
+ * without the table, live in the flow table.
+ *
+ * Both tables share one flow index space. The entry at index i of the IPv4
+ * table has the flow index vr_inet_flow_base + i, the first index past
+ * the ones the flow table can grow to, so that the agent requests, the
+ * flow events and the dirty bitmap carry flow indices of either table.
+ * The table is mapped through its own memory device object.
+ *
+ * do not change. any field positions as it might lead to incompatibility
+ */
+__attribute__packed__open__
+struct vr_inet_flow_entry {
+    vr_hentry_t ife_hentry;
+    struct vr_inet_flow ife_key;
+    uint8_t ife_gen_id;
+    uint8_t ife_action;
+    unsigned short ife_flags;
+    int ife_rflow;
+    unsigned short ife_vrf;
+    uint16_t ife_src_nh_index;
+    struct vr_flow_stats ife_stats;
+} __attribute__packed__close__;
+
 #define VR_FLOW_PROTO_SHIFT             16
 
 #define VR_UDP_DHCP_SPORT   (17 << 16 | htons(67))
@@ -412,10 +480,67 @@ struct vr_flow_entry {
 #define VR_DEF_FLOW_ENTRIES   (512 * 1024)
 
 extern unsigned int vr_flow_entries, vr_oflow_entries;
+extern unsigned int vr_inet_flow_entries;
 
 #define VR_FLOW_TABLE_SIZE   (vr_flow_entries * sizeof(struct vr_flow_entry))
 #define VR_OFLOW_TABLE_SIZE  (vr_oflow_entries * sizeof(struct vr_flow_entry))
 
+/*
+ * Once the table is this full (in percent), allocating a flow from the
+ * overflow table reclaims the least recently used idle flow of the bucket.
+ * Failing to allocate reclaims one irrespective of the occupancy.
+ */
+#define VR_FLOW_RECLAIM_WATERMARK   90
+/* seconds without a packet, in either direction, to be considered idle */
+#define VR_FLOW_RECLAIM_IDLE_SECS   30
+
+/* return the dirty flow entries without clearing them */
+#define VR_FLOW_DIRTY_FLAG_PEEK     0x1
+
+/*
+ * The flow policy cache lets the datapath set up flows that match one of
+ * the rules the agent programmed, instead of holding them and trapping the
+ * first packet to the agent. The rules are evaluated in the index order
+ * and the first match wins. Negative vrf and vif, and zero protocol, match
+ * any value.
+ *
+ * A new flow is matched only against the rules of its vrf bucket, those of
+ * a vrf hashing to the bucket and those of any vrf, and against at most
+ * VR_FLOW_POLICY_MAX_SCAN of them. A flow none of these match is held and
+ * trapped to the agent, as it is without the cache.
+ */
+#define VR_FLOW_POLICY_MAX_RULES    1024
+#define VR_FLOW_POLICY_BUCKETS      64
+#define VR_FLOW_POLICY_MAX_SCAN     64
+
+struct vr_flow_policy {
+    int fp_vrf;
+    int fp_vif;
+    uint8_t fp_family;
+    uint8_t fp_proto;
+    uint8_t fp_src_plen;
+    uint8_t fp_dst_plen;
+    uint16_t fp_sport_lo;
+    uint16_t fp_sport_hi;
+    uint16_t fp_dport_lo;
+    uint16_t fp_dport_hi;
+    unsigned short fp_action;
+    unsigned int fp_src_nh_index;
+    uint8_t fp_src[VR_IP6_ADDRESS_LEN];
+    uint8_t fp_dst[VR_IP6_ADDRESS_LEN];
+    uint64_t fp_hits;
+};
+
+/*
+ * The rules of bucket b, in the index order, are fpi_rule[fpi_start[b]]
+ * up to fpi_rule[fpi_start[b + 1]]. Replaced as a whole on every change
+ * of the rules.
+ */
+struct vr_flow_policy_index {
+    unsigned int fpi_start[VR_FLOW_POLICY_BUCKETS + 1];
+    unsigned short fpi_rule[];
+};
+
 struct vr_flow_md {
     struct vrouter *flmd_router;
     struct vr_defer_data *flmd_defer_data;
@@ -444,18 +569,26 @@ struct vr_ip6;
 extern int vr_flow_init(struct vrouter *);
 extern int vr_flow_mem(struct vrouter *);
 extern void vr_flow_exit(struct vrouter *, bool);
+extern void vr_flow_bulk_end(void);
 
 extern bool vr_flow_forward(struct vrouter *,
         struct vr_packet *, struct vr_forwarding_md *);
 
 void *vr_flow_get_va(struct vrouter *, uint64_t);
+void *vr_flow_event_get_va(struct vrouter *, uint64_t);
+void *vr_inet_flow_get_va(struct vrouter *, uint64_t);
 
 unsigned int vr_flow_table_size(struct vrouter *);
+unsigned int vr_flow_event_table_size(struct vrouter *);
+unsigned int vr_inet_flow_table_size(struct vrouter *);
 
 struct vr_flow_entry *vr_flow_get_entry(struct vrouter *, int);
 flow_result_t vr_flow_lookup(struct vrouter *, struct vr_flow *,
                              struct vr_packet *, struct vr_forwarding_md *);
 
+flow_result_t vr_inet_flow_table_lookup(struct vrouter *, struct vr_flow *,
+                             struct vr_packet *, struct vr_forwarding_md *);
+
 flow_result_t vr_inet_flow_lookup(struct vrouter *, struct vr_packet *,
                                   struct vr_forwarding_md *);
 flow_result_t vr_inet6_flow_lookup(struct vrouter *, struct vr_packet *,
@@ -489,6 +622,9 @@ extern unsigned int vr_reinject_packet(struct vr_packet *,
         struct vr_forwarding_md *);
 extern void vr_flow_set_burst_params(struct vrouter *,int,int,int);
 extern void vr_flow_get_burst_params(struct vrouter *,int *,int *,int *);
+extern struct vr_flow_policy *vr_flow_policy_match(struct vrouter *,
+        struct vr_flow *, struct vr_packet *, struct vr_forwarding_md *,
+        unsigned int *);
 
 
 bool vr_valid_link_local_port(struct vrouter *, int, int, int);
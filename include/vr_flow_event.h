@@ -0,0 +1,70 @@
+/*
+ * vr_flow_event.h -- per-cpu flow event rings shared with the agent
+ *
+ * Copyright (c) 2016 Juniper Networks, Inc. All rights reserved.
+ */
+#ifndef __VR_FLOW_EVENT_H__
+#define __VR_FLOW_EVENT_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * The datapath posts compact events about flow state changes to a ring
+ * per cpu. The rings are mapped read-only by the agent the same way as the
+ * flow table is, so the producer never waits for the consumer. Instead,
+ * each event carries its sequence number and a consumer that fell behind
+ * by more than a ring worth of events detects the loss and has to fall
+ * back to scanning the flow table.
+ */
+#define VR_FLOW_EVENT_RING_SIZE     (64 * 1024)
+
+enum vr_flow_event_type {
+    VR_FLOW_EVENT_NONE,
+    /* new flow entry is created in hold state */
+    VR_FLOW_EVENT_HOLD,
+    /* TCP session is closed, flow is marked as eviction candidate */
+    VR_FLOW_EVENT_EVICT_CANDIDATE,
+    /* flow entry is evicted */
+    VR_FLOW_EVENT_EVICTED,
+    /* flow packet or byte counter wrapped around */
+    VR_FLOW_EVENT_STATS_OFLOW,
+    /* new flow entry is set up by a flow policy cache rule (in fev_data) */
+    VR_FLOW_EVENT_POLICY,
+    VR_FLOW_EVENT_MAX,
+};
+
+struct vr_flow_event {
+    /* sequence number of the event + 1, zero while being written */
+    uint32_t fev_seq;
+    uint32_t fev_index;
+    uint8_t fev_type;
+    uint8_t fev_gen_id;
+    uint16_t fev_flags;
+    /* type specific data: TCP flags, overflow counters */
+    uint32_t fev_data;
+};
+
+struct vr_flow_event_ring_hdr {
+    /* number of events ever posted to the ring */
+    uint64_t ferh_head;
+    uint32_t ferh_entries;
+    uint32_t ferh_cpu;
+    uint8_t ferh_pad[48];
+};
+
+#define VR_FLOW_EVENT_RING_ENTRIES                                      \
+    ((VR_FLOW_EVENT_RING_SIZE - sizeof(struct vr_flow_event_ring_hdr))  \
+     / sizeof(struct vr_flow_event))
+
+struct vr_flow_event_ring {
+    struct vr_flow_event_ring_hdr fer_hdr;
+    struct vr_flow_event fer_events[VR_FLOW_EVENT_RING_ENTRIES];
+};
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __VR_FLOW_EVENT_H__ */
@@ -195,4 +195,89 @@ static inline uint32_t vr_hash_1word(uint32_t a, uint32_t initval)
     return vr_hash_3words(a, 0, 0, initval);
 }
 
+/*
+ * CRC32C hash backend.
+ *
+ * The SSE4.2 crc32 instruction operates on general purpose registers only,
+ * so unlike the vector instructions it is safe to use in the kernel as well.
+ * The instruction is emitted with inline assembly, so no special compiler
+ * flags are needed, but it must only be used if the CPU supports SSE4.2
+ * (see vr_hash_crc32c_enabled).
+ */
+#if defined(__GNUC__) && defined(__x86_64__)
+#define VR_HASH_CRC32C_ARCH
+
+static inline uint32_t __vr_crc32c_u64(uint32_t crc, uint64_t v)
+{
+    uint64_t c = crc;
+
+    __asm__ ("crc32q %1, %0" : "+r" (c) : "rm" (v));
+    return (uint32_t)c;
+}
+
+static inline uint32_t __vr_crc32c_u32(uint32_t crc, uint32_t v)
+{
+    __asm__ ("crc32l %1, %0" : "+r" (crc) : "rm" (v));
+    return crc;
+}
+
+static inline uint32_t __vr_crc32c_u8(uint32_t crc, uint8_t v)
+{
+    __asm__ ("crc32b %1, %0" : "+r" (crc) : "rm" (v));
+    return crc;
+}
+
+/* vr_hash_crc32c - hash an arbitrary key with the crc32 instruction
+ * @k: sequence of bytes as key
+ * @length: the length of the key
+ * @initval: the previous hash, or an arbitray value
+ *
+ * Returns the hash value of the key.
+ */
+static inline uint32_t vr_hash_crc32c(const void *key, uint32_t length,
+        uint32_t initval)
+{
+    const uint8_t *k = key;
+    uint32_t crc = VR_HASH_INITVAL + length + initval;
+    uint64_t v64;
+    uint32_t v32;
+
+    while (length >= 8) {
+        __builtin_memcpy(&v64, k, sizeof(v64));
+        crc = __vr_crc32c_u64(crc, v64);
+        length -= 8;
+        k += 8;
+    }
+    if (length >= 4) {
+        __builtin_memcpy(&v32, k, sizeof(v32));
+        crc = __vr_crc32c_u32(crc, v32);
+        length -= 4;
+        k += 4;
+    }
+    while (length--)
+        crc = __vr_crc32c_u8(crc, *k++);
+
+    return crc;
+}
+#endif /* __GNUC__ && __x86_64__ */
+
+/* vr_hash_key - hash a key with the selected hash backend
+ * @crc32c: use CRC32C backend, i.e. vr_hash_crc32c_enabled at the time
+ *          the table was created
+ * @k: sequence of bytes as key
+ * @length: the length of the key
+ * @initval: the previous hash, or an arbitray value
+ *
+ * Returns the hash value of the key.
+ */
+static inline uint32_t vr_hash_key(bool crc32c, const void *key,
+        uint32_t length, uint32_t initval)
+{
+#ifdef VR_HASH_CRC32C_ARCH
+    if (crc32c)
+        return vr_hash_crc32c(key, length, initval);
+#endif
+    return vr_hash(key, length, initval);
+}
+
 #endif /* _VR_HASH_H */
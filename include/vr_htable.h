@@ -8,6 +8,8 @@
 #include "vr_os.h"
 
 #define VR_INVALID_HENTRY_INDEX ((unsigned int)-1)
+/* overflow segments a table can have, including the one it is created with */
+#define VR_HTABLE_MAX_OTABLES   8
 
 struct vrouter;
 
@@ -45,9 +47,13 @@ vr_hentry_t *vr_htable_find_free_hentry(vr_htable_t , void *, unsigned int );
 int vr_htable_trav_range(vr_htable_t, unsigned int, unsigned int,
         htable_trav_cb , void *);
 void vr_htable_trav(vr_htable_t, unsigned int , htable_trav_cb , void *);
+void vr_htable_trav_bucket(vr_htable_t, void *, unsigned int,
+        htable_trav_cb, void *);
 void vr_htable_reset(vr_htable_t, htable_trav_cb , void *);
 void vr_htable_release_hentry(vr_htable_t, vr_hentry_t *);
 unsigned int vr_htable_size(vr_htable_t);
+unsigned int vr_htable_entries(vr_htable_t);
+int vr_htable_grow(vr_htable_t);
 void *vr_htable_get_address(vr_htable_t, uint64_t);
 
 #endif
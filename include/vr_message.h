@@ -36,6 +36,13 @@
 #define VR_FLOW_RESPONSE_OBJECT_ID      17
 #define VR_BRIDGE_TABLE_DATA_OBJECT_ID  18
 #define VR_HPAGE_CFG_OBJECT_ID          19
+#define VR_LCORE_STATS_OBJECT_ID        20
+#define VR_FLOW_DIRTY_OBJECT_ID         21
+#define VR_FLOW_BULK_RESPONSE_OBJECT_ID 22
+#define VR_FLOW_POLICY_OBJECT_ID        23
+#define VR_DP_LATENCY_OBJECT_ID         24
+#define VR_PKT_TRACE_OBJECT_ID          25
+#define VR_DROP_CAPTURE_OBJECT_ID       26
 
 #define VR_MESSAGE_PAGE_SIZE            (4096 - 128)
 
@@ -101,6 +108,9 @@ int vr_message_multi_response(struct vr_message_multi *);
 int vr_message_make_request(unsigned int, void *);
 int vr_message_process_response(int (*)(void *, unsigned int, void *), void *);
 int vr_message_dump_object(void *, unsigned int, void *);
+int vr_message_dump_pcpu(void *, unsigned int, int, unsigned int,
+        int (*)(void *, unsigned int, unsigned int, unsigned int, void *),
+        void *, void *);
 void *vr_mtrans_alloc(unsigned int);
 void vr_mtrans_free(void *);
 
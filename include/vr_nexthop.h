@@ -69,6 +69,7 @@ enum nexthop_type {
 #define NH_FLAG_ETREE_ROOT                  0x200000
 #define NH_FLAG_INDIRECT                    0x400000
 #define NH_FLAG_L2_CONTROL_DATA             0x800000
+#define NH_FLAG_COUNTERS                    0x1000000
 
 #define NH_SOURCE_INVALID                   0
 #define NH_SOURCE_VALID                     1
@@ -93,6 +94,21 @@ struct vr_component_nh {
     struct vr_nexthop *cnh;
 };
 
+/*
+ * Packet and byte counters of a nexthop with NH_FLAG_COUNTERS. Every cpu
+ * has its own row of nh_stats_stride entries, padded to a cache line. The
+ * first entry of a row counts the packets the nexthop handled, and for a
+ * composite nexthop, entry i + 1 counts the packets sent to component i.
+ * The allocator does not align to a cache line, so the rows are carved out
+ * of nh_stats_mem at the first aligned address.
+ */
+#define NH_STATS_ROW_ALIGN                  64
+
+struct vr_nexthop_stats {
+    uint64_t nhs_packets;
+    uint64_t nhs_bytes;
+};
+
 typedef enum {
     NH_PROCESSING_COMPLETE,
     NH_PROCESSING_INCOMPLETE,
@@ -164,6 +180,10 @@ struct vr_nexthop {
                                        struct vr_nexthop *,
                                        struct vr_forwarding_md *);
     struct vr_interface *nh_dev;
+    struct vr_nexthop_stats *nh_stats;
+    void                *nh_stats_mem;
+    unsigned short      nh_stats_slots;
+    unsigned short      nh_stats_stride;
     void                (*nh_destructor)(struct vr_nexthop *);
     uint8_t             nh_data[0];
 };
@@ -24,6 +24,7 @@
 #define vr_sync_fetch_and_add_32u(a, b)                 __sync_fetch_and_add((a), (b))
 #define vr_sync_fetch_and_add_64u(a, b)                 __sync_fetch_and_add((a), (b))
 #define vr_sync_fetch_and_or_16u(a, b)                  __sync_fetch_and_or((a), (b))
+#define vr_sync_fetch_and_or_64u(a, b)                  __sync_fetch_and_or((a), (b))
 #define vr_sync_and_and_fetch_16u(a, b)                 __sync_and_and_fetch((a), (b))
 #define vr_sync_and_and_fetch_32u(a, b)                 __sync_and_and_fetch((a), (b))
 #define vr_sync_bool_compare_and_swap_8s(a, b, c)       __sync_bool_compare_and_swap((a), (b), (c))
@@ -33,6 +34,7 @@
 #define vr_sync_bool_compare_and_swap_p(a, b, c)        __sync_bool_compare_and_swap((a), (b), (c))
 #define vr_sync_val_compare_and_swap_16u(a, b, c)       __sync_val_compare_and_swap((a), (b), (c))
 #define vr_sync_lock_test_and_set_8u(a, b)              __sync_lock_test_and_set((a), (b))
+#define vr_sync_lock_test_and_set_64u(a, b)             __sync_lock_test_and_set((a), (b))
 #define vr_sync_synchronize                             __sync_synchronize
 #define vr_ffs_32(a)                                    __builtin_ffs(a)
 #endif
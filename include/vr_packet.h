@@ -82,6 +82,10 @@
 /* Diagnostic packet */
 #define VP_FLAG_DIAG            (1 << 8)
 #define VP_FLAG_GROED           (1 << 9)
+/* sampled for the per stage datapath latency (vr_stats.h) */
+#define VP_FLAG_DP_LAT          (1 << 10)
+/* traced through the datapath (vr_trace.h) */
+#define VP_FLAG_TRACE           (1 << 11)
 
 /*
  * possible 256 values of what a packet can be. currently, this value is
@@ -1009,6 +1013,8 @@ enum {
 #define FMD_FLAG_ETREE_ENABLE           0x04
 #define FMD_FLAG_ETREE_ROOT             0x08
 #define FMD_FLAG_L2_CONTROL_DATA        0x10
+/* the traced packet is yet to match the 5-tuple filter */
+#define FMD_FLAG_TRACE_PENDING          0x20
 
 /*
  * 16 bits of fmd_mirror_data constitutes the below
@@ -1037,6 +1043,11 @@ struct vr_forwarding_md {
     int8_t fmd_queue;
     int8_t fmd_dmac[VR_ETHER_ALEN];
     int8_t fmd_smac[VR_ETHER_ALEN];
+    /* cycle counter at RX and at the last stage of a VP_FLAG_DP_LAT packet */
+    uint64_t fmd_lat_start;
+    uint64_t fmd_lat_last;
+    /* trace id of a VP_FLAG_TRACE packet */
+    uint32_t fmd_trace_id;
 };
 
 static inline void
@@ -1058,6 +1069,8 @@ vr_init_forwarding_md(struct vr_forwarding_md *fmd)
     fmd->fmd_dotonep = -1;
     VR_MAC_RESET(fmd->fmd_dmac);
     VR_MAC_RESET(fmd->fmd_smac);
+    fmd->fmd_lat_start = 0;
+    fmd->fmd_trace_id = 0;
 
     return;
 }
@@ -1447,4 +1460,127 @@ pkt_drop_stats(struct vr_interface *vif, unsigned short reason, int cpu)
     return;
 }
 
+/* the name of a drop reason, as dropstats prints it */
+static inline const char *
+vr_drop_reason_name(unsigned int reason)
+{
+    static const char *names[VP_DROP_MAX] = {
+        [VP_DROP_DISCARD]                   = "Discards",
+        [VP_DROP_PULL]                      = "Pull Fails",
+        [VP_DROP_INVALID_IF]                = "Invalid IF",
+        [VP_DROP_INVALID_ARP]               = "Invalid ARP",
+        [VP_DROP_TRAP_NO_IF]                = "Trap No IF",
+        [VP_DROP_NOWHERE_TO_GO]             = "Nowhere to go",
+        [VP_DROP_FLOW_QUEUE_LIMIT_EXCEEDED] = "Flow Queue Limit Exceeded",
+        [VP_DROP_FLOW_NO_MEMORY]            = "Flow No Memory",
+        [VP_DROP_FLOW_INVALID_PROTOCOL]     = "Flow Invalid Protocol",
+        [VP_DROP_FLOW_NAT_NO_RFLOW]         = "Flow NAT no rflow",
+        [VP_DROP_FLOW_ACTION_DROP]          = "Flow Action Drop",
+        [VP_DROP_FLOW_ACTION_INVALID]       = "Flow Action Invalid",
+        [VP_DROP_FLOW_UNUSABLE]             = "Flow Unusable",
+        [VP_DROP_FLOW_TABLE_FULL]           = "Flow Table Full",
+        [VP_DROP_INTERFACE_TX_DISCARD]      = "IF TX Discard",
+        [VP_DROP_INTERFACE_DROP]            = "IF Drop",
+        [VP_DROP_DUPLICATED]                = "Duplicated",
+        [VP_DROP_PUSH]                      = "Push Fails",
+        [VP_DROP_TTL_EXCEEDED]              = "TTL Exceeded",
+        [VP_DROP_INVALID_NH]                = "Invalid NH",
+        [VP_DROP_INVALID_LABEL]             = "Invalid Label",
+        [VP_DROP_INVALID_PROTOCOL]          = "Invalid Protocol",
+        [VP_DROP_INTERFACE_RX_DISCARD]      = "IF RX Discard",
+        [VP_DROP_INVALID_MCAST_SOURCE]      = "Invalid Mcast Source",
+        [VP_DROP_HEAD_ALLOC_FAIL]           = "Head Alloc Fails",
+        [VP_DROP_PCOW_FAIL]                 = "PCOW fails",
+        [VP_DROP_MCAST_DF_BIT]              = "Jumbo Mcast Pkt with DF Bit",
+        [VP_DROP_MCAST_CLONE_FAIL]          = "Mcast Clone Fail",
+        [VP_DROP_NO_MEMORY]                 = "Memory Failures",
+        [VP_DROP_REWRITE_FAIL]              = "Rewrite Fail",
+        [VP_DROP_MISC]                      = "Misc",
+        [VP_DROP_INVALID_PACKET]            = "Invalid Packets",
+        [VP_DROP_CKSUM_ERR]                 = "Checksum errors",
+        [VP_DROP_NO_FMD]                    = "No Fmd",
+        [VP_DROP_CLONED_ORIGINAL]           = "Cloned Original",
+        [VP_DROP_INVALID_VNID]              = "Invalid VNID",
+        [VP_DROP_FRAGMENTS]                 = "Fragment errors",
+        [VP_DROP_INVALID_SOURCE]            = "Invalid Source",
+        [VP_DROP_L2_NO_ROUTE]               = "No L2 Route",
+        [VP_DROP_FRAGMENT_QUEUE_FAIL]       = "Fragment Queueing Failures",
+        [VP_DROP_VLAN_FWD_TX]               = "VLAN fwd intf failed TX",
+        [VP_DROP_VLAN_FWD_ENQ]              = "VLAN fwd intf failed enq",
+        [VP_DROP_NEW_FLOWS]                 = "New Flow Drops",
+        [VP_DROP_FLOW_EVICT]                = "Flow Unusable (Eviction)",
+        [VP_DROP_TRAP_ORIGINAL]             = "Original Packet Trapped",
+        [VP_DROP_LEAF_TO_LEAF]              = "Etree Leaf to Leaf",
+        [VP_DROP_BMAC_ISID_MISMATCH]        = "Bmac/ISID Mismatch",
+        [VP_DROP_PKT_LOOP]                  = "Packet Loop",
+    };
+
+    if ((reason >= VP_DROP_MAX) || !names[reason])
+        return "Unknown";
+
+    return names[reason];
+}
+
+/*
+ * add the counters of a drop reason indexed array to a drop stats message,
+ * for the datapath and for the tools reading the shared stats region
+ */
+static inline void
+vr_drop_stats_fill(vr_drop_stats_req *req, uint64_t *stats)
+{
+    if (!req || !stats)
+        return;
+
+    req->vds_discard += stats[VP_DROP_DISCARD];
+    req->vds_pull += stats[VP_DROP_PULL];
+    req->vds_invalid_if += stats[VP_DROP_INVALID_IF];
+    req->vds_invalid_arp += stats[VP_DROP_INVALID_ARP];
+    req->vds_trap_no_if += stats[VP_DROP_TRAP_NO_IF];
+    req->vds_nowhere_to_go += stats[VP_DROP_NOWHERE_TO_GO];
+    req->vds_flow_queue_limit_exceeded +=
+        stats[VP_DROP_FLOW_QUEUE_LIMIT_EXCEEDED];
+    req->vds_flow_no_memory += stats[VP_DROP_FLOW_NO_MEMORY];
+    req->vds_flow_invalid_protocol += stats[VP_DROP_FLOW_INVALID_PROTOCOL];
+    req->vds_flow_nat_no_rflow += stats[VP_DROP_FLOW_NAT_NO_RFLOW];
+    req->vds_flow_action_drop += stats[VP_DROP_FLOW_ACTION_DROP];
+    req->vds_flow_action_invalid += stats[VP_DROP_FLOW_ACTION_INVALID];
+    req->vds_flow_unusable += stats[VP_DROP_FLOW_UNUSABLE];
+    req->vds_flow_table_full += stats[VP_DROP_FLOW_TABLE_FULL];
+    req->vds_interface_tx_discard += stats[VP_DROP_INTERFACE_TX_DISCARD];
+    req->vds_interface_drop += stats[VP_DROP_INTERFACE_DROP];
+    req->vds_duplicated += stats[VP_DROP_DUPLICATED];
+    req->vds_push += stats[VP_DROP_PUSH];
+    req->vds_ttl_exceeded += stats[VP_DROP_TTL_EXCEEDED];
+    req->vds_invalid_nh += stats[VP_DROP_INVALID_NH];
+    req->vds_invalid_label += stats[VP_DROP_INVALID_LABEL];
+    req->vds_invalid_protocol += stats[VP_DROP_INVALID_PROTOCOL];
+    req->vds_interface_rx_discard += stats[VP_DROP_INTERFACE_RX_DISCARD];
+    req->vds_invalid_mcast_source += stats[VP_DROP_INVALID_MCAST_SOURCE];
+    req->vds_pcow_fail += stats[VP_DROP_PCOW_FAIL];
+    req->vds_mcast_df_bit += stats[VP_DROP_MCAST_DF_BIT];
+    req->vds_mcast_clone_fail += stats[VP_DROP_MCAST_CLONE_FAIL];
+    req->vds_no_memory += stats[VP_DROP_NO_MEMORY];
+    req->vds_rewrite_fail += stats[VP_DROP_REWRITE_FAIL];
+    req->vds_misc += stats[VP_DROP_MISC];
+    req->vds_invalid_packet += stats[VP_DROP_INVALID_PACKET];
+    req->vds_cksum_err += stats[VP_DROP_CKSUM_ERR];
+    req->vds_no_fmd += stats[VP_DROP_NO_FMD];
+    req->vds_cloned_original += stats[VP_DROP_CLONED_ORIGINAL];
+    req->vds_invalid_vnid += stats[VP_DROP_INVALID_VNID];
+    req->vds_frag_err += stats[VP_DROP_FRAGMENTS];
+    req->vds_invalid_source += stats[VP_DROP_INVALID_SOURCE];
+    req->vds_l2_no_route += stats[VP_DROP_L2_NO_ROUTE];
+    req->vds_fragment_queue_fail += stats[VP_DROP_FRAGMENT_QUEUE_FAIL];
+    req->vds_vlan_fwd_tx += stats[VP_DROP_VLAN_FWD_TX];
+    req->vds_vlan_fwd_enq += stats[VP_DROP_VLAN_FWD_ENQ];
+    req->vds_drop_new_flow += stats[VP_DROP_NEW_FLOWS];
+    req->vds_flow_evict += stats[VP_DROP_FLOW_EVICT];
+    req->vds_trap_original += stats[VP_DROP_TRAP_ORIGINAL];
+    req->vds_leaf_to_leaf += stats[VP_DROP_LEAF_TO_LEAF];
+    req->vds_bmac_isid_mismatch += stats[VP_DROP_BMAC_ISID_MISMATCH];
+    req->vds_pkt_loop += stats[VP_DROP_PKT_LOOP];
+
+    return;
+}
+
 #endif /* __VR_PACKET_H__ */
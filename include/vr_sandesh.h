@@ -7,6 +7,10 @@
 #define __VR_SANDESH_H__
 
 #define VR_FLOW_MAX_CPUS    128
+/* 64 bit words of the flow dirty bitmap per vr_flow_dirty_req */
+#define VR_FLOW_DIRTY_CHUNK_WORDS   64
+/* flow operations per FLOW_OP_FLOW_BULK_SET batch */
+#define VR_FLOW_BULK_MAX_OPS        256
 
 struct sandesh_object_md {
     unsigned int obj_len;
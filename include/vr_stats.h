@@ -10,9 +10,94 @@
 extern "C" {
 #endif
 
+struct vr_packet;
+struct vr_forwarding_md;
+
 extern void vr_malloc_stats(unsigned int, unsigned int);
 extern void vr_free_stats(unsigned int);
 
+/*
+ * The datapath collectors below, and the packet trace of vr_trace.h, are
+ * off until they are set from user space. While off, each costs a single
+ * test of a global where it samples (RX, or a drop), and the per packet
+ * ones a test of a packet flag at each of their later points. Their per
+ * cpu state is allocated when they are first set, with a block per cpu
+ * on cache lines of its own.
+ */
+#define VR_PCPU_BLOCK_ALIGN         64
+
+extern void *vr_pcpu_blocks_alloc(unsigned int, unsigned int);
+extern void vr_pcpu_blocks_free(void *, unsigned int);
+
+/*
+ * Per stage datapath latency. One in vr_dp_lat_sample_rate packets received
+ * on an interface is marked with VP_FLAG_DP_LAT, and its forwarding
+ * metadata takes the host cycle counter. At every stage boundary the
+ * packet reaches, the cycles since the previous boundary go to the log2
+ * histogram of the boundary, i.e. a stage histogram holds the time taken
+ * to get to the stage. At interface TX, the time from RX also goes to the
+ * total histogram. A sampled packet which is dropped, held or trapped
+ * takes its mark with it. Collection is compiled in by default.
+ */
+#ifndef VR_DP_LATENCY
+#define VR_DP_LATENCY               1
+#endif
+
+enum vr_dp_lat_stage {
+    VR_DP_LAT_FLOW_LOOKUP,
+    VR_DP_LAT_ROUTE_LOOKUP,
+    VR_DP_LAT_NH_OUTPUT,
+    VR_DP_LAT_VIF_TX,
+    VR_DP_LAT_TOTAL,
+    VR_DP_LAT_STAGE_MAX,
+};
+
+/* bucket i counts the samples of [2^i, 2^(i + 1)) cycles */
+#define VR_DP_LAT_BUCKETS           32
+
+extern unsigned int vr_dp_lat_sample_rate;
+extern void vr_dp_lat_rx(struct vr_packet *, struct vr_forwarding_md *);
+extern void vr_dp_lat_stage(unsigned int, struct vr_packet *,
+        struct vr_forwarding_md *);
+
+#if VR_DP_LATENCY
+#define VR_DP_LAT_RX(pkt, fmd)                              \
+    do {                                                    \
+        if (vr_dp_lat_sample_rate)                          \
+            vr_dp_lat_rx((pkt), (fmd));                     \
+    } while (0)
+#define VR_DP_LAT_STAGE(stage, pkt, fmd)                    \
+    do {                                                    \
+        if ((pkt)->vp_flags & VP_FLAG_DP_LAT)               \
+            vr_dp_lat_stage((stage), (pkt), (fmd));         \
+    } while (0)
+#else
+#define VR_DP_LAT_RX(pkt, fmd)              do { } while (0)
+#define VR_DP_LAT_STAGE(stage, pkt, fmd)    do { } while (0)
+#endif
+
+/*
+ * Drop capture. One in vr_drop_capture_rate packets freed with a drop
+ * reason (optionally only with vr_drop_capture_reason) has the head of
+ * its data copied, along with the interface, vrf, nexthop and time, to a
+ * ring of the cpu which keeps the latest VR_DROP_CAPTURE_RECORDS drops.
+ */
+#define VR_DROP_CAPTURE_RECORDS     128
+#define VR_DROP_CAPTURE_LEN         128
+/* any reason, for vr_drop_capture_reason */
+#define VR_DROP_CAPTURE_ANY         -1
+/* the captured data starts at the ip header, not at the ethernet header */
+#define VR_DROP_CAPTURE_FLAG_L3     0x1
+
+extern unsigned int vr_drop_capture_rate;
+extern void vr_drop_capture(struct vr_packet *, unsigned short);
+
+#define VR_DROP_CAPTURE(pkt, reason)                        \
+    do {                                                    \
+        if (vr_drop_capture_rate)                           \
+            vr_drop_capture((pkt), (reason));               \
+    } while (0)
+
 #ifdef __cplusplus
 }
 #endif
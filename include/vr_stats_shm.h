@@ -0,0 +1,116 @@
+/*
+ * vr_stats_shm.h -- shared memory region of interface, vrf and drop
+ * statistics
+ *
+ * Copyright (c) 2016 Juniper Networks, Inc. All rights reserved.
+ */
+#ifndef __VR_STATS_SHM_H__
+#define __VR_STATS_SHM_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "vr_os.h"
+
+/*
+ * The per cpu counters of the interfaces, the vrfs and the drop reasons
+ * live in one region that tools map read only (/dev/vr_stats, or the
+ * shared memory file of DPDK vRouter), so that polling them costs neither
+ * a netlink round trip nor any work of the datapath, which increments the
+ * counters in place exactly as it does in private memory.
+ *
+ * The region starts with a header page describing the sections, followed
+ * by the state array of each section and by the sections. A section is an
+ * array of slots, one per interface, vrf or, for drops, a single one. A
+ * slot holds the counters of every cpu, ss_cpu_stride bytes apart, and
+ * slots are ss_slot_stride bytes apart from ss_offset on. The counters of
+ * an interface are a struct vr_interface_stats, whose queue to lcore
+ * pointer means nothing to a reader, those of a vrf are a struct
+ * vr_vrf_stats and those of the drops are VP_DROP_MAX counters indexed by
+ * the drop reason.
+ *
+ * A slot is handed to an object when the object is created and taken back
+ * when it is freed. An object created while its slot is still held by a
+ * deleted object that is not freed yet keeps its counters in private
+ * memory for its lifetime, and the slot says so with
+ * VR_STATS_SHM_SLOT_PRIVATE, for readers to go to netlink instead. All of
+ * these, as well as a clear of the counters, happen with st_seq of the
+ * slot odd, so a reader samples st_seq, copies the counters
+ * and samples st_seq again, retrying if it changed or was odd. sh_epoch
+ * is bumped on a reset of vRouter, for readers computing rates to know
+ * the counters went back to zero.
+ */
+#define VR_STATS_SHM_MAGIC              0x5652534d
+#define VR_STATS_SHM_VERSION            1
+#define VR_STATS_SHM_HDR_SIZE           4096
+#define VR_STATS_SHM_ALIGN              64
+/* regions larger than this are not created, counters stay private */
+#define VR_STATS_SHM_MAX_SIZE           (1024 * 1024 * 1024)
+
+enum vr_stats_shm_section_id {
+    VR_STATS_SHM_VIF,
+    VR_STATS_SHM_VRF,
+    VR_STATS_SHM_DROP,
+    VR_STATS_SHM_SECTIONS,
+};
+
+struct vr_stats_shm_section {
+    uint32_t ss_slots;
+    /* bytes of counters per cpu, and the distance between two cpus */
+    uint32_t ss_cpu_size;
+    uint32_t ss_cpu_stride;
+    uint32_t ss_slot_stride;
+    /* from the start of the region */
+    uint32_t ss_offset;
+    uint32_t ss_state_offset;
+    uint32_t ss_pad[2];
+};
+
+struct vr_stats_shm_hdr {
+    uint32_t sh_magic;
+    uint16_t sh_version;
+    uint16_t sh_sections;
+    uint32_t sh_hdr_size;
+    uint32_t sh_cpus;
+    uint32_t sh_size;
+    uint32_t sh_epoch;
+    uint32_t sh_pad[2];
+    struct vr_stats_shm_section sh_section[VR_STATS_SHM_SECTIONS];
+};
+
+#define VR_STATS_SHM_SLOT_USED          0x1
+/* the counters of the object with the index are not in the slot */
+#define VR_STATS_SHM_SLOT_PRIVATE       0x2
+
+struct vr_stats_shm_state {
+    /* odd while the slot is being handed out, taken back or cleared */
+    uint32_t st_seq;
+    uint32_t st_flags;
+};
+
+struct vrouter;
+
+/* sized and mapped by the host before vRouter is initialized, if at all */
+extern void *vr_stats_shm_table;
+extern unsigned char *vr_stats_shm_path;
+
+extern unsigned long vr_stats_shm_size(unsigned int, unsigned int,
+        unsigned int);
+extern unsigned int vr_stats_shm_table_size(struct vrouter *);
+extern void *vr_stats_shm_get_va(struct vrouter *, uint64_t);
+extern void *vr_stats_shm_attach(struct vrouter *, unsigned int,
+        unsigned int);
+extern void *vr_stats_shm_counters(struct vrouter *, unsigned int,
+        unsigned int, unsigned int);
+extern bool vr_stats_shm_owns(struct vrouter *, void *);
+extern void vr_stats_shm_detach(struct vrouter *, void *);
+extern void vr_stats_shm_clear(struct vrouter *, void *);
+extern int vr_stats_shm_init(struct vrouter *);
+extern void vr_stats_shm_exit(struct vrouter *, bool);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __VR_STATS_SHM_H__ */
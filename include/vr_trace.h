@@ -0,0 +1,106 @@
+/*
+ * vr_trace.h -- sampled packet trace through the datapath
+ *
+ * Copyright (c) 2016 Juniper Networks, Inc. All rights reserved.
+ */
+#ifndef __VR_TRACE_H__
+#define __VR_TRACE_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "vr_os.h"
+
+/*
+ * Tracing is armed for the next N packets received on an interface that
+ * match a filter on the receive interface and on the inner 5-tuple. Such
+ * a packet is marked with VP_FLAG_TRACE and a trace id in its forwarding
+ * metadata, and each function it passes through appends a record with the
+ * id to the trace buffer of the cpu. The 5-tuple is known only by the time
+ * the packet reaches nh_output, so up to that point the records of a
+ * packet are tentative, and are dropped if the packet does not match.
+ */
+#define VR_TRACE_RECORDS            512
+#define VR_TRACE_ADDR_LEN           16
+
+enum vr_trace_point {
+    VR_TRACE_NONE,
+    /* data[0]: vlan id */
+    VR_TRACE_RX,
+    /* data[0]: vlan id, data[1]: packet type */
+    VR_TRACE_FABRIC_INPUT,
+    /* data[0]: flow index, data[1]: flow action | flow flags << 16 */
+    VR_TRACE_FLOW_ACTION,
+    /* data[0]: nexthop type, data[1]: nexthop flags */
+    VR_TRACE_NH_OUTPUT,
+    /* data[0]: member index, data[1]: member nexthop id */
+    VR_TRACE_ECMP,
+    /* data[0]: tunnel destination ip, data[1]: udp source port */
+    VR_TRACE_UDP_TUNNEL,
+    /* data[0]: packet type */
+    VR_TRACE_VIF_TX,
+    VR_TRACE_POINT_MAX,
+};
+
+struct vr_trace_record {
+    /* trace id of the packet */
+    uint32_t tr_packet;
+    uint16_t tr_point;
+    uint16_t tr_vif;
+    uint16_t tr_vrf;
+    uint16_t tr_len;
+    uint32_t tr_nh;
+    uint32_t tr_data[2];
+    /* host cycle counter, zero if the host has none */
+    uint64_t tr_time;
+};
+
+struct vr_trace_filter {
+    /* -1 for any interface */
+    int tf_vif;
+    /* AF_INET, AF_INET6 or zero for any */
+    uint8_t tf_family;
+    /* zero for any protocol */
+    uint8_t tf_proto;
+    /* in network byte order, zero for any port */
+    uint16_t tf_sport;
+    uint16_t tf_dport;
+    /* all zeroes for any address */
+    uint8_t tf_sip[VR_TRACE_ADDR_LEN];
+    uint8_t tf_dip[VR_TRACE_ADDR_LEN];
+};
+
+struct vr_interface;
+struct vr_packet;
+struct vr_forwarding_md;
+struct vr_nexthop;
+
+extern unsigned int vr_trace_armed;
+extern void vr_trace_rx(struct vr_interface *, struct vr_packet *,
+        struct vr_forwarding_md *, unsigned short);
+extern void vr_trace_add(unsigned int, struct vr_interface *,
+        struct vr_packet *, struct vr_forwarding_md *, struct vr_nexthop *,
+        uint32_t, uint32_t);
+
+#define VR_TRACE_RX(vif, pkt, fmd, vlan)                                \
+    do {                                                                \
+        if (vr_trace_armed)                                             \
+            vr_trace_rx((vif), (pkt), (fmd), (vlan));                   \
+    } while (0)
+#define VR_TRACE(point, vif, pkt, fmd, nh, data0, data1)                \
+    do {                                                                \
+        if ((pkt)->vp_flags & VP_FLAG_TRACE)                            \
+            vr_trace_add((point), (vif), (pkt), (fmd), (nh),            \
+                    (data0), (data1));                                  \
+    } while (0)
+
+struct vrouter;
+extern int vr_trace_init(struct vrouter *);
+extern void vr_trace_exit(struct vrouter *, bool);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __VR_TRACE_H__ */
@@ -119,6 +119,11 @@ enum vr_malloc_objects_t {
     VR_BITMAP_OBJECT,
     VR_QOS_MAP_OBJECT,
     VR_FC_OBJECT,
+    VR_FLOW_POLICY_OBJECT,
+    VR_DP_LATENCY_OBJECT,
+    VR_TRACE_OBJECT,
+    VR_NEXTHOP_STATS_OBJECT,
+    VR_DROP_CAPTURE_OBJECT,
     VR_VROUTER_MAX_OBJECT,
 };
 
@@ -132,9 +137,13 @@ extern int vr_from_vm_mss_adj;
 extern int vr_to_vm_mss_adj;
 extern int vr_udp_coff;
 extern unsigned int vr_flow_hold_limit;
+extern unsigned int vr_flow_queue_depth;
+extern unsigned int vr_flow_queue_budget;
 extern int vr_use_linux_br;
 extern int hashrnd_inited;
 extern uint32_t vr_hashrnd;
+/* Use CRC32C hash backend for the tables created (see vr_hash.h) */
+extern bool vr_hash_crc32c_enabled;
 extern unsigned int vr_priority_tagging;
 
 #define CONTAINER_OF(member, struct_type, pointer) \
@@ -223,6 +232,8 @@ struct host_os {
     bool hos_nl_broadcast_supported;
     int (*hos_huge_page_config)(uint64_t *, int, int *, int);
     void *(*hos_huge_page_mem_get)(int);
+    int (*hos_get_lcore_stats)(unsigned int, vr_lcore_stats_req *);
+    uint64_t (*hos_get_cycles)(void);
 };
 
 #define vr_printf                       vrouter_host->hos_printf
@@ -275,6 +286,8 @@ struct host_os {
 #define vr_nl_broadcast_supported       vrouter_host->hos_nl_broadcast_supported
 #define vr_huge_page_config             vrouter_host->hos_huge_page_config
 #define vr_huge_page_mem_get            vrouter_host->hos_huge_page_mem_get
+#define vr_get_lcore_stats              vrouter_host->hos_get_lcore_stats
+#define vr_get_cycles                   vrouter_host->hos_get_cycles
 
 extern struct host_os *vrouter_host;
 
@@ -351,8 +364,23 @@ struct vrouter {
     struct vr_rtable *vr_bridge_rtable;
 
     vr_htable_t vr_flow_table;
+    /* IPv4 flow table, and the flow index of its first entry */
+    vr_htable_t vr_inet_flow_table;
+    unsigned int vr_inet_flow_base;
     struct vr_flow_table_info *vr_flow_table_info;
     unsigned int vr_flow_table_info_size;
+    struct vr_btable *vr_flow_event_table;
+    struct vr_btable *vr_flow_dirty_table;
+    unsigned int vr_flow_dirty_words;
+    /* coarse clock, in seconds, to track when the flows were last used */
+    struct vr_timer *vr_flow_clock_timer;
+    uint32_t vr_flow_clock;
+    /* datapath flow policy cache, and one past its highest rule in use */
+    struct vr_flow_policy **vr_flow_policies;
+    unsigned int vr_flow_policy_count;
+    struct vr_flow_policy_index *vr_flow_policy_index;
+    /* per cpu cache of the freed hold queues */
+    struct vr_flow_queue_cache *vr_flow_queue_cache;
 
     unsigned int vr_max_labels;
     struct vr_btable *vr_ilm;
@@ -368,6 +396,14 @@ struct vrouter {
 
     uint64_t **vr_pdrop_stats;
     struct vr_malloc_stats **vr_malloc_stats;
+    /* per cpu datapath latency histograms, allocated on first enable */
+    struct vr_dp_lat_cpu **vr_dp_latency;
+    /* per cpu packet trace buffers, allocated when tracing is first armed */
+    struct vr_trace_buffer **vr_trace_buffers;
+    /* per cpu rings of captured drops, allocated on first enable */
+    struct vr_drop_capture_cpu **vr_drop_capture;
+    /* region of the interface, vrf and drop counters, mapped by tools */
+    struct vr_btable *vr_stats_shm;
 
     uint16_t vr_link_local_ports_size;
     unsigned char *vr_link_local_ports;
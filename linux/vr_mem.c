@@ -17,9 +17,7 @@
 
 #include "vrouter.h"
 #include "vr_mem.h"
-
-#define MEM_DEV_MINOR_START         0
-#define MEM_DEV_NUM_DEVS            2
+#include "vr_stats_shm.h"
 
 struct vr_hpage_config {
     void *hcfg_uspace_vmem;
@@ -331,6 +329,18 @@ mem_fault(struct vm_area_struct *vma, struct vm_fault *vmf)
         va = vr_bridge_get_va(router, offset << PAGE_SHIFT);
         break;
 
+    case VR_MEM_FLOW_EVENT_OBJECT:
+        va = vr_flow_event_get_va(router, offset << PAGE_SHIFT);
+        break;
+
+    case VR_MEM_INET_FLOW_TABLE_OBJECT:
+        va = vr_inet_flow_get_va(router, offset << PAGE_SHIFT);
+        break;
+
+    case VR_MEM_STATS_OBJECT:
+        va = vr_stats_shm_get_va(router, offset << PAGE_SHIFT);
+        break;
+
     default:
         return -EFAULT;
     }
@@ -363,6 +373,22 @@ mem_dev_mmap(struct file *fp, struct vm_area_struct *vma)
         table_size = vr_bridge_table_size(router);
         break;
 
+    case VR_MEM_FLOW_EVENT_OBJECT:
+        table_size = vr_flow_event_table_size(router);
+        break;
+
+    case VR_MEM_INET_FLOW_TABLE_OBJECT:
+        table_size = vr_inet_flow_table_size(router);
+        break;
+
+    case VR_MEM_STATS_OBJECT:
+        /* the counters are written only by the datapath */
+        if (vma->vm_flags & VM_WRITE)
+            return -EPERM;
+        vma->vm_flags &= ~VM_MAYWRITE;
+        table_size = vr_stats_shm_table_size(router);
+        break;
+
     default:
         return -EINVAL;
     }
@@ -405,7 +431,7 @@ mem_dev_open(struct inode *inode, struct file *filp)
 
     struct vr_mem_object *vmo;
 
-    if (object_id > VR_MEM_MAX_OBJECT)
+    if (object_id >= VR_MEM_MAX_OBJECT)
         return -EINVAL;
 
     vmo = vr_malloc(sizeof(*vmo), VR_MEM_OBJECT);
@@ -13,6 +13,7 @@
 #include <linux/netdevice.h>
 #include <linux/cpumask.h>
 #include <linux/time.h>
+#include <linux/timex.h>
 #include <linux/highmem.h>
 #include <linux/version.h>
 #include <linux/if_vlan.h>
@@ -32,6 +33,7 @@
 #include "vr_flow.h"
 #include "vr_buildinfo.h"
 #include "vr_mem.h"
+#include "vr_stats.h"
 
 unsigned int vr_num_cpus = 1;
 
@@ -349,6 +351,7 @@ lh_pfree(struct vr_packet *pkt, unsigned short reason)
 
     /* Handle the Vrouter statistics */
     pkt_drop_stats(pkt->vp_if, reason, pkt->vp_cpu);
+    VR_DROP_CAPTURE(pkt, reason);
 
     skb = vp_os_packet(pkt);
     if (skb)
@@ -441,6 +444,12 @@ lh_get_mono_time(uint64_t *sec, uint64_t *nsec)
     return;
 }
 
+static uint64_t
+lh_get_cycles(void)
+{
+    return (uint64_t)get_cycles();
+}
+
 static void
 lh_work(struct work_struct *work)
 {
@@ -755,7 +764,8 @@ lh_get_udp_src_port(struct vr_packet *pkt, struct vr_forwarding_md *fmd,
         if (pkt_head_len(pkt) < ETH_HLEN)
             goto error;
 
-        hashval = vr_hash(pkt_data(pkt), ETH_HLEN, vr_hashrnd);
+        hashval = vr_hash_key(vr_hash_crc32c_enabled, pkt_data(pkt),
+                ETH_HLEN, vr_hashrnd);
         /* Include the VRF to calculate the hash */
         hashval = vr_hash_2words(hashval, vrf, vr_hashrnd);
     }
@@ -2375,6 +2385,7 @@ struct host_os linux_host = {
     .hos_nl_broadcast_supported     =       true,
     .hos_huge_page_config           =       lh_huge_page_config,
     .hos_huge_page_mem_get          =       lh_huge_mem_get,
+    .hos_get_cycles                 =       lh_get_cycles,
 };
     
 struct host_os *
@@ -2615,6 +2626,8 @@ module_param(vr_flow_entries, uint, S_IRUGO);
 MODULE_PARM_DESC(vr_flow_entries, "Number of entries in the flow table. Default is "__stringify(VR_DEF_FLOW_ENTRIES));
 module_param(vr_oflow_entries, uint, S_IRUGO);
 MODULE_PARM_DESC(vr_oflow_entries, "Number of overflow entries in the flow table.");
+module_param(vr_inet_flow_entries, uint, S_IRUGO);
+MODULE_PARM_DESC(vr_inet_flow_entries, "Number of entries in the IPv4 flow table. Default is 0, no table");
 
 module_param(vr_bridge_entries, uint, S_IRUGO);
 MODULE_PARM_DESC(vr_bridge_entries, "Number of entries in the bridge table. Default is "__stringify(VR_DEF_BRIDGE_ENTRIES));
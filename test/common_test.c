@@ -1,20 +1,119 @@
+#include <stdio.h>
+#include <string.h>
+#include <arpa/inet.h>
+
 #include "vr_types.h"
+#include "vr_os.h"
+#include "vr_packet.h"
+#include "vr_message.h"
+
+#include "host/vr_host.h"
+#include "host/vr_host_packet.h"
+#include "host/vr_host_interface.h"
+
+#include "common_test.h"
+
+uint64_t test_sink_packets[HIF_MAX_INTERFACES];
+uint64_t test_sink_bytes[HIF_MAX_INTERFACES];
+
+static int test_resp_code;
 
 void
 get_random_bytes(void *buf, int nbytes)
 {
 }
 
+#define JHASH_GOLDEN_RATIO  0x9e3779b9
+
+#define __jhash_mix(a, b, c)                                            \
+    do {                                                                \
+        a -= b; a -= c; a ^= (c >> 13);                                 \
+        b -= c; b -= a; b ^= (a << 8);                                  \
+        c -= a; c -= b; c ^= (b >> 13);                                 \
+        a -= b; a -= c; a ^= (c >> 12);                                 \
+        b -= c; b -= a; b ^= (a << 16);                                 \
+        c -= a; c -= b; c ^= (b >> 5);                                  \
+        a -= b; a -= c; a ^= (c >> 3);                                  \
+        b -= c; b -= a; b ^= (a << 10);                                 \
+        c -= a; c -= b; c ^= (b >> 15);                                 \
+    } while (0)
+
+/*
+ * the jhash of the Linux kernel, which the kernel module hashes with, so
+ * that the tables and the benchmarks spread the keys as vRouter does
+ */
 uint32_t
 jhash(void *key, uint32_t length, uint32_t initval)
 {
-    uint32_t ret;
-    int i;
-    unsigned char *data = (unsigned char *)key;
+    uint32_t a, b, c, len = length;
+    unsigned char *k = (unsigned char *)key;
+
+    a = b = JHASH_GOLDEN_RATIO;
+    c = initval;
+
+    while (len >= 12) {
+        a += (k[0] + ((uint32_t)k[1] << 8) + ((uint32_t)k[2] << 16) +
+                ((uint32_t)k[3] << 24));
+        b += (k[4] + ((uint32_t)k[5] << 8) + ((uint32_t)k[6] << 16) +
+                ((uint32_t)k[7] << 24));
+        c += (k[8] + ((uint32_t)k[9] << 8) + ((uint32_t)k[10] << 16) +
+                ((uint32_t)k[11] << 24));
+        __jhash_mix(a, b, c);
+        k += 12;
+        len -= 12;
+    }
 
-    for (i = 0; i < length; i ++)
-        ret +=  data[i];
+    c += length;
+    switch (len) {
+    case 11: c += ((uint32_t)k[10] << 24);
+    case 10: c += ((uint32_t)k[9] << 16);
+    case 9:  c += ((uint32_t)k[8] << 8);
+    case 8:  b += ((uint32_t)k[7] << 24);
+    case 7:  b += ((uint32_t)k[6] << 16);
+    case 6:  b += ((uint32_t)k[5] << 8);
+    case 5:  b += k[4];
+    case 4:  a += ((uint32_t)k[3] << 24);
+    case 3:  a += ((uint32_t)k[2] << 16);
+    case 2:  a += ((uint32_t)k[1] << 8);
+    case 1:  a += k[0];
+    }
 
-    return ret;
+    __jhash_mix(a, b, c);
+
+    return c;
 }
 
+/* whatever the vRouter transmits on an interface ends up here */
+unsigned int
+test_sink_tx(struct vr_hinterface *hif, struct vr_hpacket *hpkt)
+{
+    test_sink_packets[hif->hif_index]++;
+    test_sink_bytes[hif->hif_index] += hpkt->hp_packet.vp_len;
+    vr_hpacket_free(hpkt);
+
+    return 0;
+}
+
+/* the message layer frees the object once this returns */
+static int
+test_response_cb(void *arg, unsigned int obj_type, void *object)
+{
+    if ((obj_type == VR_RESPONSE_OBJECT_ID) &&
+            (((vr_response *)object)->resp_code < 0))
+        test_resp_code = ((vr_response *)object)->resp_code;
+
+    return 0;
+}
+
+/*
+ * processes the responses the requests queued, returns the first error
+ * among them, if any
+ */
+int
+test_drain_responses(void)
+{
+    test_resp_code = 0;
+    vr_message_process_response(test_response_cb, NULL);
+
+    return test_resp_code;
+}
@@ -6,4 +6,14 @@
 void get_random_bytes(void *buf, int nbytes);
 uint32_t jhash(void *key, uint32_t length, uint32_t initval);
 
+struct vr_hinterface;
+struct vr_hpacket;
+
+/* packets and bytes test_sink_tx took, by interface index */
+extern uint64_t test_sink_packets[];
+extern uint64_t test_sink_bytes[];
+
+unsigned int test_sink_tx(struct vr_hinterface *hif, struct vr_hpacket *hpkt);
+int test_drain_responses(void);
+
 #endif /* __COMMON_TEST_H__ */
@@ -0,0 +1,846 @@
+/*
+ * dp_core_bench.c -- microbenchmarks of the dp-core hot paths
+ *
+ * Drives synthetic workloads through the flow, route, bridge and hash
+ * table lookups, ECMP selection and the tunnel encapsulations, on top of
+ * the host (userspace) vRouter library, and reports ns, cycles and cache
+ * misses per operation.
+ *
+ * Copyright (c) 2016 Juniper Networks, Inc. All rights reserved.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <math.h>
+#include <time.h>
+
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "vr_types.h"
+#include "vr_os.h"
+#include "vr_packet.h"
+#include "vr_message.h"
+#include "vr_interface.h"
+#include "vr_nexthop.h"
+#include "vr_route.h"
+#include "vr_ip_mtrie.h"
+#include "vr_mirror.h"
+#include "vr_bridge.h"
+#include "vr_datapath.h"
+#include "vr_flow.h"
+#include "vr_htable.h"
+#include "vr_hash.h"
+
+#include "host/vr_host.h"
+#include "host/vr_host_packet.h"
+#include "host/vr_host_interface.h"
+
+#include "common_test.h"
+
+extern int vrouter_host_init(unsigned int);
+extern unsigned int vr_num_cpus;
+extern unsigned int vr_bridge_entries;
+extern unsigned int vr_bridge_oentries;
+extern unsigned int vr_flow_entries;
+extern unsigned int vr_oflow_entries;
+extern struct vr_flow_entry *vr_find_flow(struct vrouter *, struct vr_flow *,
+        uint8_t, unsigned int *);
+
+#define BENCH_SEQ_SIZE          (64 * 1024)
+#define BENCH_PKT_SIZE          2048
+#define BENCH_FABRIC_VIF        1
+#define BENCH_TUNNEL_NH_START   10
+#define BENCH_ECMP_NH           100
+#define BENCH_MAX_ECMP          16
+#define BENCH_ZIPF_S            0.99
+
+enum bench_dist {
+    BENCH_DIST_UNIFORM,
+    BENCH_DIST_ZIPF,
+};
+
+struct bench_key {
+    uint32_t bk_sip;
+    uint32_t bk_dip;
+    uint16_t bk_sport;
+    uint16_t bk_dport;
+};
+
+struct bench_counters {
+    int bc_cycles_fd;
+    int bc_misses_fd;
+};
+
+struct bench {
+    const char *b_name;
+    int (*b_setup)(void);
+    void (*b_run)(unsigned int);
+};
+
+static unsigned int entries = 64 * 1024;
+static unsigned int iterations = 1000000;
+static unsigned int ecmp_members = 4;
+static enum bench_dist dist = BENCH_DIST_UNIFORM;
+static const char *bench_filter;
+
+static struct vrouter *router;
+static struct vr_interface *fabric_vif;
+static struct bench_key *keys;
+static unsigned int *seq;
+static struct vr_flow *flow_keys;
+static vr_htable_t bench_htable;
+static struct bench_counters counters;
+static struct vr_nexthop *tunnel_nh[3];
+static struct vr_nexthop *ecmp_nh;
+
+static int
+bench_perf_open(uint64_t config)
+{
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    return syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static void
+bench_counters_start(void)
+{
+    if (counters.bc_cycles_fd >= 0) {
+        ioctl(counters.bc_cycles_fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(counters.bc_cycles_fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+
+    if (counters.bc_misses_fd >= 0) {
+        ioctl(counters.bc_misses_fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(counters.bc_misses_fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+
+    return;
+}
+
+static int64_t
+bench_counter_stop(int fd)
+{
+    uint64_t value;
+
+    if (fd < 0)
+        return -1;
+
+    ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+    if (read(fd, &value, sizeof(value)) != sizeof(value))
+        return -1;
+
+    return (int64_t)value;
+}
+
+static uint64_t
+bench_now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* access sequence over the keys, generated before the clock starts */
+static int
+bench_seq_init(void)
+{
+    unsigned int i, j, tmp, lo, hi, mid, *perm;
+    double sum = 0, r, *cdf;
+
+    seq = calloc(BENCH_SEQ_SIZE, sizeof(*seq));
+    if (!seq)
+        return -ENOMEM;
+
+    if (dist == BENCH_DIST_UNIFORM) {
+        for (i = 0; i < BENCH_SEQ_SIZE; i++)
+            seq[i] = (unsigned int)random() % entries;
+        return 0;
+    }
+
+    cdf = calloc(entries, sizeof(*cdf));
+    perm = calloc(entries, sizeof(*perm));
+    if (!cdf || !perm) {
+        free(cdf);
+        free(perm);
+        return -ENOMEM;
+    }
+
+    /* spread the popular keys over the table, with a shuffle of the ranks */
+    for (i = 0; i < entries; i++)
+        perm[i] = i;
+    for (i = entries - 1; i > 0; i--) {
+        j = (unsigned int)random() % (i + 1);
+        tmp = perm[i];
+        perm[i] = perm[j];
+        perm[j] = tmp;
+    }
+
+    for (i = 0; i < entries; i++) {
+        sum += 1.0 / pow((double)(i + 1), BENCH_ZIPF_S);
+        cdf[i] = sum;
+    }
+
+    for (i = 0; i < BENCH_SEQ_SIZE; i++) {
+        r = ((double)random() / RAND_MAX) * sum;
+        lo = 0;
+        hi = entries - 1;
+        while (lo < hi) {
+            mid = (lo + hi) / 2;
+            if (cdf[mid] < r)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        seq[i] = perm[lo];
+    }
+
+    free(cdf);
+    free(perm);
+
+    return 0;
+}
+
+static int
+bench_keys_init(void)
+{
+    unsigned int i;
+
+    keys = calloc(entries, sizeof(*keys));
+    flow_keys = calloc(entries, sizeof(*flow_keys));
+    if (!keys || !flow_keys)
+        return -ENOMEM;
+
+    for (i = 0; i < entries; i++) {
+        keys[i].bk_sip = htonl(0x0a000000 | (unsigned int)random() % 0xffffff);
+        keys[i].bk_dip = htonl(0x14000000 | i);
+        keys[i].bk_sport = htons(1024 + (random() % 60000));
+        keys[i].bk_dport = htons(1 + (i % 1024));
+        vr_inet_fill_flow(&flow_keys[i], 0, keys[i].bk_sip, keys[i].bk_dip,
+                VR_IP_PROTO_UDP, keys[i].bk_sport, keys[i].bk_dport,
+                VR_FLOW_KEY_ALL);
+    }
+
+    return bench_seq_init();
+}
+
+/* an IPv4/UDP packet of the key, with the data at the network header */
+static struct vr_packet *
+bench_ip_packet(struct bench_key *key)
+{
+    struct vr_packet *pkt;
+    struct vr_ip *ip;
+    struct vr_udp *udp;
+
+    pkt = vr_palloc(BENCH_PKT_SIZE);
+    if (!pkt)
+        return NULL;
+
+    ip = (struct vr_ip *)pkt_data(pkt);
+    memset(ip, 0, sizeof(*ip) + sizeof(*udp));
+    ip->ip_version = 4;
+    ip->ip_hl = 5;
+    ip->ip_ttl = 64;
+    ip->ip_proto = VR_IP_PROTO_UDP;
+    ip->ip_len = htons(sizeof(*ip) + sizeof(*udp) + 64);
+    ip->ip_saddr = key->bk_sip;
+    ip->ip_daddr = key->bk_dip;
+    udp = (struct vr_udp *)(ip + 1);
+    udp->udp_sport = key->bk_sport;
+    udp->udp_dport = key->bk_dport;
+    udp->udp_length = htons(sizeof(*udp) + 64);
+
+    pkt->vp_tail += ntohs(ip->ip_len);
+    pkt->vp_len = ntohs(ip->ip_len);
+    pkt->vp_type = VP_TYPE_IP;
+    pkt->vp_if = fabric_vif;
+    pkt->vp_cpu = 0;
+    pkt_set_network_header(pkt, pkt->vp_data);
+
+    return pkt;
+}
+
+static vr_hentry_key
+bench_htable_get_key(vr_htable_t table, vr_hentry_t *ent, unsigned int *len)
+{
+    if (len)
+        *len = sizeof(struct bench_key);
+
+    return (vr_hentry_key)(ent + 1);
+}
+
+static int
+bench_htable_setup(void)
+{
+    unsigned int i;
+    vr_hentry_t *ent;
+
+    bench_htable = vr_htable_create(router, entries, entries / 8,
+            sizeof(vr_hentry_t) + sizeof(struct bench_key),
+            sizeof(struct bench_key), 0, bench_htable_get_key);
+    if (!bench_htable)
+        return -ENOMEM;
+
+    for (i = 0; i < entries; i++) {
+        ent = vr_htable_find_free_hentry(bench_htable, &keys[i],
+                sizeof(struct bench_key));
+        if (!ent)
+            continue;
+        memcpy(ent + 1, &keys[i], sizeof(struct bench_key));
+    }
+
+    return 0;
+}
+
+static void
+bench_htable_run(unsigned int n)
+{
+    unsigned int i;
+
+    for (i = 0; i < n; i++)
+        (void)vr_htable_find_hentry(bench_htable,
+                &keys[seq[i & (BENCH_SEQ_SIZE - 1)]],
+                sizeof(struct bench_key));
+
+    return;
+}
+
+/* the flows are installed the way the datapath does, with a drop action */
+static int
+bench_flow_setup(void)
+{
+    unsigned int i;
+    struct vr_flow_entry *fe;
+
+    for (i = 0; i < entries; i++) {
+        fe = (struct vr_flow_entry *)vr_htable_find_free_hentry(
+                router->vr_flow_table, &flow_keys[i],
+                flow_keys[i].flow_key_len);
+        if (!fe)
+            continue;
+
+        memcpy(&fe->fe_key, &flow_keys[i], flow_keys[i].flow_key_len);
+        fe->fe_key.flow_key_len = flow_keys[i].flow_key_len;
+        fe->fe_type = VP_TYPE_IP;
+        fe->fe_vrf = 0;
+        fe->fe_rflow = -1;
+        fe->fe_ecmp_nh_index = -1;
+        fe->fe_mirror_id = VR_MAX_MIRROR_INDICES;
+        fe->fe_sec_mirror_id = VR_MAX_MIRROR_INDICES;
+        fe->fe_action = VR_FLOW_ACTION_DROP;
+        fe->fe_flags |= VR_FLOW_FLAG_ACTIVE;
+    }
+
+    return 0;
+}
+
+static void
+bench_flow_find_run(unsigned int n)
+{
+    unsigned int i, index;
+
+    for (i = 0; i < n; i++)
+        (void)vr_find_flow(router, &flow_keys[seq[i & (BENCH_SEQ_SIZE - 1)]],
+                VP_TYPE_IP, &index);
+
+    return;
+}
+
+static void
+bench_pkt_alloc_run(unsigned int n)
+{
+    unsigned int i;
+    struct vr_packet *pkt;
+
+    for (i = 0; i < n; i++) {
+        pkt = bench_ip_packet(&keys[seq[i & (BENCH_SEQ_SIZE - 1)]]);
+        if (pkt)
+            vr_pfree(pkt, VP_DROP_DISCARD);
+    }
+
+    return;
+}
+
+static void
+bench_flow_lookup_run(unsigned int n)
+{
+    unsigned int i, k;
+    struct vr_packet *pkt;
+    struct vr_forwarding_md fmd;
+
+    for (i = 0; i < n; i++) {
+        k = seq[i & (BENCH_SEQ_SIZE - 1)];
+        pkt = bench_ip_packet(&keys[k]);
+        if (!pkt)
+            continue;
+
+        vr_init_forwarding_md(&fmd);
+        fmd.fmd_dvrf = 0;
+        (void)vr_flow_lookup(router, &flow_keys[k], pkt, &fmd);
+    }
+
+    return;
+}
+
+static int
+bench_route_setup(void)
+{
+    unsigned int i;
+    vr_route_req req;
+
+    for (i = 0; i < entries; i++) {
+        memset(&req, 0, sizeof(req));
+        req.h_op = SANDESH_OP_ADD;
+        req.rtr_family = AF_INET;
+        req.rtr_vrf_id = 0;
+        req.rtr_prefix = (int8_t *)&keys[i].bk_dip;
+        req.rtr_prefix_size = 4;
+        req.rtr_prefix_len = 32;
+        req.rtr_nh_id = NH_DISCARD_ID;
+        req.rtr_label = -1;
+        vr_route_add(&req);
+        if (!(i % 1024))
+            (void)test_drain_responses();
+    }
+
+    (void)test_drain_responses();
+
+    return 0;
+}
+
+static void
+bench_route_run(unsigned int n)
+{
+    unsigned int i;
+    uint32_t prefix;
+    struct vr_route_req rt;
+
+    for (i = 0; i < n; i++) {
+        prefix = keys[seq[i & (BENCH_SEQ_SIZE - 1)]].bk_dip;
+        rt.rtr_req.rtr_vrf_id = 0;
+        rt.rtr_req.rtr_prefix = (uint8_t *)&prefix;
+        rt.rtr_req.rtr_prefix_size = 4;
+        rt.rtr_req.rtr_prefix_len = IP4_PREFIX_LEN;
+        rt.rtr_req.rtr_family = AF_INET;
+        rt.rtr_req.rtr_marker_size = 0;
+        rt.rtr_req.rtr_nh_id = 0;
+        (void)vr_inet_route_lookup(0, &rt);
+    }
+
+    return;
+}
+
+static void
+bench_key_mac(unsigned int i, uint8_t *mac)
+{
+    mac[0] = 0x02;
+    mac[1] = 0x00;
+    memcpy(mac + 2, &keys[i].bk_dip, sizeof(keys[i].bk_dip));
+
+    return;
+}
+
+static int
+bench_bridge_setup(void)
+{
+    unsigned int i;
+    uint8_t mac[VR_ETHER_ALEN];
+    vr_route_req req;
+
+    for (i = 0; i < entries; i++) {
+        bench_key_mac(i, mac);
+        memset(&req, 0, sizeof(req));
+        req.h_op = SANDESH_OP_ADD;
+        req.rtr_family = AF_BRIDGE;
+        req.rtr_vrf_id = 0;
+        req.rtr_mac = (int8_t *)mac;
+        req.rtr_mac_size = VR_ETHER_ALEN;
+        req.rtr_nh_id = NH_DISCARD_ID;
+        req.rtr_label = -1;
+        vr_route_add(&req);
+        if (!(i % 1024))
+            (void)test_drain_responses();
+    }
+
+    (void)test_drain_responses();
+
+    return 0;
+}
+
+static void
+bench_bridge_run(unsigned int n)
+{
+    unsigned int i;
+    uint8_t mac[VR_ETHER_ALEN];
+    struct vr_route_req rt;
+
+    for (i = 0; i < n; i++) {
+        bench_key_mac(seq[i & (BENCH_SEQ_SIZE - 1)], mac);
+        rt.rtr_req.rtr_label_flags = 0;
+        rt.rtr_req.rtr_index = VR_BE_INVALID_INDEX;
+        rt.rtr_req.rtr_mac_size = VR_ETHER_ALEN;
+        rt.rtr_req.rtr_mac = (int8_t *)mac;
+        rt.rtr_req.rtr_vrf_id = 0;
+        (void)vr_bridge_lookup(0, &rt);
+    }
+
+    return;
+}
+
+/*
+ * a fabric interface whose transmit is a sink, and one tunnel nexthop of
+ * each encapsulation over it
+ */
+static int
+bench_fabric_setup(void)
+{
+    int ret;
+    unsigned int i;
+    int32_t nh_list[BENCH_MAX_ECMP], label_list[BENCH_MAX_ECMP];
+    uint8_t mac[VR_ETHER_ALEN] = {0x02, 0x00, 0x00, 0x00, 0x00, 0x01};
+    uint8_t encap[VR_ETHER_HLEN] = {
+        0x02, 0x00, 0x00, 0x00, 0x00, 0x02,
+        0x02, 0x00, 0x00, 0x00, 0x00, 0x01,
+        0x08, 0x00,
+    };
+    unsigned int tunnel_flags[] = {
+        NH_FLAG_TUNNEL_GRE,
+        NH_FLAG_TUNNEL_UDP_MPLS,
+        NH_FLAG_TUNNEL_VXLAN,
+    };
+    struct vr_hinterface *hif;
+    vr_interface_req vif_req;
+    vr_nexthop_req nh_req;
+
+    if (fabric_vif)
+        return 0;
+
+    hif = vr_hinterface_create(HIF_PHYSICAL_INTERFACE_INDEX, HIF_TYPE_UDP,
+            VIF_TYPE_PHYSICAL);
+    if (!hif)
+        return -ENODEV;
+    hif->hif_tx = test_sink_tx;
+
+    memset(&vif_req, 0, sizeof(vif_req));
+    vif_req.h_op = SANDESH_OP_ADD;
+    vif_req.vifr_type = VIF_TYPE_PHYSICAL;
+    vif_req.vifr_transport = VIF_TRANSPORT_ETH;
+    vif_req.vifr_idx = BENCH_FABRIC_VIF;
+    vif_req.vifr_os_idx = HIF_PHYSICAL_INTERFACE_INDEX;
+    vif_req.vifr_mtu = 9000;
+    vif_req.vifr_name = "bench0";
+    vif_req.vifr_mac = (int8_t *)mac;
+    vif_req.vifr_mac_size = VR_ETHER_ALEN;
+    vif_req.vifr_mir_id = -1;
+    ret = vr_interface_add(&vif_req, false);
+    (void)test_drain_responses();
+    if (ret)
+        return ret;
+
+    fabric_vif = __vrouter_get_interface(router, BENCH_FABRIC_VIF);
+    if (!fabric_vif)
+        return -ENODEV;
+
+    for (i = 0; i < 3; i++) {
+        memset(&nh_req, 0, sizeof(nh_req));
+        nh_req.h_op = SANDESH_OP_ADD;
+        nh_req.nhr_type = NH_TUNNEL;
+        nh_req.nhr_family = AF_INET;
+        nh_req.nhr_id = BENCH_TUNNEL_NH_START + i;
+        nh_req.nhr_flags = NH_FLAG_VALID | tunnel_flags[i];
+        nh_req.nhr_encap_oif_id = BENCH_FABRIC_VIF;
+        nh_req.nhr_encap = (int8_t *)encap;
+        nh_req.nhr_encap_size = sizeof(encap);
+        nh_req.nhr_tun_sip = htonl(0x01010101);
+        nh_req.nhr_tun_dip = htonl(0x02020202 + i);
+        ret = vr_nexthop_add(&nh_req);
+        (void)test_drain_responses();
+        if (ret)
+            return ret;
+
+        tunnel_nh[i] = __vrouter_get_nexthop(router, nh_req.nhr_id);
+    }
+
+    if (ecmp_members > BENCH_MAX_ECMP)
+        ecmp_members = BENCH_MAX_ECMP;
+
+    for (i = 0; i < ecmp_members; i++) {
+        nh_list[i] = BENCH_TUNNEL_NH_START + (i % 2);
+        label_list[i] = 16 + i;
+    }
+
+    memset(&nh_req, 0, sizeof(nh_req));
+    nh_req.h_op = SANDESH_OP_ADD;
+    nh_req.nhr_type = NH_COMPOSITE;
+    nh_req.nhr_family = AF_INET;
+    nh_req.nhr_id = BENCH_ECMP_NH;
+    nh_req.nhr_flags = NH_FLAG_VALID | NH_FLAG_COMPOSITE_ECMP;
+    nh_req.nhr_nh_list = nh_list;
+    nh_req.nhr_nh_list_size = ecmp_members;
+    nh_req.nhr_label_list = label_list;
+    nh_req.nhr_label_list_size = ecmp_members;
+    ret = vr_nexthop_add(&nh_req);
+    (void)test_drain_responses();
+    if (ret)
+        return ret;
+
+    ecmp_nh = __vrouter_get_nexthop(router, BENCH_ECMP_NH);
+
+    return 0;
+}
+
+static void
+bench_nh_run(struct vr_nexthop *nh, unsigned int n, unsigned int label_type)
+{
+    unsigned int i;
+    struct vr_packet *pkt;
+    struct vr_forwarding_md fmd;
+
+    if (!nh)
+        return;
+
+    for (i = 0; i < n; i++) {
+        pkt = bench_ip_packet(&keys[seq[i & (BENCH_SEQ_SIZE - 1)]]);
+        if (!pkt)
+            continue;
+
+        vr_init_forwarding_md(&fmd);
+        fmd.fmd_dvrf = 0;
+        vr_fmd_set_label(&fmd, 16, label_type);
+        nh->nh_reach_nh(pkt, nh, &fmd);
+    }
+
+    return;
+}
+
+static void
+bench_ecmp_run(unsigned int n)
+{
+    bench_nh_run(ecmp_nh, n, VR_LABEL_TYPE_MPLS);
+    return;
+}
+
+static void
+bench_gre_run(unsigned int n)
+{
+    bench_nh_run(tunnel_nh[0], n, VR_LABEL_TYPE_MPLS);
+    return;
+}
+
+static void
+bench_mpls_udp_run(unsigned int n)
+{
+    bench_nh_run(tunnel_nh[1], n, VR_LABEL_TYPE_MPLS);
+    return;
+}
+
+static void
+bench_vxlan_run(unsigned int n)
+{
+    bench_nh_run(tunnel_nh[2], n, VR_LABEL_TYPE_VXLAN_ID);
+    return;
+}
+
+static struct bench benches[] = {
+    {"htable_find",         bench_htable_setup,     bench_htable_run},
+    {"flow_find",           bench_flow_setup,       bench_flow_find_run},
+    {"pkt_alloc_free",      bench_fabric_setup,     bench_pkt_alloc_run},
+    {"flow_lookup",         bench_fabric_setup,     bench_flow_lookup_run},
+    {"inet_route_lookup",   bench_route_setup,      bench_route_run},
+    {"bridge_lookup",       bench_bridge_setup,     bench_bridge_run},
+    {"ecmp_select",         bench_fabric_setup,     bench_ecmp_run},
+    {"nh_gre_encap",        bench_fabric_setup,     bench_gre_run},
+    {"nh_mpls_udp_encap",   bench_fabric_setup,     bench_mpls_udp_run},
+    {"nh_vxlan_encap",      bench_fabric_setup,     bench_vxlan_run},
+};
+
+static void
+bench_run(struct bench *b)
+{
+    int64_t cycles, misses;
+    uint64_t start, ns;
+
+    /* warm up the caches and the branch predictors */
+    b->b_run(BENCH_SEQ_SIZE);
+    (void)test_drain_responses();
+
+    bench_counters_start();
+    start = bench_now_ns();
+    b->b_run(iterations);
+    ns = bench_now_ns() - start;
+    cycles = bench_counter_stop(counters.bc_cycles_fd);
+    misses = bench_counter_stop(counters.bc_misses_fd);
+    (void)test_drain_responses();
+
+    printf("%-20s %10u %-8s %10.2f", b->b_name, entries,
+            (dist == BENCH_DIST_ZIPF) ? "zipf" : "uniform",
+            (double)ns / iterations);
+    if (cycles >= 0)
+        printf(" %12.2f", (double)cycles / iterations);
+    else
+        printf(" %12s", "-");
+    if (misses >= 0)
+        printf(" %12.4f\n", (double)misses / iterations);
+    else
+        printf(" %12s\n", "-");
+
+    return;
+}
+
+static void
+Usage(void)
+{
+    printf("Usage: dp_core_bench [--entries <n>] [--iterations <n>]\n");
+    printf("                     [--dist uniform|zipf] [--ecmp <members>]\n");
+    printf("                     [--bench <name>]\n\n");
+    printf("--entries <n>      Entries in the tables and keys in the workload\n");
+    printf("--iterations <n>   Operations timed per benchmark\n");
+    printf("--dist <dist>      Key distribution of the lookups\n");
+    printf("--ecmp <members>   Members of the ECMP nexthop (max %u)\n",
+            BENCH_MAX_ECMP);
+    printf("--bench <name>     Run only the benchmarks with <name> in the name\n");
+
+    exit(-EINVAL);
+}
+
+enum opt_bench_index {
+    ENTRIES_OPT_INDEX,
+    ITERATIONS_OPT_INDEX,
+    DIST_OPT_INDEX,
+    ECMP_OPT_INDEX,
+    BENCH_OPT_INDEX,
+    HELP_OPT_INDEX,
+    MAX_OPT_INDEX
+};
+
+static struct option long_options[] = {
+    [ENTRIES_OPT_INDEX]     = {"entries",       required_argument,  0,  0},
+    [ITERATIONS_OPT_INDEX]  = {"iterations",    required_argument,  0,  0},
+    [DIST_OPT_INDEX]        = {"dist",          required_argument,  0,  0},
+    [ECMP_OPT_INDEX]        = {"ecmp",          required_argument,  0,  0},
+    [BENCH_OPT_INDEX]       = {"bench",         required_argument,  0,  0},
+    [HELP_OPT_INDEX]        = {"help",          no_argument,        0,  0},
+    [MAX_OPT_INDEX]         = {NULL,            0,                  0,  0},
+};
+
+static void
+parse_long_opts(int opt_index, char *opt_arg)
+{
+    errno = 0;
+
+    switch (opt_index) {
+    case ENTRIES_OPT_INDEX:
+        entries = strtoul(opt_arg, NULL, 0);
+        if (errno || !entries)
+            Usage();
+        break;
+
+    case ITERATIONS_OPT_INDEX:
+        iterations = strtoul(opt_arg, NULL, 0);
+        if (errno || !iterations)
+            Usage();
+        break;
+
+    case DIST_OPT_INDEX:
+        if (!strcmp(opt_arg, "uniform"))
+            dist = BENCH_DIST_UNIFORM;
+        else if (!strcmp(opt_arg, "zipf"))
+            dist = BENCH_DIST_ZIPF;
+        else
+            Usage();
+        break;
+
+    case ECMP_OPT_INDEX:
+        ecmp_members = strtoul(opt_arg, NULL, 0);
+        if (errno || !ecmp_members)
+            Usage();
+        break;
+
+    case BENCH_OPT_INDEX:
+        bench_filter = opt_arg;
+        break;
+
+    case HELP_OPT_INDEX:
+    default:
+        Usage();
+    }
+
+    return;
+}
+
+int
+main(int argc, char *argv[])
+{
+    int ret, opt, option_index;
+    unsigned int i;
+
+    while ((opt = getopt_long(argc, argv, "", long_options,
+                    &option_index)) >= 0) {
+        switch (opt) {
+        case 0:
+            parse_long_opts(option_index, optarg);
+            break;
+
+        default:
+            Usage();
+        }
+    }
+
+    /* the tables have to hold the workload, and a bit more */
+    vr_flow_entries = 1024;
+    while (vr_flow_entries < entries)
+        vr_flow_entries <<= 1;
+    vr_oflow_entries = vr_flow_entries / 8;
+    vr_bridge_entries = vr_flow_entries;
+    vr_bridge_oentries = vr_oflow_entries;
+
+    vr_diet_message_proto_init();
+    ret = vrouter_host_init(VR_MPROTO_SANDESH);
+    if (ret)
+        return ret;
+
+    router = vrouter_get(0);
+    if (!router)
+        return -ENODEV;
+
+    srandom(0x5eed);
+    if ((ret = bench_keys_init()))
+        return ret;
+
+    counters.bc_cycles_fd = bench_perf_open(PERF_COUNT_HW_CPU_CYCLES);
+    counters.bc_misses_fd = bench_perf_open(PERF_COUNT_HW_CACHE_MISSES);
+
+    printf("%-20s %10s %-8s %10s %12s %12s\n", "Benchmark", "Entries",
+            "Keys", "ns/op", "cycles/op", "misses/op");
+
+    for (i = 0; i < sizeof(benches) / sizeof(benches[0]); i++) {
+        if (bench_filter && !strstr(benches[i].b_name, bench_filter))
+            continue;
+
+        ret = benches[i].b_setup();
+        (void)test_drain_responses();
+        if (ret) {
+            printf("%-20s setup failed: %s (%d)\n", benches[i].b_name,
+                    strerror(-ret), ret);
+            continue;
+        }
+
+        bench_run(&benches[i]);
+    }
+
+    return 0;
+}
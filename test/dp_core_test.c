@@ -1,26 +1,36 @@
 #include <stdio.h>
+#include <string.h>
 #include <unistd.h>
 #include <stdarg.h>
 #include <stddef.h>
 #include <setjmp.h>
 #include <cmocka.h>
+#include <arpa/inet.h>
 
 #include "vr_types.h"
 #include "vr_os.h"
 #include "vr_packet.h"
 #include "vr_message.h"
 #include "vr_interface.h"
+#include "vr_nexthop.h"
+#include "vr_flow.h"
+#include "vr_htable.h"
+#include "vrouter.h"
 
 #include "host/vr_host.h"
 #include "host/vr_host_packet.h"
 #include "host/vr_host_interface.h"
 
+#include "common_test.h"
+#include "../dpdk/vr_dpdk_lcore.h"
+
 extern int vrouter_host_init(unsigned int);
 extern unsigned int vr_num_cpus;
 extern unsigned int vr_bridge_entries;
 extern unsigned int vr_bridge_oentries;
 extern unsigned int vr_flow_entries;
 extern unsigned int vr_oflow_entries;
+extern unsigned int vr_inet_flow_entries;
 
 
 unsigned int allocated = 0;
@@ -60,6 +70,350 @@ void drop_stats_memory_test(void **state) {
     assert_int_equal(allocated, 0);
 }
 
+/* entries of a page worth of main table and of overflow segment */
+#define GROW_TEST_ENTRY_SIZE    64
+#define GROW_TEST_ENTRIES       64
+#define GROW_TEST_KEYS          1024
+
+/* GROW_TEST_ENTRY_SIZE bytes apart in the table */
+struct grow_test_entry {
+    vr_hentry_t gte_hentry;
+    uint32_t gte_key;
+};
+
+static vr_hentry_key grow_test_get_key(vr_htable_t table, vr_hentry_t *ent,
+        unsigned int *key_len) {
+    struct grow_test_entry *gte = (struct grow_test_entry *)ent;
+
+    if (key_len)
+        *key_len = sizeof(uint32_t);
+
+    return &gte->gte_key;
+}
+
+/* inserts keys from *key on till the table is full, the index of each */
+static unsigned int grow_test_fill(vr_htable_t table, uint32_t *key,
+        unsigned int *index) {
+    unsigned int n = 0;
+    struct grow_test_entry *ent;
+
+    for (; *key < GROW_TEST_KEYS; (*key)++) {
+        ent = (struct grow_test_entry *)
+            vr_htable_find_free_hentry(table, key, sizeof(*key));
+        if (!ent)
+            break;
+
+        ent->gte_key = *key;
+        index[*key] = ent->gte_hentry.hentry_index;
+        n++;
+    }
+
+    return n;
+}
+
+static void grow_test_check(vr_htable_t table, uint32_t key,
+        unsigned int index) {
+    vr_hentry_t *ent;
+
+    ent = vr_htable_find_hentry(table, &key, sizeof(key));
+    assert_non_null(ent);
+    assert_int_equal(ent->hentry_index, index);
+    assert_true(ent == __vr_htable_get_hentry_by_index(table, index));
+    assert_true((void *)ent == vr_htable_get_address(table,
+                (uint64_t)index * GROW_TEST_ENTRY_SIZE));
+}
+
+void htable_grow_test(void **state) {
+    uint32_t key = 0, full, i;
+    unsigned int grown = 0, index[GROW_TEST_KEYS];
+    vr_htable_t table;
+
+    table = vr_htable_create(vrouter_get(0), GROW_TEST_ENTRIES,
+            GROW_TEST_ENTRIES, GROW_TEST_ENTRY_SIZE,
+            sizeof(uint32_t), 0, grow_test_get_key);
+    assert_non_null(table);
+    assert_int_equal(vr_htable_entries(table), 2 * GROW_TEST_ENTRIES);
+
+    /* all of the overflow entries are taken */
+    assert_true(grow_test_fill(table, &key, index) > 0);
+    assert_int_equal(vr_htable_used_oflow_entries(table), GROW_TEST_ENTRIES);
+    full = key;
+
+    assert_int_equal(vr_htable_grow(table), 0);
+    assert_int_equal(vr_htable_entries(table), 3 * GROW_TEST_ENTRIES);
+    assert_int_equal(vr_htable_size(table),
+            3 * GROW_TEST_ENTRIES * GROW_TEST_ENTRY_SIZE);
+
+    /* the entries in use keep their index */
+    for (i = 0; i < full; i++)
+        grow_test_check(table, i, index[i]);
+
+    /* the new ones are handed out, and reachable through the mapping */
+    key = full;
+    assert_true(grow_test_fill(table, &key, index) > 0);
+    assert_int_equal(vr_htable_used_oflow_entries(table),
+            2 * GROW_TEST_ENTRIES);
+    for (i = full; i < key; i++) {
+        if (index[i] >= 2 * GROW_TEST_ENTRIES)
+            grown++;
+        grow_test_check(table, i, index[i]);
+    }
+    assert_int_equal(grown, GROW_TEST_ENTRIES);
+    for (i = 0; i < full; i++)
+        grow_test_check(table, i, index[i]);
+
+    vr_htable_delete(table);
+}
+
+static void flow_policy_req(sandesh_op op, int index, int vrf,
+        unsigned char proto, char *src, unsigned char src_plen,
+        char *dst, unsigned char dst_plen,
+        unsigned short dport_lo, unsigned short dport_hi) {
+    struct in_addr src_addr, dst_addr;
+    vr_flow_policy_req req = {
+        .h_op = op,
+        .fpr_index = index,
+        .fpr_vrf = vrf,
+        .fpr_vif = -1,
+        .fpr_family = AF_INET,
+        .fpr_proto = proto,
+        .fpr_sport_lo = 0,
+        .fpr_sport_hi = 65535,
+        .fpr_dport_lo = dport_lo,
+        .fpr_dport_hi = dport_hi,
+        .fpr_src_plen = src_plen,
+        .fpr_dst_plen = dst_plen,
+        .fpr_action = VR_FLOW_ACTION_FORWARD,
+        .fpr_src_nh_index = NH_DISCARD_ID,
+    };
+
+    inet_pton(AF_INET, src, &src_addr);
+    inet_pton(AF_INET, dst, &dst_addr);
+    req.fpr_src_prefix = (int8_t *)&src_addr;
+    req.fpr_src_prefix_size = sizeof(src_addr);
+    req.fpr_dst_prefix = (int8_t *)&dst_addr;
+    req.fpr_dst_prefix_size = sizeof(dst_addr);
+
+    vr_flow_policy_req_process(&req);
+    vr_message_process_response(fake_response_cb, NULL);
+}
+
+/* the index of the rule the flow matches, -1 for none */
+static int flow_policy_match(int vrf, unsigned char proto, char *sip,
+        char *dip, unsigned short dport) {
+    unsigned int rule;
+    struct vr_flow key;
+    struct vr_packet pkt;
+    struct vr_forwarding_md fmd;
+
+    memset(&key, 0, sizeof(key));
+    memset(&pkt, 0, sizeof(pkt));
+    memset(&fmd, 0, sizeof(fmd));
+
+    key.flow_family = AF_INET;
+    key.flow_proto = proto;
+    key.flow_sport = htons(1024);
+    key.flow_dport = htons(dport);
+    inet_pton(AF_INET, sip, &key.flow4_sip);
+    inet_pton(AF_INET, dip, &key.flow4_dip);
+    fmd.fmd_dvrf = vrf;
+
+    if (!vr_flow_policy_match(vrouter_get(0), &key, &pkt, &fmd, &rule))
+        return -1;
+
+    return rule;
+}
+
+void flow_policy_prefix_test(void **state) {
+    flow_policy_req(SANDESH_OP_ADD, 0, 1, 0, "10.1.0.0", 16,
+            "192.168.16.0", 20, 0, 65535);
+
+    assert_int_equal(flow_policy_match(1, 6, "10.1.2.3", "192.168.17.1", 80), 0);
+    assert_int_equal(flow_policy_match(1, 17, "10.1.255.255", "192.168.31.255", 53), 0);
+    assert_int_equal(flow_policy_match(1, 6, "10.2.0.1", "192.168.17.1", 80), -1);
+    assert_int_equal(flow_policy_match(1, 6, "10.1.2.3", "192.168.32.1", 80), -1);
+    /* another vrf, in the same bucket and in another one */
+    assert_int_equal(flow_policy_match(1 + VR_FLOW_POLICY_BUCKETS, 6,
+                "10.1.2.3", "192.168.17.1", 80), -1);
+    assert_int_equal(flow_policy_match(2, 6, "10.1.2.3", "192.168.17.1", 80), -1);
+
+    flow_policy_req(SANDESH_OP_DEL, 0, 0, 0, "0.0.0.0", 0, "0.0.0.0", 0, 0, 0);
+    assert_int_equal(flow_policy_match(1, 6, "10.1.2.3", "192.168.17.1", 80), -1);
+}
+
+void flow_policy_port_range_test(void **state) {
+    flow_policy_req(SANDESH_OP_ADD, 3, -1, 6, "0.0.0.0", 0,
+            "0.0.0.0", 0, 8000, 8099);
+
+    assert_int_equal(flow_policy_match(7, 6, "1.1.1.1", "2.2.2.2", 8000), 3);
+    assert_int_equal(flow_policy_match(7, 6, "1.1.1.1", "2.2.2.2", 8099), 3);
+    assert_int_equal(flow_policy_match(7, 6, "1.1.1.1", "2.2.2.2", 7999), -1);
+    assert_int_equal(flow_policy_match(7, 6, "1.1.1.1", "2.2.2.2", 8100), -1);
+    /* the protocol of the rule */
+    assert_int_equal(flow_policy_match(7, 17, "1.1.1.1", "2.2.2.2", 8000), -1);
+
+    flow_policy_req(SANDESH_OP_DEL, 3, 0, 0, "0.0.0.0", 0, "0.0.0.0", 0, 0, 0);
+}
+
+void flow_policy_order_test(void **state) {
+    flow_policy_req(SANDESH_OP_ADD, 5, 4, 6, "10.0.0.0", 8,
+            "0.0.0.0", 0, 80, 80);
+    flow_policy_req(SANDESH_OP_ADD, 9, -1, 0, "10.0.0.0", 8,
+            "0.0.0.0", 0, 0, 65535);
+
+    assert_int_equal(flow_policy_match(4, 6, "10.9.9.9", "2.2.2.2", 80), 5);
+    assert_int_equal(flow_policy_match(4, 6, "10.9.9.9", "2.2.2.2", 81), 9);
+
+    /* a broader rule ahead of them wins */
+    flow_policy_req(SANDESH_OP_ADD, 2, -1, 0, "0.0.0.0", 0,
+            "0.0.0.0", 0, 0, 65535);
+    assert_int_equal(flow_policy_match(4, 6, "10.9.9.9", "2.2.2.2", 80), 2);
+
+    flow_policy_req(SANDESH_OP_DEL, 2, 0, 0, "0.0.0.0", 0, "0.0.0.0", 0, 0, 0);
+    assert_int_equal(flow_policy_match(4, 6, "10.9.9.9", "2.2.2.2", 80), 5);
+
+    flow_policy_req(SANDESH_OP_DEL, 5, 0, 0, "0.0.0.0", 0, "0.0.0.0", 0, 0, 0);
+    flow_policy_req(SANDESH_OP_DEL, 9, 0, 0, "0.0.0.0", 0, "0.0.0.0", 0, 0, 0);
+    assert_int_equal(flow_policy_match(4, 6, "10.9.9.9", "2.2.2.2", 80), -1);
+}
+
+#define INET_FLOW_TEST_SIP  0x0a000001
+#define INET_FLOW_TEST_DIP  0x0a000002
+
+static int inet_flow_req(int index, uint8_t gen_id, short flags,
+        unsigned short op_flags, int rindex) {
+    vr_flow_req req = {
+        .fr_op = FLOW_OP_FLOW_SET,
+        .fr_index = index,
+        .fr_gen_id = gen_id,
+        .fr_flags = flags,
+        .fr_op_flags = op_flags,
+        .fr_action = VR_FLOW_ACTION_FORWARD,
+        .fr_family = AF_INET,
+        .fr_flow_sip_l = INET_FLOW_TEST_SIP,
+        .fr_flow_dip_l = INET_FLOW_TEST_DIP,
+        .fr_flow_proto = 6,
+        .fr_flow_sport = 1024,
+        .fr_flow_dport = 80,
+        .fr_rindex = rindex,
+        .fr_ecmp_nh_index = -1,
+        .fr_qos_id = -1,
+        .fr_src_nh_index = NH_DISCARD_ID,
+    };
+
+    vr_flow_req_process(&req);
+    return test_drain_responses();
+}
+
+void inet_flow_table_test(void **state) {
+    unsigned int index;
+    struct vr_flow key;
+    struct vr_inet_flow_entry *ife;
+    struct vrouter *router = vrouter_get(0);
+
+    assert_non_null(router->vr_inet_flow_table);
+    assert_true(router->vr_inet_flow_base >=
+            vr_htable_entries(router->vr_flow_table));
+
+    vr_inet_fill_flow(&key, 0, INET_FLOW_TEST_SIP, INET_FLOW_TEST_DIP, 6,
+            1024, 80, VR_FLOW_KEY_ALL);
+
+    assert_int_equal(inet_flow_req(-1, 0, VR_FLOW_FLAG_ACTIVE,
+                VR_FLOW_OP_FLAG_INET, -1), 0);
+    ife = (struct vr_inet_flow_entry *)vr_htable_find_hentry(
+            router->vr_inet_flow_table, &key, sizeof(struct vr_inet_flow));
+    assert_non_null(ife);
+    assert_int_equal(ife->ife_action, VR_FLOW_ACTION_FORWARD);
+    assert_null(vr_htable_find_hentry(router->vr_flow_table, &key,
+                key.flow_key_len));
+    index = router->vr_inet_flow_base + ife->ife_hentry.hentry_index;
+
+    /* the flow is there, whichever table is asked for */
+    assert_int_equal(inet_flow_req(-1, 0, VR_FLOW_FLAG_ACTIVE,
+                VR_FLOW_OP_FLAG_INET, -1), -EEXIST);
+    assert_int_equal(inet_flow_req(-1, 0, VR_FLOW_FLAG_ACTIVE, 0, -1),
+            -EEXIST);
+
+    /* the entry can not mirror, and has to be the one asked for */
+    assert_int_equal(inet_flow_req(index, ife->ife_gen_id,
+                VR_FLOW_FLAG_ACTIVE | VR_FLOW_FLAG_MIRROR, 0, -1), -EINVAL);
+    assert_int_equal(inet_flow_req(index, ife->ife_gen_id + 1,
+                VR_FLOW_FLAG_ACTIVE, 0, -1), -EBADF);
+
+    /* nor be the reverse flow of a flow table entry */
+    assert_int_equal(inet_flow_req(-1, 0,
+                VR_FLOW_FLAG_ACTIVE | VR_RFLOW_VALID, 0, index), -EINVAL);
+
+    assert_int_equal(inet_flow_req(index, ife->ife_gen_id, 0, 0, -1), 0);
+    assert_null(vr_htable_find_hentry(router->vr_inet_flow_table, &key,
+                sizeof(struct vr_inet_flow)));
+    assert_int_equal(inet_flow_req(index, ife->ife_gen_id, 0, 0, -1),
+            -ENOENT);
+}
+
+void flow_bulk_truncated_test(void **state) {
+    /* the first of two operations, the second one never comes */
+    vr_flow_req req = {
+        .fr_op = FLOW_OP_FLOW_BULK_SET,
+        .fr_bulk_index = 0,
+        .fr_bulk_count = 2,
+        .fr_index = -1,
+        .fr_family = AF_INET,
+        .fr_flow_sip_l = INET_FLOW_TEST_SIP,
+        .fr_flow_dip_l = INET_FLOW_TEST_DIP,
+        .fr_flow_proto = 17,
+        .fr_flow_sport = 1024,
+        .fr_flow_dport = 53,
+        .fr_rindex = -1,
+        .fr_ecmp_nh_index = -1,
+        .fr_qos_id = -1,
+        .fr_src_nh_index = NH_DISCARD_ID,
+    };
+
+    vr_flow_req_process(&req);
+    assert_int_equal(test_drain_responses(), 0);
+
+    /* the end of the message answers the batch */
+    vr_flow_bulk_end();
+    assert_int_equal(test_drain_responses(), -EINVAL);
+
+    vr_flow_bulk_end();
+    assert_int_equal(test_drain_responses(), 0);
+}
+
+/* lcore RX ring of 1024 mbufs, congested at 7/8 and till below half */
+#define DIST_TEST_RING_ON   896
+#define DIST_TEST_RING_OFF  512
+
+void dpdk_dist_congestion_test(void **state) {
+    unsigned int count;
+    bool congested = false;
+
+    /* the ring fills up */
+    for (count = 0; count < DIST_TEST_RING_ON; count += 64) {
+        congested = dpdk_lcore_dist_congested(congested, count,
+                DIST_TEST_RING_ON, DIST_TEST_RING_OFF);
+        assert_false(congested);
+    }
+    congested = dpdk_lcore_dist_congested(congested, DIST_TEST_RING_ON,
+            DIST_TEST_RING_ON, DIST_TEST_RING_OFF);
+    assert_true(congested);
+
+    /*
+     * nothing is staged for the ring any more, the periodic check alone
+     * sees it drain, and the congestion clears only below the low mark
+     */
+    for (count = DIST_TEST_RING_ON; count >= DIST_TEST_RING_OFF;
+            count -= 64) {
+        congested = dpdk_lcore_dist_congested(congested, count,
+                DIST_TEST_RING_ON, DIST_TEST_RING_OFF);
+        assert_true(congested);
+    }
+    congested = dpdk_lcore_dist_congested(congested, count,
+            DIST_TEST_RING_ON, DIST_TEST_RING_OFF);
+    assert_false(congested);
+}
+
 static void setup(void **state) {
     vrouter_host->hos_malloc = alloc_for_test;
     vrouter_host->hos_zalloc = alloc_for_test;
@@ -82,9 +436,18 @@ int main(void) {
     vr_bridge_oentries = 64;
     vr_flow_entries = 1024;
     vr_oflow_entries = 64;
+    vr_inet_flow_entries = 1024;
 
     /* test suite */
     const UnitTest tests[] = {
+        /* ahead of the tests that take over the allocator */
+        unit_test(htable_grow_test),
+        unit_test(flow_policy_prefix_test),
+        unit_test(flow_policy_port_range_test),
+        unit_test(flow_policy_order_test),
+        unit_test(inet_flow_table_test),
+        unit_test(flow_bulk_truncated_test),
+        unit_test(dpdk_dist_congestion_test),
         unit_test_setup_teardown(drop_stats_memory_test, setup, teardown),
     };
 
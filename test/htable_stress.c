@@ -0,0 +1,759 @@
+/*
+ * htable_stress.c -- multi-threaded scalability and consistency test of
+ * vr_htable and the flow table
+ *
+ * Runs N threads of lookups and insert/delete churn against a standalone
+ * hash table or the flow table of the host (userspace) vRouter library,
+ * for each of a list of thread counts, and reports the throughput and any
+ * violation of the table invariants.
+ *
+ * Each thread owns a disjoint slice of the keys. Only the owner inserts
+ * and deletes the keys of its slice, so it knows at any time whether a
+ * key has to be found, while all threads look up keys of every slice.
+ * The host library has a single cpu and no RCU, so the test provides
+ * both: a cpu per thread and an epoch based grace period run by a
+ * maintenance thread, which also runs the scheduled overflow deletes
+ * the same way the DPDK vRouter does.
+ *
+ * Copyright (c) 2016 Juniper Networks, Inc. All rights reserved.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "vr_types.h"
+#include "vr_os.h"
+#include "vr_packet.h"
+#include "vr_message.h"
+#include "vr_flow.h"
+#include "vr_htable.h"
+
+#include "host/vr_host.h"
+#include "host/vr_host_packet.h"
+
+#include "common_test.h"
+
+extern int vrouter_host_init(unsigned int);
+extern unsigned int vr_num_cpus;
+extern unsigned int vr_flow_entries;
+extern unsigned int vr_oflow_entries;
+extern void vr_htable_hentry_scheduled_delete(void *);
+
+#define STRESS_MAX_THREADS      64
+#define STRESS_EPOCH_OFFLINE    ((uint64_t)-1)
+
+enum stress_table {
+    STRESS_TABLE_HTABLE,
+    STRESS_TABLE_FLOW,
+};
+
+/* entry of the standalone table, the key is published by its length */
+struct stress_entry {
+    vr_hentry_t se_hentry;
+    uint32_t se_key_len;
+    struct vr_flow se_key;
+};
+
+struct stress_defer {
+    struct stress_defer *sd_next;
+    vr_defer_cb sd_cb;
+    struct vrouter *sd_router;
+    unsigned char sd_data[0];
+};
+
+struct stress_thread {
+    pthread_t st_thread;
+    unsigned int st_cpu;
+    unsigned int st_first_key;
+    unsigned int st_keys;
+    uint64_t st_rand;
+    /* the last epoch the thread has seen outside of a table operation */
+    volatile uint64_t st_epoch;
+    uint64_t st_lookups;
+    uint64_t st_hits;
+    uint64_t st_inserts;
+    uint64_t st_deletes;
+    uint64_t st_full;
+    uint64_t st_violations;
+} __attribute__((aligned(64)));
+
+static unsigned int entries = 64 * 1024;
+static unsigned int oentries;
+static unsigned int main_entries;
+static unsigned int churn = 10;
+static unsigned int duration = 2;
+static unsigned int max_threads = STRESS_MAX_THREADS;
+static enum stress_table table_type = STRESS_TABLE_HTABLE;
+static char *thread_list = "1,2,4,8,16,32,64";
+
+static struct vrouter *router;
+static vr_htable_t table;
+static struct vr_flow *keys;
+static uint8_t *present;
+static unsigned int nkeys;
+static struct stress_thread threads[STRESS_MAX_THREADS];
+static unsigned int nthreads;
+
+static volatile bool stress_running;
+static volatile bool maint_running;
+static volatile uint64_t stress_epoch = 1;
+static pthread_mutex_t defer_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct stress_defer *defer_head;
+static pthread_t maint_thread;
+static __thread unsigned int stress_cpu;
+
+static unsigned int
+stress_get_cpu(void)
+{
+    return stress_cpu;
+}
+
+static void *
+stress_get_defer_data(unsigned int len)
+{
+    struct stress_defer *defer;
+
+    defer = calloc(1, sizeof(*defer) + len);
+    if (!defer)
+        return NULL;
+
+    return defer->sd_data;
+}
+
+static void
+stress_put_defer_data(void *data)
+{
+    if (data)
+        free(CONTAINER_OF(sd_data, struct stress_defer, data));
+
+    return;
+}
+
+static void
+stress_defer(struct vrouter *router, vr_defer_cb cb, void *data)
+{
+    struct stress_defer *defer;
+
+    defer = CONTAINER_OF(sd_data, struct stress_defer, data);
+    defer->sd_cb = cb;
+    defer->sd_router = router;
+
+    pthread_mutex_lock(&defer_lock);
+    defer->sd_next = defer_head;
+    defer_head = defer;
+    pthread_mutex_unlock(&defer_lock);
+
+    return;
+}
+
+static void
+stress_work_cb(struct vrouter *router, void *arg)
+{
+    void **work = (void **)arg;
+
+    ((void (*)(void *))work[0])(work[1]);
+    return;
+}
+
+/*
+ * as in the DPDK vRouter, the deletion of overflow entries runs after a
+ * grace period, so that it never races with another one of the bucket
+ */
+static int
+stress_schedule_work(unsigned int cpu, void (*fn)(void *), void *arg)
+{
+    void **work;
+
+    if (!fn)
+        return -EINVAL;
+
+    if (fn != vr_htable_hentry_scheduled_delete) {
+        fn(arg);
+        return 0;
+    }
+
+    work = stress_get_defer_data(2 * sizeof(void *));
+    if (!work)
+        return -ENOMEM;
+
+    work[0] = (void *)fn;
+    work[1] = arg;
+    stress_defer(NULL, stress_work_cb, work);
+
+    return 0;
+}
+
+/* waits until every thread has been outside of the table since now */
+static void
+stress_synchronize(void)
+{
+    unsigned int i;
+    uint64_t epoch, seen;
+
+    epoch = __sync_add_and_fetch(&stress_epoch, 1);
+    for (i = 0; i < nthreads; i++) {
+        if (threads[i].st_cpu == stress_cpu && stress_cpu != max_threads)
+            continue;
+
+        do {
+            seen = threads[i].st_epoch;
+            if (seen == STRESS_EPOCH_OFFLINE || seen >= epoch)
+                break;
+            sched_yield();
+        } while (1);
+    }
+
+    return;
+}
+
+static void
+stress_delay_op(void)
+{
+    if (stress_cpu < nthreads)
+        threads[stress_cpu].st_epoch = stress_epoch;
+
+    stress_synchronize();
+    return;
+}
+
+/* runs the deferred callbacks, returns the number of them */
+static unsigned int
+stress_defer_run(void)
+{
+    unsigned int count = 0;
+    struct stress_defer *defer, *next;
+
+    pthread_mutex_lock(&defer_lock);
+    defer = defer_head;
+    defer_head = NULL;
+    pthread_mutex_unlock(&defer_lock);
+
+    if (!defer)
+        return 0;
+
+    stress_synchronize();
+
+    while (defer) {
+        next = defer->sd_next;
+        defer->sd_cb(defer->sd_router, defer->sd_data);
+        free(defer);
+        defer = next;
+        count++;
+    }
+
+    return count;
+}
+
+static void *
+stress_maint(void *arg)
+{
+    stress_cpu = max_threads;
+
+    while (maint_running) {
+        if (!stress_defer_run())
+            usleep(100);
+    }
+
+    /* the callbacks can defer more work, as the overflow deletes do */
+    while (stress_defer_run())
+        ;
+
+    return NULL;
+}
+
+static vr_hentry_key
+stress_get_key(vr_htable_t htable, vr_hentry_t *ent, unsigned int *len)
+{
+    struct stress_entry *se = (struct stress_entry *)ent;
+
+    if (!se->se_key_len)
+        return NULL;
+
+    if (len)
+        *len = se->se_key_len;
+
+    return &se->se_key;
+}
+
+static vr_hentry_t *
+stress_insert(struct vr_flow *key)
+{
+    vr_hentry_t *ent;
+    struct stress_entry *se;
+    struct vr_flow_entry *fe;
+
+    ent = vr_htable_find_free_hentry(table, key, key->flow_key_len);
+    if (!ent)
+        return NULL;
+
+    /* the key is published only once it is complete */
+    if (table_type == STRESS_TABLE_FLOW) {
+        fe = (struct vr_flow_entry *)ent;
+        memcpy(&fe->fe_key, key, key->flow_key_len);
+        fe->fe_key.flow_key_len = key->flow_key_len;
+        fe->fe_type = VP_TYPE_IP;
+        fe->fe_action = VR_FLOW_ACTION_DROP;
+        __sync_synchronize();
+        fe->fe_flags = VR_FLOW_FLAG_ACTIVE;
+    } else {
+        se = (struct stress_entry *)ent;
+        memcpy(&se->se_key, key, key->flow_key_len);
+        __sync_synchronize();
+        se->se_key_len = key->flow_key_len;
+    }
+
+    return ent;
+}
+
+static void
+stress_remove(vr_hentry_t *ent)
+{
+    struct vr_flow_entry *fe;
+
+    if (table_type == STRESS_TABLE_FLOW) {
+        fe = (struct vr_flow_entry *)ent;
+        fe->fe_flags = 0;
+        fe->fe_type = VP_TYPE_NULL;
+    } else {
+        ((struct stress_entry *)ent)->se_key_len = 0;
+    }
+
+    __sync_synchronize();
+    vr_htable_release_hentry(table, ent);
+
+    return;
+}
+
+static inline uint64_t
+stress_rand(struct stress_thread *st)
+{
+    st->st_rand ^= st->st_rand << 13;
+    st->st_rand ^= st->st_rand >> 7;
+    st->st_rand ^= st->st_rand << 17;
+
+    return st->st_rand;
+}
+
+static inline bool
+stress_key_owned(struct stress_thread *st, unsigned int k)
+{
+    return (k >= st->st_first_key) && (k < st->st_first_key + st->st_keys);
+}
+
+/* the owner of the key knows whether it has to be in the table */
+static void
+stress_check(struct stress_thread *st, unsigned int k, vr_hentry_t *expected)
+{
+    vr_hentry_t *ent;
+
+    ent = vr_htable_find_hentry(table, &keys[k], keys[k].flow_key_len);
+    if (present[k]) {
+        if (!ent || (expected && ent != expected))
+            st->st_violations++;
+    } else if (ent) {
+        st->st_violations++;
+    }
+
+    return;
+}
+
+static void *
+stress_worker(void *arg)
+{
+    unsigned int k;
+    vr_hentry_t *ent;
+    struct stress_thread *st = (struct stress_thread *)arg;
+
+    stress_cpu = st->st_cpu;
+
+    while (stress_running) {
+        st->st_epoch = stress_epoch;
+
+        if ((stress_rand(st) % 100) < churn) {
+            k = st->st_first_key + (stress_rand(st) % st->st_keys);
+            ent = vr_htable_find_hentry(table, &keys[k], keys[k].flow_key_len);
+            if (present[k]) {
+                if (!ent) {
+                    st->st_violations++;
+                    continue;
+                }
+
+                stress_remove(ent);
+                present[k] = 0;
+                st->st_deletes++;
+                stress_check(st, k, NULL);
+            } else {
+                if (ent) {
+                    st->st_violations++;
+                    continue;
+                }
+
+                ent = stress_insert(&keys[k]);
+                if (!ent) {
+                    st->st_full++;
+                    continue;
+                }
+
+                present[k] = 1;
+                st->st_inserts++;
+                stress_check(st, k, ent);
+            }
+
+            continue;
+        }
+
+        k = stress_rand(st) % nkeys;
+        st->st_lookups++;
+        if (stress_key_owned(st, k)) {
+            stress_check(st, k, NULL);
+            st->st_hits += present[k];
+        } else if (vr_htable_find_hentry(table, &keys[k],
+                    keys[k].flow_key_len)) {
+            st->st_hits++;
+        }
+    }
+
+    st->st_epoch = STRESS_EPOCH_OFFLINE;
+
+    return NULL;
+}
+
+static unsigned int
+stress_reset_keys(void)
+{
+    unsigned int k, failed = 0;
+    vr_hentry_t *ent;
+
+    stress_cpu = 0;
+    for (k = 0; k < nkeys; k++) {
+        ent = vr_htable_find_hentry(table, &keys[k], keys[k].flow_key_len);
+        if (ent) {
+            stress_remove(ent);
+            present[k] = 0;
+        }
+
+        /* half of the keys are in the table when a run starts */
+        if (k & 1) {
+            if (stress_insert(&keys[k]))
+                present[k] = 1;
+            else
+                failed++;
+        }
+    }
+
+    return failed;
+}
+
+/* with the threads stopped and the deletes flushed, the table is exact */
+static unsigned int
+stress_verify(void)
+{
+    unsigned int i, k, valid = 0, ovalid = 0, expected = 0, violations = 0;
+    vr_hentry_t *ent;
+    vr_hentry_key hkey;
+    unsigned int len;
+
+    for (k = 0; k < nkeys; k++) {
+        ent = vr_htable_find_hentry(table, &keys[k], keys[k].flow_key_len);
+        if (!!ent != !!present[k])
+            violations++;
+        expected += present[k];
+    }
+
+    for (i = 0; i < vr_htable_entries(table); i++) {
+        ent = vr_htable_get_hentry_by_index(table, i);
+        if (!ent)
+            continue;
+
+        valid++;
+        if (i >= main_entries)
+            ovalid++;
+
+        /* every entry is reachable by its key, and by it only */
+        if (table_type == STRESS_TABLE_FLOW)
+            hkey = &((struct vr_flow_entry *)ent)->fe_key;
+        else
+            hkey = &((struct stress_entry *)ent)->se_key;
+        len = ((struct vr_flow *)hkey)->flow_key_len;
+        if (vr_htable_find_hentry(table, hkey, len) != ent)
+            violations++;
+    }
+
+    if (valid != expected)
+        violations++;
+    if (vr_htable_used_total_entries(table) != expected)
+        violations++;
+    if (vr_htable_used_oflow_entries(table) != ovalid)
+        violations++;
+
+    return violations;
+}
+
+static int
+stress_run(unsigned int count)
+{
+    int ret;
+    unsigned int i, slice, failed, violations;
+    uint64_t ops, lookups = 0, hits = 0, inserts = 0, deletes = 0;
+    uint64_t full = 0, run_violations = 0;
+    struct timespec start, end;
+    double secs;
+
+    failed = stress_reset_keys();
+
+    nthreads = count;
+    slice = nkeys / count;
+    for (i = 0; i < count; i++) {
+        memset(&threads[i], 0, sizeof(threads[i]));
+        threads[i].st_cpu = i;
+        threads[i].st_first_key = i * slice;
+        threads[i].st_keys = (i == count - 1) ? (nkeys - i * slice) : slice;
+        threads[i].st_rand = 0x9e3779b97f4a7c15ULL * (i + 1);
+        threads[i].st_epoch = stress_epoch;
+    }
+
+    maint_running = true;
+    ret = pthread_create(&maint_thread, NULL, stress_maint, NULL);
+    if (ret)
+        return -ret;
+
+    stress_running = true;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < count; i++) {
+        ret = pthread_create(&threads[i].st_thread, NULL, stress_worker,
+                &threads[i]);
+        if (ret) {
+            stress_running = false;
+            count = i;
+            break;
+        }
+    }
+
+    if (count == nthreads)
+        sleep(duration);
+
+    stress_running = false;
+    for (i = 0; i < count; i++)
+        pthread_join(threads[i].st_thread, NULL);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    maint_running = false;
+    pthread_join(maint_thread, NULL);
+
+    if (count != nthreads)
+        return -ret;
+
+    violations = stress_verify();
+
+    for (i = 0; i < count; i++) {
+        lookups += threads[i].st_lookups;
+        hits += threads[i].st_hits;
+        inserts += threads[i].st_inserts;
+        deletes += threads[i].st_deletes;
+        full += threads[i].st_full;
+        run_violations += threads[i].st_violations;
+    }
+
+    secs = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    ops = lookups + inserts + deletes;
+    printf("%7u %10.3f %10.3f %12" PRIu64 " %6.1f%% %10" PRIu64 " %10"
+            PRIu64 " %8" PRIu64 " %10" PRIu64 " %8u\n", count,
+            ops / secs / 1e6, ops / secs / 1e6 / count, lookups,
+            lookups ? (100.0 * hits / lookups) : 0.0, inserts, deletes,
+            full + failed, run_violations, violations);
+
+    return (run_violations || violations) ? 1 : 0;
+}
+
+static void
+Usage(void)
+{
+    printf("Usage: htable_stress [--table htable|flow] [--entries <n>]\n");
+    printf("                     [--threads <n>[,<n>...]] [--churn <percent>]\n");
+    printf("                     [--duration <seconds>]\n\n");
+    printf("--table <table>    Standalone hash table or the flow table\n");
+    printf("--entries <n>      Entries of the table, as many keys are used\n");
+    printf("--threads <list>   Thread counts to run with, max %u\n",
+            STRESS_MAX_THREADS);
+    printf("--churn <percent>  Share of the operations that insert or delete\n");
+    printf("--duration <secs>  Duration of each run\n");
+
+    exit(-EINVAL);
+}
+
+enum opt_stress_index {
+    TABLE_OPT_INDEX,
+    ENTRIES_OPT_INDEX,
+    THREADS_OPT_INDEX,
+    CHURN_OPT_INDEX,
+    DURATION_OPT_INDEX,
+    HELP_OPT_INDEX,
+    MAX_OPT_INDEX
+};
+
+static struct option long_options[] = {
+    [TABLE_OPT_INDEX]       = {"table",         required_argument,  0,  0},
+    [ENTRIES_OPT_INDEX]     = {"entries",       required_argument,  0,  0},
+    [THREADS_OPT_INDEX]     = {"threads",       required_argument,  0,  0},
+    [CHURN_OPT_INDEX]       = {"churn",         required_argument,  0,  0},
+    [DURATION_OPT_INDEX]    = {"duration",      required_argument,  0,  0},
+    [HELP_OPT_INDEX]        = {"help",          no_argument,        0,  0},
+    [MAX_OPT_INDEX]         = {NULL,            0,                  0,  0},
+};
+
+static void
+parse_long_opts(int opt_index, char *opt_arg)
+{
+    errno = 0;
+
+    switch (opt_index) {
+    case TABLE_OPT_INDEX:
+        if (!strcmp(opt_arg, "htable"))
+            table_type = STRESS_TABLE_HTABLE;
+        else if (!strcmp(opt_arg, "flow"))
+            table_type = STRESS_TABLE_FLOW;
+        else
+            Usage();
+        break;
+
+    case ENTRIES_OPT_INDEX:
+        entries = strtoul(opt_arg, NULL, 0);
+        if (errno || entries < 1024)
+            Usage();
+        break;
+
+    case THREADS_OPT_INDEX:
+        thread_list = opt_arg;
+        break;
+
+    case CHURN_OPT_INDEX:
+        churn = strtoul(opt_arg, NULL, 0);
+        if (errno || churn > 100)
+            Usage();
+        break;
+
+    case DURATION_OPT_INDEX:
+        duration = strtoul(opt_arg, NULL, 0);
+        if (errno || !duration)
+            Usage();
+        break;
+
+    case HELP_OPT_INDEX:
+    default:
+        Usage();
+    }
+
+    return;
+}
+
+static int
+stress_init(void)
+{
+    unsigned int k;
+
+    if (table_type == STRESS_TABLE_FLOW) {
+        table = router->vr_flow_table;
+        oentries = vr_oflow_entries;
+    } else {
+        oentries = entries / 8;
+        table = vr_htable_create(router, entries, oentries,
+                sizeof(struct stress_entry), 0, 0, stress_get_key);
+    }
+
+    if (!table)
+        return -ENOMEM;
+
+    main_entries = vr_htable_entries(table) - oentries;
+
+    /* keep the table at most half full on average, overflow included */
+    nkeys = main_entries;
+    keys = calloc(nkeys, sizeof(*keys));
+    present = calloc(nkeys, sizeof(*present));
+    if (!keys || !present)
+        return -ENOMEM;
+
+    for (k = 0; k < nkeys; k++)
+        vr_inet_fill_flow(&keys[k], 0, htonl(0x0a000000 | (k >> 8)),
+                htonl(0x14000000 | k), VR_IP_PROTO_TCP, htons(k & 0xffff),
+                htons(80), VR_FLOW_KEY_ALL);
+
+    return 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+    int ret, opt, option_index, result = 0;
+    unsigned int count;
+    char *list, *token, *saveptr;
+
+    while ((opt = getopt_long(argc, argv, "", long_options,
+                    &option_index)) >= 0) {
+        switch (opt) {
+        case 0:
+            parse_long_opts(option_index, optarg);
+            break;
+
+        default:
+            Usage();
+        }
+    }
+
+    vr_num_cpus = max_threads + 1;
+    vr_flow_entries = entries;
+    vr_oflow_entries = entries / 8;
+
+    vr_diet_message_proto_init();
+    ret = vrouter_host_init(VR_MPROTO_SANDESH);
+    if (ret)
+        return ret;
+
+    vrouter_host->hos_get_cpu = stress_get_cpu;
+    vrouter_host->hos_schedule_work = stress_schedule_work;
+    vrouter_host->hos_delay_op = stress_delay_op;
+    vrouter_host->hos_defer = stress_defer;
+    vrouter_host->hos_get_defer_data = stress_get_defer_data;
+    vrouter_host->hos_put_defer_data = stress_put_defer_data;
+
+    router = vrouter_get(0);
+    if (!router)
+        return -ENODEV;
+
+    if ((ret = stress_init()))
+        return ret;
+
+    printf("%s table, %u entries, %u overflow entries, %u%% churn\n\n",
+            (table_type == STRESS_TABLE_FLOW) ? "Flow" : "Hash",
+            main_entries, oentries, churn);
+    printf("%7s %10s %10s %12s %7s %10s %10s %8s %10s %8s\n", "Threads",
+            "Mops/s", "Mops/s/thr", "Lookups", "Hits", "Inserts", "Deletes",
+            "Full", "Violation", "Verify");
+
+    list = strdup(thread_list);
+    for (token = strtok_r(list, ",", &saveptr); token;
+            token = strtok_r(NULL, ",", &saveptr)) {
+        count = strtoul(token, NULL, 0);
+        if (!count || count > max_threads)
+            Usage();
+
+        ret = stress_run(count);
+        if (ret < 0) {
+            printf("%7u failed to start the threads: %s\n", count,
+                    strerror(-ret));
+            result = 1;
+            break;
+        }
+
+        result |= ret;
+    }
+
+    free(list);
+
+    return result;
+}
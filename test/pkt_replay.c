@@ -0,0 +1,1031 @@
+/*
+ * pkt_replay.c -- end to end throughput of the userspace vRouter
+ *
+ * Sets up the vRouter of the host library from a configuration file,
+ * then replays the packets of pcap files and of generated traffic mixes
+ * from memory straight into vif_rx of the interfaces, without sockets,
+ * and reports the throughput, the distribution of the time spent in the
+ * datapath per packet, the transmitted packets and the drop reasons.
+ *
+ * The configuration is one object per line, made of a keyword and of
+ * name value pairs. '#' starts a comment.
+ *
+ *   vif <idx> physical|virtual|agent|vhost mac <mac> [vrf <vrf>] [ip <ip>]
+ *           [nh <nh>] [mtu <mtu>] [os_idx <hif>] [policy]
+ *   nh <id> discard
+ *   nh <id> receive oif <vif> [vrf <vrf>]
+ *   nh <id> encap oif <vif> dmac <mac> [vrf <vrf>] [l2] [policy]
+ *   nh <id> tunnel gre|udp|vxlan oif <vif> dmac <mac> sip <ip> dip <ip>
+ *           [vrf <vrf>]
+ *   nh <id> composite ecmp|l2|fabric members <nh>:<label>[,...] [vrf <vrf>]
+ *   route vrf <vrf> prefix <ip>/<len> nh <nh> [label <label>]
+ *   bridge vrf <vrf> mac <mac> nh <nh> [label <label>]
+ *   mpls label <label> nh <nh>
+ *   vxlan vnid <vnid> nh <nh>
+ *   flow vrf <vrf> sip <ip> dip <ip> proto <proto> sport <port>
+ *           dport <port> nh <key nh> action forward|drop
+ *   traffic vm|mpls_udp|mpls_gre|vxlan vif <idx> sip <ip> dip <ip>
+ *           [osip <ip> odip <ip>] [label <label>] [vnid <vnid>]
+ *           [smac <mac>] [dmac <mac>] [flows <n>] [size <bytes>]
+ *           [weight <n>]
+ *   pcap file <path> vif <idx>
+ *
+ * Copyright (c) 2016 Juniper Networks, Inc. All rights reserved.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <time.h>
+#include <arpa/inet.h>
+
+#include "vr_types.h"
+#include "vr_os.h"
+#include "vr_packet.h"
+#include "vr_message.h"
+#include "vr_interface.h"
+#include "vr_nexthop.h"
+#include "vr_route.h"
+#include "vr_mpls.h"
+#include "vr_flow.h"
+#include "vr_mirror.h"
+#include "vr_defs.h"
+
+#include "host/vr_host.h"
+#include "host/vr_host_packet.h"
+#include "host/vr_host_interface.h"
+
+#include "common_test.h"
+
+extern int vrouter_host_init(unsigned int);
+extern unsigned int vr_num_cpus;
+
+extern void vr_interface_req_process(void *);
+extern void vr_nexthop_req_process(void *);
+extern void vr_route_req_process(void *);
+extern void vr_mpls_req_process(void *);
+extern void vr_vxlan_req_process(void *);
+extern void vr_flow_req_process(void *);
+
+#define REPLAY_MAX_ARGS         48
+#define REPLAY_MAX_MEMBERS      32
+#define REPLAY_MAX_FRAME        9216
+#define REPLAY_HIST_BUCKETS     32
+#define REPLAY_PCAP_MAGIC       0xa1b2c3d4
+#define REPLAY_PCAP_NSEC_MAGIC  0xa1b23c4d
+
+struct replay_frame {
+    struct vr_interface *rf_vif;
+    unsigned int rf_vif_idx;
+    unsigned int rf_len;
+    unsigned char *rf_data;
+};
+
+struct replay_pcap_hdr {
+    uint32_t rph_magic;
+    uint16_t rph_major;
+    uint16_t rph_minor;
+    int32_t rph_zone;
+    uint32_t rph_sigfigs;
+    uint32_t rph_snaplen;
+    uint32_t rph_linktype;
+};
+
+/* generated traffic, by the encapsulation headers before the inner frame */
+struct replay_kind {
+    const char *name;
+    unsigned int outer;
+};
+
+static struct replay_kind replay_kinds[] = {
+    {"vm",          0},
+    {"mpls_udp",    sizeof(struct vr_ip) + sizeof(struct vr_udp) +
+                        VR_MPLS_HDR_LEN},
+    {"mpls_gre",    sizeof(struct vr_ip) + sizeof(struct vr_gre) +
+                        VR_MPLS_HDR_LEN},
+    {"vxlan",       sizeof(struct vr_ip) + sizeof(struct vr_udp) +
+                        sizeof(struct vr_vxlan) + VR_ETHER_HLEN},
+    {NULL,          0},
+};
+
+static struct vrouter *router;
+static char *config_file;
+static uint64_t count = 1000000;
+static unsigned int latency_sample = 1;
+
+static struct replay_frame *frames;
+static unsigned int nframes, frames_size;
+static unsigned int *schedule;
+static unsigned int nschedule, schedule_size;
+
+static unsigned int replay_line;
+
+static uint64_t latency_hist[REPLAY_HIST_BUCKETS];
+static uint64_t drops_before[VP_DROP_MAX];
+
+/* runs a request the way the agent would send it, returns its result */
+static int
+replay_request(void (*process)(void *), void *req)
+{
+    process(req);
+
+    return test_drain_responses();
+}
+
+static char *
+replay_arg(int argc, char **argv, const char *name)
+{
+    int i;
+
+    for (i = 0; i < argc - 1; i++) {
+        if (!strcmp(argv[i], name))
+            return argv[i + 1];
+    }
+
+    return NULL;
+}
+
+static bool
+replay_flag(int argc, char **argv, const char *name)
+{
+    int i;
+
+    for (i = 0; i < argc; i++) {
+        if (!strcmp(argv[i], name))
+            return true;
+    }
+
+    return false;
+}
+
+static int
+replay_int(int argc, char **argv, const char *name, int def)
+{
+    char *value = replay_arg(argc, argv, name);
+
+    if (!value)
+        return def;
+
+    return strtol(value, NULL, 0);
+}
+
+static int
+replay_ip(int argc, char **argv, const char *name, uint32_t *ip)
+{
+    char *value = replay_arg(argc, argv, name);
+
+    if (!value || inet_pton(AF_INET, value, ip) != 1)
+        return -EINVAL;
+
+    return 0;
+}
+
+static int
+replay_mac(int argc, char **argv, const char *name, uint8_t *mac)
+{
+    unsigned int m[VR_ETHER_ALEN], i;
+    char *value = replay_arg(argc, argv, name);
+
+    if (!value || sscanf(value, "%x:%x:%x:%x:%x:%x", &m[0], &m[1], &m[2],
+                &m[3], &m[4], &m[5]) != VR_ETHER_ALEN)
+        return -EINVAL;
+
+    for (i = 0; i < VR_ETHER_ALEN; i++)
+        mac[i] = m[i];
+
+    return 0;
+}
+
+static struct vr_interface *
+replay_vif(unsigned int idx)
+{
+    return __vrouter_get_interface(router, idx);
+}
+
+static int
+replay_config_vif(int argc, char **argv)
+{
+    int ret, os_idx;
+    uint32_t ip = 0;
+    uint8_t mac[VR_ETHER_ALEN];
+    struct vr_hinterface *hif;
+    vr_interface_req req;
+
+    static unsigned int physical, virtual;
+
+    if (argc < 3)
+        return -EINVAL;
+
+    memset(&req, 0, sizeof(req));
+    req.h_op = SANDESH_OP_ADD;
+    req.vifr_idx = strtoul(argv[1], NULL, 0);
+    req.vifr_transport = VIF_TRANSPORT_ETH;
+    if (!strcmp(argv[2], "physical")) {
+        req.vifr_type = VIF_TYPE_PHYSICAL;
+        os_idx = HIF_PHYSICAL_INTERFACE_INDEX + physical++;
+    } else if (!strcmp(argv[2], "virtual")) {
+        req.vifr_type = VIF_TYPE_VIRTUAL;
+        req.vifr_transport = VIF_TRANSPORT_VIRTUAL;
+        os_idx = HIF_VIRTUAL_INTERFACE_INDEX_START + virtual++;
+    } else if (!strcmp(argv[2], "agent")) {
+        req.vifr_type = VIF_TYPE_AGENT;
+        os_idx = HIF_AGENT_INTERFACE_INDEX;
+    } else if (!strcmp(argv[2], "vhost")) {
+        req.vifr_type = VIF_TYPE_HOST;
+        os_idx = HIF_VHOST_INTERFACE_INDEX;
+    } else {
+        return -EINVAL;
+    }
+
+    if (replay_mac(argc, argv, "mac", mac))
+        return -EINVAL;
+
+    os_idx = replay_int(argc, argv, "os_idx", os_idx);
+    hif = vr_hinterface_create(os_idx, HIF_TYPE_UDP, req.vifr_type);
+    if (!hif)
+        return -ENODEV;
+    hif->hif_tx = test_sink_tx;
+
+    replay_ip(argc, argv, "ip", &ip);
+
+    req.vifr_os_idx = os_idx;
+    req.vifr_name = argv[2];
+    req.vifr_mac = (int8_t *)mac;
+    req.vifr_mac_size = VR_ETHER_ALEN;
+    req.vifr_vrf = replay_int(argc, argv, "vrf", 0);
+    req.vifr_ip = ip;
+    req.vifr_nh_id = replay_int(argc, argv, "nh", 0);
+    req.vifr_mtu = replay_int(argc, argv, "mtu", 1514);
+    req.vifr_mir_id = -1;
+    req.vifr_flags = VIF_FLAG_L3_ENABLED | VIF_FLAG_L2_ENABLED;
+    if (replay_flag(argc, argv, "policy"))
+        req.vifr_flags |= VIF_FLAG_POLICY_ENABLED;
+
+    ret = replay_request(vr_interface_req_process, &req);
+    if (ret)
+        vr_hinterface_delete(hif);
+
+    return ret;
+}
+
+static int
+replay_config_nh(int argc, char **argv)
+{
+    unsigned int i = 0;
+    int32_t nh_list[REPLAY_MAX_MEMBERS], label_list[REPLAY_MAX_MEMBERS];
+    char *members, *member, *saveptr;
+    uint8_t encap[VR_ETHER_HLEN];
+    struct vr_interface *vif;
+    vr_nexthop_req req;
+
+    if (argc < 3)
+        return -EINVAL;
+
+    memset(&req, 0, sizeof(req));
+    req.h_op = SANDESH_OP_ADD;
+    req.nhr_id = strtoul(argv[1], NULL, 0);
+    req.nhr_family = AF_INET;
+    req.nhr_flags = NH_FLAG_VALID;
+    req.nhr_vrf = replay_int(argc, argv, "vrf", 0);
+    req.nhr_encap_oif_id = replay_int(argc, argv, "oif", -1);
+    if (replay_flag(argc, argv, "policy"))
+        req.nhr_flags |= NH_FLAG_POLICY_ENABLED;
+
+    /* the rewrite is to the given mac from the one of the interface */
+    if (!replay_mac(argc, argv, "dmac", encap)) {
+        vif = replay_vif(req.nhr_encap_oif_id);
+        if (!vif)
+            return -ENODEV;
+
+        memcpy(encap + VR_ETHER_ALEN, vif->vif_mac, VR_ETHER_ALEN);
+        *(uint16_t *)(encap + 2 * VR_ETHER_ALEN) = htons(VR_ETH_PROTO_IP);
+        req.nhr_encap = (int8_t *)encap;
+        req.nhr_encap_size = sizeof(encap);
+    }
+
+    if (!strcmp(argv[2], "discard")) {
+        req.nhr_type = NH_DISCARD;
+    } else if (!strcmp(argv[2], "receive")) {
+        req.nhr_type = NH_RCV;
+    } else if (!strcmp(argv[2], "encap")) {
+        req.nhr_type = NH_ENCAP;
+        if (replay_flag(argc, argv, "l2")) {
+            req.nhr_family = AF_BRIDGE;
+            req.nhr_flags |= NH_FLAG_ENCAP_L2;
+        }
+    } else if (!strcmp(argv[2], "tunnel") && argc > 3) {
+        req.nhr_type = NH_TUNNEL;
+        if (!strcmp(argv[3], "gre"))
+            req.nhr_flags |= NH_FLAG_TUNNEL_GRE;
+        else if (!strcmp(argv[3], "udp"))
+            req.nhr_flags |= NH_FLAG_TUNNEL_UDP_MPLS;
+        else if (!strcmp(argv[3], "vxlan"))
+            req.nhr_flags |= NH_FLAG_TUNNEL_VXLAN;
+        else
+            return -EINVAL;
+
+        if (replay_ip(argc, argv, "sip", &req.nhr_tun_sip) ||
+                replay_ip(argc, argv, "dip", &req.nhr_tun_dip))
+            return -EINVAL;
+    } else if (!strcmp(argv[2], "composite") && argc > 3) {
+        req.nhr_type = NH_COMPOSITE;
+        if (!strcmp(argv[3], "ecmp")) {
+            req.nhr_flags |= NH_FLAG_COMPOSITE_ECMP;
+        } else if (!strcmp(argv[3], "l2")) {
+            req.nhr_family = AF_BRIDGE;
+            req.nhr_flags |= NH_FLAG_COMPOSITE_L2;
+        } else if (!strcmp(argv[3], "fabric")) {
+            req.nhr_family = AF_BRIDGE;
+            req.nhr_flags |= NH_FLAG_COMPOSITE_FABRIC;
+        } else {
+            return -EINVAL;
+        }
+
+        members = replay_arg(argc, argv, "members");
+        if (!members)
+            return -EINVAL;
+
+        for (member = strtok_r(members, ",", &saveptr);
+                member && i < REPLAY_MAX_MEMBERS;
+                member = strtok_r(NULL, ",", &saveptr), i++) {
+            label_list[i] = 0;
+            if (sscanf(member, "%d:%d", &nh_list[i], &label_list[i]) < 1)
+                return -EINVAL;
+        }
+
+        req.nhr_nh_list = nh_list;
+        req.nhr_nh_list_size = i;
+        req.nhr_label_list = label_list;
+        req.nhr_label_list_size = i;
+    } else {
+        return -EINVAL;
+    }
+
+    return replay_request(vr_nexthop_req_process, &req);
+}
+
+static int
+replay_config_route(int argc, char **argv, bool bridge)
+{
+    int label;
+    uint32_t prefix;
+    uint8_t mac[VR_ETHER_ALEN];
+    char *value, *len;
+    vr_route_req req;
+
+    memset(&req, 0, sizeof(req));
+    req.h_op = SANDESH_OP_ADD;
+    req.rtr_vrf_id = replay_int(argc, argv, "vrf", 0);
+    req.rtr_nh_id = replay_int(argc, argv, "nh", NH_DISCARD_ID);
+    req.rtr_index = -1;
+    req.rtr_label = -1;
+
+    label = replay_int(argc, argv, "label", -1);
+    if (label >= 0) {
+        req.rtr_label = label;
+        req.rtr_label_flags = VR_RT_LABEL_VALID_FLAG;
+    }
+
+    if (bridge) {
+        if (replay_mac(argc, argv, "mac", mac))
+            return -EINVAL;
+
+        req.rtr_family = AF_BRIDGE;
+        req.rtr_mac = (int8_t *)mac;
+        req.rtr_mac_size = VR_ETHER_ALEN;
+    } else {
+        value = replay_arg(argc, argv, "prefix");
+        if (!value)
+            return -EINVAL;
+
+        len = strchr(value, '/');
+        if (len)
+            *len++ = '\0';
+        if (inet_pton(AF_INET, value, &prefix) != 1)
+            return -EINVAL;
+
+        req.rtr_family = AF_INET;
+        req.rtr_prefix = (int8_t *)&prefix;
+        req.rtr_prefix_size = sizeof(prefix);
+        req.rtr_prefix_len = len ? strtoul(len, NULL, 0) : 32;
+    }
+
+    return replay_request(vr_route_req_process, &req);
+}
+
+static int
+replay_config_mpls(int argc, char **argv)
+{
+    vr_mpls_req req;
+
+    memset(&req, 0, sizeof(req));
+    req.h_op = SANDESH_OP_ADD;
+    req.mr_label = replay_int(argc, argv, "label", -1);
+    req.mr_nhid = replay_int(argc, argv, "nh", NH_DISCARD_ID);
+
+    return replay_request(vr_mpls_req_process, &req);
+}
+
+static int
+replay_config_vxlan(int argc, char **argv)
+{
+    vr_vxlan_req req;
+
+    memset(&req, 0, sizeof(req));
+    req.h_op = SANDESH_OP_ADD;
+    req.vxlanr_vnid = replay_int(argc, argv, "vnid", -1);
+    req.vxlanr_nhid = replay_int(argc, argv, "nh", NH_DISCARD_ID);
+
+    return replay_request(vr_vxlan_req_process, &req);
+}
+
+static int
+replay_config_flow(int argc, char **argv)
+{
+    uint32_t sip, dip;
+    char *action;
+    vr_flow_req req;
+
+    if (replay_ip(argc, argv, "sip", &sip) ||
+            replay_ip(argc, argv, "dip", &dip))
+        return -EINVAL;
+
+    memset(&req, 0, sizeof(req));
+    req.fr_op = FLOW_OP_FLOW_SET;
+    req.fr_index = -1;
+    req.fr_rindex = -1;
+    req.fr_family = AF_INET;
+    req.fr_flags = VR_FLOW_FLAG_ACTIVE;
+    req.fr_flow_sip_l = sip;
+    req.fr_flow_dip_l = dip;
+    req.fr_flow_proto = replay_int(argc, argv, "proto", VR_IP_PROTO_UDP);
+    req.fr_flow_sport = htons(replay_int(argc, argv, "sport", 0));
+    req.fr_flow_dport = htons(replay_int(argc, argv, "dport", 0));
+    req.fr_flow_vrf = replay_int(argc, argv, "vrf", 0);
+    req.fr_flow_nh_id = replay_int(argc, argv, "nh", 0);
+    req.fr_mir_id = VR_MAX_MIRROR_INDICES;
+    req.fr_sec_mir_id = VR_MAX_MIRROR_INDICES;
+    req.fr_ecmp_nh_index = -1;
+    req.fr_src_nh_index = NH_DISCARD_ID;
+
+    action = replay_arg(argc, argv, "action");
+    if (!action || !strcmp(action, "forward"))
+        req.fr_action = VR_FLOW_ACTION_FORWARD;
+    else if (!strcmp(action, "drop"))
+        req.fr_action = VR_FLOW_ACTION_DROP;
+    else
+        return -EINVAL;
+
+    return replay_request(vr_flow_req_process, &req);
+}
+
+static struct replay_frame *
+replay_frame_add(unsigned int vif_idx, unsigned int len, unsigned int weight)
+{
+    unsigned int i;
+    struct replay_frame *frame;
+
+    if (!len || len > REPLAY_MAX_FRAME)
+        return NULL;
+
+    if (nframes == frames_size) {
+        frames_size = frames_size ? 2 * frames_size : 1024;
+        frames = realloc(frames, frames_size * sizeof(*frames));
+        if (!frames)
+            return NULL;
+    }
+
+    if (nschedule + weight > schedule_size) {
+        schedule_size = 2 * (nschedule + weight);
+        schedule = realloc(schedule, schedule_size * sizeof(*schedule));
+        if (!schedule)
+            return NULL;
+    }
+
+    frame = &frames[nframes];
+    frame->rf_vif_idx = vif_idx;
+    frame->rf_vif = replay_vif(vif_idx);
+    frame->rf_len = len;
+    frame->rf_data = calloc(1, len);
+    if (!frame->rf_vif || !frame->rf_data)
+        return NULL;
+
+    for (i = 0; i < weight; i++)
+        schedule[nschedule++] = nframes;
+    nframes++;
+
+    return frame;
+}
+
+static unsigned char *
+replay_put_ip(unsigned char *data, uint32_t sip, uint32_t dip,
+        unsigned char proto, unsigned int len)
+{
+    struct vr_ip *ip = (struct vr_ip *)data;
+
+    ip->ip_version = 4;
+    ip->ip_hl = 5;
+    ip->ip_ttl = 64;
+    ip->ip_proto = proto;
+    ip->ip_len = htons(len);
+    ip->ip_saddr = sip;
+    ip->ip_daddr = dip;
+    ip->ip_csum = 0;
+    ip->ip_csum = vr_ip_csum(ip);
+
+    return (unsigned char *)(ip + 1);
+}
+
+static unsigned char *
+replay_put_udp(unsigned char *data, unsigned short sport,
+        unsigned short dport, unsigned int len)
+{
+    struct vr_udp *udp = (struct vr_udp *)data;
+
+    udp->udp_sport = htons(sport);
+    udp->udp_dport = htons(dport);
+    udp->udp_length = htons(len);
+    udp->udp_csum = 0;
+
+    return (unsigned char *)(udp + 1);
+}
+
+static unsigned char *
+replay_put_eth(unsigned char *data, uint8_t *dmac, uint8_t *smac,
+        unsigned short proto)
+{
+    struct vr_eth *eth = (struct vr_eth *)data;
+
+    memcpy(eth->eth_dmac, dmac, VR_ETHER_ALEN);
+    memcpy(eth->eth_smac, smac, VR_ETHER_ALEN);
+    eth->eth_proto = htons(proto);
+
+    return (unsigned char *)(eth + 1);
+}
+
+/*
+ * one frame per flow, the flows differing in the source port of the
+ * inner packet. 'size' is the length of the inner IP packet
+ */
+static int
+replay_config_traffic(int argc, char **argv)
+{
+    unsigned int i, flows, size, weight, vif_idx, len, label, vnid;
+    unsigned int outer_len = 0, inner_len;
+    uint32_t sip, dip, osip = 0, odip = 0;
+    uint8_t smac[VR_ETHER_ALEN] = {0x02, 0x00, 0x00, 0x00, 0x00, 0xfe};
+    uint8_t dmac[VR_ETHER_ALEN] = {0x00, 0x00, 0x5e, 0x00, 0x01, 0x00};
+    unsigned char *data;
+    struct vr_interface *vif;
+    struct replay_kind *kind;
+
+    if (argc < 2)
+        return -EINVAL;
+
+    for (kind = replay_kinds; kind->name; kind++) {
+        if (!strcmp(kind->name, argv[1]))
+            break;
+    }
+
+    if (!kind->name)
+        return -EINVAL;
+
+    vif_idx = replay_int(argc, argv, "vif", -1);
+    vif = replay_vif(vif_idx);
+    if (!vif)
+        return -ENODEV;
+
+    if (replay_ip(argc, argv, "sip", &sip) ||
+            replay_ip(argc, argv, "dip", &dip))
+        return -EINVAL;
+
+    if (kind->outer) {
+        if (replay_ip(argc, argv, "osip", &osip) ||
+                replay_ip(argc, argv, "odip", &odip))
+            return -EINVAL;
+        /* the outer frame is to the fabric interface */
+        memcpy(dmac, vif->vif_mac, VR_ETHER_ALEN);
+    }
+
+    replay_mac(argc, argv, "smac", smac);
+    replay_mac(argc, argv, "dmac", dmac);
+    flows = replay_int(argc, argv, "flows", 1);
+    size = replay_int(argc, argv, "size", 64);
+    weight = replay_int(argc, argv, "weight", 1);
+    label = replay_int(argc, argv, "label", 16);
+    vnid = replay_int(argc, argv, "vnid", 1);
+
+    if (size < sizeof(struct vr_ip) + sizeof(struct vr_udp))
+        size = sizeof(struct vr_ip) + sizeof(struct vr_udp);
+
+    outer_len = kind->outer;
+    len = VR_ETHER_HLEN + outer_len + size;
+
+    for (i = 0; i < flows; i++) {
+        if (!replay_frame_add(vif_idx, len, weight))
+            return -ENOMEM;
+
+        data = frames[nframes - 1].rf_data;
+        data = replay_put_eth(data, dmac, smac, VR_ETH_PROTO_IP);
+
+        if (!strcmp(kind->name, "mpls_udp") || !strcmp(kind->name, "vxlan")) {
+            data = replay_put_ip(data, osip, odip, VR_IP_PROTO_UDP,
+                    outer_len + size);
+            data = replay_put_udp(data, 49152 + (i & 0x3fff),
+                    strcmp(kind->name, "vxlan") ? VR_MPLS_OVER_UDP_DST_PORT :
+                    VR_VXLAN_UDP_DST_PORT,
+                    outer_len - sizeof(struct vr_ip) + size);
+        } else if (!strcmp(kind->name, "mpls_gre")) {
+            data = replay_put_ip(data, osip, odip, VR_IP_PROTO_GRE,
+                    outer_len + size);
+            ((struct vr_gre *)data)->gre_flags = 0;
+            ((struct vr_gre *)data)->gre_proto = VR_GRE_PROTO_MPLS_NO;
+            data += sizeof(struct vr_gre);
+        }
+
+        if (!strcmp(kind->name, "vxlan")) {
+            ((struct vr_vxlan *)data)->vxlan_flags = htonl(VR_VXLAN_IBIT);
+            ((struct vr_vxlan *)data)->vxlan_vnid = htonl(vnid << 8);
+            data += sizeof(struct vr_vxlan);
+            data = replay_put_eth(data, dmac, smac, VR_ETH_PROTO_IP);
+        } else if (kind->outer) {
+            *(uint32_t *)data = htonl((label << VR_MPLS_LABEL_SHIFT) |
+                    VR_MPLS_STACK_BIT | 64);
+            data += VR_MPLS_HDR_LEN;
+        }
+
+        inner_len = size;
+        data = replay_put_ip(data, sip, dip, VR_IP_PROTO_UDP, inner_len);
+        replay_put_udp(data, 1024 + (i % 64000), 5001,
+                inner_len - sizeof(struct vr_ip));
+    }
+
+    return 0;
+}
+
+static inline uint32_t
+replay_pcap_32(uint32_t value, bool swap)
+{
+    return swap ? __builtin_bswap32(value) : value;
+}
+
+static int
+replay_config_pcap(int argc, char **argv)
+{
+    int ret = 0;
+    bool swap;
+    unsigned int vif_idx, len;
+    char *file;
+    FILE *fp;
+    struct vr_pcap rec;
+    struct replay_frame *frame;
+    struct replay_pcap_hdr hdr;
+
+    file = replay_arg(argc, argv, "file");
+    vif_idx = replay_int(argc, argv, "vif", -1);
+    if (!file || !replay_vif(vif_idx))
+        return -EINVAL;
+
+    fp = fopen(file, "r");
+    if (!fp)
+        return -errno;
+
+    if (fread(&hdr, sizeof(hdr), 1, fp) != 1) {
+        ret = -EINVAL;
+        goto exit_pcap;
+    }
+
+    if (hdr.rph_magic == REPLAY_PCAP_MAGIC ||
+            hdr.rph_magic == REPLAY_PCAP_NSEC_MAGIC) {
+        swap = false;
+    } else if (__builtin_bswap32(hdr.rph_magic) == REPLAY_PCAP_MAGIC ||
+            __builtin_bswap32(hdr.rph_magic) == REPLAY_PCAP_NSEC_MAGIC) {
+        swap = true;
+    } else {
+        ret = -EINVAL;
+        goto exit_pcap;
+    }
+
+    /* only ethernet captures can go to vif_rx */
+    if (replay_pcap_32(hdr.rph_linktype, swap) != 1) {
+        ret = -EPROTONOSUPPORT;
+        goto exit_pcap;
+    }
+
+    while (fread(&rec, sizeof(rec), 1, fp) == 1) {
+        len = replay_pcap_32(rec.pcap_incl_len, swap);
+        if (len > REPLAY_MAX_FRAME) {
+            ret = -EFBIG;
+            break;
+        }
+
+        frame = replay_frame_add(vif_idx, len, 1);
+        if (!frame) {
+            ret = -ENOMEM;
+            break;
+        }
+
+        if (fread(frame->rf_data, len, 1, fp) != 1) {
+            ret = -EINVAL;
+            break;
+        }
+    }
+
+exit_pcap:
+    fclose(fp);
+    return ret;
+}
+
+static int
+replay_config(const char *file)
+{
+    int ret = 0, argc;
+    char line[1024], *argv[REPLAY_MAX_ARGS], *token, *saveptr, *comment;
+    FILE *fp;
+
+    fp = fopen(file, "r");
+    if (!fp) {
+        perror(file);
+        return -errno;
+    }
+
+    while (fgets(line, sizeof(line), fp)) {
+        replay_line++;
+        if ((comment = strchr(line, '#')))
+            *comment = '\0';
+
+        argc = 0;
+        for (token = strtok_r(line, " \t\r\n", &saveptr);
+                token && argc < REPLAY_MAX_ARGS;
+                token = strtok_r(NULL, " \t\r\n", &saveptr))
+            argv[argc++] = token;
+
+        if (!argc)
+            continue;
+
+        if (!strcmp(argv[0], "vif"))
+            ret = replay_config_vif(argc, argv);
+        else if (!strcmp(argv[0], "nh"))
+            ret = replay_config_nh(argc, argv);
+        else if (!strcmp(argv[0], "route"))
+            ret = replay_config_route(argc, argv, false);
+        else if (!strcmp(argv[0], "bridge"))
+            ret = replay_config_route(argc, argv, true);
+        else if (!strcmp(argv[0], "mpls"))
+            ret = replay_config_mpls(argc, argv);
+        else if (!strcmp(argv[0], "vxlan"))
+            ret = replay_config_vxlan(argc, argv);
+        else if (!strcmp(argv[0], "flow"))
+            ret = replay_config_flow(argc, argv);
+        else if (!strcmp(argv[0], "traffic"))
+            ret = replay_config_traffic(argc, argv);
+        else if (!strcmp(argv[0], "pcap"))
+            ret = replay_config_pcap(argc, argv);
+        else
+            ret = -EINVAL;
+
+        if (ret) {
+            fprintf(stderr, "%s:%u: %s failed: %s (%d)\n", file, replay_line,
+                    argv[0], strerror(-ret), ret);
+            break;
+        }
+    }
+
+    fclose(fp);
+    return ret;
+}
+
+static inline uint64_t
+replay_now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void
+replay_drop_stats(uint64_t *stats)
+{
+    unsigned int cpu, reason;
+
+    memset(stats, 0, VP_DROP_MAX * sizeof(*stats));
+    for (cpu = 0; cpu < vr_num_cpus; cpu++) {
+        for (reason = 0; reason < VP_DROP_MAX; reason++)
+            stats[reason] += router->vr_pdrop_stats[cpu][reason];
+    }
+
+    return;
+}
+
+/*
+ * the packet is a copy of the frame, as the datapath rewrites it in
+ * place, with the head room the datapath expects for the encapsulation
+ */
+static struct vr_packet *
+replay_packet(struct replay_frame *frame)
+{
+    struct vr_packet *pkt;
+    struct vr_hpacket *hpkt;
+
+    pkt = vr_palloc(frame->rf_len + 2 * VR_HPACKET_HEAD_SPACE);
+    if (!pkt)
+        return NULL;
+
+    memcpy(pkt_data(pkt), frame->rf_data, frame->rf_len);
+    hpkt = VR_PACKET_TO_HPACKET(pkt);
+    hpkt->hp_tail = hpkt->hp_data + frame->rf_len;
+    pkt->vp_tail = hpkt->hp_tail;
+    pkt->vp_len = frame->rf_len;
+    pkt->vp_if = frame->rf_vif;
+    pkt->vp_cpu = vr_get_cpu();
+
+    return pkt;
+}
+
+static void
+replay_run(void)
+{
+    unsigned int i, bucket;
+    uint64_t n, start, end, t0 = 0, ns, sampled = 0, cumulative;
+    uint64_t rx_bytes = 0, tx_total = 0, drops[VP_DROP_MAX];
+    double secs;
+    struct vr_packet *pkt;
+    struct replay_frame *frame;
+    static const double percentiles[] = {50, 90, 99, 99.9};
+    unsigned int p = 0;
+
+    replay_drop_stats(drops_before);
+
+    start = replay_now_ns();
+    for (n = 0; n < count; n++) {
+        frame = &frames[schedule[n % nschedule]];
+        if (!(n % latency_sample))
+            t0 = replay_now_ns();
+
+        pkt = replay_packet(frame);
+        if (!pkt)
+            break;
+
+        rx_bytes += frame->rf_len;
+        frame->rf_vif->vif_rx(frame->rf_vif, pkt, VLAN_ID_INVALID);
+
+        if (!(n % latency_sample)) {
+            ns = replay_now_ns() - t0;
+            bucket = ns ? (63 - __builtin_clzll(ns)) : 0;
+            if (bucket >= REPLAY_HIST_BUCKETS)
+                bucket = REPLAY_HIST_BUCKETS - 1;
+            latency_hist[bucket]++;
+            sampled++;
+        }
+    }
+    end = replay_now_ns();
+
+    secs = (end - start) / 1e9;
+    printf("Replayed %" PRIu64 " packets of %u frames in %.3f s: "
+            "%.3f Mpps, %.1f Mbps\n\n", n, nframes, secs, n / secs / 1e6,
+            rx_bytes * 8 / secs / 1e6);
+
+    printf("Time in the datapath per packet, %" PRIu64 " samples\n", sampled);
+    cumulative = 0;
+    for (i = 0; i < REPLAY_HIST_BUCKETS; i++) {
+        if (!latency_hist[i])
+            continue;
+
+        cumulative += latency_hist[i];
+        printf("    < %10" PRIu64 " ns %12" PRIu64 " %6.2f%%",
+                (uint64_t)2 << i, latency_hist[i],
+                100.0 * latency_hist[i] / sampled);
+        while (p < sizeof(percentiles) / sizeof(percentiles[0]) &&
+                cumulative * 100.0 >= percentiles[p] * sampled)
+            printf(" p%g", percentiles[p++]);
+        printf("\n");
+    }
+
+    printf("\nTransmitted\n");
+    for (i = 0; i < HIF_MAX_INTERFACES; i++) {
+        if (!test_sink_packets[i])
+            continue;
+
+        tx_total += test_sink_packets[i];
+        printf("    hif %-4u %12" PRIu64 " packets %14" PRIu64 " bytes\n", i,
+                test_sink_packets[i], test_sink_bytes[i]);
+    }
+    printf("    total    %12" PRIu64 " packets\n", tx_total);
+
+    replay_drop_stats(drops);
+    printf("\nDropped\n");
+    for (i = 0; i < VP_DROP_MAX; i++) {
+        if (drops[i] == drops_before[i])
+            continue;
+
+        printf("    %-28s %12" PRIu64 "\n", vr_drop_reason_name(i),
+                drops[i] - drops_before[i]);
+    }
+
+    return;
+}
+
+static void
+Usage(void)
+{
+    printf("Usage: pkt_replay --config <file> [--count <packets>]\n");
+    printf("                  [--latency-sample <n>]\n\n");
+    printf("--config <file>         vRouter objects and traffic to replay\n");
+    printf("--count <packets>       Packets to replay, looping over the traffic\n");
+    printf("--latency-sample <n>    Time one packet out of n\n");
+
+    exit(-EINVAL);
+}
+
+enum opt_replay_index {
+    CONFIG_OPT_INDEX,
+    COUNT_OPT_INDEX,
+    LATENCY_SAMPLE_OPT_INDEX,
+    HELP_OPT_INDEX,
+    MAX_OPT_INDEX
+};
+
+static struct option long_options[] = {
+    [CONFIG_OPT_INDEX]          = {"config",        required_argument, 0, 0},
+    [COUNT_OPT_INDEX]           = {"count",         required_argument, 0, 0},
+    [LATENCY_SAMPLE_OPT_INDEX]  = {"latency-sample", required_argument, 0, 0},
+    [HELP_OPT_INDEX]            = {"help",          no_argument,       0, 0},
+    [MAX_OPT_INDEX]             = {NULL,            0,                 0, 0},
+};
+
+static void
+parse_long_opts(int opt_index, char *opt_arg)
+{
+    errno = 0;
+
+    switch (opt_index) {
+    case CONFIG_OPT_INDEX:
+        config_file = opt_arg;
+        break;
+
+    case COUNT_OPT_INDEX:
+        count = strtoull(opt_arg, NULL, 0);
+        if (errno || !count)
+            Usage();
+        break;
+
+    case LATENCY_SAMPLE_OPT_INDEX:
+        latency_sample = strtoul(opt_arg, NULL, 0);
+        if (errno || !latency_sample)
+            Usage();
+        break;
+
+    case HELP_OPT_INDEX:
+    default:
+        Usage();
+    }
+
+    return;
+}
+
+int
+main(int argc, char *argv[])
+{
+    int ret, opt, option_index;
+
+    while ((opt = getopt_long(argc, argv, "", long_options,
+                    &option_index)) >= 0) {
+        switch (opt) {
+        case 0:
+            parse_long_opts(option_index, optarg);
+            break;
+
+        default:
+            Usage();
+        }
+    }
+
+    if (!config_file)
+        Usage();
+
+    vr_diet_message_proto_init();
+    ret = vrouter_host_init(VR_MPROTO_SANDESH);
+    if (ret)
+        return ret;
+
+    router = vrouter_get(0);
+    if (!router)
+        return -ENODEV;
+
+    ret = replay_config(config_file);
+    if (ret)
+        return ret;
+
+    if (!nschedule) {
+        fprintf(stderr, "%s: no traffic to replay\n", config_file);
+        return -EINVAL;
+    }
+
+    replay_run();
+
+    return 0;
+}
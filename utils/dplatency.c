@@ -0,0 +1,266 @@
+/*
+ * dplatency.c - per stage datapath latency histograms
+ *
+ * Copyright (c) 2016 Juniper Networks, Inc. All rights reserved.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <getopt.h>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+
+#include <net/if.h>
+
+#include "vr_os.h"
+#include "vr_types.h"
+#include "nl_util.h"
+
+static struct nl_client *cl;
+static int help_set, core_set, enable_set, disable_set, reset_set;
+static int core = -1;
+static unsigned int sample_rate;
+static bool dump_pending = false;
+
+/*
+ * in the order of enum vr_dp_lat_stage. a stage histogram holds the time
+ * from the previous stage, or RX, up to the stage
+ */
+static const char *dp_latency_stages[] = {
+    "Up to Flow Lookup",
+    "Up to Route Lookup",
+    "Up to Nexthop Output",
+    "Up to Interface TX",
+    "Total (RX to TX)",
+};
+
+static int64_t
+dp_latency_percentile(int64_t *hist, unsigned int buckets, int64_t count,
+        unsigned int percent)
+{
+    unsigned int i;
+    int64_t seen = 0;
+
+    for (i = 0; i < buckets; i++) {
+        seen += hist[i];
+        if (seen * 100 >= count * percent)
+            return (int64_t)1 << (i + 1);
+    }
+
+    return (int64_t)1 << buckets;
+}
+
+static void
+dp_latency_req_process(void *s_req)
+{
+    unsigned int i, j;
+    int64_t count, *hist;
+    vr_dp_latency_req *req = (vr_dp_latency_req *)s_req;
+
+    if (req->vdl_core < 0)
+        printf("All cores");
+    else
+        printf("Core %d", req->vdl_core);
+
+    if (req->vdl_sample_rate)
+        printf(", sampling 1 in %u packets", req->vdl_sample_rate);
+    else
+        printf(", sampling disabled");
+    printf(", %" PRIu64 " packets sampled\n\n", req->vdl_samples);
+
+    if (req->vdl_hist_size < req->vdl_stages * req->vdl_buckets)
+        return;
+
+    for (i = 0; i < req->vdl_stages; i++) {
+        hist = req->vdl_hist + (i * req->vdl_buckets);
+
+        count = 0;
+        for (j = 0; j < req->vdl_buckets; j++)
+            count += hist[j];
+
+        if (i < sizeof(dp_latency_stages) / sizeof(dp_latency_stages[0]))
+            printf("%s\n", dp_latency_stages[i]);
+        else
+            printf("Stage %u\n", i);
+
+        if (!count) {
+            printf("    No samples\n\n");
+            continue;
+        }
+
+        printf("    Samples %" PRId64 ", cycles p50 < %" PRId64
+                "  p90 < %" PRId64 "  p99 < %" PRId64 "\n", count,
+                dp_latency_percentile(hist, req->vdl_buckets, count, 50),
+                dp_latency_percentile(hist, req->vdl_buckets, count, 90),
+                dp_latency_percentile(hist, req->vdl_buckets, count, 99));
+
+        printf("   ");
+        for (j = 0; j < req->vdl_buckets; j++) {
+            if (!hist[j])
+                continue;
+            printf(" [%" PRIu64 "-%" PRIu64 "] %" PRId64, (uint64_t)1 << j,
+                    ((uint64_t)2 << j) - 1, hist[j]);
+        }
+        printf("\n\n");
+    }
+
+    return;
+}
+
+static void
+response_process(void *s)
+{
+    vr_response_common_process((vr_response *)s, &dump_pending);
+    return;
+}
+
+static void
+dp_latency_fill_nl_callbacks()
+{
+    nl_cb.vr_dp_latency_req_process = dp_latency_req_process;
+    nl_cb.vr_response_process = response_process;
+}
+
+static int
+dp_latency_op(struct nl_client *cl)
+{
+    int ret;
+
+    if (enable_set || disable_set)
+        ret = vr_send_dp_latency_set(cl, 0, enable_set ? sample_rate : 0);
+    else if (reset_set)
+        ret = vr_send_dp_latency_reset(cl, 0);
+    else
+        ret = vr_send_dp_latency_get(cl, 0, core);
+    if (ret < 0)
+        return ret;
+
+    ret = vr_recvmsg(cl, false);
+    if (ret <= 0)
+        return ret;
+
+    return 0;
+}
+
+enum opt_index {
+    HELP_OPT_INDEX,
+    CORE_OPT_INDEX,
+    ENABLE_OPT_INDEX,
+    DISABLE_OPT_INDEX,
+    RESET_OPT_INDEX,
+    MAX_OPT_INDEX,
+};
+
+static struct option long_options[] = {
+    [HELP_OPT_INDEX]    =   {"help",    no_argument,        &help_set,      1},
+    [CORE_OPT_INDEX]    =   {"core",    required_argument,  &core_set,      1},
+    [ENABLE_OPT_INDEX]  =   {"enable",  required_argument,  &enable_set,    1},
+    [DISABLE_OPT_INDEX] =   {"disable", no_argument,        &disable_set,   1},
+    [RESET_OPT_INDEX]   =   {"reset",   no_argument,        &reset_set,     1},
+    [MAX_OPT_INDEX]     =   {NULL,    0,                  0,              0},
+};
+
+static void
+Usage()
+{
+    printf("Usage: dplatency [--help]\n");
+    printf("Usage: dplatency [--core|-c] <core number>\n");
+    printf("       dplatency --enable <N>\n");
+    printf("       dplatency --disable\n");
+    printf("       dplatency --reset\n\n");
+    printf("--core <core number>\t Show histograms of a specified core\n");
+    printf("\t\t\t Histograms summed over all the cores are shown by default\n");
+    printf("--enable <N>\t\t Timestamp one in N received packets\n");
+    printf("--disable\t\t Stop sampling, the histograms are retained\n");
+    printf("--reset\t\t\t Clear the histograms\n");
+    exit(-EINVAL);
+}
+
+static void
+parse_long_opts(int opt_index, char *opt_arg)
+{
+    errno = 0;
+
+    switch (opt_index) {
+    case CORE_OPT_INDEX:
+        core = (int)strtol(opt_arg, NULL, 0);
+        if (errno || core < 0) {
+            printf("Error parsing core %s: %s (%d)\n", opt_arg,
+                    strerror(errno), errno);
+            Usage();
+        }
+        break;
+
+    case ENABLE_OPT_INDEX:
+        sample_rate = (unsigned int)strtoul(opt_arg, NULL, 0);
+        if (errno || !sample_rate) {
+            printf("Error parsing sample rate %s: %s (%d)\n", opt_arg,
+                    strerror(errno), errno);
+            Usage();
+        }
+        break;
+
+    case DISABLE_OPT_INDEX:
+    case RESET_OPT_INDEX:
+        break;
+
+    case HELP_OPT_INDEX:
+    default:
+        Usage();
+    }
+
+    return;
+}
+
+static void
+validate_options(void)
+{
+    if ((enable_set + disable_set + reset_set + core_set) > 1)
+        Usage();
+
+    return;
+}
+
+int
+main(int argc, char *argv[])
+{
+    char opt;
+    int ret, option_index;
+
+    dp_latency_fill_nl_callbacks();
+
+    while (((opt = getopt_long(argc, argv, "hc:",
+                        long_options, &option_index)) >= 0)) {
+        switch (opt) {
+        case 'c':
+            core_set = 1;
+            parse_long_opts(CORE_OPT_INDEX, optarg);
+            break;
+
+        case 0:
+            parse_long_opts(option_index, optarg);
+            break;
+
+        case 'h':
+        default:
+            Usage();
+        }
+    }
+
+    validate_options();
+
+    cl = vr_get_nl_client(VR_NETLINK_PROTO_DEFAULT);
+    if (!cl)
+        return -1;
+
+    ret = dp_latency_op(cl);
+    if (ret < 0)
+        return ret;
+
+    return 0;
+}
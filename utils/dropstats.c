@@ -21,14 +21,58 @@
 #include "ini_parser.h"
 #include "vr_os.h"
 #include "vr_types.h"
+#include "vr_packet.h"
 #include "vr_nexthop.h"
+#include "vr_stats.h"
+#include "vr_stats_shm.h"
 #include "ini_parser.h"
 #include "nl_util.h"
 #include "ini_parser.h"
 
 static struct nl_client *cl;
 static int help_set, core_set;
+static int capture_enable_set, capture_reason_set, capture_disable_set;
+static int capture_reset_set, capture_status_set, capture_set;
 static unsigned int core = (unsigned)-1;
+static unsigned int capture_rate;
+static int capture_reason = -1;
+static char *capture_file;
+static int capture_op = -1;
+static bool dump_pending = false;
+static int dump_marker = -1;
+
+/* records of the dropped packets, sorted by time before they are written */
+struct drop_capture {
+    vr_drop_capture_req dc_req;
+    uint8_t dc_data[VR_DROP_CAPTURE_LEN];
+};
+
+static struct drop_capture *captures;
+static unsigned int num_captures, max_captures;
+
+/* classic pcap file, ethernet link type */
+#define PCAP_MAGIC          0xa1b2c3d4
+#define PCAP_VERSION_MAJOR  2
+#define PCAP_VERSION_MINOR  4
+#define PCAP_SNAPLEN        65535
+#define PCAP_LINKTYPE_EN10MB 1
+
+struct pcap_file_header {
+    uint32_t magic;
+    uint16_t version_major;
+    uint16_t version_minor;
+    int32_t thiszone;
+    uint32_t sigfigs;
+    uint32_t snaplen;
+    uint32_t linktype;
+};
+
+struct pcap_record_header {
+    uint32_t ts_sec;
+    uint32_t ts_usec;
+    uint32_t incl_len;
+    uint32_t orig_len;
+};
 
 static void
 drop_stats_req_process(void *s_req)
@@ -39,10 +83,242 @@ drop_stats_req_process(void *s_req)
     return;
 }
 
+static void
+drop_capture_req_process(void *s_req)
+{
+    struct drop_capture *dc;
+    vr_drop_capture_req *req = (vr_drop_capture_req *)s_req;
+
+    if (capture_op == SANDESH_OP_GET) {
+        if (req->vdc_rate)
+            printf("Capturing one in %u drops", req->vdc_rate);
+        else
+            printf("Capture disabled");
+        if (req->vdc_reason >= 0)
+            printf(" of reason %d", req->vdc_reason);
+        printf(", %" PRIu64 " drops captured\n", req->vdc_captured);
+        return;
+    }
+
+    dump_marker = req->vdc_marker;
+
+    if (num_captures == max_captures) {
+        max_captures = max_captures ? max_captures * 2 : 256;
+        dc = realloc(captures, max_captures * sizeof(*captures));
+        if (!dc) {
+            printf("Error allocating memory for %u records\n", max_captures);
+            exit(-ENOMEM);
+        }
+        captures = dc;
+    }
+
+    dc = &captures[num_captures++];
+    memcpy(&dc->dc_req, req, sizeof(*req));
+    if (req->vdc_data_size > VR_DROP_CAPTURE_LEN)
+        dc->dc_req.vdc_data_size = VR_DROP_CAPTURE_LEN;
+    memcpy(dc->dc_data, req->vdc_data, dc->dc_req.vdc_data_size);
+    dc->dc_req.vdc_data = NULL;
+
+    return;
+}
+
+static void
+response_process(void *s)
+{
+    vr_response_common_process((vr_response *)s, &dump_pending);
+    return;
+}
+
 static void
 dropstats_fill_nl_callbacks()
 {
     nl_cb.vr_drop_stats_req_process = drop_stats_req_process;
+    nl_cb.vr_drop_capture_req_process = drop_capture_req_process;
+    nl_cb.vr_response_process = response_process;
+}
+
+static int
+drop_capture_cmp(const void *a, const void *b)
+{
+    const vr_drop_capture_req *ra = &((const struct drop_capture *)a)->dc_req;
+    const vr_drop_capture_req *rb = &((const struct drop_capture *)b)->dc_req;
+
+    if (ra->vdc_sec != rb->vdc_sec)
+        return (ra->vdc_sec < rb->vdc_sec) ? -1 : 1;
+    if (ra->vdc_usec != rb->vdc_usec)
+        return (ra->vdc_usec < rb->vdc_usec) ? -1 : 1;
+    if (ra->vdc_core != rb->vdc_core)
+        return ra->vdc_core - rb->vdc_core;
+    if (ra->vdc_seq != rb->vdc_seq)
+        return (ra->vdc_seq < rb->vdc_seq) ? -1 : 1;
+
+    return 0;
+}
+
+/*
+ * Records captured from the ip header carry a made up ethernet header in
+ * the file, so that all the frames share the ethernet link type. Pcap has
+ * no room for the interface, vrf, nexthop and reason of a drop, so those
+ * are printed with the frame number instead.
+ */
+static int
+drop_capture_write(const char *file)
+{
+    unsigned int i, hlen;
+    uint8_t eth[VR_ETHER_HLEN];
+    FILE *fp;
+    vr_drop_capture_req *req;
+    struct pcap_file_header fh;
+    struct pcap_record_header rh;
+
+    fp = fopen(file, "wb");
+    if (!fp) {
+        printf("Error opening %s: %s (%d)\n", file, strerror(errno), errno);
+        return -errno;
+    }
+
+    memset(&fh, 0, sizeof(fh));
+    fh.magic = PCAP_MAGIC;
+    fh.version_major = PCAP_VERSION_MAJOR;
+    fh.version_minor = PCAP_VERSION_MINOR;
+    fh.snaplen = PCAP_SNAPLEN;
+    fh.linktype = PCAP_LINKTYPE_EN10MB;
+    if (fwrite(&fh, sizeof(fh), 1, fp) != 1)
+        goto write_error;
+
+    if (num_captures)
+        qsort(captures, num_captures, sizeof(*captures), drop_capture_cmp);
+
+    printf("%8s%6s%8s%6s%8s%8s%8s  %s\n", "Frame", "Core", "Vif", "Vrf",
+            "Nh", "Reason", "Len", "Time");
+
+    for (i = 0; i < num_captures; i++) {
+        req = &captures[i].dc_req;
+
+        hlen = 0;
+        if (req->vdc_flags & VR_DROP_CAPTURE_FLAG_L3) {
+            memset(eth, 0, sizeof(eth));
+            if (req->vdc_data_size &&
+                    ((captures[i].dc_data[0] >> 4) == 6)) {
+                eth[12] = 0x86;
+                eth[13] = 0xdd;
+            } else {
+                eth[12] = 0x08;
+                eth[13] = 0x00;
+            }
+            hlen = sizeof(eth);
+        }
+
+        rh.ts_sec = (uint32_t)req->vdc_sec;
+        rh.ts_usec = (uint32_t)req->vdc_usec;
+        rh.incl_len = hlen + req->vdc_data_size;
+        rh.orig_len = hlen + req->vdc_len;
+        if (rh.orig_len < rh.incl_len)
+            rh.orig_len = rh.incl_len;
+
+        if (fwrite(&rh, sizeof(rh), 1, fp) != 1)
+            goto write_error;
+        if (hlen && (fwrite(eth, hlen, 1, fp) != 1))
+            goto write_error;
+        if (req->vdc_data_size && (fwrite(captures[i].dc_data,
+                        req->vdc_data_size, 1, fp) != 1))
+            goto write_error;
+
+        printf("%8u%6d%8d%6u%8d%8u%8u  %" PRIu64 ".%06" PRIu64 "\n", i + 1,
+                req->vdc_core, req->vdc_vif, req->vdc_vrf, req->vdc_nh,
+                req->vdc_drop_reason, req->vdc_len, req->vdc_sec,
+                req->vdc_usec);
+    }
+
+    fclose(fp);
+    printf("%u records written to %s\n", num_captures, file);
+
+    return 0;
+
+write_error:
+    printf("Error writing %s: %s (%d)\n", file, strerror(errno), errno);
+    fclose(fp);
+    return -EIO;
+}
+
+static int
+drop_capture_op(struct nl_client *cl)
+{
+    int ret;
+    bool dump = false;
+
+op_retry:
+    switch (capture_op) {
+    case SANDESH_OP_ADD:
+        ret = vr_send_drop_capture_set(cl, 0, capture_rate, capture_reason);
+        break;
+
+    case SANDESH_OP_RESET:
+        ret = vr_send_drop_capture_reset(cl, 0);
+        break;
+
+    case SANDESH_OP_GET:
+        ret = vr_send_drop_capture_get(cl, 0);
+        break;
+
+    case SANDESH_OP_DUMP:
+        dump = true;
+        ret = vr_send_drop_capture_dump(cl, 0, dump_marker);
+        break;
+
+    default:
+        ret = -EINVAL;
+        break;
+    }
+
+    if (ret < 0)
+        return ret;
+
+    ret = vr_recvmsg(cl, dump);
+    if (ret <= 0)
+        return ret;
+
+    if (dump_pending)
+        goto op_retry;
+
+    /* show the state of the capture ahead of writing the records */
+    if (capture_op == SANDESH_OP_GET && capture_file) {
+        capture_op = SANDESH_OP_DUMP;
+        goto op_retry;
+    }
+
+    if (capture_op == SANDESH_OP_DUMP)
+        return drop_capture_write(capture_file);
+
+    return 0;
+}
+
+/*
+ * read the counters from the shared statistics region, if vRouter has one,
+ * rather than have them summed up in the datapath
+ */
+static int
+vr_get_drop_stats_shm(struct nl_client *cl)
+{
+    int ret;
+    void *shm;
+    uint64_t counters[VP_DROP_MAX];
+    vr_drop_stats_req stats;
+
+    shm = vr_stats_shm_map(cl);
+    if (!shm)
+        return -ENOENT;
+
+    ret = vr_stats_shm_read(shm, VR_STATS_SHM_DROP, 0, (int)core, counters,
+            VP_DROP_MAX);
+    if (ret)
+        return ret;
+
+    memset(&stats, 0, sizeof(stats));
+    vr_drop_stats_fill(&stats, counters);
+    vr_print_drop_stats(&stats, core);
+
+    return 0;
 }
 
 static int
@@ -50,6 +326,9 @@ vr_get_drop_stats(struct nl_client *cl)
 {
     int ret;
 
+    if (!vr_get_drop_stats_shm(cl))
+        return 0;
+
     /*
      * Implementation of getting per-core drop statistics is based on this
      * little trick to avoid making changes in how agent makes requests for
@@ -81,21 +360,53 @@ vr_get_drop_stats(struct nl_client *cl)
 enum opt_index {
     HELP_OPT_INDEX,
     CORE_OPT_INDEX,
+    CAPTURE_ENABLE_OPT_INDEX,
+    CAPTURE_REASON_OPT_INDEX,
+    CAPTURE_DISABLE_OPT_INDEX,
+    CAPTURE_RESET_OPT_INDEX,
+    CAPTURE_STATUS_OPT_INDEX,
+    CAPTURE_OPT_INDEX,
     MAX_OPT_INDEX,
 };
 
 static struct option long_options[] = {
-    [HELP_OPT_INDEX]    =   {"help",    no_argument,        &help_set,      1},
-    [CORE_OPT_INDEX]    =   {"core",    required_argument,  &core_set,      1},
-    [MAX_OPT_INDEX]     =   {NULL,    0,                  0,              0},
+    [HELP_OPT_INDEX]            =   {"help",            no_argument,
+                                        &help_set,              1},
+    [CORE_OPT_INDEX]            =   {"core",            required_argument,
+                                        &core_set,              1},
+    [CAPTURE_ENABLE_OPT_INDEX]  =   {"capture-enable",  required_argument,
+                                        &capture_enable_set,    1},
+    [CAPTURE_REASON_OPT_INDEX]  =   {"capture-reason",  required_argument,
+                                        &capture_reason_set,    1},
+    [CAPTURE_DISABLE_OPT_INDEX] =   {"capture-disable", no_argument,
+                                        &capture_disable_set,   1},
+    [CAPTURE_RESET_OPT_INDEX]   =   {"capture-reset",   no_argument,
+                                        &capture_reset_set,     1},
+    [CAPTURE_STATUS_OPT_INDEX]  =   {"capture-status",  no_argument,
+                                        &capture_status_set,    1},
+    [CAPTURE_OPT_INDEX]         =   {"capture",         required_argument,
+                                        &capture_set,           1},
+    [MAX_OPT_INDEX]             =   {NULL,              0,
+                                        0,                      0},
 };
 
 static void
 Usage()
 {
     printf("Usage: dropstats [--help]\n");
-    printf("Usage: dropstats [--core|-c] <core number>\n\n");
+    printf("Usage: dropstats [--core|-c] <core number>\n");
+    printf("       dropstats --capture-enable <N> [--capture-reason <R>]\n");
+    printf("       dropstats --capture-disable\n");
+    printf("       dropstats --capture-reset\n");
+    printf("       dropstats --capture-status\n");
+    printf("       dropstats --capture <file>\n\n");
     printf("--core <core number>\t Show statistics for a specified CPU core\n");
+    printf("--capture-enable <N>\t Capture the head of one in N dropped packets\n");
+    printf("--capture-reason <R>\t Capture only drops of reason code R (VP_DROP_*)\n");
+    printf("--capture-disable\t Stop capturing, the records are retained\n");
+    printf("--capture-reset\t\t Clear the records of a disabled capture\n");
+    printf("--capture-status\t Show the state of the capture\n");
+    printf("--capture <file>\t Write the captured drops to a pcap file\n");
     exit(-EINVAL);
 }
 
@@ -114,6 +425,42 @@ parse_long_opts(int opt_index, char *opt_arg)
         }
         break;
 
+    case CAPTURE_ENABLE_OPT_INDEX:
+        capture_rate = (unsigned int)strtoul(opt_arg, NULL, 0);
+        if (errno || !capture_rate) {
+            printf("Error parsing capture rate %s: %s (%d)\n", opt_arg,
+                    strerror(errno), errno);
+            Usage();
+        }
+        capture_op = SANDESH_OP_ADD;
+        break;
+
+    case CAPTURE_REASON_OPT_INDEX:
+        capture_reason = (int)strtol(opt_arg, NULL, 0);
+        if (errno || (capture_reason < 0)) {
+            printf("Error parsing drop reason %s: %s (%d)\n", opt_arg,
+                    strerror(errno), errno);
+            Usage();
+        }
+        break;
+
+    case CAPTURE_DISABLE_OPT_INDEX:
+        capture_op = SANDESH_OP_ADD;
+        break;
+
+    case CAPTURE_RESET_OPT_INDEX:
+        capture_op = SANDESH_OP_RESET;
+        break;
+
+    case CAPTURE_STATUS_OPT_INDEX:
+        capture_op = SANDESH_OP_GET;
+        break;
+
+    case CAPTURE_OPT_INDEX:
+        capture_file = opt_arg;
+        capture_op = SANDESH_OP_GET;
+        break;
+
     case HELP_OPT_INDEX:
     default:
         Usage();
@@ -122,6 +469,19 @@ parse_long_opts(int opt_index, char *opt_arg)
     return;
 }
 
+static void
+validate_options(void)
+{
+    if ((capture_enable_set + capture_disable_set + capture_reset_set +
+                capture_status_set + capture_set + core_set) > 1)
+        Usage();
+
+    if (capture_reason_set && !capture_enable_set)
+        Usage();
+
+    return;
+}
+
 int
 main(int argc, char *argv[])
 {
@@ -148,10 +508,15 @@ main(int argc, char *argv[])
         }
     }
 
+    validate_options();
+
     cl = vr_get_nl_client(VR_NETLINK_PROTO_DEFAULT);
     if (!cl)
         return -1;
 
+    if (capture_op >= 0)
+        return drop_capture_op(cl);
+
     vr_get_drop_stats(cl);
 
     return 0;
@@ -39,6 +39,7 @@
 #include "vr_types.h"
 #include "vr_qos.h"
 #include "vr_flow.h"
+#include "vr_flow_event.h"
 #include "vr_mirror.h"
 #include "vr_genetlink.h"
 #include "nl_util.h"
@@ -47,23 +48,32 @@
 #include "vr_packet.h"
 #include "vr_message.h"
 #include "vr_mem.h"
+#include "vr_sandesh.h"
 
 #define TABLE_FLAG_VALID        0x1
 
 #define MAX_FLOW_NL_MSG_BUNCH   15
+/* a bulk request has to fit in one netlink attribute */
+#define FLOW_BULK_BUF_SIZE      (60 * 1024)
 #define MAX_FLOWS               4000000
+#define MAX_FLOW_EVENT_BATCH    64
+#define MAX_FLOW_EVENT_RINGS    256
 
 #define MEM_DEV                 "/dev/flow"
 
 static int mem_fd;
 
 static int dvrf_set, mir_set, show_evicted_set;
-static int help_set, match_set, get_set;
+static int help_set, match_set, get_set, events_set, dirty_set, bulk_set;
+static int grow_set, policy_set;
 static unsigned short dvrf;
 static int list, flow_cmd, mirror = -1;
 static unsigned long flow_index;
 static int rate, stats, perf, flush, bunch = 1;
 static bool more = false;
+static bool dump_pending = false;
+static int dump_marker = -1;
+static uint64_t *dirty_bitmap;
 
 #define FLOW_GET_FIELD_LENGTH   30
 #define FLOW_COMPONENT_NH_COUNT 16
@@ -119,12 +129,27 @@ struct flow_table {
     unsigned int ft_flags;
     unsigned int ft_cpus;
     unsigned int ft_hold_oflows;
+    u_int64_t ft_hold_queued;
+    u_int64_t ft_hold_queue_drops;
     unsigned int ft_hold_stat_count;
     unsigned int ft_oflow_entries;
     u_int32_t ft_hold_stat[128];
     char flow_table_path[256];
+    int ft_dev;
+    unsigned int ft_event_size;
+    unsigned int ft_event_ring_size;
+    char ft_event_path[256];
 } main_table;
 
+/* the IPv4 flow table, the entries of which follow the ones of main_table */
+struct inet_flow_table {
+    struct vr_inet_flow_entry *ift_entries;
+    u_int64_t ift_span;
+    u_int64_t ift_used_entries;
+    unsigned int ift_num_entries;
+    unsigned int ift_base;
+} inet_table;
+
 struct flow_md {
     unsigned int fmd_index;
     unsigned int fmd_gen_id;
@@ -143,6 +168,7 @@ static void flow_dump_nexthop(vr_nexthop_req *, vr_interface_req *,
 static vr_nexthop_req *flow_get_nexthop(int);
 static int flow_table_map(vr_flow_table_data *);
 static int flow_table_get(void);
+static unsigned int ftable_entries;
 
 static void
 response_process(void *sresp)
@@ -154,6 +180,8 @@ response_process(void *sresp)
         exit(-2);
     }
 
+    dump_pending = !!(resp->resp_code & VR_MESSAGE_DUMP_INCOMPLETE);
+
     return;
 }
 
@@ -170,16 +198,99 @@ flow_response_process(void *sresp)
 }
 
 
+static void
+flow_bulk_response_process(void *sresp)
+{
+    unsigned int i;
+    vr_flow_bulk_response *resp = (vr_flow_bulk_response *)sresp;
+
+    for (i = 0; i < resp->fbresp_index_size; i++) {
+        if (resp->fbresp_status[i] < 0) {
+            printf("Bulk flow operation %u failed: %s\n", i,
+                    strerror(-resp->fbresp_status[i]));
+            continue;
+        }
+
+        if (array_index == -1)
+            continue;
+
+        flow_md_mem[array_index + i].fmd_index = resp->fbresp_index[i];
+        flow_md_mem[array_index + i].fmd_gen_id = resp->fbresp_gen_id[i];
+    }
+
+    return;
+}
+
 static void
 flow_table_data_process(void *sreq)
 {
     vr_flow_table_data *ftable = (vr_flow_table_data *)sreq;
 
+    ftable_entries = ftable->ftable_entries;
     flow_table_map(ftable);
 
     return;
 }
 
+/* the dirty bitmap covers the IPv4 flow table as well */
+static unsigned int
+flow_dirty_entries(void)
+{
+    if (inet_table.ift_entries)
+        return inet_table.ift_base + inet_table.ift_num_entries;
+
+    return main_table.ft_num_entries;
+}
+
+static void
+flow_dirty_req_process(void *sreq)
+{
+    unsigned int i, word;
+    vr_flow_dirty_req *req = (vr_flow_dirty_req *)sreq;
+
+    word = req->fdr_offset / 64;
+    for (i = 0; i < req->fdr_bitmap_size; i++) {
+        if (word + i >= (flow_dirty_entries() + 63) / 64)
+            break;
+        dirty_bitmap[word + i] |= (uint64_t)req->fdr_bitmap[i];
+    }
+
+    dump_marker = req->fdr_marker;
+
+    return;
+}
+
+static void
+flow_policy_req_process(void *sreq)
+{
+    char sbuf[INET6_ADDRSTRLEN], dbuf[INET6_ADDRSTRLEN];
+    uint8_t sip[16], dip[16];
+    vr_flow_policy_req *req = (vr_flow_policy_req *)sreq;
+
+    memset(sip, 0, sizeof(sip));
+    memset(dip, 0, sizeof(dip));
+    if (req->fpr_src_prefix_size <= (int)sizeof(sip))
+        memcpy(sip, req->fpr_src_prefix, req->fpr_src_prefix_size);
+    if (req->fpr_dst_prefix_size <= (int)sizeof(dip))
+        memcpy(dip, req->fpr_dst_prefix, req->fpr_dst_prefix_size);
+
+    printf("%6d %5d %5d %5d  %s/%u -> %s/%u  %u-%u  %u-%u  %s(%u)  %"
+            PRIu64 "\n",
+            req->fpr_index, req->fpr_vrf, req->fpr_vif, req->fpr_proto,
+            inet_ntop(req->fpr_family, sip, sbuf, sizeof(sbuf)),
+            req->fpr_src_plen,
+            inet_ntop(req->fpr_family, dip, dbuf, sizeof(dbuf)),
+            req->fpr_dst_plen,
+            req->fpr_sport_lo, req->fpr_sport_hi,
+            req->fpr_dport_lo, req->fpr_dport_hi,
+            (req->fpr_action == VR_FLOW_ACTION_FORWARD) ? "F" : "D",
+            req->fpr_src_nh_index, req->fpr_hits);
+
+    dump_marker = req->fpr_index;
+
+    return;
+}
+
 static void
 interface_req_process(void *arg)
 {
@@ -230,6 +341,9 @@ flow_fill_nl_callbacks()
     nl_cb.vr_nexthop_req_process = nexthop_req_process;
     nl_cb.vr_route_req_process = route_req_process;
     nl_cb.vr_drop_stats_req_process = drop_stats_req_process;
+    nl_cb.vr_flow_dirty_req_process = flow_dirty_req_process;
+    nl_cb.vr_flow_bulk_response_process = flow_bulk_response_process;
+    nl_cb.vr_flow_policy_req_process = flow_policy_req_process;
 }
 
 struct vr_flow_entry *
@@ -467,6 +581,65 @@ flow_match_source(struct vr_flow_entry *fe, uint8_t *addr, int32_t port)
     return false;
 }
 
+static bool
+flow_match_entry(struct vr_flow_entry *fe)
+{
+    bool smatch, dmatch;
+
+    if (match_vrf >= 0) {
+        if (fe->fe_vrf != match_vrf)
+            return false;
+    }
+
+    if (match_proto >= 0) {
+        if (fe->fe_key.flow_proto != match_proto)
+            return false;
+    }
+
+    if (match_family) {
+        if (match_family != VR_FLOW_FAMILY(fe->fe_type)) {
+            return false;
+        }
+
+        smatch = dmatch = false;
+        if (match_ip1_set) {
+            smatch = flow_match_source(fe, match_ip1, match_port1);
+            if (!smatch) {
+                dmatch = flow_match_dest(fe, match_ip1, match_port1);
+            }
+        }
+
+        if (match_ip2_set) {
+            if (smatch) {
+                dmatch = flow_match_dest(fe, match_ip2, match_port2);
+                if (!dmatch)
+                    return false;
+            } else if (dmatch) {
+                smatch = flow_match_source(fe, match_ip2, match_port2);
+                if (!smatch)
+                    return false;
+            } else {
+                smatch = flow_match_source(fe, match_ip2, match_port2);
+                if (!smatch) {
+                    dmatch = flow_match_dest(fe, match_ip2, match_port2);
+                }
+
+            }
+        }
+
+        if (!smatch && !dmatch)
+            return false;
+
+        if (match_ip1_set && match_ip2_set) {
+            if (!smatch || !dmatch) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
 static void
 flow_print_spaces(void)
 {
@@ -1173,7 +1346,6 @@ flow_dump_table(struct flow_table *ft)
     const char *drop_reason = NULL;
     char in_src[INET6_ADDRSTRLEN], in_dest[INET6_ADDRSTRLEN];
     char addr[INET6_ADDRSTRLEN];
-    bool smatch, dmatch;
 
     printf("Flow table(size %" PRIu64 ", entries %u)\n\n", ft->ft_span,
             ft->ft_num_entries);
@@ -1187,7 +1359,9 @@ flow_dump_table(struct flow_table *ft)
         if (i != (ft->ft_hold_stat_count - 1))
             printf(" ");
     }
-    printf(")(oflows %u)\n\n", ft->ft_hold_oflows);
+    printf(")(oflows %u)\n", ft->ft_hold_oflows);
+    printf("Hold queues: Queued packets %" PRIu64 " Dropped %" PRIu64 "\n\n",
+            ft->ft_hold_queued, ft->ft_hold_queue_drops);
 
     flow_dump_legend();
 
@@ -1255,6 +1429,9 @@ flow_dump_table(struct flow_table *ft)
         memset(flag_string, 0, sizeof(flag_string));
         need_flag_print = 0;
         need_drop_reason = 0;
+        if (dirty_bitmap && !(dirty_bitmap[i / 64] & (1ULL << (i % 64))))
+            continue;
+
         fe = (struct vr_flow_entry *)((char *)ft->ft_entries + (i * sizeof(*fe)));
         if (fe->fe_flags & VR_FLOW_FLAG_ACTIVE) {
 
@@ -1264,56 +1441,8 @@ flow_dump_table(struct flow_table *ft)
             }
 
 
-            if (match_vrf >= 0) {
-                if (fe->fe_vrf != match_vrf)
-                    continue;
-            }
-
-            if (match_proto >= 0) {
-                if (fe->fe_key.flow_proto != match_proto)
-                    continue;
-            }
-
-            if (match_family) {
-                if (match_family != VR_FLOW_FAMILY(fe->fe_type)) {
-                    continue;
-                }
-
-                smatch = dmatch = false;
-                if (match_ip1_set) {
-                    smatch = flow_match_source(fe, match_ip1, match_port1);
-                    if (!smatch) {
-                        dmatch = flow_match_dest(fe, match_ip1, match_port1);
-                    }
-                }
-
-                if (match_ip2_set) {
-                    if (smatch) {
-                        dmatch = flow_match_dest(fe, match_ip2, match_port2);
-                        if (!dmatch)
-                            continue;
-                    } else if (dmatch) {
-                        smatch = flow_match_source(fe, match_ip2, match_port2);
-                        if (!smatch)
-                            continue;
-                    } else {
-                        smatch = flow_match_source(fe, match_ip2, match_port2);
-                        if (!smatch) {
-                            dmatch = flow_match_dest(fe, match_ip2, match_port2);
-                        }
-
-                    }
-                }
-
-                if (!smatch && !dmatch)
-                    continue;
-
-                if (match_ip1_set && match_ip2_set) {
-                    if (!smatch || !dmatch) {
-                        continue;
-                    }
-                }
-            }
+            if (!flow_match_entry(fe))
+                continue;
 
 
             if ((fe->fe_type == VP_TYPE_IP) || (fe->fe_type == VP_TYPE_IP6)) {
@@ -1513,10 +1642,147 @@ flow_dump_table(struct flow_table *ft)
     return;
 }
 
+static int
+flow_policy_list(void)
+{
+    int ret;
+
+    printf("Flow Policy Cache\n");
+    printf(" Index   VRF   VIF Proto  Source -> Destination"
+            "  SPorts  DPorts  Action(Src NH)  Hits\n");
+
+op_retry:
+    dump_pending = false;
+    ret = vr_send_flow_policy_dump(cl, 0, dump_marker);
+    if (ret < 0)
+        return ret;
+
+    ret = vr_recvmsg(cl, true);
+    if (ret <= 0)
+        return ret;
+
+    if (dump_pending)
+        goto op_retry;
+
+    return 0;
+}
+
+/*
+ * get the flow entries that changed since the agent last harvested the
+ * dirty bitmap. the bitmap is only peeked at, not to steal the changes
+ * from the agent
+ */
+static int
+flow_dirty_get(void)
+{
+    int ret;
+
+    dirty_bitmap = calloc((flow_dirty_entries() + 63) / 64,
+            sizeof(*dirty_bitmap));
+    if (!dirty_bitmap)
+        return -ENOMEM;
+
+op_retry:
+    dump_pending = false;
+    ret = vr_send_flow_dirty_dump(cl, 0, dump_marker,
+            VR_FLOW_DIRTY_FLAG_PEEK);
+    if (ret < 0)
+        return ret;
+
+    ret = vr_recvmsg(cl, true);
+    if (ret <= 0)
+        return ret;
+
+    cl->cl_buf_offset = 0;
+    if (dump_pending)
+        goto op_retry;
+
+    return 0;
+}
+
+static void
+flow_dump_inet_table(struct inet_flow_table *ift)
+{
+    unsigned int i, index, k, printed;
+    struct vr_flow_entry fe;
+    struct vr_inet_flow_entry *ife;
+    char in_src[INET_ADDRSTRLEN], in_dest[INET_ADDRSTRLEN];
+
+    if (!ift->ift_entries)
+        return;
+
+    printf("\nIPv4 flow table(size %" PRIu64 ", entries %u, first index %u)\n",
+            ift->ift_span, ift->ift_num_entries, ift->ift_base);
+    printf("Entries: Used %" PRIu64 "\n\n", ift->ift_used_entries);
+    printf("    Index            ");
+    printf("%4c", ' ');
+    printf("Source:Port/Destination:Port                  ");
+    printf("%4c", ' ');
+    printf("Proto(V)\n");
+    printf("-----------------------------------------------------------------");
+    printf("------------------\n");
+
+    memset(&fe, 0, sizeof(fe));
+    fe.fe_type = VP_TYPE_IP;
+    for (i = 0; i < ift->ift_num_entries; i++) {
+        index = ift->ift_base + i;
+        if (dirty_bitmap &&
+                !(dirty_bitmap[index / 64] & (1ULL << (index % 64))))
+            continue;
+
+        ife = &ift->ift_entries[i];
+        if (!(ife->ife_flags & VR_FLOW_FLAG_ACTIVE))
+            continue;
+
+        /* the matching goes by the flow entry */
+        memcpy(&fe.fe_key, &ife->ife_key, sizeof(ife->ife_key));
+        fe.fe_vrf = ife->ife_vrf;
+        if (!flow_match_entry(&fe))
+            continue;
+
+        inet_ntop(AF_INET, &ife->ife_key.ip4_sip, in_src, sizeof(in_src));
+        inet_ntop(AF_INET, &ife->ife_key.ip4_dip, in_dest, sizeof(in_dest));
+
+        printf("%9u", index);
+        if (ife->ife_rflow >= 0)
+            printf("<=>%-9d", ife->ife_rflow);
+        else
+            printf("%12c", ' ');
+
+        printf("%4c", ' ');
+        printed = printf("%s:%-5d", in_src, ntohs(ife->ife_key.ip4_sport));
+        for (k = printed; k < 46; k++)
+            printf(" ");
+        printf("%4c", ' ');
+        printf("%3d (%d)\n", ife->ife_key.ip4_proto, ife->ife_vrf);
+        printf("%25c", ' ');
+        printf("%s:%-5d\n", in_dest, ntohs(ife->ife_key.ip4_dport));
+
+        printf("(Gen: %u, K(nh):%u, Action:%c, Flags:%s, ",
+                ife->ife_gen_id, ife->ife_key.ip4_nh_id,
+                (ife->ife_action == VR_FLOW_ACTION_FORWARD) ? 'F' : 'D',
+                (ife->ife_flags & VR_FLOW_FLAG_DELETE_MARKED) ? "Dm" : "");
+        printf("Stats:%" PRIu64 "/%" PRIu64 ", SrcNh:%u)\n\n",
+                ((uint64_t)ife->ife_stats.flow_packets_oflow << 32) |
+                ife->ife_stats.flow_packets,
+                ((uint64_t)ife->ife_stats.flow_bytes_oflow << 32) |
+                ife->ife_stats.flow_bytes,
+                ife->ife_src_nh_index);
+    }
+
+    return;
+}
+
 static void
 flow_list(void)
 {
+    if (dirty_set && flow_dirty_get()) {
+        printf("Failed to get the flow dirty bitmap\n");
+        exit(1);
+    }
+
     flow_dump_table(&main_table);
+    flow_dump_inet_table(&inet_table);
     return;
 }
 
@@ -1733,6 +1999,8 @@ get_flow_table_map_counts(vr_flow_table_data *table, struct flow_table *ft)
     ft->ft_processed = table->ftable_processed;
     ft->ft_created = table->ftable_created;
     ft->ft_hold_oflows = table->ftable_hold_oflows;
+    ft->ft_hold_queued = table->ftable_hold_queued;
+    ft->ft_hold_queue_drops = table->ftable_hold_queue_drops;
     ft->ft_added = table->ftable_added;
     ft->ft_oflow_entries = table->ftable_oflow_entries;
     ft->ft_deleted = table->ftable_deleted;
@@ -1740,6 +2008,7 @@ get_flow_table_map_counts(vr_flow_table_data *table, struct flow_table *ft)
     ft->ft_total_entries = table->ftable_used_entries;
     ft->ft_burst_free_tokens = table->ftable_burst_free_tokens;
     ft->ft_hold_entries = table->ftable_hold_entries;
+    inet_table.ift_used_entries = table->ftable_inet_used_entries;
 
 
     return 0;
@@ -1772,9 +2041,32 @@ flow_table_map(vr_flow_table_data *table)
 
     ft->ft_span = table->ftable_size;
     ft->ft_num_entries = ft->ft_span / sizeof(struct vr_flow_entry);
+
+    if (table->ftable_inet_size) {
+        mmap_success = vr_table_map(table->ftable_dev,
+                VR_MEM_INET_FLOW_TABLE_OBJECT, NULL, table->ftable_inet_size,
+                (void **)&inet_table.ift_entries);
+        if (!mmap_success) {
+            printf("IPv4 flow table mapping failed\n");
+            exit(1);
+        }
+
+        inet_table.ift_span = table->ftable_inet_size;
+        inet_table.ift_num_entries = table->ftable_inet_entries;
+        inet_table.ift_base = table->ftable_inet_base;
+        inet_table.ift_used_entries = table->ftable_inet_used_entries;
+    }
+    ft->ft_dev = table->ftable_dev;
+    ft->ft_event_size = table->ftable_event_size;
+    ft->ft_event_ring_size = table->ftable_event_ring_size;
+    if (table->ftable_event_file_path)
+        strncpy(ft->ft_event_path, table->ftable_event_file_path,
+                sizeof(ft->ft_event_path) - 1);
     ft->ft_processed = table->ftable_processed;
     ft->ft_created = table->ftable_created;
     ft->ft_hold_oflows = table->ftable_hold_oflows;
+    ft->ft_hold_queued = table->ftable_hold_queued;
+    ft->ft_hold_queue_drops = table->ftable_hold_queue_drops;
     ft->ft_added = table->ftable_added;
     ft->ft_cpus = table->ftable_cpus;
     ft->ft_oflow_entries = table->ftable_oflow_entries;
@@ -1803,6 +2095,93 @@ flow_table_map(vr_flow_table_data *table)
     return ft->ft_num_entries;
 }
 
+static const char *
+flow_event_type_string(uint8_t type)
+{
+    switch (type) {
+    case VR_FLOW_EVENT_HOLD:
+        return "HOLD";
+    case VR_FLOW_EVENT_EVICT_CANDIDATE:
+        return "EVICT_CANDIDATE";
+    case VR_FLOW_EVENT_EVICTED:
+        return "EVICTED";
+    case VR_FLOW_EVENT_STATS_OFLOW:
+        return "STATS_OFLOW";
+    default:
+        return "UNKNOWN";
+    }
+}
+
+/*
+ * Follow the per-cpu flow event rings and print the events as they are
+ * posted by the datapath.
+ */
+static void
+flow_events(void)
+{
+#ifndef _WIN32
+    struct flow_table *ft = &main_table;
+    unsigned int i, j, n, rings, total;
+    uint64_t tails[MAX_FLOW_EVENT_RINGS], lost, prev_lost = 0;
+    struct vr_flow_event events[MAX_FLOW_EVENT_BATCH];
+    struct vr_flow_event_ring *ring;
+    void *mem;
+
+    if (!ft->ft_event_size || ft->ft_event_ring_size != VR_FLOW_EVENT_RING_SIZE) {
+        printf("flow event rings are not supported by the datapath\n");
+        exit(ENODEV);
+    }
+
+    if (!vr_table_map(ft->ft_dev, VR_MEM_FLOW_EVENT_OBJECT, ft->ft_event_path,
+                ft->ft_event_size, &mem)) {
+        printf("flow event rings mapping failed\n");
+        exit(1);
+    }
+
+    rings = ft->ft_event_size / ft->ft_event_ring_size;
+    if (rings > MAX_FLOW_EVENT_RINGS)
+        rings = MAX_FLOW_EVENT_RINGS;
+
+    /* start with the events posted from now on */
+    for (i = 0; i < rings; i++) {
+        ring = (struct vr_flow_event_ring *)((char *)mem +
+                i * ft->ft_event_ring_size);
+        tails[i] = ring->fer_hdr.ferh_head;
+    }
+
+    lost = 0;
+    while (1) {
+        total = 0;
+        for (i = 0; i < rings; i++) {
+            ring = (struct vr_flow_event_ring *)((char *)mem +
+                    i * ft->ft_event_ring_size);
+            n = vr_flow_event_ring_read(ring, &tails[i], events,
+                    MAX_FLOW_EVENT_BATCH, &lost);
+            for (j = 0; j < n; j++) {
+                printf("CPU %3u %-16s Index %-8u Gen %-3u Flags 0x%04x"
+                        " Data 0x%x\n", i,
+                        flow_event_type_string(events[j].fev_type),
+                        events[j].fev_index, events[j].fev_gen_id,
+                        events[j].fev_flags, events[j].fev_data);
+            }
+            total += n;
+        }
+
+        if (lost != prev_lost) {
+            printf("Lost %" PRIu64 " events, rescan of the flow table needed\n",
+                    lost - prev_lost);
+            prev_lost = lost;
+        }
+
+        if (!total)
+            usleep(100000);
+    }
+#else
+    printf("flow event rings are not supported on this platform\n");
+    exit(ENODEV);
+#endif
+}
+
 static int
 flow_make_flow_req(void *req, char *flow_str)
 {
@@ -1830,6 +2209,23 @@ flow_table_get(void)
     return flow_make_flow_req(&ftable, "vr_flow_table_data");
 }
 
+static int
+flow_table_grow(void)
+{
+    int ret;
+
+    memset(&ftable, 0, sizeof(ftable));
+    ftable.ftable_op = FLOW_OP_FLOW_TABLE_GROW;
+
+    ret = flow_make_flow_req(&ftable, "vr_flow_table_data");
+    if (ret < 0)
+        return ret;
+
+    printf("Flow table grown to %u entries\n", ftable_entries);
+
+    return 0;
+}
+
 static int
 flow_table_setup(void)
 {
@@ -2042,6 +2438,77 @@ flow_make_flow_req_perf(vr_flow_req *req)
 #endif
 }
 
+/*
+ * add an operation to the bulk request being built, and send the request
+ * once all the count operations are in. the kernel answers with one
+ * vr_flow_bulk_response for the whole batch
+ */
+static int
+flow_make_flow_req_bulk(vr_flow_req *req, unsigned int index,
+        unsigned int count)
+{
+#ifdef _WIN32
+    // TODO(Windows): Implement for Windows
+    return -1;
+#else
+    int ret, attr_len = 0, error = 0;
+
+    if (!index) {
+        cl->cl_buf_offset = 0;
+        ret = nl_build_nlh(cl, cl->cl_genl_family_id, NLM_F_REQUEST);
+        if (ret)
+            return ret;
+
+        ret = nl_build_genlh(cl, SANDESH_REQUEST, 0);
+        if (ret)
+            return ret;
+
+        attr_len = nl_get_attr_hdr_size();
+    }
+
+    req->fr_op = FLOW_OP_FLOW_BULK_SET;
+    req->fr_bulk_index = index;
+    req->fr_bulk_count = count;
+
+    ret = sandesh_encode(req, "vr_flow_req", vr_find_sandesh_info,
+                         (nl_get_buf_ptr(cl) + attr_len),
+                         (nl_get_buf_len(cl) - attr_len), &error);
+    if ((ret <= 0) || error)
+        return -ENOSPC;
+
+    if (!index) {
+        nl_build_attr(cl, ret, NL_ATTR_VR_MESSAGE_PROTOCOL);
+    } else {
+        nl_update_attr_len(cl, ret);
+    }
+
+    nl_update_nlh(cl);
+
+    if (index + 1 < count)
+        return 0;
+
+    ret = nl_sendmsg(cl);
+    if (ret <= 0)
+        return ret;
+
+    flow_process_response();
+    cl->cl_buf_offset = 0;
+
+    return 0;
+#endif
+}
+
+/* operation op of ops in total, in batches of bunch operations */
+static int
+flow_make_flow_req_bulk_op(vr_flow_req *req, unsigned int op,
+        unsigned int ops)
+{
+    unsigned int start = op - (op % bunch);
+
+    return flow_make_flow_req_bulk(req, op - start,
+            ((ops - start) < bunch) ? (ops - start) : bunch);
+}
+
 void
 run_perf(void)
 {
@@ -2052,6 +2519,8 @@ run_perf(void)
     uint8_t proto = 0xFF;
     uint16_t sport = 1000;
     uint16_t nhid = 1;
+    char *buf = NULL;
+    unsigned int buf_len = 0;
 
     memset(&flow_req, 0, sizeof(flow_req));
     flow_req.fr_family = AF_INET;
@@ -2066,15 +2535,36 @@ run_perf(void)
     struct timeval last_time;
     gettimeofday(&last_time, NULL);
 
+    /* a bulk request takes a larger buffer, the client gets its own back */
+    if (bulk_set) {
+        buf = cl->cl_buf;
+        buf_len = cl->cl_buf_len;
+        cl->cl_buf = calloc(FLOW_BULK_BUF_SIZE, 1);
+        if (!cl->cl_buf) {
+            cl->cl_buf = buf;
+            printf("Could not allocate the bulk request buffer\n");
+            return;
+        }
+        cl->cl_buf_len = FLOW_BULK_BUF_SIZE;
+        cl->cl_buf_offset = 0;
+    }
+
     int i = 0;
     for (i = 0; i < perf; i++) {
         more = false;
-        array_index = i;
         flow_req.fr_action = VR_FLOW_ACTION_HOLD;
         flow_req.fr_flow_sport = htons(sport + (i / 65535));
         flow_req.fr_flow_dport = htons(i % 65535);
         flow_req.fr_index = -1;
-        flow_make_flow_req_perf(&flow_req);
+        if (bulk_set) {
+            array_index = i - (i % bunch);
+            ret = flow_make_flow_req_bulk_op(&flow_req, i, perf);
+            if (ret < 0)
+                goto bulk_fail;
+        } else {
+            array_index = i;
+            flow_make_flow_req_perf(&flow_req);
+        }
     }
     cl->cl_buf_offset = 0;
 
@@ -2096,7 +2586,16 @@ run_perf(void)
         flow_req.fr_action = VR_FLOW_ACTION_FORWARD;
         flow_req.fr_gen_id = 0;
         more = true;
-        flow_make_flow_req_perf(&flow_req);
+        if (bulk_set) {
+            /* install the reverse and the forward flow as a pair */
+            flow_req.fr_flags = VR_FLOW_FLAG_ACTIVE;
+            flow_req.fr_op_flags = VR_FLOW_OP_FLAG_PAIR;
+            ret = flow_make_flow_req_bulk_op(&flow_req, 2 * i, 2 * perf);
+            if (ret < 0)
+                goto bulk_fail;
+        } else {
+            flow_make_flow_req_perf(&flow_req);
+        }
 
         flow_req.fr_flow_sip_l = sip;
         flow_req.fr_flow_dip_l = dip;
@@ -2108,7 +2607,21 @@ run_perf(void)
         if (i == (perf - 1)) {
             more = false;
         }
-        flow_make_flow_req_perf(&flow_req);
+        if (bulk_set) {
+            flow_req.fr_flags = VR_FLOW_FLAG_ACTIVE | VR_RFLOW_VALID;
+            flow_req.fr_rindex = -1;
+            flow_req.fr_rflow_sip_l = dip;
+            flow_req.fr_rflow_dip_l = sip;
+            flow_req.fr_rflow_sport = htons(i % 65535);
+            flow_req.fr_rflow_dport = htons(sport + (i / 65535));
+            flow_req.fr_rflow_nh_id = nhid;
+            ret = flow_make_flow_req_bulk_op(&flow_req, (2 * i) + 1,
+                    2 * perf);
+            if (ret < 0)
+                goto bulk_fail;
+        } else {
+            flow_make_flow_req_perf(&flow_req);
+        }
     }
 
     gettimeofday(&now, NULL);
@@ -2117,6 +2630,18 @@ run_perf(void)
     printf("Created %d HOLD and %d FWD entries in %d msec\n",
             perf, perf, diff_ms);
 
+    if (bulk_set)
+        nl_set_buf(cl, buf, buf_len);
+
+    return;
+
+bulk_fail:
+    /* the batch the failed operation was part of was not sent */
+    printf("Bulk flow request failed at flow %d: %s\n", i,
+            strerror(-ret));
+    nl_set_buf(cl, buf, buf_len);
+
+    return;
 }
 
 void
@@ -2172,6 +2697,8 @@ Usage(void)
     printf("           [-p flow_count]\n");
     printf("           [-b bunch_count]\n");
     printf("           [-F]\n");
+    printf("           [--grow]\n");
+    printf("           [--policy]\n");
     printf("\n");
 
     printf("-f <flow_index>  Set forward action for flow at flow_index <flow_index>\n");
@@ -2179,7 +2706,11 @@ Usage(void)
     printf("-i <flow_index>  Invalidate flow at flow_index <flow_index>\n");
     printf("-p <flow_count>  Profile time to add/delete flow entries\n");
     printf("-b <bunch_count> Bunch flow messages in one netlink message\n");
+    printf("--bulk           Send the bunch as one bulk request (with -p),\n");
+    printf("                 installing the forward and reverse flows as pairs\n");
     printf("-F               Flush all the flows\n");
+    printf("--grow           Add one more overflow segment to the flow table\n");
+    printf("--policy         List the flow policy cache rules\n");
     printf("--get            Get and print flow entry in a particular index\n");
     printf("                 e.g.: --get <flow_index>\n");
     printf("--mirror         Mirror index to mirror to\n");
@@ -2192,6 +2723,8 @@ Usage(void)
     printf("                               proto {tcp, udp, icmp, icmp6, sctp}\n");
     printf("-l               List flows\n");
     printf("--show-evicted   Show evicted flows too\n");
+    printf("--dirty          List only the flows changed since the last sync\n");
+    printf("--events         Follow flow events posted by the datapath\n");
     printf("-r               Start dumping flow setup rate\n");
     printf("-s               Start dumping flow stats\n");
     printf("--help           Print this help\n");
@@ -2204,6 +2737,11 @@ enum opt_flow_index {
     GET_OPT_INDEX,
     MIRROR_OPT_INDEX,
     SHOW_EVICTED_OPT_INDEX,
+    EVENTS_OPT_INDEX,
+    DIRTY_OPT_INDEX,
+    BULK_OPT_INDEX,
+    GROW_OPT_INDEX,
+    POLICY_OPT_INDEX,
     MATCH_OPT_INDEX,
     HELP_OPT_INDEX,
     MAX_OPT_INDEX
@@ -2214,6 +2752,11 @@ static struct option long_options[] = {
     [GET_OPT_INDEX]             = {"get",           required_argument, &get_set,            1},
     [MIRROR_OPT_INDEX]          = {"mirror",        required_argument, &mir_set,            1},
     [SHOW_EVICTED_OPT_INDEX]    = {"show-evicted",  no_argument,       &show_evicted_set,   1},
+    [EVENTS_OPT_INDEX]          = {"events",        no_argument,       &events_set,         1},
+    [DIRTY_OPT_INDEX]           = {"dirty",         no_argument,       &dirty_set,          1},
+    [BULK_OPT_INDEX]            = {"bulk",          no_argument,       &bulk_set,           1},
+    [GROW_OPT_INDEX]            = {"grow",          no_argument,       &grow_set,           1},
+    [POLICY_OPT_INDEX]          = {"policy",        no_argument,       &policy_set,         1},
     [MATCH_OPT_INDEX]           = {"match",         required_argument, &match_set,          1},
     [HELP_OPT_INDEX]            = {"help",          no_argument,       &help_set,           1},
     [MAX_OPT_INDEX]             = { NULL,           0,                 0,                   0}
@@ -2223,7 +2766,7 @@ static void
 validate_options(void)
 {
     if (!flow_index && !list && !rate && !stats && !match_set
-        && !perf && !flush)
+        && !perf && !flush && !events_set && !grow_set && !policy_set)
         Usage();
 
     if (show_evicted_set && !list)
@@ -2503,6 +3046,16 @@ parse_long_opts(int opt_flow_index, char *opt_arg)
         break;
 
     case SHOW_EVICTED_OPT_INDEX:
+    case EVENTS_OPT_INDEX:
+        break;
+
+    case DIRTY_OPT_INDEX:
+        list = 1;
+        break;
+
+    case BULK_OPT_INDEX:
+    case GROW_OPT_INDEX:
+    case POLICY_OPT_INDEX:
         break;
 
     case HELP_OPT_INDEX:
@@ -2563,11 +3116,6 @@ main(int argc, char *argv[])
             if (bunch < 1) {
                 bunch = 1;
             }
-            if (bunch > MAX_FLOW_NL_MSG_BUNCH) {
-                printf("Max NETLINK messages in a bunch cannot exceed %u.\n",
-                        MAX_FLOW_NL_MSG_BUNCH);
-                bunch = MAX_FLOW_NL_MSG_BUNCH;
-            }
             break;
 
         case 0:
@@ -2581,6 +3129,16 @@ main(int argc, char *argv[])
 
     validate_options();
 
+    if (bulk_set && bunch > VR_FLOW_BULK_MAX_OPS) {
+        printf("Max flow operations in a bulk request cannot exceed %u.\n",
+                VR_FLOW_BULK_MAX_OPS);
+        bunch = VR_FLOW_BULK_MAX_OPS;
+    } else if (!bulk_set && bunch > MAX_FLOW_NL_MSG_BUNCH) {
+        printf("Max NETLINK messages in a bunch cannot exceed %u.\n",
+                MAX_FLOW_NL_MSG_BUNCH);
+        bunch = MAX_FLOW_NL_MSG_BUNCH;
+    }
+
     ret = flow_table_setup();
     if (ret < 0)
         return ret;
@@ -2599,6 +3157,16 @@ main(int argc, char *argv[])
         run_perf();
     } else if (flush) {
         run_flush();
+    } else if (events_set) {
+        flow_events();
+    } else if (grow_set) {
+        ret = flow_table_grow();
+        if (ret < 0)
+            return ret;
+    } else if (policy_set) {
+        ret = flow_policy_list();
+        if (ret < 0)
+            return ret;
     } else {
         if (flow_index >= main_table.ft_num_entries) {
             printf("Flow index %lu is greater than available indices (%u)\n",
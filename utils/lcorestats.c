@@ -0,0 +1,201 @@
+/*
+ * lcorestats.c - per-lcore cycle and poll efficiency statistics
+ *
+ * Copyright (c) 2016 Juniper Networks, Inc. All rights reserved.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <getopt.h>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+
+#include <net/if.h>
+
+#include "vr_os.h"
+#include "vr_types.h"
+#include "nl_util.h"
+
+static struct nl_client *cl;
+static int help_set, core_set;
+static int core = -1;
+static bool dump_pending = false;
+static int dump_marker = -1;
+
+static double
+lcore_stats_ratio(uint64_t num, uint64_t den)
+{
+    if (!den)
+        return 0;
+
+    return (double)num / den;
+}
+
+static void
+lcore_stats_req_process(void *s_req)
+{
+    int i;
+    uint64_t total_cycles;
+    vr_lcore_stats_req *stats = (vr_lcore_stats_req *)s_req;
+
+    total_cycles = stats->vlsr_busy_cycles + stats->vlsr_idle_cycles;
+
+    printf("Lcore %d\n", stats->vlsr_core);
+    printf("    Busy                        %.2f%% (%" PRIu64 " of %" PRIu64
+            " cycles, TSC %" PRIu64 " Hz)\n",
+            100 * lcore_stats_ratio(stats->vlsr_busy_cycles, total_cycles),
+            stats->vlsr_busy_cycles, total_cycles, stats->vlsr_tsc_hz);
+    printf("    Loops                       %" PRIu64 "\n", stats->vlsr_loops);
+    printf("    Polls                       %" PRIu64 " (empty %" PRIu64
+            ")\n", stats->vlsr_polls + stats->vlsr_empty_polls,
+            stats->vlsr_empty_polls);
+    printf("    Packets                     %" PRIu64 "\n",
+            stats->vlsr_packets);
+    printf("    Packets/Non-empty Poll      %.2f\n",
+            lcore_stats_ratio(stats->vlsr_packets, stats->vlsr_polls));
+
+    printf("    Burst Size Histogram       ");
+    for (i = 0; i < stats->vlsr_burst_hist_size; i++)
+        printf(" [%d-%d] %" PRId64, 1 << i, (2 << i) - 1,
+                stats->vlsr_burst_hist[i]);
+    printf("\n");
+
+    printf("    Cycles/Packet               RX %.1f  Distribute %.1f"
+            "  Vroute %.1f  TX Push %.1f\n",
+            lcore_stats_ratio(stats->vlsr_rx_cycles, stats->vlsr_packets),
+            lcore_stats_ratio(stats->vlsr_distribute_cycles,
+                stats->vlsr_packets),
+            lcore_stats_ratio(stats->vlsr_vroute_cycles, stats->vlsr_packets),
+            lcore_stats_ratio(stats->vlsr_tx_push_cycles,
+                stats->vlsr_packets));
+    printf("\n");
+
+    dump_marker = stats->vlsr_core;
+
+    return;
+}
+
+static void
+response_process(void *s)
+{
+    vr_response_common_process((vr_response *)s, &dump_pending);
+    return;
+}
+
+static void
+lcorestats_fill_nl_callbacks()
+{
+    nl_cb.vr_lcore_stats_req_process = lcore_stats_req_process;
+    nl_cb.vr_response_process = response_process;
+}
+
+static int
+vr_get_lcore_stats(struct nl_client *cl)
+{
+    int ret;
+    bool dump = !core_set;
+
+op_retry:
+    if (dump)
+        ret = vr_send_lcore_stats_dump(cl, 0, dump_marker);
+    else
+        ret = vr_send_lcore_stats_get(cl, 0, core);
+    if (ret < 0)
+        return ret;
+
+    ret = vr_recvmsg(cl, dump);
+    if (ret <= 0)
+        return ret;
+
+    if (dump_pending)
+        goto op_retry;
+
+    return 0;
+}
+
+enum opt_index {
+    HELP_OPT_INDEX,
+    CORE_OPT_INDEX,
+    MAX_OPT_INDEX,
+};
+
+static struct option long_options[] = {
+    [HELP_OPT_INDEX]    =   {"help",    no_argument,        &help_set,      1},
+    [CORE_OPT_INDEX]    =   {"core",    required_argument,  &core_set,      1},
+    [MAX_OPT_INDEX]     =   {NULL,    0,                  0,              0},
+};
+
+static void
+Usage()
+{
+    printf("Usage: lcorestats [--help]\n");
+    printf("Usage: lcorestats [--core|-c] <core number>\n\n");
+    printf("--core <core number>\t Show statistics for a specified lcore\n");
+    printf("\t\t\t Statistics for all the forwarding lcores are shown by default\n");
+    exit(-EINVAL);
+}
+
+static void
+parse_long_opts(int opt_index, char *opt_arg)
+{
+    errno = 0;
+
+    switch (opt_index) {
+    case CORE_OPT_INDEX:
+        core = (int)strtol(opt_arg, NULL, 0);
+        if (errno || core < 0) {
+            printf("Error parsing core %s: %s (%d)\n", opt_arg,
+                    strerror(errno), errno);
+            Usage();
+        }
+        break;
+
+    case HELP_OPT_INDEX:
+    default:
+        Usage();
+    }
+
+    return;
+}
+
+int
+main(int argc, char *argv[])
+{
+    char opt;
+    int ret, option_index;
+
+    lcorestats_fill_nl_callbacks();
+
+    while (((opt = getopt_long(argc, argv, "hc:",
+                        long_options, &option_index)) >= 0)) {
+        switch (opt) {
+        case 'c':
+            core_set = 1;
+            parse_long_opts(CORE_OPT_INDEX, optarg);
+            break;
+
+        case 0:
+            parse_long_opts(option_index, optarg);
+            break;
+
+        case 'h':
+        default:
+            Usage();
+        }
+    }
+
+    cl = vr_get_nl_client(VR_NETLINK_PROTO_DEFAULT);
+    if (!cl)
+        return -1;
+
+    ret = vr_get_lcore_stats(cl);
+    if (ret < 0)
+        return ret;
+
+    return 0;
+}
@@ -11,6 +11,7 @@
 #include <errno.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <inttypes.h>
 #include <getopt.h>
 
 #include <sys/types.h>
@@ -233,6 +234,10 @@ nh_flags(uint32_t flags, uint8_t type, char *ptr)
         case NH_FLAG_L2_CONTROL_DATA:
             strcat(ptr, "Evpn Control Word, ");
             break;
+
+        case NH_FLAG_COUNTERS:
+            strcat(ptr, "Counters, ");
+            break;
         }
     }
 
@@ -275,6 +280,12 @@ nexthop_req_process(void *s_req)
     printf("Flags:%s",
             nh_flags(req->nhr_flags, req->nhr_type, flags_mem));
 
+    if (req->nhr_flags & NH_FLAG_COUNTERS) {
+        nh_print_newline_header();
+        printf("Packets:%" PRIu64 "  Bytes:%" PRIu64,
+                req->nhr_packets, req->nhr_bytes);
+    }
+
     if ((req->nhr_flags & NH_FLAG_INDIRECT) && (req->nhr_nh_list_size)) {
         i = -1;
         if (req->nhr_label_list_size)
@@ -362,6 +373,23 @@ nexthop_req_process(void *s_req)
             printf(" and %u more components...\n",
                     req->nhr_nh_count - req->nhr_nh_list_size);
         }
+
+        if (req->nhr_nh_packets_size) {
+            nh_print_newline_header();
+            printf("Sub NH Packets(Bytes):");
+            printed = 0;
+            for (i = 0; i < req->nhr_nh_packets_size; i++) {
+                if (printed > 60) {
+                    nh_print_newline_header();
+                    printf("%14c", ' ');
+                    printed = 0;
+                }
+                printed += printf(" %" PRIu64 "(%" PRIu64 ")",
+                        req->nhr_nh_packets[i],
+                        (i < req->nhr_nh_bytes_size) ?
+                        req->nhr_nh_bytes[i] : 0);
+            }
+        }
     }
 
     if (command == SANDESH_OP_DUMP) {
@@ -466,6 +494,7 @@ cmd_usage()
            "       [--pol NH with policy]\n"
            "       [--rpol NH with relaxed policy]\n"
            "       [--root NH is an Etree Root]\n"
+           "       [--cnt Count packets and bytes through the NH]\n"
            "       [--rlkup Force Route Lookup]\n"
            "       [--type <type> type of the tunnel 1 - rcv, 2 - encap \n"
            "                       3 - tunnel, 4 - resolve, 5 - discard, 6 - Composite\n"
@@ -562,6 +591,7 @@ enum opt_index {
     PBB_OPT_IND,
     ROOT_OPT_IND,
     ML_OPT_IND,
+    CNT_OPT_IND,
     HLP_OPT_IND,
     MAX_OPT_IND
 };
@@ -616,6 +646,7 @@ static struct option long_options[] = {
     [PBB_OPT_IND]       = {"pbb",   no_argument,        &opt[PBB_OPT_IND],      1},
     [ROOT_OPT_IND]      = {"root",  no_argument,        &opt[ROOT_OPT_IND],     1},
     [ML_OPT_IND]        = {"ml",    no_argument,        &opt[ML_OPT_IND],       1},
+    [CNT_OPT_IND]       = {"cnt",   no_argument,        &opt[CNT_OPT_IND],      1},
     [HLP_OPT_IND]       = {"help",  no_argument,        &opt[HLP_OPT_IND],      1},
     [MAX_OPT_IND]       = { NULL,   0,                  0,                      0}
 };
@@ -765,6 +796,9 @@ validate_options(void)
         if (opt_set(ROOT_OPT_IND))
             flags |= NH_FLAG_ETREE_ROOT;
 
+        if (opt_set(CNT_OPT_IND))
+            flags |= NH_FLAG_COUNTERS;
+
         if (type == NH_RCV) {
             if (!opt_set(OIF_OPT_IND))
                 cmd_usage();
@@ -194,6 +194,62 @@ vr_hugepage_config_process(void *s_req)
     }
 }
 
+void
+vr_lcore_stats_req_process(void *s_req)
+{
+    if (nl_cb.vr_lcore_stats_req_process) {
+        nl_cb.vr_lcore_stats_req_process(s_req);
+    }
+}
+
+void
+vr_flow_policy_req_process(void *s_req)
+{
+    if (nl_cb.vr_flow_policy_req_process) {
+        nl_cb.vr_flow_policy_req_process(s_req);
+    }
+}
+
+void
+vr_dp_latency_req_process(void *s_req)
+{
+    if (nl_cb.vr_dp_latency_req_process) {
+        nl_cb.vr_dp_latency_req_process(s_req);
+    }
+}
+
+void
+vr_pkt_trace_req_process(void *s_req)
+{
+    if (nl_cb.vr_pkt_trace_req_process) {
+        nl_cb.vr_pkt_trace_req_process(s_req);
+    }
+}
+
+void
+vr_drop_capture_req_process(void *s_req)
+{
+    if (nl_cb.vr_drop_capture_req_process) {
+        nl_cb.vr_drop_capture_req_process(s_req);
+    }
+}
+
+void
+vr_flow_dirty_req_process(void *s_req)
+{
+    if (nl_cb.vr_flow_dirty_req_process) {
+        nl_cb.vr_flow_dirty_req_process(s_req);
+    }
+}
+
+void
+vr_flow_bulk_response_process(void *s_req)
+{
+    if (nl_cb.vr_flow_bulk_response_process) {
+        nl_cb.vr_flow_bulk_response_process(s_req);
+    }
+}
+
 struct nl_response *
 nl_parse_gen_ctrl(struct nl_client *cl)
 {
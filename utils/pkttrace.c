@@ -0,0 +1,389 @@
+/*
+ * pkttrace.c - trace sampled packets through the datapath
+ *
+ * Copyright (c) 2016 Juniper Networks, Inc. All rights reserved.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <getopt.h>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+
+#include <net/if.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "vr_os.h"
+#include "vr_types.h"
+#include "nl_util.h"
+#include "vr_trace.h"
+
+static struct nl_client *cl;
+static int help_set, arm_set, disarm_set, reset_set;
+static int vif_set, proto_set, sport_set, dport_set, sip_set, dip_set;
+static int trace_op = SANDESH_OP_GET;
+static int count, vif = -1, proto, sport, dport;
+static uint8_t family;
+static uint8_t sip[VR_TRACE_ADDR_LEN], dip[VR_TRACE_ADDR_LEN];
+static bool dump_pending = false;
+static int dump_marker = -1;
+
+/* the packet and the cycle count of the last record that was printed */
+static int last_core = -1;
+static unsigned int last_packet;
+static uint64_t last_time;
+
+/* in the order of enum vr_trace_point */
+static const char *trace_points[] = {
+    "None",
+    "RX",
+    "Fabric Input",
+    "Flow Action",
+    "Nexthop Output",
+    "ECMP",
+    "UDP Tunnel",
+    "Interface TX",
+};
+
+static void
+pkt_trace_print_filter(vr_pkt_trace_req *req)
+{
+    char addr[INET6_ADDRSTRLEN];
+
+    printf("Filter:");
+    if (req->ptr_vif >= 0)
+        printf(" vif %d", req->ptr_vif);
+    if (req->ptr_proto)
+        printf(" proto %u", (uint8_t)req->ptr_proto);
+    if (req->ptr_sport)
+        printf(" sport %u", req->ptr_sport);
+    if (req->ptr_dport)
+        printf(" dport %u", req->ptr_dport);
+
+    if (req->ptr_family && req->ptr_sip_size &&
+            inet_ntop(req->ptr_family, req->ptr_sip, addr, sizeof(addr)))
+        printf(" sip %s", addr);
+    if (req->ptr_family && req->ptr_dip_size &&
+            inet_ntop(req->ptr_family, req->ptr_dip, addr, sizeof(addr)))
+        printf(" dip %s", addr);
+
+    printf("\n");
+
+    return;
+}
+
+static void
+pkt_trace_print_record(vr_pkt_trace_req *req)
+{
+    struct in_addr ip;
+
+    if ((req->ptr_core != last_core) || (req->ptr_packet != last_packet)) {
+        printf("\nCore %d, packet %u\n", req->ptr_core, req->ptr_packet);
+        printf("    %-16s%8s%6s%6s%8s%14s%14s%12s\n", "Point", "Vif", "Vrf",
+                "Len", "Nh", "Data0", "Data1", "Cycles");
+        last_core = req->ptr_core;
+        last_packet = req->ptr_packet;
+        last_time = req->ptr_time;
+    }
+
+    if (req->ptr_point < sizeof(trace_points) / sizeof(trace_points[0]))
+        printf("    %-16s", trace_points[req->ptr_point]);
+    else
+        printf("    %-16u", req->ptr_point);
+
+    printf("%8u%6u%6u%8u", req->ptr_rec_vif, req->ptr_vrf, req->ptr_len,
+            req->ptr_nh);
+
+    if (req->ptr_point == VR_TRACE_UDP_TUNNEL && req->ptr_data0) {
+        ip.s_addr = req->ptr_data0;
+        printf("%14s", inet_ntoa(ip));
+    } else {
+        printf("%14u", req->ptr_data0);
+    }
+    printf("%14u", req->ptr_data1);
+
+    printf("%12" PRIu64 "\n", req->ptr_time - last_time);
+
+    return;
+}
+
+static void
+pkt_trace_req_process(void *s_req)
+{
+    vr_pkt_trace_req *req = (vr_pkt_trace_req *)s_req;
+
+    if (trace_op == SANDESH_OP_GET) {
+        if (req->ptr_count)
+            printf("Armed, %d packets left to trace\n", req->ptr_count);
+        else
+            printf("Not armed\n");
+        pkt_trace_print_filter(req);
+        printf("%u records, %u records lost\n", req->ptr_records,
+                req->ptr_lost);
+        return;
+    }
+
+    pkt_trace_print_record(req);
+    dump_marker = req->ptr_marker;
+
+    return;
+}
+
+static void
+response_process(void *s)
+{
+    vr_response_common_process((vr_response *)s, &dump_pending);
+    return;
+}
+
+static void
+pkt_trace_fill_nl_callbacks()
+{
+    nl_cb.vr_pkt_trace_req_process = pkt_trace_req_process;
+    nl_cb.vr_response_process = response_process;
+}
+
+static int
+pkt_trace_op(struct nl_client *cl)
+{
+    int ret;
+    bool dump = false;
+
+op_retry:
+    switch (trace_op) {
+    case SANDESH_OP_ADD:
+        ret = vr_send_pkt_trace_arm(cl, 0, count, vif, family, proto, sport,
+                dport, sip_set ? sip : NULL, dip_set ? dip : NULL);
+        break;
+
+    case SANDESH_OP_DEL:
+        ret = vr_send_pkt_trace_disarm(cl, 0);
+        break;
+
+    case SANDESH_OP_RESET:
+        ret = vr_send_pkt_trace_reset(cl, 0);
+        break;
+
+    case SANDESH_OP_GET:
+        ret = vr_send_pkt_trace_get(cl, 0);
+        break;
+
+    case SANDESH_OP_DUMP:
+        dump = true;
+        ret = vr_send_pkt_trace_dump(cl, 0, dump_marker);
+        break;
+
+    default:
+        ret = -EINVAL;
+        break;
+    }
+
+    if (ret < 0)
+        return ret;
+
+    ret = vr_recvmsg(cl, dump);
+    if (ret <= 0)
+        return ret;
+
+    if (dump_pending)
+        goto op_retry;
+
+    /* show the state of the trace ahead of the records */
+    if (trace_op == SANDESH_OP_GET) {
+        trace_op = SANDESH_OP_DUMP;
+        goto op_retry;
+    }
+
+    return 0;
+}
+
+enum opt_index {
+    HELP_OPT_INDEX,
+    ARM_OPT_INDEX,
+    DISARM_OPT_INDEX,
+    RESET_OPT_INDEX,
+    VIF_OPT_INDEX,
+    PROTO_OPT_INDEX,
+    SPORT_OPT_INDEX,
+    DPORT_OPT_INDEX,
+    SIP_OPT_INDEX,
+    DIP_OPT_INDEX,
+    MAX_OPT_INDEX,
+};
+
+static struct option long_options[] = {
+    [HELP_OPT_INDEX]    =   {"help",    no_argument,        &help_set,      1},
+    [ARM_OPT_INDEX]     =   {"arm",     required_argument,  &arm_set,       1},
+    [DISARM_OPT_INDEX]  =   {"disarm",  no_argument,        &disarm_set,    1},
+    [RESET_OPT_INDEX]   =   {"reset",   no_argument,        &reset_set,     1},
+    [VIF_OPT_INDEX]     =   {"vif",     required_argument,  &vif_set,       1},
+    [PROTO_OPT_INDEX]   =   {"proto",   required_argument,  &proto_set,     1},
+    [SPORT_OPT_INDEX]   =   {"sport",   required_argument,  &sport_set,     1},
+    [DPORT_OPT_INDEX]   =   {"dport",   required_argument,  &dport_set,     1},
+    [SIP_OPT_INDEX]     =   {"sip",     required_argument,  &sip_set,       1},
+    [DIP_OPT_INDEX]     =   {"dip",     required_argument,  &dip_set,       1},
+    [MAX_OPT_INDEX]     =   {NULL,    0,                  0,              0},
+};
+
+static void
+Usage()
+{
+    printf("Usage: pkttrace [--help]\n");
+    printf("Usage: pkttrace\n");
+    printf("       pkttrace --arm <N> [--vif <vif>] [--proto <proto>]\n");
+    printf("                [--sip <ip>] [--dip <ip>]\n");
+    printf("                [--sport <port>] [--dport <port>]\n");
+    printf("       pkttrace --disarm\n");
+    printf("       pkttrace --reset\n\n");
+    printf("\t\t\t Without options, show the state and the records of the trace\n");
+    printf("--arm <N>\t\t Trace the next N packets that match the filter\n");
+    printf("--vif <vif>\t\t Trace only packets received on the interface\n");
+    printf("--proto <proto>\t\t Trace only packets of the IP protocol\n");
+    printf("--sip, --dip <ip>\t Trace only packets from or to the address\n");
+    printf("--sport, --dport <port>\t Trace only packets from or to the port\n");
+    printf("--disarm\t\t Stop tracing, the records are retained\n");
+    printf("--reset\t\t\t Clear the records of a disarmed trace\n");
+    exit(-EINVAL);
+}
+
+static int
+parse_addr(char *opt_arg, uint8_t *addr)
+{
+    uint8_t addr_family = AF_INET;
+
+    if (strchr(opt_arg, ':'))
+        addr_family = AF_INET6;
+
+    if (inet_pton(addr_family, opt_arg, addr) != 1)
+        return -EINVAL;
+
+    if (family && (family != addr_family))
+        return -EINVAL;
+    family = addr_family;
+
+    return 0;
+}
+
+static void
+parse_long_opts(int opt_index, char *opt_arg)
+{
+    errno = 0;
+
+    switch (opt_index) {
+    case ARM_OPT_INDEX:
+        count = (int)strtol(opt_arg, NULL, 0);
+        if (errno || (count <= 0)) {
+            printf("Error parsing packet count %s: %s (%d)\n", opt_arg,
+                    strerror(errno), errno);
+            Usage();
+        }
+        trace_op = SANDESH_OP_ADD;
+        break;
+
+    case DISARM_OPT_INDEX:
+        trace_op = SANDESH_OP_DEL;
+        break;
+
+    case RESET_OPT_INDEX:
+        trace_op = SANDESH_OP_RESET;
+        break;
+
+    case VIF_OPT_INDEX:
+        vif = (int)strtol(opt_arg, NULL, 0);
+        if (errno || (vif < 0)) {
+            printf("Error parsing vif %s: %s (%d)\n", opt_arg,
+                    strerror(errno), errno);
+            Usage();
+        }
+        break;
+
+    case PROTO_OPT_INDEX:
+        proto = (int)strtol(opt_arg, NULL, 0);
+        if (errno || (proto <= 0) || (proto > 255)) {
+            printf("Error parsing protocol %s\n", opt_arg);
+            Usage();
+        }
+        break;
+
+    case SPORT_OPT_INDEX:
+    case DPORT_OPT_INDEX:
+        if (opt_index == SPORT_OPT_INDEX)
+            sport = (int)strtol(opt_arg, NULL, 0);
+        else
+            dport = (int)strtol(opt_arg, NULL, 0);
+        if (errno || (sport < 0) || (sport > 65535) ||
+                (dport < 0) || (dport > 65535)) {
+            printf("Error parsing port %s\n", opt_arg);
+            Usage();
+        }
+        break;
+
+    case SIP_OPT_INDEX:
+    case DIP_OPT_INDEX:
+        if (parse_addr(opt_arg,
+                    (opt_index == SIP_OPT_INDEX) ? sip : dip)) {
+            printf("Error parsing address %s\n", opt_arg);
+            Usage();
+        }
+        break;
+
+    case HELP_OPT_INDEX:
+    default:
+        Usage();
+    }
+
+    return;
+}
+
+static void
+validate_options(void)
+{
+    if ((arm_set + disarm_set + reset_set) > 1)
+        Usage();
+
+    if (!arm_set && (vif_set || proto_set || sport_set || dport_set ||
+                sip_set || dip_set))
+        Usage();
+
+    return;
+}
+
+int
+main(int argc, char *argv[])
+{
+    char opt;
+    int ret, option_index;
+
+    pkt_trace_fill_nl_callbacks();
+
+    while (((opt = getopt_long(argc, argv, "h",
+                        long_options, &option_index)) >= 0)) {
+        switch (opt) {
+        case 0:
+            parse_long_opts(option_index, optarg);
+            break;
+
+        case 'h':
+        default:
+            Usage();
+        }
+    }
+
+    validate_options();
+
+    cl = vr_get_nl_client(VR_NETLINK_PROTO_DEFAULT);
+    if (!cl)
+        return -1;
+
+    ret = pkt_trace_op(cl);
+    if (ret < 0)
+        return ret;
+
+    return 0;
+}
@@ -20,6 +20,8 @@
 #endif
 
 #include <vr_mem.h>
+#include <vr_flow_event.h>
+#include <vr_stats_shm.h>
 #include <nl_util.h>
 #include <ini_parser.h>
 
@@ -55,6 +57,18 @@ vr_table_map(int major, unsigned int table, char *table_path, size_t size, void
             path = FLOW_TABLE_DEV;
             break;
 
+        case VR_MEM_FLOW_EVENT_OBJECT:
+            path = FLOW_EVENT_DEV;
+            break;
+
+        case VR_MEM_INET_FLOW_TABLE_OBJECT:
+            path = INET_FLOW_TABLE_DEV;
+            break;
+
+        case VR_MEM_STATS_OBJECT:
+            path = STATS_DEV;
+            break;
+
         default:
             return false;
         }
@@ -83,6 +97,129 @@ vr_table_map(int major, unsigned int table, char *table_path, size_t size, void
     return true;
 }
 
+/*
+ * vr_flow_event_ring_read - copy up to max events posted to a mapped flow
+ * event ring since *tail, and advance *tail. Events overwritten by the
+ * datapath before they could be read are added to *lost.
+ *
+ * Returns the number of events copied.
+ */
+unsigned int
+vr_flow_event_ring_read(struct vr_flow_event_ring *ring, uint64_t *tail,
+        struct vr_flow_event *events, unsigned int max, uint64_t *lost)
+{
+    int32_t diff;
+    uint32_t seq;
+    uint64_t head;
+    unsigned int n = 0;
+    volatile struct vr_flow_event *slot;
+
+    head = *(volatile uint64_t *)&ring->fer_hdr.ferh_head;
+    __sync_synchronize();
+
+    if (head - *tail > VR_FLOW_EVENT_RING_ENTRIES) {
+        *lost += head - *tail - VR_FLOW_EVENT_RING_ENTRIES;
+        *tail = head - VR_FLOW_EVENT_RING_ENTRIES;
+    }
+
+    while (*tail < head && n < max) {
+        slot = &ring->fer_events[*tail % VR_FLOW_EVENT_RING_ENTRIES];
+        seq = slot->fev_seq;
+        diff = (int32_t)(seq - (uint32_t)(*tail + 1));
+        /* the slot is still being written, try again later */
+        if (diff < 0)
+            break;
+
+        if (!diff) {
+            __sync_synchronize();
+            events[n].fev_index = slot->fev_index;
+            events[n].fev_type = slot->fev_type;
+            events[n].fev_gen_id = slot->fev_gen_id;
+            events[n].fev_flags = slot->fev_flags;
+            events[n].fev_data = slot->fev_data;
+            events[n].fev_seq = seq;
+            __sync_synchronize();
+            /* a newer event did not overwrite the slot while copying */
+            if (slot->fev_seq == seq)
+                n++;
+            else
+                (*lost)++;
+        } else {
+            (*lost)++;
+        }
+        (*tail)++;
+    }
+
+    return n;
+}
+
+#define VR_STATS_SHM_READ_RETRIES   64
+
+/*
+ * vr_stats_shm_read - copy up to words counters of a slot of a mapped
+ * stats region, of one cpu or summed over all of them if cpu is negative.
+ *
+ * Returns 0, -ENOENT if the slot is not in use or the object with the index
+ * keeps its counters in private memory, -EINVAL if the slot or the cpu is
+ * not in the region, or -EAGAIN if the slot kept changing.
+ */
+int
+vr_stats_shm_read(void *shm, unsigned int section, unsigned int slot,
+        int cpu, uint64_t *counters, unsigned int words)
+{
+    uint32_t seq;
+    unsigned int i, j, first, last, retries;
+    volatile uint64_t *src;
+    volatile struct vr_stats_shm_state *state;
+    struct vr_stats_shm_section *ss;
+    struct vr_stats_shm_hdr *hdr = (struct vr_stats_shm_hdr *)shm;
+
+    if ((section >= hdr->sh_sections) || (section >= VR_STATS_SHM_SECTIONS))
+        return -EINVAL;
+
+    ss = &hdr->sh_section[section];
+    if ((slot >= ss->ss_slots) || (cpu >= (int)hdr->sh_cpus))
+        return -EINVAL;
+
+    if (words > ss->ss_cpu_size / sizeof(uint64_t))
+        words = ss->ss_cpu_size / sizeof(uint64_t);
+
+    first = (cpu < 0) ? 0 : cpu;
+    last = (cpu < 0) ? hdr->sh_cpus : cpu + 1;
+    state = (volatile struct vr_stats_shm_state *)((char *)shm +
+            ss->ss_state_offset) + slot;
+
+    for (retries = 0; retries < VR_STATS_SHM_READ_RETRIES; retries++) {
+        seq = state->st_seq;
+        /* the slot is being handed out, taken back or cleared */
+        if (seq & 1)
+            continue;
+
+        __sync_synchronize();
+        if ((state->st_flags & (VR_STATS_SHM_SLOT_USED |
+                        VR_STATS_SHM_SLOT_PRIVATE)) != VR_STATS_SHM_SLOT_USED) {
+            if (state->st_seq != seq)
+                continue;
+            return -ENOENT;
+        }
+
+        memset(counters, 0, words * sizeof(uint64_t));
+        for (i = first; i < last; i++) {
+            src = (volatile uint64_t *)((char *)shm + ss->ss_offset +
+                    (uint64_t)slot * ss->ss_slot_stride +
+                    i * ss->ss_cpu_stride);
+            for (j = 0; j < words; j++)
+                counters[j] += src[j];
+        }
+
+        __sync_synchronize();
+        if (state->st_seq == seq)
+            return 0;
+    }
+
+    return -EAGAIN;
+}
+
 int
 nl_socket(struct nl_client *cl, int domain, int type, int protocol)
 {
@@ -52,6 +52,7 @@
 #include "vr_genetlink.h"
 #include "nl_util.h"
 #include "ini_parser.h"
+#include "vr_stats_shm.h"
 
 
 #define LISTING_NUM_OF_LINE  3
@@ -121,6 +122,19 @@ static struct timeval last_time;
 
 static bool first_rate_iter = false;
 
+/*
+ * With the shared statistics region mapped, the rates of the interfaces of
+ * the last dump are refreshed from the region, and the interfaces are
+ * dumped again only every VIF_SHM_DUMP_INTERVAL iterations, when the
+ * terminal was too small to show them or when one of them went away.
+ */
+#define VIF_SHM_DUMP_INTERVAL   10
+
+static void *stats_shm;
+static vr_interface_req *shm_reqs;
+static unsigned int shm_num_reqs, shm_max_reqs, shm_iterations;
+static bool shm_recording, shm_stale;
+
 
 /*
  * How many times we partially ignore function call vr_interface_req_process.
@@ -762,6 +776,95 @@ rate_process(vr_interface_req *req, vr_interface_req *prev_req)
     }
 }
 
+static void
+rate_shm_flush(void)
+{
+    unsigned int i;
+
+    for (i = 0; i < shm_num_reqs; i++) {
+        free(shm_reqs[i].vifr_name);
+        free(shm_reqs[i].vifr_queue_ierrors_to_lcore);
+    }
+    shm_num_reqs = 0;
+
+    return;
+}
+
+/* keep what list_rate_print needs of an interface that was dumped */
+static void
+rate_shm_cache(vr_interface_req *req)
+{
+    vr_interface_req *cached;
+
+    if (shm_num_reqs == shm_max_reqs) {
+        shm_max_reqs = shm_max_reqs ? shm_max_reqs * 2 : 64;
+        cached = realloc(shm_reqs, shm_max_reqs * sizeof(*shm_reqs));
+        if (!cached) {
+            fprintf(stderr, "Fail, memory allocation. (%s:%d).", __FILE__ , __LINE__);
+            exit(1);
+        }
+        shm_reqs = cached;
+    }
+
+    cached = &shm_reqs[shm_num_reqs];
+    memset(cached, 0, sizeof(*cached));
+    cached->vifr_type = req->vifr_type;
+    cached->vifr_rid = req->vifr_rid;
+    cached->vifr_idx = req->vifr_idx;
+    cached->vifr_name = strdup(req->vifr_name ? req->vifr_name : "");
+    cached->vifr_queue_ierrors_to_lcore =
+        calloc(req->vifr_queue_ierrors_to_lcore_size + 1, sizeof(uint64_t));
+    if (!cached->vifr_name || !cached->vifr_queue_ierrors_to_lcore) {
+        fprintf(stderr, "Fail, memory allocation. (%s:%d).", __FILE__ , __LINE__);
+        exit(1);
+    }
+
+    /* the region does not have the queue errors of the lcores */
+    cached->vifr_queue_ierrors_to_lcore_size =
+        req->vifr_queue_ierrors_to_lcore_size;
+    if (req->vifr_queue_ierrors_to_lcore)
+        memcpy(cached->vifr_queue_ierrors_to_lcore,
+                req->vifr_queue_ierrors_to_lcore,
+                req->vifr_queue_ierrors_to_lcore_size * sizeof(uint64_t));
+    shm_num_reqs++;
+
+    return;
+}
+
+static void
+rate_shm_fill(vr_interface_req *req, struct vr_interface_stats *stats)
+{
+    req->vifr_ibytes = stats->vis_ibytes;
+    req->vifr_ipackets = stats->vis_ipackets;
+    req->vifr_ierrors = stats->vis_ierrors;
+    req->vifr_obytes = stats->vis_obytes;
+    req->vifr_opackets = stats->vis_opackets;
+    req->vifr_oerrors = stats->vis_oerrors;
+
+    req->vifr_queue_ipackets = stats->vis_queue_ipackets;
+    req->vifr_queue_ierrors = stats->vis_queue_ierrors;
+    req->vifr_queue_opackets = stats->vis_queue_opackets;
+    req->vifr_queue_oerrors = stats->vis_queue_oerrors;
+
+    req->vifr_port_ipackets = stats->vis_port_ipackets;
+    req->vifr_port_ierrors = stats->vis_port_ierrors;
+    req->vifr_port_isyscalls = stats->vis_port_isyscalls;
+    req->vifr_port_inombufs = stats->vis_port_inombufs;
+    req->vifr_port_opackets = stats->vis_port_opackets;
+    req->vifr_port_oerrors = stats->vis_port_oerrors;
+    req->vifr_port_osyscalls = stats->vis_port_osyscalls;
+
+    req->vifr_dev_ibytes = stats->vis_dev_ibytes;
+    req->vifr_dev_ipackets = stats->vis_dev_ipackets;
+    req->vifr_dev_ierrors = stats->vis_dev_ierrors;
+    req->vifr_dev_inombufs = stats->vis_dev_inombufs;
+    req->vifr_dev_obytes = stats->vis_dev_obytes;
+    req->vifr_dev_opackets = stats->vis_dev_opackets;
+    req->vifr_dev_oerrors = stats->vis_dev_oerrors;
+
+    return;
+}
+
 /*
  * The function is called by functions sandesh_decode.
  * In case, when we have sent SANDESH_OP_DUMP (usually --list parameter) msg to nl_client,
@@ -784,6 +887,9 @@ interface_req_process(void *s)
         return;
 
     if (rate_set) {
+        if (shm_recording)
+            rate_shm_cache(req);
+
         /* Compute for each "current" vif interfaces. */
         rate_process(req, &prev_req[req->vifr_idx % VR_MAX_INTERFACES]);
 
@@ -1432,6 +1538,47 @@ rate_stats_diff(vr_interface_req *req, vr_interface_req *prev_req)
     COMPUTE_DIFFERENCE(req, prev_req, vifr_dev_oerrors, diff_ms);
  }
 
+static int
+rate_refresh(struct nl_client *cl, unsigned int vr_op)
+{
+    int ret;
+    unsigned int i;
+    vr_interface_req req;
+    struct vr_interface_stats stats;
+
+    if (!stats_shm || first_rate_iter || shm_stale || !shm_num_reqs ||
+            !(++shm_iterations % VIF_SHM_DUMP_INTERVAL)) {
+        rate_shm_flush();
+        shm_iterations = 0;
+        shm_stale = false;
+        shm_recording = (stats_shm != NULL);
+        ret = vr_intf_op(cl, vr_op);
+        shm_recording = false;
+        return ret;
+    }
+
+    list_header_print();
+    for (i = 0; i < shm_num_reqs; i++) {
+        req = shm_reqs[i];
+        memset(&stats, 0, sizeof(stats));
+        if (vr_stats_shm_read(stats_shm, VR_STATS_SHM_VIF, req.vifr_idx,
+                    (int)core, (uint64_t *)&stats,
+                    sizeof(stats) / sizeof(uint64_t))) {
+            /*
+             * the interface went away, or keeps its counters out of the
+             * region, dump them again next time
+             */
+            shm_stale = true;
+            continue;
+        }
+
+        rate_shm_fill(&req, &stats);
+        interface_req_process(&req);
+    }
+
+    return 0;
+}
+
 static void
 rate_stats(struct nl_client *cl, unsigned int vr_op)
 {
@@ -1444,6 +1591,13 @@ rate_stats(struct nl_client *cl, unsigned int vr_op)
     int local_print_number_interface = print_number_interface;
     first_rate_iter = true;
 
+    /*
+     * DPDK vRouter collects the port and the device counters of the
+     * interfaces only when they are dumped
+     */
+    if (list_set && (platform != DPDK_PLATFORM))
+        stats_shm = vr_stats_shm_map(cl);
+
     while (true) {
         while (!is_stdin_hit() || get_set) {
             ignore_number_interface = local_ignore_number_interface;
@@ -1468,7 +1622,7 @@ rate_stats(struct nl_client *cl, unsigned int vr_op)
             }
             printf("Interface rate statistics\n");
             printf("-------------------------\n\n");
-            if (vr_intf_op(cl, vr_op)) {
+            if (rate_refresh(cl, vr_op)) {
                 fprintf(stderr, "Communication problem with vRouter.\n\n");
                 exit(1);
             }
@@ -42,6 +42,7 @@
 #include "vr_route.h"
 #include "vr_bridge.h"
 #include "vr_mem.h"
+#include "vr_stats_shm.h"
 #include "ini_parser.h"
 
 /* Suppress NetLink error messages */
@@ -547,6 +548,14 @@ vr_send_set_ieee_ets(struct nl_client *cl, uint8_t *ifname,
 #endif
 }
 
+static void
+vr_print_drop_reason(unsigned int reason, uint64_t count)
+{
+    printf("%-30s%" PRIu64 "\n", vr_drop_reason_name(reason), count);
+
+    return;
+}
+
 void
 vr_print_drop_stats(vr_drop_stats_req *stats, int core)
 {
@@ -558,116 +567,78 @@ vr_print_drop_stats(vr_drop_stats_req *stats, int core)
    if (stats->vds_pcpu_stats_failure_status)
        printf("Failed to maintain PerCPU stats for this interface\n\n");
 
-    printf("Invalid IF                    %" PRIu64 "\n",
-            stats->vds_invalid_if);
-    printf("Trap No IF                    %" PRIu64 "\n",
-            stats->vds_trap_no_if);
-    printf("IF TX Discard                 %" PRIu64 "\n",
+    vr_print_drop_reason(VP_DROP_INVALID_IF, stats->vds_invalid_if);
+    vr_print_drop_reason(VP_DROP_TRAP_NO_IF, stats->vds_trap_no_if);
+    vr_print_drop_reason(VP_DROP_INTERFACE_TX_DISCARD,
             stats->vds_interface_tx_discard);
-    printf("IF Drop                       %" PRIu64 "\n",
-            stats->vds_interface_drop);
-    printf("IF RX Discard                 %" PRIu64 "\n",
+    vr_print_drop_reason(VP_DROP_INTERFACE_DROP, stats->vds_interface_drop);
+    vr_print_drop_reason(VP_DROP_INTERFACE_RX_DISCARD,
             stats->vds_interface_rx_discard);
     printf("\n");
 
-    printf("Flow Unusable                 %" PRIu64 "\n",
-            stats->vds_flow_unusable);
-    printf("Flow No Memory                %" PRIu64 "\n",
-            stats->vds_flow_no_memory);
-    printf("Flow Table Full               %" PRIu64 "\n",
-            stats->vds_flow_table_full);
-    printf("Flow NAT no rflow             %" PRIu64 "\n",
+    vr_print_drop_reason(VP_DROP_FLOW_UNUSABLE, stats->vds_flow_unusable);
+    vr_print_drop_reason(VP_DROP_FLOW_NO_MEMORY, stats->vds_flow_no_memory);
+    vr_print_drop_reason(VP_DROP_FLOW_TABLE_FULL, stats->vds_flow_table_full);
+    vr_print_drop_reason(VP_DROP_FLOW_NAT_NO_RFLOW,
             stats->vds_flow_nat_no_rflow);
-    printf("Flow Action Drop              %" PRIu64 "\n",
-            stats->vds_flow_action_drop);
-    printf("Flow Action Invalid           %" PRIu64 "\n",
+    vr_print_drop_reason(VP_DROP_FLOW_ACTION_DROP, stats->vds_flow_action_drop);
+    vr_print_drop_reason(VP_DROP_FLOW_ACTION_INVALID,
             stats->vds_flow_action_invalid);
-    printf("Flow Invalid Protocol         %" PRIu64 "\n",
+    vr_print_drop_reason(VP_DROP_FLOW_INVALID_PROTOCOL,
             stats->vds_flow_invalid_protocol);
-    printf("Flow Queue Limit Exceeded     %" PRIu64 "\n",
+    vr_print_drop_reason(VP_DROP_FLOW_QUEUE_LIMIT_EXCEEDED,
             stats->vds_flow_queue_limit_exceeded);
-    printf("New Flow Drops                %" PRIu64 "\n",
-            stats->vds_drop_new_flow);
-    printf("Flow Unusable (Eviction)      %" PRIu64 "\n",
-            stats->vds_flow_evict);
+    vr_print_drop_reason(VP_DROP_NEW_FLOWS, stats->vds_drop_new_flow);
+    vr_print_drop_reason(VP_DROP_FLOW_EVICT, stats->vds_flow_evict);
     printf("\n");
 
-    printf("Original Packet Trapped       %" PRIu64 "\n",
-            stats->vds_trap_original);
+    vr_print_drop_reason(VP_DROP_TRAP_ORIGINAL, stats->vds_trap_original);
     printf("\n");
 
-    printf("Discards                      %" PRIu64 "\n",
-            stats->vds_discard);
-    printf("TTL Exceeded                  %" PRIu64 "\n",
-            stats->vds_ttl_exceeded);
-    printf("Mcast Clone Fail              %" PRIu64 "\n",
-            stats->vds_mcast_clone_fail);
-    printf("Cloned Original               %" PRIu64 "\n",
-            stats->vds_cloned_original);
+    vr_print_drop_reason(VP_DROP_DISCARD, stats->vds_discard);
+    vr_print_drop_reason(VP_DROP_TTL_EXCEEDED, stats->vds_ttl_exceeded);
+    vr_print_drop_reason(VP_DROP_MCAST_CLONE_FAIL, stats->vds_mcast_clone_fail);
+    vr_print_drop_reason(VP_DROP_CLONED_ORIGINAL, stats->vds_cloned_original);
     printf("\n");
 
-    printf("Invalid NH                    %" PRIu64 "\n",
-            stats->vds_invalid_nh);
-    printf("Invalid Label                 %" PRIu64 "\n",
-            stats->vds_invalid_label);
-    printf("Invalid Protocol              %" PRIu64 "\n",
-            stats->vds_invalid_protocol);
-    printf("Etree Leaf to Leaf            %" PRIu64 "\n",
-            stats->vds_leaf_to_leaf);
-    printf("Bmac/ISID Mismatch            %" PRIu64 "\n",
+    vr_print_drop_reason(VP_DROP_INVALID_NH, stats->vds_invalid_nh);
+    vr_print_drop_reason(VP_DROP_INVALID_LABEL, stats->vds_invalid_label);
+    vr_print_drop_reason(VP_DROP_INVALID_PROTOCOL, stats->vds_invalid_protocol);
+    vr_print_drop_reason(VP_DROP_LEAF_TO_LEAF, stats->vds_leaf_to_leaf);
+    vr_print_drop_reason(VP_DROP_BMAC_ISID_MISMATCH,
             stats->vds_bmac_isid_mismatch);
-    printf("Rewrite Fail                  %" PRIu64 "\n",
-            stats->vds_rewrite_fail);
-    printf("Invalid Mcast Source          %" PRIu64 "\n",
+    vr_print_drop_reason(VP_DROP_REWRITE_FAIL, stats->vds_rewrite_fail);
+    vr_print_drop_reason(VP_DROP_INVALID_MCAST_SOURCE,
             stats->vds_invalid_mcast_source);
-    printf("Packet Loop                   %" PRIu64 "\n",
-            stats->vds_pkt_loop);
+    vr_print_drop_reason(VP_DROP_PKT_LOOP, stats->vds_pkt_loop);
     printf("\n");
 
-    printf("Push Fails                    %" PRIu64 "\n",
-            stats->vds_push);
-    printf("Pull Fails                    %" PRIu64 "\n",
-            stats->vds_pull);
-    printf("Duplicated                    %" PRIu64 "\n",
-            stats->vds_duplicated);
-    printf("Head Alloc Fails              %" PRIu64 "\n",
-            stats->vds_head_alloc_fail);
-    printf("PCOW fails                    %" PRIu64 "\n",
-            stats->vds_pcow_fail);
-    printf("Invalid Packets               %" PRIu64 "\n",
-            stats->vds_invalid_packet);
+    vr_print_drop_reason(VP_DROP_PUSH, stats->vds_push);
+    vr_print_drop_reason(VP_DROP_PULL, stats->vds_pull);
+    vr_print_drop_reason(VP_DROP_DUPLICATED, stats->vds_duplicated);
+    vr_print_drop_reason(VP_DROP_HEAD_ALLOC_FAIL, stats->vds_head_alloc_fail);
+    vr_print_drop_reason(VP_DROP_PCOW_FAIL, stats->vds_pcow_fail);
+    vr_print_drop_reason(VP_DROP_INVALID_PACKET, stats->vds_invalid_packet);
     printf("\n");
 
-    printf("Misc                          %" PRIu64 "\n",
-            stats->vds_misc);
-    printf("Nowhere to go                 %" PRIu64 "\n",
-            stats->vds_nowhere_to_go);
-    printf("Checksum errors               %" PRIu64 "\n",
-            stats->vds_cksum_err);
-    printf("No Fmd                        %" PRIu64 "\n",
-            stats->vds_no_fmd);
-    printf("Invalid VNID                  %" PRIu64 "\n",
-            stats->vds_invalid_vnid);
-    printf("Fragment errors               %" PRIu64 "\n",
-            stats->vds_frag_err);
-    printf("Invalid Source                %" PRIu64 "\n",
-            stats->vds_invalid_source);
-    printf("Jumbo Mcast Pkt with DF Bit   %" PRIu64 "\n",
-            stats->vds_mcast_df_bit);
-    printf("No L2 Route                   %" PRIu64 "\n",
-            stats->vds_l2_no_route);
-
-    printf("Memory Failures               %" PRIu64 "\n",
-            stats->vds_no_memory);
-    printf("Fragment Queueing Failures    %" PRIu64 "\n",
+    vr_print_drop_reason(VP_DROP_MISC, stats->vds_misc);
+    vr_print_drop_reason(VP_DROP_NOWHERE_TO_GO, stats->vds_nowhere_to_go);
+    vr_print_drop_reason(VP_DROP_CKSUM_ERR, stats->vds_cksum_err);
+    vr_print_drop_reason(VP_DROP_NO_FMD, stats->vds_no_fmd);
+    vr_print_drop_reason(VP_DROP_INVALID_VNID, stats->vds_invalid_vnid);
+    vr_print_drop_reason(VP_DROP_FRAGMENTS, stats->vds_frag_err);
+    vr_print_drop_reason(VP_DROP_INVALID_SOURCE, stats->vds_invalid_source);
+    vr_print_drop_reason(VP_DROP_MCAST_DF_BIT, stats->vds_mcast_df_bit);
+    vr_print_drop_reason(VP_DROP_L2_NO_ROUTE, stats->vds_l2_no_route);
+
+    vr_print_drop_reason(VP_DROP_NO_MEMORY, stats->vds_no_memory);
+    vr_print_drop_reason(VP_DROP_FRAGMENT_QUEUE_FAIL,
             stats->vds_fragment_queue_fail);
 
     printf("\n");
     if (platform == DPDK_PLATFORM) {
-        printf("VLAN fwd intf failed TX       %" PRIu64 "\n",
-                stats->vds_vlan_fwd_tx);
-        printf("VLAN fwd intf failed enq      %" PRIu64 "\n",
-                stats->vds_vlan_fwd_enq);
+        vr_print_drop_reason(VP_DROP_VLAN_FWD_TX, stats->vds_vlan_fwd_tx);
+        vr_print_drop_reason(VP_DROP_VLAN_FWD_ENQ, stats->vds_vlan_fwd_enq);
     }
     return;
 }
@@ -1033,6 +1004,317 @@ vr_send_mem_stats_get(struct nl_client *cl, unsigned int router_id)
     return vr_sendmsg(cl, &req, "vr_mem_stats_req");
 }
 
+/* lcore stats */
+int
+vr_send_lcore_stats_get(struct nl_client *cl, unsigned int router_id,
+        int core)
+{
+    vr_lcore_stats_req req;
+
+    memset(&req, 0, sizeof(req));
+    req.h_op = SANDESH_OP_GET;
+    req.vlsr_rid = router_id;
+    req.vlsr_core = core;
+
+    return vr_sendmsg(cl, &req, "vr_lcore_stats_req");
+}
+
+int
+vr_send_lcore_stats_dump(struct nl_client *cl, unsigned int router_id,
+        int marker)
+{
+    vr_lcore_stats_req req;
+
+    memset(&req, 0, sizeof(req));
+    req.h_op = SANDESH_OP_DUMP;
+    req.vlsr_rid = router_id;
+    req.vlsr_marker = marker;
+
+    return vr_sendmsg(cl, &req, "vr_lcore_stats_req");
+}
+
+/* flow dirty bitmap */
+int
+vr_send_flow_dirty_dump(struct nl_client *cl, unsigned int router_id,
+        int marker, unsigned short flags)
+{
+    vr_flow_dirty_req req;
+
+    memset(&req, 0, sizeof(req));
+    req.h_op = SANDESH_OP_DUMP;
+    req.fdr_rid = router_id;
+    req.fdr_marker = marker;
+    req.fdr_flags = flags;
+
+    return vr_sendmsg(cl, &req, "vr_flow_dirty_req");
+}
+
+/* flow policy cache */
+int
+vr_send_flow_policy_dump(struct nl_client *cl, unsigned int router_id,
+        int marker)
+{
+    vr_flow_policy_req req;
+
+    memset(&req, 0, sizeof(req));
+    req.h_op = SANDESH_OP_DUMP;
+    req.fpr_rid = router_id;
+    req.fpr_marker = marker;
+
+    return vr_sendmsg(cl, &req, "vr_flow_policy_req");
+}
+
+/* datapath latency histograms */
+int
+vr_send_dp_latency_set(struct nl_client *cl, unsigned int router_id,
+        unsigned int sample_rate)
+{
+    vr_dp_latency_req req;
+
+    memset(&req, 0, sizeof(req));
+    req.h_op = SANDESH_OP_ADD;
+    req.vdl_rid = router_id;
+    req.vdl_sample_rate = sample_rate;
+
+    return vr_sendmsg(cl, &req, "vr_dp_latency_req");
+}
+
+int
+vr_send_dp_latency_reset(struct nl_client *cl, unsigned int router_id)
+{
+    vr_dp_latency_req req;
+
+    memset(&req, 0, sizeof(req));
+    req.h_op = SANDESH_OP_RESET;
+    req.vdl_rid = router_id;
+
+    return vr_sendmsg(cl, &req, "vr_dp_latency_req");
+}
+
+int
+vr_send_dp_latency_get(struct nl_client *cl, unsigned int router_id,
+        int core)
+{
+    vr_dp_latency_req req;
+
+    memset(&req, 0, sizeof(req));
+    req.h_op = SANDESH_OP_GET;
+    req.vdl_rid = router_id;
+    req.vdl_core = core;
+
+    return vr_sendmsg(cl, &req, "vr_dp_latency_req");
+}
+
+int
+vr_send_dp_latency_dump(struct nl_client *cl, unsigned int router_id,
+        int marker)
+{
+    vr_dp_latency_req req;
+
+    memset(&req, 0, sizeof(req));
+    req.h_op = SANDESH_OP_DUMP;
+    req.vdl_rid = router_id;
+    req.vdl_marker = marker;
+
+    return vr_sendmsg(cl, &req, "vr_dp_latency_req");
+}
+
+/* packet trace */
+int
+vr_send_pkt_trace_arm(struct nl_client *cl, unsigned int router_id,
+        int count, int vif, uint8_t family, uint8_t proto, uint16_t sport,
+        uint16_t dport, uint8_t *sip, uint8_t *dip)
+{
+    unsigned int alen;
+    vr_pkt_trace_req req;
+
+    memset(&req, 0, sizeof(req));
+    req.h_op = SANDESH_OP_ADD;
+    req.ptr_rid = router_id;
+    req.ptr_count = count;
+    req.ptr_vif = vif;
+    req.ptr_family = family;
+    req.ptr_proto = proto;
+    req.ptr_sport = sport;
+    req.ptr_dport = dport;
+
+    alen = (family == AF_INET6) ? VR_IP6_ADDRESS_LEN : VR_IP_ADDRESS_LEN;
+    if (family && sip) {
+        req.ptr_sip = (int8_t *)sip;
+        req.ptr_sip_size = alen;
+    }
+
+    if (family && dip) {
+        req.ptr_dip = (int8_t *)dip;
+        req.ptr_dip_size = alen;
+    }
+
+    return vr_sendmsg(cl, &req, "vr_pkt_trace_req");
+}
+
+int
+vr_send_pkt_trace_disarm(struct nl_client *cl, unsigned int router_id)
+{
+    vr_pkt_trace_req req;
+
+    memset(&req, 0, sizeof(req));
+    req.h_op = SANDESH_OP_DEL;
+    req.ptr_rid = router_id;
+
+    return vr_sendmsg(cl, &req, "vr_pkt_trace_req");
+}
+
+int
+vr_send_pkt_trace_reset(struct nl_client *cl, unsigned int router_id)
+{
+    vr_pkt_trace_req req;
+
+    memset(&req, 0, sizeof(req));
+    req.h_op = SANDESH_OP_RESET;
+    req.ptr_rid = router_id;
+
+    return vr_sendmsg(cl, &req, "vr_pkt_trace_req");
+}
+
+int
+vr_send_pkt_trace_get(struct nl_client *cl, unsigned int router_id)
+{
+    vr_pkt_trace_req req;
+
+    memset(&req, 0, sizeof(req));
+    req.h_op = SANDESH_OP_GET;
+    req.ptr_rid = router_id;
+
+    return vr_sendmsg(cl, &req, "vr_pkt_trace_req");
+}
+
+int
+vr_send_pkt_trace_dump(struct nl_client *cl, unsigned int router_id,
+        int marker)
+{
+    vr_pkt_trace_req req;
+
+    memset(&req, 0, sizeof(req));
+    req.h_op = SANDESH_OP_DUMP;
+    req.ptr_rid = router_id;
+    req.ptr_marker = marker;
+
+    return vr_sendmsg(cl, &req, "vr_pkt_trace_req");
+}
+
+/* drop capture */
+int
+vr_send_drop_capture_set(struct nl_client *cl, unsigned int router_id,
+        unsigned int rate, int reason)
+{
+    vr_drop_capture_req req;
+
+    memset(&req, 0, sizeof(req));
+    req.h_op = SANDESH_OP_ADD;
+    req.vdc_rid = router_id;
+    req.vdc_rate = rate;
+    req.vdc_reason = reason;
+
+    return vr_sendmsg(cl, &req, "vr_drop_capture_req");
+}
+
+int
+vr_send_drop_capture_reset(struct nl_client *cl, unsigned int router_id)
+{
+    vr_drop_capture_req req;
+
+    memset(&req, 0, sizeof(req));
+    req.h_op = SANDESH_OP_RESET;
+    req.vdc_rid = router_id;
+
+    return vr_sendmsg(cl, &req, "vr_drop_capture_req");
+}
+
+int
+vr_send_drop_capture_get(struct nl_client *cl, unsigned int router_id)
+{
+    vr_drop_capture_req req;
+
+    memset(&req, 0, sizeof(req));
+    req.h_op = SANDESH_OP_GET;
+    req.vdc_rid = router_id;
+
+    return vr_sendmsg(cl, &req, "vr_drop_capture_req");
+}
+
+int
+vr_send_drop_capture_dump(struct nl_client *cl, unsigned int router_id,
+        int marker)
+{
+    vr_drop_capture_req req;
+
+    memset(&req, 0, sizeof(req));
+    req.h_op = SANDESH_OP_DUMP;
+    req.vdc_rid = router_id;
+    req.vdc_marker = marker;
+
+    return vr_sendmsg(cl, &req, "vr_drop_capture_req");
+}
+
+/* statistics region */
+static int stats_shm_dev = -1;
+static unsigned int stats_shm_size;
+static char stats_shm_path[VR_UNIX_PATH_MAX];
+
+static void
+stats_shm_vrouter_ops_process(void *s_req)
+{
+    vrouter_ops *req = (vrouter_ops *)s_req;
+
+    stats_shm_dev = req->vo_stats_dev;
+    stats_shm_size = req->vo_stats_size;
+    if (req->vo_stats_file_path)
+        strncpy(stats_shm_path, req->vo_stats_file_path,
+                sizeof(stats_shm_path) - 1);
+
+    return;
+}
+
+/*
+ * Map the region of the interface, vrf and drop counters read only.
+ * Returns NULL if vRouter has no such region, in which case the counters
+ * are to be requested over netlink.
+ */
+void *
+vr_stats_shm_map(struct nl_client *cl)
+{
+    int ret;
+    void *shm = NULL;
+    void (*saved_cb)(void *) = nl_cb.vrouter_ops_process;
+    struct vr_stats_shm_hdr *hdr;
+
+    nl_cb.vrouter_ops_process = stats_shm_vrouter_ops_process;
+    ret = vr_send_vrouter_get(cl, 0);
+    if (ret >= 0)
+        ret = vr_recvmsg(cl, false);
+    nl_cb.vrouter_ops_process = saved_cb;
+
+    if ((ret <= 0) || (stats_shm_size < VR_STATS_SHM_HDR_SIZE))
+        return NULL;
+
+    if (!vr_table_map(stats_shm_dev, VR_MEM_STATS_OBJECT, stats_shm_path,
+                stats_shm_size, &shm))
+        return NULL;
+
+    hdr = (struct vr_stats_shm_hdr *)shm;
+    if ((hdr->sh_magic != VR_STATS_SHM_MAGIC) ||
+            (hdr->sh_version != VR_STATS_SHM_VERSION) ||
+            (hdr->sh_sections < VR_STATS_SHM_SECTIONS) ||
+            (hdr->sh_size > stats_shm_size)) {
+#ifndef _WIN32
+        munmap(shm, stats_shm_size);
+#endif
+        return NULL;
+    }
+
+    return shm;
+}
+
 /* mirror start */
 void
 vr_mirror_req_destroy(vr_mirror_req *req)
@@ -1898,7 +2180,8 @@ vr_send_vrouter_set_runtime_opts(struct nl_client *cl, unsigned int router_id,
         int perfr1, int perfr2, int perfr3, int perfp, int perfq1,
         int perfq2, int perfq3, int udp_coff, int flow_hold_limit,
         int mudp, int btokens, int binterval, int bstep,
-        unsigned int priority_tagging)
+        unsigned int priority_tagging, int hold_queue_depth,
+        int hold_queue_budget)
 {
     vrouter_ops req;
 
@@ -1930,6 +2213,8 @@ vr_send_vrouter_set_runtime_opts(struct nl_client *cl, unsigned int router_id,
     req.vo_burst_interval = binterval;
     req.vo_burst_step = bstep;
     req.vo_priority_tagging = priority_tagging;
+    req.vo_flow_hold_queue_depth = hold_queue_depth;
+    req.vo_flow_hold_queue_budget = hold_queue_budget;
 
     /*
      * We create request to change runtime (sysctl) options only. Log level
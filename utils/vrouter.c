@@ -56,6 +56,8 @@ enum opt_vrouter_index {
     SET_BURST_INTERVAL_INDEX,
     SET_BURST_STEP_INDEX,
     SET_PRIORITY_TAGGING_INDEX,
+    SET_FLOW_HOLD_QUEUE_DEPTH_INDEX,
+    SET_FLOW_HOLD_QUEUE_BUDGET_INDEX,
     MAX_OPT_INDEX
 };
 
@@ -124,6 +126,7 @@ static int perfr1 = -1, perfr2 = -1, perfr3 = -1, perfp = -1, perfq1 = -1;
 static int perfq2 = -1, perfq3 = -1, udp_coff = -1, flow_hold_limit = -1;
 static int mudp = -1, burst_tokens = -1, burst_interval = -1, burst_step = -1;
 static unsigned int priority_tagging = 0;
+static int flow_hold_queue_depth = -1, flow_hold_queue_budget = -1;
 
 static int platform, vrouter_op = -1;
 
@@ -328,6 +331,8 @@ print_vrouter_parameters(vrouter_ops *req)
         "    Burst Interval                       %u\n"
         "    Burst Step                           %u\n"
         "    NIC Priority Tagging                 %u\n"
+        "    Flow hold queue depth                %d\n"
+        "    Flow hold queue budget               %d\n"
         "\n",
 
         req->vo_perfr, req->vo_perfs,
@@ -338,7 +343,8 @@ print_vrouter_parameters(vrouter_ops *req)
         req->vo_flow_used_entries, req->vo_flow_used_oentries,
         req->vo_bridge_used_entries, req->vo_bridge_used_oentries,
         req->vo_burst_tokens, req->vo_burst_interval, req->vo_burst_step,
-        req->vo_priority_tagging
+        req->vo_priority_tagging, req->vo_flow_hold_queue_depth,
+        req->vo_flow_hold_queue_budget
     );
 
     return;
@@ -440,7 +446,8 @@ vr_vrouter_op(struct nl_client *cl)
                     perfr1, perfr2, perfr3, perfp, perfq1,
                     perfq2, perfq3, udp_coff, flow_hold_limit,
                     mudp, burst_tokens, burst_interval, burst_step,
-                    priority_tagging);
+                    priority_tagging, flow_hold_queue_depth,
+                    flow_hold_queue_budget);
         }
         break;
 
@@ -531,6 +538,14 @@ static struct option long_options[] = {
     [SET_PRIORITY_TAGGING_INDEX] = {
         "set-priority-tagging", required_argument, &opt[SET_PRIORITY_TAGGING_INDEX], 1
     },
+    [SET_FLOW_HOLD_QUEUE_DEPTH_INDEX] = {
+        "flow_hold_queue_depth", required_argument,
+        &opt[SET_FLOW_HOLD_QUEUE_DEPTH_INDEX], 1
+    },
+    [SET_FLOW_HOLD_QUEUE_BUDGET_INDEX] = {
+        "flow_hold_queue_budget", required_argument,
+        &opt[SET_FLOW_HOLD_QUEUE_BUDGET_INDEX], 1
+    },
     [MAX_OPT_INDEX] = {NULL, 0, 0, 0}
 };
 
@@ -545,7 +560,7 @@ Usage(void)
                "vrouter ([--set-log-level <level>] [--enable-log-type <type>]...\n"
                "         [--disable-log-type <type>]...)\n"
                "vrouter ([--set-mudp <0|1>] [--from_vm_mss_adj <0|1>]...\n"
-               "         [--flow_hold_limit <0|1>]...)\n"
+               "         [--flow_hold_limit <0|1>] [--flow_hold_queue_depth <int>]...)\n"
                "vrouter ([--burst_tokens <int>>] [--burst_interval<int>]...\n"
                "         [--burst_step<int>]...)\n\n"
                "Options:\n"
@@ -557,6 +572,8 @@ Usage(void)
                "--disable-log-type <type> Disable given log type\n"
                "--from_vm_mss_adj <0|1> Turn on|off TCP MSS on packets from VM\n"
                "--flow_hold_limit <0|1> Turn on|off flow hold limit\n"
+               "--flow_hold_queue_depth <int> packets queued per flow in hold (3-256)\n"
+               "--flow_hold_queue_budget <int> queued packets beyond 3 per flow, all flows together\n"
                "--mudp <0|1> Turn on|off MPLS over UDP globally\n"
                "--burst_tokens <int> total burst tokens \n"
                "--burst_interval <int> timer interval of burst tokens in ms\n"
@@ -583,7 +600,7 @@ Usage(void)
         printf("Usage:\n"
                "vrouter --info | --help\n"
                "vrouter ([--set-mudp <0|1>] [--from_vm_mss_adj <0|1>]...\n"
-               "         [--flow_hold_limit <0|1>]...)\n"
+               "         [--flow_hold_limit <0|1>] [--flow_hold_queue_depth <int>]...)\n"
                "vrouter ([--burst_tokens <int>>] [--burst_interval<int>]...\n"
                "         [--burst_step<int>]...)\n\n"
                "--info Dumps information about vrouter\n"
@@ -600,6 +617,8 @@ Usage(void)
                "--perfq3 <cpu> CPU to send pkts to if perfr3 set\n"
                "--udp_coff <0|1> NIC cksum offload for outer UDP hdr\n"
                "--flow_hold_limit <0|1> Turn on|off flow hold limit\n"
+               "--flow_hold_queue_depth <int> packets queued per flow in hold (3-256)\n"
+               "--flow_hold_queue_budget <int> queued packets beyond 3 per flow, all flows together\n"
                "--mudp <0|1> Turn on|off MPLS over UDP globally\n"
                "--burst_tokens <int> total burst tokens \n"
                "--burst_interval <int> timer interval of burst tokens in ms\n"
@@ -887,6 +906,26 @@ parse_long_opts(int opt_index, char *opt_arg)
         }
         break;
 
+    case SET_FLOW_HOLD_QUEUE_DEPTH_INDEX:
+        vrouter_op = SANDESH_OP_ADD;
+        flow_hold_queue_depth = (int)strtol(opt_arg, NULL, 0);
+        if (errno != 0) {
+            printf("vrouter: Error parsing flow_hold_queue_depth: %s: %s (%d)\n",
+                    opt_arg, strerror(errno), errno);
+            Usage();
+        }
+        break;
+
+    case SET_FLOW_HOLD_QUEUE_BUDGET_INDEX:
+        vrouter_op = SANDESH_OP_ADD;
+        flow_hold_queue_budget = (int)strtol(opt_arg, NULL, 0);
+        if (errno != 0) {
+            printf("vrouter: Error parsing flow_hold_queue_budget: %s: %s (%d)\n",
+                    opt_arg, strerror(errno), errno);
+            Usage();
+        }
+        break;
+
     case SET_PRIORITY_TAGGING_INDEX:
         vrouter_op = SANDESH_OP_ADD;
         priority_tagging = strtoul(opt_arg, NULL, 0);
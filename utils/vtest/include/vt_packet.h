@@ -13,6 +13,16 @@
 
 #define READ_TRY_MAX 1U << 31
 
+/* Defaults and limits of the performance test. */
+#define VT_PERF_DEF_PACKETS             100000
+#define VT_PERF_DEF_BURST               32
+#define VT_PERF_DEF_LATENCY_SAMPLES     100
+#define VT_PERF_MAX_BURST               256
+#define VT_PERF_MAX_FRAMES              4096
+/* Test ends after a second without any packet sent or received. */
+#define VT_PERF_IDLE_TIMEOUT_NS         1000000000ULL
+#define VT_PERF_LATENCY_TIMEOUT_NS      100000000ULL
+
 typedef enum {
     S_START = 0,
     S_LOAD_PACKET,
@@ -67,6 +77,7 @@ typedef int (*tx_rx_automata_handler)(struct tx_rx_handler *);
 
 
 int run_pcap_test(struct vtest *);
+int run_performance_test(struct vtest *);
 int tx_rx_pcap_test(struct vtest *test);
 
 
@@ -37,6 +37,24 @@ struct packet {
     size_t rx_client_num;
 };
 
+struct performance {
+    char pcap_file[PATH_MAX];
+    unsigned short tx_vif_id;
+    unsigned short rx_vif_id;
+    /* Packets to send, the pcap file is replayed in a loop. */
+    uint64_t packets;
+    unsigned int burst;
+    unsigned int queue_pairs;
+    bool mrg_rxbuf;
+    size_t rx_buf_len;
+    size_t tx_seg_len;
+    /* Packets sent one by one to measure the latency. */
+    unsigned int latency_samples;
+    /* Pass criteria, ignored if zero. */
+    uint64_t min_pps;
+    double max_loss;
+};
+
 struct received_mem_handle {
     void *mem;
     void (*free_mem)(void *);
@@ -89,6 +107,7 @@ struct vtest {
     struct packet_interface packet_tx;
     struct packet_interface packet_rx[VT_PACKET_MAX_TX_CLIENT];
     struct packet packet;
+    struct performance performance;
     /* vRouter socket -> for message sending */
     struct nl_client *vrouter_cl;
     char *file_name;
@@ -104,6 +123,7 @@ extern const size_t VTEST_NUM_MODULES;
 
 extern int vt_message(xmlNodePtr, struct vtest *);
 extern int vt_packet(xmlNodePtr, struct vtest *);
+extern int vt_performance(xmlNodePtr, struct vtest *);
 extern int vt_test_name(xmlNodePtr, struct vtest *);
 
 #endif /* __VTEST_H__ */
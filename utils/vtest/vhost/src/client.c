@@ -187,6 +187,9 @@ client_vhost_ioctl(Client *client, VhostUserRequest request, void *req_ptr) {
     /* Function argument pointer (req_ptr) for following messages
      * SHOULD not be NULL. */
     switch (request) {
+        case VHOST_USER_SET_FEATURES:
+        case VHOST_USER_SET_PROTOCOL_FEATURES:
+        case VHOST_USER_SET_VRING_ENABLE:
         case VHOST_USER_SET_MEM_TABLE:
         case VHOST_USER_SET_LOG_BASE:
         case VHOST_USER_SET_LOG_FD:
@@ -263,6 +266,7 @@ client_vhost_ioctl_set_send_msg(Client *client, VhostUserRequest request, void *
             break;
 
         case VHOST_USER_SET_FEATURES:
+        case VHOST_USER_SET_PROTOCOL_FEATURES:
         case VHOST_USER_SET_LOG_BASE:
             message->u64 = *((uint64_t *) req_ptr);
             message->size = sizeof(sizeof_VhostUserMsg.u64);
@@ -292,6 +296,7 @@ client_vhost_ioctl_set_send_msg(Client *client, VhostUserRequest request, void *
 
         case VHOST_USER_SET_VRING_NUM:
         case VHOST_USER_SET_VRING_BASE:
+        case VHOST_USER_SET_VRING_ENABLE:
             memcpy(&message->state, req_ptr, sizeof(sizeof_VhostUserMsg.state));
             message->size = sizeof(sizeof_VhostUserMsg.state);
             break;
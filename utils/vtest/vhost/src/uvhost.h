@@ -17,12 +17,19 @@
 #define VHOST_USER_HDR_SIZE (sizeof(struct virtio_net_hdr))
 #define VHOST_MEMORY_MAX_NREGIONS    8
 
+/* Every queue pair takes one memory region per vring. */
+#define VHOST_CLIENT_MAX_QUEUE_PAIRS (VHOST_MEMORY_MAX_NREGIONS / 2)
+
 typedef enum {
     VHOST_CLIENT_VRING_IDX_RX = 0,
     VHOST_CLIENT_VRING_IDX_TX = 1,
-    VHOST_CLIENT_VRING_MAX_VRINGS
+    VHOST_CLIENT_VRING_MAX_VRINGS = 2 * VHOST_CLIENT_MAX_QUEUE_PAIRS
 }VHOST_CLIENT_VRING;
 
+/* Vring indexes of the queue pair qp. */
+#define VHOST_CLIENT_VRING_RX(qp) (2 * (qp) + VHOST_CLIENT_VRING_IDX_RX)
+#define VHOST_CLIENT_VRING_TX(qp) (2 * (qp) + VHOST_CLIENT_VRING_IDX_TX)
+
 
 typedef enum VhostUserRequest {
     VHOST_USER_NONE = 0,
@@ -40,6 +47,10 @@ typedef enum VhostUserRequest {
     VHOST_USER_SET_VRING_KICK = 12,
     VHOST_USER_SET_VRING_CALL = 13,
     VHOST_USER_SET_VRING_ERR = 14,
+    VHOST_USER_GET_PROTOCOL_FEATURES = 15,
+    VHOST_USER_SET_PROTOCOL_FEATURES = 16,
+    VHOST_USER_GET_QUEUE_NUM = 17,
+    VHOST_USER_SET_VRING_ENABLE = 18,
     VHOST_USER_MAX
 } VhostUserRequest;
 
@@ -79,6 +90,16 @@ typedef struct VhostUserMsg {
  */
 #define VHOST_USER_HSIZE (offsetof(VhostUserMsg, u64))
 
+/* Feature bits negotiated with VHOST_USER_SET_(PROTOCOL_)FEATURES. */
+#ifndef VIRTIO_NET_F_MRG_RXBUF
+#define VIRTIO_NET_F_MRG_RXBUF          15
+#endif
+#ifndef VIRTIO_NET_F_MQ
+#define VIRTIO_NET_F_MQ                 22
+#endif
+#define VHOST_USER_F_PROTOCOL_FEATURES  30
+#define VHOST_USER_PROTOCOL_F_MQ        0
+
 
 #endif
 
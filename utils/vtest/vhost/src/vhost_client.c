@@ -23,9 +23,11 @@
 #include "virtio_hdr.h"
 
 static int vhost_client_delete_Vhost_Client(Vhost_Client *vhost_client);
-static int vhost_client_init_Vhost_Client(Vhost_Client *vhost_client);
-static int vhost_client_run_vhost_client(Vhost_Client **vhost_cl, const char *);
-static Vhost_Client* vhost_client_create_vhost_client(void);
+static int vhost_client_init_Vhost_Client(Vhost_Client *vhost_client,
+        const struct vhost_net_opts *opts);
+static int vhost_client_run_vhost_client(Vhost_Client **vhost_cl, const char *,
+        const struct vhost_net_opts *opts);
+static Vhost_Client* vhost_client_create_vhost_client(const struct vhost_net_opts *opts);
 static int vhost_client_init_control_communication(Vhost_Client *vhost_client);
 static int vhost_client_set_mem_Vhost_Client(Vhost_Client *vhost_client);
 static int vhost_client_vhost_init_control_msgs(Vhost_Client *vhost_client);
@@ -73,19 +75,33 @@ vhost_client_dealloc_Vhost_Client(Vhost_Client *vhost_client) {
 }
 
 static int
-vhost_client_init_Vhost_Client(Vhost_Client *vhost_client) {
+vhost_client_init_Vhost_Client(Vhost_Client *vhost_client,
+        const struct vhost_net_opts *opts) {
 
     Vhost_Client *const vhost_cl = vhost_client;
 
-    if (!vhost_client) {
+    if (!vhost_client || !opts) {
         fprintf(stderr, "%s(): Error initializing vhost client: no vhost client\n",
             __func__);
         return E_VHOST_CLIENT_ERR_FARG;
     }
 
-    vhost_cl->mem.nregions = VHOST_CLIENT_VRING_MAX_VRINGS;
-    vhost_cl->virtq_num = VHOST_CLIENT_VRING_MAX_VRINGS;
+    if (opts->queue_pairs > VHOST_CLIENT_MAX_QUEUE_PAIRS) {
+        fprintf(stderr, "%s(): Error initializing vhost client: %u queue pairs,"
+            " at most %d supported\n", __func__, opts->queue_pairs,
+            VHOST_CLIENT_MAX_QUEUE_PAIRS);
+        return E_VHOST_CLIENT_ERR_FARG;
+    }
+
+    vhost_cl->queue_pairs = opts->queue_pairs ? opts->queue_pairs : 1;
+    vhost_cl->mem.nregions = 2 * vhost_cl->queue_pairs;
+    vhost_cl->virtq_num = 2 * vhost_cl->queue_pairs;
     vhost_cl->page_size = VHOST_CLIENT_PAGE_SIZE;
+    vhost_cl->mrg_rxbuf = opts->mrg_rxbuf;
+    vhost_cl->hdr_len = opts->mrg_rxbuf ?
+        sizeof(struct virtio_net_hdr_mrg_rxbuf) : sizeof(struct virtio_net_hdr);
+    vhost_cl->rx_buf_len = opts->rx_buf_len;
+    vhost_cl->tx_seg_len = opts->tx_seg_len;
 
     return E_VHOST_CLIENT_OK;
 }
@@ -131,7 +147,7 @@ vhost_client_set_mem_Vhost_Client(Vhost_Client *vhost_client) {
     }
 
     ret_val = virt_queue_map_all_mem_reqion_virtq(vhost_cl->sh_mem_virtq_table,
-           &vhost_client->mem, VHOST_CLIENT_VRING_MAX_VRINGS);
+           &vhost_client->mem, vhost_cl->virtq_num);
     if (ret_val != E_VIRT_QUEUE_OK) {
         return ret_val;
     }
@@ -139,7 +155,7 @@ vhost_client_set_mem_Vhost_Client(Vhost_Client *vhost_client) {
 }
 
 static Vhost_Client*
-vhost_client_create_vhost_client(void) {
+vhost_client_create_vhost_client(const struct vhost_net_opts *opts) {
 
     Vhost_Client *vhost_client = NULL;
     VHOST_CLIENT_H_RET_VAL vhost_client_ret_val = E_VHOST_CLIENT_OK;
@@ -149,8 +165,9 @@ vhost_client_create_vhost_client(void) {
         return NULL;
     }
 
-    vhost_client_ret_val = vhost_client_init_Vhost_Client(vhost_client);
+    vhost_client_ret_val = vhost_client_init_Vhost_Client(vhost_client, opts);
     if (vhost_client_ret_val != E_VHOST_CLIENT_OK) {
+        vhost_client_dealloc_Vhost_Client(vhost_client);
         return NULL;
     }
 
@@ -202,8 +219,26 @@ vhost_client_delete_Vhost_Client(Vhost_Client *vhost_client) {
     return vhost_client_ret_val;
 }
 
+/*
+ * Keep VHOST_CLIENT_RX_RING_FILL buffers posted to the receive queue.
+ */
+static void
+vhost_client_refill_rx(Vhost_Client *vhost_client, VHOST_CLIENT_VRING vq_id) {
+
+    struct virtq_control *vq_ctrl = vhost_client->virtq_control[vq_id];
+    size_t posted = vq_ctrl->virtq.num - vq_ctrl->num_free;
+
+    if (posted < VHOST_CLIENT_RX_RING_FILL) {
+        virt_queue_put_rx_burst_virt_queue(vhost_client->virtq_control, vq_id,
+                VHOST_CLIENT_RX_RING_FILL - posted, vhost_client->rx_buf_len);
+    }
+
+    return;
+}
+
 static int
-vhost_client_run_vhost_client(Vhost_Client **vhost_cl, const char *vhost_client_path ) {
+vhost_client_run_vhost_client(Vhost_Client **vhost_cl, const char *vhost_client_path,
+        const struct vhost_net_opts *opts) {
 
     Vhost_Client *l_vhost_client = NULL;
     VHOST_CLIENT_H_RET_VAL vhost_client_ret_val = E_VHOST_CLIENT_OK;
@@ -216,7 +251,7 @@ vhost_client_run_vhost_client(Vhost_Client **vhost_cl, const char *vhost_client_
         return E_VHOST_CLIENT_ERR_FARG;
     }
 
-    l_vhost_client = vhost_client_create_vhost_client();
+    l_vhost_client = vhost_client_create_vhost_client(opts);
     *vhost_cl = l_vhost_client;
     if (!l_vhost_client) {
         return E_VHOST_CLIENT_ERR;
@@ -250,8 +285,14 @@ vhost_client_run_vhost_client(Vhost_Client **vhost_cl, const char *vhost_client_
 
     l_vhost_client->vhost_net_app_handler.rx_func_handler = vhost_client_poll_client_rx;
     l_vhost_client->vhost_net_app_handler.tx_func_handler = vhost_client_poll_client_tx;
-//TODO: Burst
-    virt_queue_put_rx_virt_queue(l_vhost_client->virtq_control, VHOST_CLIENT_VRING_IDX_RX , ETH_MAX_MTU);
+    l_vhost_client->vhost_net_app_handler.rx_burst_func_handler =
+        vhost_client_poll_client_rx_burst;
+    l_vhost_client->vhost_net_app_handler.tx_burst_func_handler =
+        vhost_client_poll_client_tx_burst;
+
+    for (size_t qp = 0; qp < l_vhost_client->queue_pairs; qp++) {
+        vhost_client_refill_rx(l_vhost_client, VHOST_CLIENT_VRING_RX(qp));
+    }
 
     return E_VHOST_CLIENT_OK;
 }
@@ -281,6 +322,8 @@ vhost_client_vhost_init_control_msgs(Vhost_Client *vhost_client) {
     Vhost_Client *const l_vhost_client = vhost_client;
     CLIENT_H_RET_VAL client_ret_val = E_CLIENT_OK;
     VIRT_QUEUE_H_RET_VAL virt_queue_ret_val = E_VIRT_QUEUE_OK;
+    struct vhost_vring_state vring_state;
+    uint64_t features = 0;
 
     if (!vhost_client) {
         return E_VHOST_CLIENT_ERR_FARG;
@@ -303,6 +346,36 @@ vhost_client_vhost_init_control_msgs(Vhost_Client *vhost_client) {
         return E_VHOST_CLIENT_ERR;
     }
 
+    /*
+     * Features are only set when asked for, so that the default client
+     * talks to vRouter the way it always did.
+     */
+    if (l_vhost_client->mrg_rxbuf || l_vhost_client->queue_pairs > 1) {
+        features = 0;
+        if (l_vhost_client->mrg_rxbuf) {
+            features |= (1ULL << VIRTIO_NET_F_MRG_RXBUF);
+        }
+        if (l_vhost_client->queue_pairs > 1) {
+            features |= (1ULL << VIRTIO_NET_F_MQ) |
+                (1ULL << VHOST_USER_F_PROTOCOL_FEATURES);
+        }
+
+        client_ret_val = client_vhost_ioctl(l_client, VHOST_USER_SET_FEATURES,
+                &features);
+        if (client_ret_val != E_CLIENT_OK) {
+            return E_VHOST_CLIENT_ERR;
+        }
+    }
+
+    if (l_vhost_client->queue_pairs > 1) {
+        features = (1ULL << VHOST_USER_PROTOCOL_F_MQ);
+        client_ret_val = client_vhost_ioctl(l_client,
+                VHOST_USER_SET_PROTOCOL_FEATURES, &features);
+        if (client_ret_val != E_CLIENT_OK) {
+            return E_VHOST_CLIENT_ERR;
+        }
+    }
+
     client_ret_val = (client_vhost_ioctl(l_client, VHOST_USER_SET_MEM_TABLE,
                &l_vhost_client->mem));
     if (client_ret_val != E_CLIENT_OK) {
@@ -310,9 +383,24 @@ vhost_client_vhost_init_control_msgs(Vhost_Client *vhost_client) {
     }
 
     virt_queue_ret_val = virt_queue_set_host_virtq_table(l_vhost_client->sh_mem_virtq_table,
-                VHOST_CLIENT_VRING_MAX_VRINGS, l_client);
+                l_vhost_client->virtq_num, l_client);
+    if (virt_queue_ret_val != E_VIRT_QUEUE_OK) {
+        return virt_queue_ret_val;
+    }
+
+    /* Queues other than the first pair are disabled until enabled. */
+    for (size_t i = 0; l_vhost_client->queue_pairs > 1 &&
+            i < l_vhost_client->virtq_num; i++) {
+        vring_state.index = i;
+        vring_state.num = 1;
+        client_ret_val = client_vhost_ioctl(l_client,
+                VHOST_USER_SET_VRING_ENABLE, &vring_state);
+        if (client_ret_val != E_CLIENT_OK) {
+            return E_VHOST_CLIENT_ERR;
+        }
+    }
 
-    return virt_queue_ret_val;
+    return E_VIRT_QUEUE_OK;
 }
 
 static vhost_net_state
@@ -347,10 +435,21 @@ map_ret_val_vhost_client_2_vhost_net(VHOST_CLIENT_H_RET_VAL vhost_client_ret_val
 int
 init_vhost_net(vhost_net **client,  const char *vhost_client_path ) {
 
+    struct vhost_net_opts opts;
+
+    memset(&opts, 0, sizeof(opts));
+
+    return init_vhost_net_opts(client, vhost_client_path, &opts);
+}
+
+int
+init_vhost_net_opts(vhost_net **client, const char *vhost_client_path,
+        const struct vhost_net_opts *opts) {
+
     Vhost_Client *run_vhost_client= NULL;
     VHOST_CLIENT_H_RET_VAL vhost_client_ret_val = E_VHOST_CLIENT_OK;
 
-    if (!client || !vhost_client_path || !strlen(vhost_client_path)) {
+    if (!client || !opts || !vhost_client_path || !strlen(vhost_client_path)) {
         fprintf(stderr, "%s(): Error initializing vhost net: no client path\n",
             __func__);
         return E_VHOST_NET_ERR_FARG;
@@ -358,7 +457,7 @@ init_vhost_net(vhost_net **client,  const char *vhost_client_path ) {
 
 
     vhost_client_ret_val = vhost_client_run_vhost_client(&run_vhost_client,
-            vhost_client_path);
+            vhost_client_path, opts);
 
     if (vhost_client_ret_val != E_VHOST_CLIENT_OK) {
         return map_ret_val_vhost_client_2_vhost_net(vhost_client_ret_val);
@@ -374,6 +473,8 @@ init_vhost_net(vhost_net **client,  const char *vhost_client_path ) {
     (*client)->context = run_vhost_client;
     (*client)->tx = run_vhost_client->vhost_net_app_handler.tx_func_handler;
     (*client)->rx = run_vhost_client->vhost_net_app_handler.rx_func_handler;
+    (*client)->tx_burst = run_vhost_client->vhost_net_app_handler.tx_burst_func_handler;
+    (*client)->rx_burst = run_vhost_client->vhost_net_app_handler.rx_burst_func_handler;
 
 
     return E_VHOST_NET_OK;
@@ -460,61 +561,58 @@ vhost_client_poll_client_tx(void *context, void *src_buf , size_t *src_buf_len)
 
 }
 
-static inline int
-recv_packet(virtq_control *virtq_control, uint64_t *dst_buf, size_t *dst_buf_len) {
+int
+vhost_client_poll_client_tx_burst(void *context, unsigned int queue,
+        void **bufs, size_t *buf_lens, size_t num) {
 
-    struct virtq_used *used = NULL;
-    struct virtq_desc *desc = NULL;
-    uint16_t last_used_idx = 0;
-    uint64_t num = 0;
-    uintptr_t *data_point = NULL;
-    size_t data_size = 0;
+    Vhost_Client *vhost_client = (Vhost_Client *) context;
 
-    if (!virtq_control || !dst_buf ) {
-        return E_VHOST_CLIENT_ERR_FARG;
+    if (!vhost_client || !bufs || !buf_lens ||
+            queue >= vhost_client->queue_pairs) {
+        return 0;
     }
-     last_used_idx = virtq_control->last_used_idx;
-    used = virtq_control->virtq.used;
-    desc = virtq_control->virtq.desc;
-    num = virtq_control->virtq.num;
 
-    if (last_used_idx != used->idx) {
+    return virt_queue_put_tx_burst_virt_queue(vhost_client->virtq_control,
+            VHOST_CLIENT_VRING_TX(queue), bufs, buf_lens, num,
+            vhost_client->tx_seg_len);
+}
 
-        data_point = (uintptr_t *) ((uintptr_t)desc[used->ring[last_used_idx %num].id].addr
-                + (uintptr_t)sizeof(struct virtio_net_hdr));
-        data_size = used->ring[last_used_idx % num].len - sizeof(struct virtio_net_hdr);
+int
+vhost_client_poll_client_rx_burst(void *context, unsigned int queue,
+        void **bufs, size_t *buf_lens, size_t num) {
 
-        memcpy((void *)(dst_buf), (void*) data_point, data_size);
-        *dst_buf_len = data_size;
+    Vhost_Client *vhost_client = (Vhost_Client *) context;
+    int received;
 
-    } else {
-        return E_VIRT_QUEUE_ERR_RECV_PACKET;
+    if (!vhost_client || !buf_lens || queue >= vhost_client->queue_pairs) {
+        return 0;
     }
-    return E_VIRT_QUEUE_OK;
+
+    received = virt_queue_get_rx_burst_virt_queue(vhost_client->virtq_control,
+            VHOST_CLIENT_VRING_RX(queue), bufs, buf_lens, num);
+    if (received) {
+        vhost_client_refill_rx(vhost_client, VHOST_CLIENT_VRING_RX(queue));
+    }
+
+    return received;
 }
 
 int
 vhost_client_poll_client_rx(void *context, void *dst_buf, size_t *dst_buf_len) {
 
     Vhost_Client *vhost_client = NULL;
-    VHOST_CLIENT_VRING vq_id = VHOST_CLIENT_VRING_IDX_RX;
-    VIRT_QUEUE_H_RET_VAL virt_queue_ret_val = E_VIRT_QUEUE_OK;
 
-    if (!context || !dst_buf ) {
+    if (!context || !dst_buf || !dst_buf_len) {
         return map_ret_val_virt_queue_2_vhost_net(E_VIRT_QUEUE_ERR_FARG);
     }
 
     vhost_client = (Vhost_Client *) context;
 
-    virt_queue_ret_val = recv_packet((vhost_client->virtq_control[vq_id]),
-            (uint64_t *)dst_buf, dst_buf_len);
-    if (virt_queue_ret_val == E_VIRT_QUEUE_OK) {
-        virt_queue_process_used_rx_virt_queue(vhost_client->virtq_control, vq_id);
-        //TODO: Burst
-        virt_queue_put_rx_virt_queue(vhost_client->virtq_control,
-                vq_id, ETH_MAX_MTU);
+    *dst_buf_len = ETH_MAX_MTU;
+    if (vhost_client_poll_client_rx_burst(vhost_client, 0, &dst_buf,
+                dst_buf_len, 1) != 1) {
+        return map_ret_val_virt_queue_2_vhost_net(E_VIRT_QUEUE_ERR_RECV_PACKET);
     }
 
-    return map_ret_val_virt_queue_2_vhost_net(virt_queue_ret_val);
+    return map_ret_val_virt_queue_2_vhost_net(E_VIRT_QUEUE_OK);
 }
-
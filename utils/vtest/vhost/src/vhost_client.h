@@ -11,17 +11,28 @@ struct vhost_client_app_handler {
     void *context;
     tx_rx_packet_handler rx_func_handler;
     tx_rx_packet_handler tx_func_handler;
+    tx_rx_burst_handler rx_burst_func_handler;
+    tx_rx_burst_handler tx_burst_func_handler;
 };
 
+/* Number of receive buffers kept posted to every receive queue. */
+#define VHOST_CLIENT_RX_RING_FILL (1024)
+
 typedef struct Vhost_net_Client {
 
     VhostUserMemory mem;
     size_t page_size;
     size_t virtq_num;
+    size_t queue_pairs;
+    /* Size of the virtio header, depends on mergeable buffers. */
+    size_t hdr_len;
+    size_t rx_buf_len;
+    size_t tx_seg_len;
+    bool mrg_rxbuf;
     // Map RX/TX virtq
     struct uvhost_virtq *sh_mem_virtq_table[VHOST_CLIENT_VRING_MAX_VRINGS];
     struct virtq_control *virtq_control[VHOST_CLIENT_VRING_MAX_VRINGS];
-    uint16_t features;
+    uint64_t features;
     struct vhost_client_app_handler vhost_net_app_handler;
     struct Client client;
 } Vhost_net_Client;
@@ -56,6 +67,10 @@ safer_free(void **mem) {
 
 int vhost_client_poll_client_tx(void *context, void *src_buf , size_t *src_buf_len);
 int vhost_client_poll_client_rx(void *context, void *src_buf , size_t *src_buf_len);
+int vhost_client_poll_client_tx_burst(void *context, unsigned int queue,
+        void **bufs, size_t *buf_lens, size_t num);
+int vhost_client_poll_client_rx_burst(void *context, unsigned int queue,
+        void **bufs, size_t *buf_lens, size_t num);
 
 #endif
 
@@ -7,6 +7,7 @@
 #define VHOST_NET_H
 
 #include <stdlib.h>
+#include <stdbool.h>
 
 typedef enum {
 
@@ -24,15 +25,39 @@ typedef enum {
 } vhost_net_state;
 
 typedef int (*tx_rx_packet_handler)(void *context, void *src_buf, size_t *src_buf_len);
+/*
+ * Burst handlers transfer up to num packets on the queue pair and return
+ * the number of packets transferred. buf_lens[i] is the size of bufs[i] on
+ * receive and gets the length of the received packet.
+ */
+typedef int (*tx_rx_burst_handler)(void *context, unsigned int queue,
+        void **bufs, size_t *buf_lens, size_t num);
 
 typedef struct vhost_net {
     tx_rx_packet_handler rx;
     tx_rx_packet_handler tx;
+    tx_rx_burst_handler rx_burst;
+    tx_rx_burst_handler tx_burst;
     void *context;
 
 } vhost_net;
 
+/* Zeroed options are what init_vhost_net() uses. */
+struct vhost_net_opts {
+    /* Number of queue pairs, one if zero. */
+    unsigned int queue_pairs;
+    /* Negotiate mergeable receive buffers. */
+    bool mrg_rxbuf;
+    /* Size of receive buffers including the virtio header, zero for maximum. */
+    size_t rx_buf_len;
+    /* Size of transmit descriptors including the virtio header, zero for
+     * maximum. Longer packets are put to chains of descriptors. */
+    size_t tx_seg_len;
+};
+
 int init_vhost_net(vhost_net **client,  const char *vhost_client_path );
+int init_vhost_net_opts(vhost_net **client, const char *vhost_client_path,
+        const struct vhost_net_opts *opts);
 int deinit_vhost_net(vhost_net *client);
 #endif
 
@@ -70,9 +70,13 @@ virt_queue_map_uvhost_virtq_2_virtq_control(Vhost_Client *vhost_client) {
         return E_VIRT_QUEUE_ERR_FARG;
     }
 
-    for (size_t vq_id = 0; vq_id < VHOST_CLIENT_VRING_MAX_VRINGS; vq_id++) {
+    for (size_t vq_id = 0; vq_id < vhost_client->virtq_num; vq_id++) {
 
         virtq_control[vq_id]->last_used_idx = 0;
+        virtq_control[vq_id]->avail_idx = 0;
+        virtq_control[vq_id]->free_head = 0;
+        virtq_control[vq_id]->num_free = VIRTQ_DESC_MAX_SIZE;
+        virtq_control[vq_id]->hdr_len = vhost_client->hdr_len;
         virtq_control[vq_id]->kickfd = uvhost_virtq[vq_id]->kickfd;
         virtq_control[vq_id]->callfd = uvhost_virtq[vq_id]->callfd;
         virtq_control[vq_id]->virtq.desc = uvhost_virtq[vq_id]->desc;
@@ -198,6 +202,9 @@ virt_queue_set_host_virtq_table(struct uvhost_virtq **virtq, size_t virtq_table_
     return E_VIRT_QUEUE_OK;
 }
 
+/* Make the ring updates visible to vRouter before the index that exposes them. */
+#define virt_queue_barrier() __sync_synchronize()
+
 static inline void
 init_desc_element(size_t desc_len, struct virtq_desc *desc_id) {
 
@@ -209,7 +216,7 @@ init_desc_element(size_t desc_len, struct virtq_desc *desc_id) {
 }
 
 static inline void
-init_virtio_hdr(void *mem) {
+init_virtio_hdr(void *mem, size_t hdr_len) {
 
     struct virtio_net_hdr *virtio_hdr = (struct virtio_net_hdr *)mem;
 
@@ -220,103 +227,290 @@ init_virtio_hdr(void *mem) {
     virtio_hdr->gso_size = 0;
     virtio_hdr->hdr_len = 0;
 
+    if (hdr_len == sizeof(struct virtio_net_hdr_mrg_rxbuf)) {
+        ((struct virtio_net_hdr_mrg_rxbuf *)mem)->num_buffers = 0;
+    }
+
     return;
 }
 
-/*Copy data from src_buf to desc,
- * currently only single buffer is supported
- *      => src_buf_len MUST NOT be greater than desc[x].len
+/*
+ * Take num chained descriptors from the free list.
+ * Returns the head of the chain or VIRTQ_IDX_NONE if there are not enough.
+ */
+static uint16_t
+virt_queue_alloc_desc(struct virtq_control *vq_ctrl, uint16_t num) {
+
+    struct virtq_desc *desc = vq_ctrl->virtq.desc;
+    uint16_t head, last;
+
+    if (!num || num > vq_ctrl->num_free) {
+        return VIRTQ_IDX_NONE;
+    }
+
+    head = last = vq_ctrl->free_head;
+    for (uint16_t i = 1; i < num; i++) {
+        desc[last].flags = VIRTIO_DESC_F_NEXT;
+        last = desc[last].next;
+    }
+    desc[last].flags = 0;
+
+    vq_ctrl->free_head = desc[last].next;
+    vq_ctrl->num_free -= num;
+    desc[last].next = VIRTQ_IDX_NONE;
+
+    return head;
+}
+
+static inline void
+virt_queue_publish_avail(struct virtq_control *vq_ctrl) {
+
+    virt_queue_barrier();
+    vq_ctrl->virtq.avail->idx = vq_ctrl->avail_idx;
+
+    return;
+}
+
+/*
+ * Copy packets to chains of descriptors, seg_len bytes (including the virtio
+ * header) at most per descriptor, and make the whole burst available to
+ * vRouter at once.
+ *
+ * Returns number of packets put to the queue.
  */
 int
-virt_queue_put_tx_virt_queue(struct virtq_control **virtq_control, VHOST_CLIENT_VRING vq_id,
-        void *src_buf, size_t src_buf_len) {
+virt_queue_put_tx_burst_virt_queue(struct virtq_control **virtq_control,
+        VHOST_CLIENT_VRING vq_id, void **bufs, size_t *buf_lens, size_t num,
+        size_t seg_len) {
+
+    struct virtq_control *vq_ctrl = NULL;
+    struct virtq_desc *desc = NULL;
+    size_t i, copied, tocopy, hdr_len, room, nsegs;
+    uint16_t head, idx;
+    uintptr_t desc_address;
+
+    if (!virtq_control || !bufs || !buf_lens) {
+        return 0;
+    }
 
-    struct virtq_avail* avail = NULL;
-    struct virtq_desc* desc = NULL;
-    struct virtq_used *used = NULL;
+    vq_ctrl = virtq_control[vq_id];
+    desc = vq_ctrl->virtq.desc;
+    hdr_len = vq_ctrl->hdr_len;
 
-    size_t num = 0;
-    uint16_t last_avail_idx = 0;
-    uint16_t last_used_idx = 0;
-    void *desc_address = NULL;
+    if (!seg_len || seg_len > VIRTQ_DESC_BUFF_SIZE) {
+        seg_len = VIRTQ_DESC_BUFF_SIZE;
+    }
+    if (seg_len <= hdr_len) {
+        return 0;
+    }
 
-    if (!virtq_control) {
-        return E_VIRT_QUEUE_ERR_FARG;
+    /* Make room for the new burst. */
+    virt_queue_process_used_tx_virt_queue(virtq_control, vq_id);
+
+    for (i = 0; i < num; i++) {
+        nsegs = (hdr_len + buf_lens[i] + seg_len - 1) / seg_len;
+        if (nsegs > VIRTQ_DESC_MAX_SIZE) {
+            break;
+        }
+
+        head = virt_queue_alloc_desc(vq_ctrl, nsegs);
+        if (head == VIRTQ_IDX_NONE) {
+            break;
+        }
+
+        idx = head;
+        desc_address = (uintptr_t)desc[idx].addr;
+        init_virtio_hdr((void *)desc_address, hdr_len);
+        room = seg_len - hdr_len;
+        desc_address += hdr_len;
+        desc[idx].len = hdr_len;
+
+        for (copied = 0; copied < buf_lens[i]; copied += tocopy) {
+            if (!room) {
+                idx = desc[idx].next;
+                desc_address = (uintptr_t)desc[idx].addr;
+                desc[idx].len = 0;
+                room = seg_len;
+            }
+
+            tocopy = buf_lens[i] - copied;
+            if (tocopy > room) {
+                tocopy = room;
+            }
+
+            memcpy((void *)desc_address, (char *)bufs[i] + copied, tocopy);
+            desc[idx].len += tocopy;
+            desc_address += tocopy;
+            room -= tocopy;
+        }
+
+        vq_ctrl->virtq.avail->ring[vq_ctrl->avail_idx % vq_ctrl->virtq.num] = head;
+        vq_ctrl->avail_idx++;
     }
 
-    used = virtq_control[vq_id]->virtq.used;
-    avail = virtq_control[vq_id]->virtq.avail;
-    desc = virtq_control[vq_id]->virtq.desc;
-    num = virtq_control[vq_id]->virtq.num;
-    last_avail_idx = avail->ring[avail->idx %num];
-    last_used_idx = virtq_control[vq_id]->last_used_idx;
+    if (i) {
+        virt_queue_publish_avail(vq_ctrl);
+    }
+
+    return i;
+}
 
-    if (src_buf_len + sizeof(struct virtio_net_hdr) > desc[last_avail_idx].len) {
+/*
+ * Copy data from src_buf to the queue. Packets not fitting one descriptor
+ * are put to a chain of descriptors.
+ */
+int
+virt_queue_put_tx_virt_queue(struct virtq_control **virtq_control, VHOST_CLIENT_VRING vq_id,
+        void *src_buf, size_t src_buf_len) {
+
+    if (!virtq_control) {
         return E_VIRT_QUEUE_ERR_FARG;
     }
 
-    if ( avail->idx % num < last_used_idx % num && last_used_idx %num  - (avail->idx % num ) <= 1) {
-        return E_VIRT_QUEUE_ERR_SEND_PACKET_SPACE;
-    } else if ( last_used_idx % num < avail->idx % num  && avail->idx % num  - last_used_idx % num> num -1 ) {
-        return E_VIRT_QUEUE_ERR_SEND_PACKET_SPACE;
-    } else if (last_used_idx != used->idx  && avail->idx %num  == last_used_idx %num) {
+    if (virt_queue_put_tx_burst_virt_queue(virtq_control, vq_id, &src_buf,
+                &src_buf_len, 1, 0) != 1) {
         return E_VIRT_QUEUE_ERR_SEND_PACKET_SPACE;
     }
-    desc_address = (void *)(uintptr_t) desc[last_avail_idx].addr;
-    init_virtio_hdr(desc_address);
 
-    memcpy((void *) ((uintptr_t)desc_address + (uintptr_t)sizeof(struct virtio_net_hdr)),
-            src_buf, src_buf_len);
+    return E_VIRT_QUEUE_OK;
+}
+
+/*
+ * Post num empty buffers of buf_len bytes (including the virtio header)
+ * for vRouter to write received packets to.
+ *
+ * Returns number of buffers posted.
+ */
+int
+virt_queue_put_rx_burst_virt_queue(struct virtq_control **virtq_control,
+        VHOST_CLIENT_VRING vq_id, size_t num, size_t buf_len) {
 
-    init_desc_element(sizeof(struct virtio_net_hdr) + src_buf_len, &desc[last_avail_idx]);
+    struct virtq_control *vq_ctrl = NULL;
+    size_t i;
+    uint16_t head;
 
-    avail->ring[avail->idx % num] = last_avail_idx;
-    avail->idx++;
+    if (!virtq_control) {
+        return 0;
+    }
 
+    vq_ctrl = virtq_control[vq_id];
+    if (!buf_len || buf_len > VIRTQ_DESC_BUFF_SIZE) {
+        buf_len = VIRTQ_DESC_BUFF_SIZE;
+    }
 
-    return E_VIRT_QUEUE_OK;
+    for (i = 0; i < num; i++) {
+        head = virt_queue_alloc_desc(vq_ctrl, 1);
+        if (head == VIRTQ_IDX_NONE) {
+            break;
+        }
+
+        init_desc_element(buf_len, &vq_ctrl->virtq.desc[head]);
+        vq_ctrl->virtq.avail->ring[vq_ctrl->avail_idx % vq_ctrl->virtq.num] = head;
+        vq_ctrl->avail_idx++;
+    }
+
+    if (i) {
+        virt_queue_publish_avail(vq_ctrl);
+    }
+
+    return i;
 }
 
 int
 virt_queue_put_rx_virt_queue(struct virtq_control **virtq_control, VHOST_CLIENT_VRING vq_id,
         size_t src_buf_len) {
 
-    struct virtq_avail* avail = NULL;
-    struct virtq_desc* desc = NULL;
-    struct virtq_used *used = NULL;
-
-    size_t num = 0;
-    uint16_t last_avail_idx = 0;
-    uint16_t last_used_idx = 0;
-
     if (!virtq_control) {
         return E_VIRT_QUEUE_ERR_FARG;
     }
 
-    used = virtq_control[vq_id]->virtq.used;
-    avail = virtq_control[vq_id]->virtq.avail;
-    desc = virtq_control[vq_id]->virtq.desc;
-    num = virtq_control[vq_id]->virtq.num;
-    last_avail_idx = avail->ring[avail->idx % num];
-    last_used_idx = virtq_control[vq_id]->last_used_idx;
-
-    if (src_buf_len > desc[last_avail_idx].len) {
+    if (sizeof(struct virtio_net_hdr) + src_buf_len > VIRTQ_DESC_BUFF_SIZE) {
         return E_VIRT_QUEUE_ERR_FARG;
     }
-    if ( avail->idx % num < last_used_idx % num && last_used_idx %num  - (avail->idx % num ) <= 1) {
-        return E_VIRT_QUEUE_ERR_RECV_PACKET_SPACE;
-    } else if ( ((last_used_idx % num ) < (avail->idx % num))  && ((avail->idx % num)  - (last_used_idx % num) > (num -1))) {
-        return E_VIRT_QUEUE_ERR_RECV_PACKET_SPACE;
-    } else if (last_used_idx != used->idx  && avail->idx %num  == last_used_idx %num) {
+
+    if (virt_queue_put_rx_burst_virt_queue(virtq_control, vq_id, 1,
+                sizeof(struct virtio_net_hdr) + src_buf_len) != 1) {
         return E_VIRT_QUEUE_ERR_RECV_PACKET_SPACE;
     }
 
-    init_desc_element(sizeof(struct virtio_net_hdr) + src_buf_len, &desc[last_avail_idx]);
+    return E_VIRT_QUEUE_OK;
+}
 
-    avail->ring[avail->idx % num] = last_avail_idx;
-    avail->idx++;
+/*
+ * Copy up to num received packets from the used ring to bufs, buf_lens[i] is
+ * the size of bufs[i] on input and the length of the packet on output. NULL
+ * bufs only reaps the packets. A packet spanning several mergeable buffers
+ * is copied once all of them are used.
+ *
+ * Returns number of packets received.
+ */
+int
+virt_queue_get_rx_burst_virt_queue(struct virtq_control **virtq_control,
+        VHOST_CLIENT_VRING vq_id, void **bufs, size_t *buf_lens, size_t num) {
 
-    return E_VIRT_QUEUE_OK;
+    struct virtq_control *vq_ctrl = NULL;
+    struct virtq_used *used = NULL;
+    struct virtq_desc *desc = NULL;
+    struct virtq_used_elem *elem;
+    size_t i, b, nbufs, len, copied, tocopy, offset;
+    uint16_t used_idx, last_used_idx;
+    unsigned int ring_num;
+
+    if (!virtq_control || !buf_lens) {
+        return 0;
+    }
+
+    vq_ctrl = virtq_control[vq_id];
+    used = vq_ctrl->virtq.used;
+    desc = vq_ctrl->virtq.desc;
+    ring_num = vq_ctrl->virtq.num;
+    last_used_idx = vq_ctrl->last_used_idx;
+
+    used_idx = used->idx;
+    virt_queue_barrier();
+
+    for (i = 0; i < num && last_used_idx != used_idx; i++) {
+        elem = &used->ring[last_used_idx % ring_num];
+
+        nbufs = 1;
+        if (vq_ctrl->hdr_len == sizeof(struct virtio_net_hdr_mrg_rxbuf)) {
+            nbufs = ((struct virtio_net_hdr_mrg_rxbuf *)(uintptr_t)
+                    desc[elem->id].addr)->num_buffers;
+            if (!nbufs) {
+                nbufs = 1;
+            }
+            if ((uint16_t)(used_idx - last_used_idx) < nbufs) {
+                break;
+            }
+        }
+
+        copied = 0;
+        offset = vq_ctrl->hdr_len;
+        for (b = 0; b < nbufs; b++) {
+            elem = &used->ring[(uint16_t)(last_used_idx + b) % ring_num];
+            len = elem->len > offset ? elem->len - offset : 0;
+
+            if (bufs && bufs[i] && copied < buf_lens[i]) {
+                tocopy = len;
+                if (tocopy > buf_lens[i] - copied) {
+                    tocopy = buf_lens[i] - copied;
+                }
+                memcpy((char *)bufs[i] + copied,
+                        (void *)(uintptr_t)(desc[elem->id].addr + offset), tocopy);
+            }
+
+            copied += len;
+            offset = 0;
+            virt_queue_free_virt_queue(virtq_control, vq_id, elem->id);
+        }
+
+        buf_lens[i] = copied;
+        last_used_idx += nbufs;
+    }
+
+    vq_ctrl->last_used_idx = last_used_idx;
+
+    return i;
 }
 
 
@@ -326,6 +520,7 @@ virt_queue_process_used_tx_virt_queue(struct virtq_control **virtq_control,
 
     struct virtq_used* used = NULL;
     uint16_t last_used_idx = 0;
+    uint16_t used_idx = 0;
     unsigned int num = 0;
 
     if (!virtq_control) {
@@ -336,7 +531,10 @@ virt_queue_process_used_tx_virt_queue(struct virtq_control **virtq_control,
     used = virtq_control[vq_id]->virtq.used;
     last_used_idx = virtq_control[vq_id]->last_used_idx;
 
-    for (;last_used_idx != used->idx; last_used_idx++ ) {
+    used_idx = used->idx;
+    virt_queue_barrier();
+
+    for (;last_used_idx != used_idx; last_used_idx++ ) {
         virt_queue_free_virt_queue(virtq_control, vq_id, used->ring[last_used_idx % num].id);
     }
 
@@ -371,24 +569,35 @@ virt_queue_process_used_rx_virt_queue(struct virtq_control **virtq_control,
     return E_VIRT_QUEUE_OK;
 }
 
+/*
+ * Return the chain of descriptors starting at desc_idx to the free list.
+ */
 int
 virt_queue_free_virt_queue(struct virtq_control **virtq_control, VHOST_CLIENT_VRING vq_id, uint32_t desc_idx) {
 
+    struct virtq_control *vq_ctrl = NULL;
     struct virtq_desc* desc = NULL;
-    uint16_t free_idx = 0;
+    uint16_t last = desc_idx;
+    uint16_t freed = 1;
 
     if (!virtq_control) {
         return E_VIRT_QUEUE_ERR_FARG;
     }
 
-    desc = virtq_control[vq_id]->virtq.desc;
-    free_idx = virtq_control[vq_id]->virtq.avail->ring[virtq_control[vq_id]->virtq.avail->idx];;
+    vq_ctrl = virtq_control[vq_id];
+    desc = vq_ctrl->virtq.desc;
+
+    while (desc[last].flags & VIRTIO_DESC_F_NEXT) {
+        desc[last].len = VIRTQ_DESC_BUFF_SIZE;
+        last = desc[last].next;
+        freed++;
+    }
 
-    desc[desc_idx].len = VIRTQ_DESC_BUFF_SIZE;
-    desc[desc_idx].flags |= VIRTIO_DESC_F_WRITE | VRING_AVAIL_F_NO_INTERRUPT;
-    desc[desc_idx].next = free_idx;
+    desc[last].len = VIRTQ_DESC_BUFF_SIZE;
+    desc[last].flags = VIRTIO_DESC_F_WRITE;
+    desc[last].next = vq_ctrl->free_head;
+    vq_ctrl->free_head = desc_idx;
+    vq_ctrl->num_free += freed;
 
     return E_VIRT_QUEUE_OK;
 }
-
-
@@ -90,6 +90,13 @@ struct virtq {
 typedef struct virtq_control {
     struct virtq virtq;
     uint16_t last_used_idx;
+    /* avail->idx to be published with the next burst */
+    uint16_t avail_idx;
+    /* Free descriptors are chained via next starting at free_head. */
+    uint16_t free_head;
+    uint16_t num_free;
+    /* virtio_net_hdr or virtio_net_hdr_mrg_rxbuf */
+    uint16_t hdr_len;
     int kickfd;
     int callfd;
 } virtq_control;
@@ -119,6 +126,12 @@ typedef enum {
 
 int virt_queue_put_tx_virt_queue(struct virtq_control **virtq_control, VHOST_CLIENT_VRING vq_id, void *src_buf, size_t src_buf_len);
 int virt_queue_put_rx_virt_queue(struct virtq_control **virtq_control, VHOST_CLIENT_VRING vq_id, size_t src_buf_len);
+int virt_queue_put_tx_burst_virt_queue(struct virtq_control **virtq_control, VHOST_CLIENT_VRING vq_id,
+        void **bufs, size_t *buf_lens, size_t num, size_t seg_len);
+int virt_queue_put_rx_burst_virt_queue(struct virtq_control **virtq_control, VHOST_CLIENT_VRING vq_id,
+        size_t num, size_t buf_len);
+int virt_queue_get_rx_burst_virt_queue(struct virtq_control **virtq_control, VHOST_CLIENT_VRING vq_id,
+        void **bufs, size_t *buf_lens, size_t num);
 int virt_queue_process_used_tx_virt_queue(struct virtq_control **virtq_control, VHOST_CLIENT_VRING vq_id);
 int virt_queue_process_used_rx_virt_queue(struct virtq_control **virtq_control, VHOST_CLIENT_VRING vq_id);
 int virt_queue_free_virt_queue(struct virtq_control **virtq_control, VHOST_CLIENT_VRING vq_id, uint32_t desc_idx);
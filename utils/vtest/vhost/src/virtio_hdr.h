@@ -19,5 +19,12 @@ struct virtio_net_hdr {
     uint16_t csum_start;
     uint16_t csum_offset;
 };
+
+/* Header used in both directions once VIRTIO_NET_F_MRG_RXBUF is negotiated. */
+struct virtio_net_hdr_mrg_rxbuf {
+    struct virtio_net_hdr hdr;
+    /* Number of used buffers the received packet spans. */
+    uint16_t num_buffers;
+};
 #endif
 
@@ -62,6 +62,10 @@ struct vtest_module vt_modules[] = {
         .vt_name        =   "packet",
         .vt_node        =   vt_packet,
     },
+    {
+        .vt_name        =   "performance",
+        .vt_node        =   vt_performance,
+    },
 };
 
 const size_t VTEST_NUM_MODULES = ARRAYSIZE(vt_modules);
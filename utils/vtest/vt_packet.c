@@ -4,6 +4,7 @@
 #include <limits.h>
 #include <time.h>
 #include <unistd.h>
+#include <inttypes.h>
 
 #include <libxml/xmlmemory.h>
 #include <libxml/parser.h>
@@ -127,6 +128,96 @@ vt_packet(xmlNodePtr node, struct vtest *test)
     return E_PACKET_OK;
 }
 
+static unsigned short
+vt_packet_vif_index(xmlNodePtr node)
+{
+    node = node->xmlChildrenNode;
+    while (node) {
+        if (node->type == XML_ELEMENT_NODE &&
+                node->children && node->children->content) {
+            return strtoul(node->children->content, NULL, 0);
+        }
+        node = node->next;
+    }
+
+    return 0;
+}
+
+/*
+ * Parse XML structure of a performance test and set structure performance
+ * (vtest.h)
+ */
+int
+vt_performance(xmlNodePtr node, struct vtest *test)
+{
+    char *content;
+    struct performance *perf = &test->performance;
+
+    memset(perf, 0, sizeof(*perf));
+    perf->packets = VT_PERF_DEF_PACKETS;
+    perf->burst = VT_PERF_DEF_BURST;
+    perf->queue_pairs = 1;
+    perf->latency_samples = VT_PERF_DEF_LATENCY_SAMPLES;
+
+    node = node->xmlChildrenNode;
+    while (node) {
+        if (node->type != XML_ELEMENT_NODE) {
+            node = node->next;
+            continue;
+        }
+
+        content = NULL;
+        if (node->children && node->children->content) {
+            content = (char *)node->children->content;
+        }
+
+        if (!strcmp(node->name, "tx_interface")) {
+            perf->tx_vif_id = vt_packet_vif_index(node);
+        } else if (!strcmp(node->name, "rx_interface")) {
+            perf->rx_vif_id = vt_packet_vif_index(node);
+        } else if (!content) {
+            fprintf(stderr, "%s(): Element %s has no value\n", __func__,
+                node->name);
+            return E_PACKET_FARG_ERR;
+        } else if (!strcmp(node->name, "pcap_input_file")) {
+            vt_fname_assign(test, perf->pcap_file, content);
+        } else if (!strcmp(node->name, "packets")) {
+            perf->packets = strtoull(content, NULL, 0);
+        } else if (!strcmp(node->name, "burst")) {
+            perf->burst = strtoul(content, NULL, 0);
+        } else if (!strcmp(node->name, "queues")) {
+            perf->queue_pairs = strtoul(content, NULL, 0);
+        } else if (!strcmp(node->name, "mrg_rxbuf")) {
+            perf->mrg_rxbuf = !!strtoul(content, NULL, 0);
+        } else if (!strcmp(node->name, "rx_buffer_size")) {
+            perf->rx_buf_len = strtoul(content, NULL, 0);
+        } else if (!strcmp(node->name, "tx_segment_size")) {
+            perf->tx_seg_len = strtoul(content, NULL, 0);
+        } else if (!strcmp(node->name, "latency_samples")) {
+            perf->latency_samples = strtoul(content, NULL, 0);
+        } else if (!strcmp(node->name, "min_pps")) {
+            perf->min_pps = strtoull(content, NULL, 0);
+        } else if (!strcmp(node->name, "max_loss")) {
+            perf->max_loss = strtod(content, NULL);
+        } else {
+            fprintf(stderr, "%s(): Unknown element %s\n", __func__, node->name);
+            return E_PACKET_FARG_ERR;
+        }
+
+        node = node->next;
+    }
+
+    if (!strlen(perf->pcap_file) || !perf->burst ||
+            perf->burst > VT_PERF_MAX_BURST || !perf->queue_pairs) {
+        fprintf(stderr, "%s(): Performance test needs a pcap_input_file,"
+            " burst of 1 to %d and at least one queue\n", __func__,
+            VT_PERF_MAX_BURST);
+        return E_PACKET_FARG_ERR;
+    }
+
+    return E_PACKET_OK;
+}
+
 int
 pcap_compare(char *pcap_file_1, char *pcap_file_2) {
 
@@ -370,3 +461,238 @@ tx_rx_pcap_test(struct vtest *test) {
 }
 
 
+
+static inline uint64_t
+vt_perf_now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int
+vt_perf_cmp_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+/* Receive whatever is ready on all queue pairs, without copying it. */
+static uint64_t
+vt_perf_rx(vhost_net *rx, unsigned int queue_pairs, size_t *lens,
+        unsigned int burst, uint64_t *bytes)
+{
+    unsigned int q;
+    int i, n;
+    uint64_t received = 0;
+
+    for (q = 0; q < queue_pairs; q++) {
+        do {
+            n = rx->rx_burst(rx->context, q, NULL, lens, burst);
+            for (i = 0; i < n; i++) {
+                *bytes += lens[i];
+            }
+            received += n;
+        } while (n == (int)burst);
+    }
+
+    return received;
+}
+
+/*
+ * Load the frames of the pcap file, which the test then sends in a loop.
+ */
+static int
+vt_perf_load_pcap(struct performance *perf, u_char ***frames, size_t **lens,
+        size_t *num)
+{
+    char errbuf[PCAP_ERRBUF_SIZE];
+    struct pcap_pkthdr *pkt_header;
+    const u_char *pkt_data;
+    pcap_t *p;
+    size_t n = 0;
+
+    p = pcap_open_offline(perf->pcap_file, errbuf);
+    if (!p) {
+        fprintf(stderr, "%s(): Error opening pcap offline: %s\n",
+            __func__, errbuf);
+        return E_PACKET_PCAP_SETUP_TEST_ERR;
+    }
+
+    *frames = calloc(VT_PERF_MAX_FRAMES, sizeof(**frames));
+    *lens = calloc(VT_PERF_MAX_FRAMES, sizeof(**lens));
+    if (!*frames || !*lens) {
+        pcap_close(p);
+        return E_PACKET_ERR;
+    }
+
+    while (n < VT_PERF_MAX_FRAMES &&
+            pcap_next_ex(p, &pkt_header, &pkt_data) == 1) {
+        (*frames)[n] = malloc(pkt_header->caplen);
+        if (!(*frames)[n])
+            break;
+        memcpy((*frames)[n], pkt_data, pkt_header->caplen);
+        (*lens)[n++] = pkt_header->caplen;
+    }
+    pcap_close(p);
+
+    *num = n;
+    if (!n) {
+        fprintf(stderr, "%s(): No packets in %s\n", __func__, perf->pcap_file);
+        return E_PACKET_PCAP_SETUP_TEST_ERR;
+    }
+
+    return E_PACKET_OK;
+}
+
+/*
+ * Send the pcap file from one vif to another in bursts to measure the
+ * throughput, then packet by packet to measure the latency.
+ */
+int
+run_performance_test(struct vtest *test)
+{
+    int ret = E_PACKET_OK, sent_now;
+    unsigned int i, q = 0, samples = 0;
+    size_t num_frames = 0, *frame_lens = NULL;
+    size_t tx_lens[VT_PERF_MAX_BURST], rx_lens[VT_PERF_MAX_BURST];
+    void *tx_bufs[VT_PERF_MAX_BURST];
+    u_char **frames = NULL;
+    uint64_t sent = 0, received = 0, rx_bytes = 0, got, n;
+    uint64_t start, last_progress, last_rx, now, *latency = NULL, lat_sum = 0;
+    double secs, loss, tx_pps, rx_pps;
+    char src_vif_ctrl_sock[UNIX_PATH_MAX] = {0};
+    char dst_vif_ctrl_sock[UNIX_PATH_MAX] = {0};
+    vhost_net *tx = NULL, *rx = NULL;
+    struct vhost_net_opts opts;
+    struct performance *perf = &test->performance;
+
+    ret = vt_perf_load_pcap(perf, &frames, &frame_lens, &num_frames);
+    if (ret != E_PACKET_OK)
+        goto cleanup;
+
+    snprintf(src_vif_ctrl_sock, UNIX_PATH_MAX, "%s/uvh_vif_%d",
+        vr_socket_dir, perf->tx_vif_id);
+    snprintf(dst_vif_ctrl_sock, UNIX_PATH_MAX, "%s/uvh_vif_%d",
+        vr_socket_dir, perf->rx_vif_id);
+
+    memset(&opts, 0, sizeof(opts));
+    opts.queue_pairs = perf->queue_pairs;
+    opts.mrg_rxbuf = perf->mrg_rxbuf;
+    opts.rx_buf_len = perf->rx_buf_len;
+    opts.tx_seg_len = perf->tx_seg_len;
+
+    if (init_vhost_net_opts(&tx, src_vif_ctrl_sock, &opts) != E_VHOST_NET_OK ||
+            init_vhost_net_opts(&rx, dst_vif_ctrl_sock, &opts) != E_VHOST_NET_OK) {
+        ret = E_PACKET_ERR;
+        goto cleanup;
+    }
+
+    /* Give vRouter the time to start polling the new queues. */
+    sleep(1);
+
+    start = last_progress = last_rx = vt_perf_now_ns();
+    while (true) {
+        sent_now = 0;
+        if (sent < perf->packets) {
+            n = perf->packets - sent;
+            if (n > perf->burst)
+                n = perf->burst;
+            for (i = 0; i < n; i++) {
+                tx_bufs[i] = frames[(sent + i) % num_frames];
+                tx_lens[i] = frame_lens[(sent + i) % num_frames];
+            }
+
+            sent_now = tx->tx_burst(tx->context, q, tx_bufs, tx_lens, n);
+            sent += sent_now;
+            q = (q + 1) % perf->queue_pairs;
+        } else if (received >= sent) {
+            break;
+        }
+
+        got = vt_perf_rx(rx, perf->queue_pairs, rx_lens, perf->burst,
+                &rx_bytes);
+        received += got;
+
+        now = vt_perf_now_ns();
+        if (got)
+            last_rx = now;
+        if (got || sent_now)
+            last_progress = now;
+        else if (now - last_progress > VT_PERF_IDLE_TIMEOUT_NS)
+            break;
+    }
+
+    secs = (double)(last_rx - start) / 1e9;
+    loss = sent ? 100.0 * (double)(sent - received) / sent : 0;
+    tx_pps = secs > 0 ? sent / secs : 0;
+    rx_pps = secs > 0 ? received / secs : 0;
+
+    printf("Performance: %" PRIu64 " packets sent, %" PRIu64
+        " received (%.2f%% loss) in %.3f s\n", sent, received, loss, secs);
+    printf("Performance: TX %.0f pps, RX %.0f pps, RX %.1f Mbps"
+        " (%u queue pairs, burst %u%s)\n", tx_pps, rx_pps,
+        secs > 0 ? rx_bytes * 8 / secs / 1e6 : 0, perf->queue_pairs,
+        perf->burst, perf->mrg_rxbuf ? ", mergeable buffers" : "");
+
+    if (perf->latency_samples) {
+        latency = calloc(perf->latency_samples, sizeof(*latency));
+        if (!latency) {
+            ret = E_PACKET_ERR;
+            goto cleanup;
+        }
+    }
+
+    for (i = 0; i < perf->latency_samples; i++) {
+        /* Whatever arrives late from the previous sample is not counted. */
+        vt_perf_rx(rx, perf->queue_pairs, rx_lens, perf->burst, &rx_bytes);
+
+        tx_bufs[0] = frames[i % num_frames];
+        tx_lens[0] = frame_lens[i % num_frames];
+        start = vt_perf_now_ns();
+        if (tx->tx_burst(tx->context, 0, tx_bufs, tx_lens, 1) != 1)
+            continue;
+
+        do {
+            now = vt_perf_now_ns();
+            if (vt_perf_rx(rx, perf->queue_pairs, rx_lens, 1, &rx_bytes)) {
+                latency[samples] = now - start;
+                lat_sum += latency[samples++];
+                break;
+            }
+        } while (now - start < VT_PERF_LATENCY_TIMEOUT_NS);
+    }
+
+    if (samples) {
+        qsort(latency, samples, sizeof(*latency), vt_perf_cmp_u64);
+        printf("Latency (us): min %.1f avg %.1f p50 %.1f p99 %.1f max %.1f"
+            " (%u of %u samples)\n", latency[0] / 1e3,
+            (double)lat_sum / samples / 1e3, latency[samples / 2] / 1e3,
+            latency[(samples * 99) / 100] / 1e3, latency[samples - 1] / 1e3,
+            samples, perf->latency_samples);
+    }
+
+    test->vtest_return = E_MAIN_TEST_PASS;
+    if (!received ||
+            (perf->max_loss && loss > perf->max_loss) ||
+            (perf->min_pps && rx_pps < perf->min_pps)) {
+        fprintf(stderr, "%s(): Performance below the expected\n", __func__);
+        test->vtest_return = E_MAIN_TEST_FAIL;
+    }
+
+cleanup:
+    if (tx)
+        deinit_vhost_net(tx);
+    if (rx)
+        deinit_vhost_net(rx);
+
+    for (i = 0; frames && i < num_frames; i++)
+        free(frames[i]);
+    free(frames);
+    free(frame_lens);
+    free(latency);
+
+    return ret;
+}
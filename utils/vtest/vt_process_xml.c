@@ -182,6 +182,22 @@ vt_post_process_packet(struct vtest *test) {
     return E_PROCESS_XML_OK;
 }
 
+#ifndef _WIN32
+static int inline
+vt_post_process_performance(struct vtest *test) {
+
+    int ret = 0;
+
+    ret = run_performance_test(test);
+    if (ret != E_PACKET_OK) {
+        test->vtest_return = E_MAIN_TEST_FAIL;
+        return E_PROCESS_XML_ERR;
+    }
+
+    return E_PROCESS_XML_OK;
+}
+#endif
+
 static int
 vt_post_process_node(xmlNodePtr node, struct vtest *test) {
 
@@ -200,6 +216,10 @@ vt_post_process_node(xmlNodePtr node, struct vtest *test) {
     if(!strncmp((char *) node->name, "packet", sizeof("packet"))) {
         ret = vt_post_process_packet(test);
     }
+
+    if (!strncmp((char *) node->name, "performance", sizeof("performance"))) {
+        ret = vt_post_process_performance(test);
+    }
 #endif
 
     return ret;
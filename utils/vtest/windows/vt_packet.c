@@ -18,3 +18,10 @@ vt_packet(xmlNodePtr node, struct vtest *test)
     fprintf(stderr, "packet node is not supported on Windows, skipping\n");
     return EXIT_SUCCESS;
 }
+
+int
+vt_performance(xmlNodePtr node, struct vtest *test)
+{
+    fprintf(stderr, "performance node is not supported on Windows, skipping\n");
+    return EXIT_SUCCESS;
+}
@@ -78,6 +78,14 @@ vr_table_map(int major, unsigned int table, char *table_path, size_t size, void
     return true;
 }
 
+/* the statistics region is not mapped on Windows */
+int
+vr_stats_shm_read(void *shm, unsigned int section, unsigned int slot,
+        int cpu, uint64_t *counters, unsigned int words)
+{
+    return -EOPNOTSUPP;
+}
+
 int
 nl_sendmsg(struct nl_client *cl)
 {
@@ -133,6 +133,7 @@ win_pfree(struct vr_packet *pkt, unsigned short reason)
 
     if (router)
         ((uint64_t *)(router->vr_pdrop_stats[cpu]))[reason]++;
+    VR_DROP_CAPTURE(pkt, reason);
 
     win_free_packet(pkt);
 }
@@ -808,7 +809,8 @@ win_get_udp_src_port(struct vr_packet *pkt, struct vr_forwarding_md *md,
     if (pkt_head_len(pkt) < ETH_HLEN)
         return 0;
 
-    hashval = vr_hash(pkt_data(pkt), ETH_HLEN, vr_hashrnd);
+    hashval = vr_hash_key(vr_hash_crc32c_enabled, pkt_data(pkt), ETH_HLEN,
+            vr_hashrnd);
     hashval = vr_hash_2words(hashval, vrf, vr_hashrnd);
 
     port_range = VR_MUDP_PORT_RANGE_END - VR_MUDP_PORT_RANGE_START;
@@ -65,6 +65,10 @@ __forceinline UINT16 vr_sync_fetch_and_or_16u(UINT16 *ptr, UINT16 val) {
     return InterlockedOr16((PSHORT)ptr, (SHORT)val);
 }
 
+__forceinline UINT64 vr_sync_fetch_and_or_64u(UINT64 *ptr, UINT64 val) {
+    return InterlockedOr64((PLONGLONG)ptr, (LONGLONG)val);
+}
+
 
 __forceinline UINT16 vr_sync_and_and_fetch_16u(UINT16 *ptr, UINT16 val) {
     return InterlockedAnd16((PSHORT)ptr, (SHORT)val) & ((SHORT)val);
@@ -105,6 +109,10 @@ __forceinline UINT8 vr_sync_lock_test_and_set_8u(UINT8 *ptr, UINT8 val) {
     return InterlockedExchange8((PCHAR)ptr, val);
 }
 
+__forceinline UINT64 vr_sync_lock_test_and_set_64u(UINT64 *ptr, UINT64 val) {
+    return InterlockedExchange64((PLONGLONG)ptr, (LONGLONG)val);
+}
+
 
 __forceinline void vr_sync_synchronize() {
     _ReadWriteBarrier();    // compiler memory barrier (compiler level fence)